@@ -0,0 +1,446 @@
+// FMI 2.0 co-simulation entry points for the power unit, built as the
+// f1pu shared library packed into f1pu.fmu. The variable table is in
+// include/fmu.hpp.
+#include "fmi2.hpp"
+#include "../include/fmu.hpp"
+#include "../include/ice_engine.hpp"
+#include "../include/telemetry.hpp"
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace {
+
+enum class Phase { INSTANTIATED, INITIALIZATION, STEPPING, TERMINATED };
+
+// What fmi2GetFMUstate captures
+struct State {
+  ICEEngine engine;
+  double time = 0.0;
+  int64_t steps = 0; // physics steps since the start time
+};
+
+struct Instance {
+  std::string name;
+  const fmi2CallbackFunctions *callbacks = nullptr;
+  bool logging = false;
+  Phase phase = Phase::INSTANTIATED;
+
+  // Parameters
+  EngineParams params;
+  double step_size = 1e-4;
+  double ecu_period = Ecu::kDefaultPeriod;
+  bool ers_external = false;
+
+  double inputs[kFmuInputs] = {};
+  double start_time = 0.0;
+  std::unique_ptr<State> state; // from fmi2EnterInitializationMode on
+};
+
+void logMessage(const Instance *inst, fmi2Status status,
+                const char *category, const std::string &message) {
+  if (!inst || !inst->callbacks || !inst->callbacks->logger)
+    return;
+  if (!inst->logging && status < fmi2Error)
+    return;
+  inst->callbacks->logger(inst->callbacks->componentEnvironment,
+                          inst->name.c_str(), status, category, "%s",
+                          message.c_str());
+}
+
+fmi2Status fail(const Instance *inst, const std::string &message) {
+  logMessage(inst, fmi2Error, "logStatusError", message);
+  return fmi2Error;
+}
+
+// Parameters are fixed once stepping starts
+bool parametersSettable(const Instance *inst) {
+  return inst->phase == Phase::INSTANTIATED ||
+         inst->phase == Phase::INITIALIZATION;
+}
+
+void buildState(Instance *inst) {
+  inst->state = std::make_unique<State>(State{ICEEngine(inst->params)});
+  inst->state->time = inst->start_time;
+  Ecu &ecu = inst->state->engine.getEcu();
+  ecu.setControlPeriod(inst->ecu_period);
+  if (inst->ers_external) {
+    ecu.setBoostStrategy(std::make_unique<ManualBoost<double>>());
+    ecu.setDeploymentStrategy(std::make_unique<ManualDeployment<double>>());
+  }
+}
+
+// Inputs take effect from the next physics step
+void applyInputs(Instance *inst) {
+  ICEEngine &engine = inst->state->engine;
+  engine.setThrottle(inst->inputs[0]);
+  engine.setExternalLoadTorque(inst->inputs[3]);
+  if (inst->ers_external) {
+    Ecu &ecu = engine.getEcu();
+    ecu.setBoostStrategy(
+        std::make_unique<ManualBoost<double>>(inst->inputs[2]));
+    ecu.setDeploymentStrategy(
+        std::make_unique<ManualDeployment<double>>(inst->inputs[1]));
+  }
+}
+
+double *tunable(EngineParams &params, unsigned index) {
+  double *found = nullptr;
+  unsigned k = 0;
+  forEachParameter(params, [&](const char *, double &field) {
+    if (k++ == index)
+      found = &field;
+  });
+  return found;
+}
+
+Instance *instance(fmi2Component c) { return static_cast<Instance *>(c); }
+
+} // namespace
+
+// --------------------------------------------------
+// INQUIRY AND LIFECYCLE
+// --------------------------------------------------
+
+FMI2_EXPORT const char *fmi2GetTypesPlatform() { return "default"; }
+
+FMI2_EXPORT const char *fmi2GetVersion() { return "2.0"; }
+
+FMI2_EXPORT fmi2Status fmi2SetDebugLogging(fmi2Component c,
+                                           fmi2Boolean loggingOn, size_t,
+                                           const fmi2String[]) {
+  instance(c)->logging = loggingOn != fmi2False;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Component
+fmi2Instantiate(fmi2String instanceName, fmi2Type fmuType, fmi2String fmuGUID,
+                fmi2String, const fmi2CallbackFunctions *functions,
+                fmi2Boolean, fmi2Boolean loggingOn) {
+  Instance probe;
+  probe.name = instanceName ? instanceName : "";
+  probe.callbacks = functions;
+  if (fmuType != fmi2CoSimulation) {
+    fail(&probe, "only co-simulation is supported");
+    return nullptr;
+  }
+  if (!fmuGUID || fmuGuid() != fmuGUID) {
+    fail(&probe, "GUID does not match this binary");
+    return nullptr;
+  }
+
+  Instance *inst = new Instance(std::move(probe));
+  inst->logging = loggingOn != fmi2False;
+  return inst;
+}
+
+FMI2_EXPORT void fmi2FreeInstance(fmi2Component c) { delete instance(c); }
+
+FMI2_EXPORT fmi2Status fmi2SetupExperiment(fmi2Component c, fmi2Boolean,
+                                           fmi2Real, fmi2Real startTime,
+                                           fmi2Boolean, fmi2Real) {
+  Instance *inst = instance(c);
+  if (inst->phase != Phase::INSTANTIATED)
+    return fail(inst, "fmi2SetupExperiment after initialization");
+  inst->start_time = startTime;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2EnterInitializationMode(fmi2Component c) {
+  Instance *inst = instance(c);
+  if (inst->phase != Phase::INSTANTIATED)
+    return fail(inst, "fmi2EnterInitializationMode called twice");
+  if (!(inst->step_size > 0.0) || !(inst->ecu_period > 0.0))
+    return fail(inst, "step_size and ecu_period must be positive");
+  buildState(inst);
+  inst->phase = Phase::INITIALIZATION;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2ExitInitializationMode(fmi2Component c) {
+  Instance *inst = instance(c);
+  if (inst->phase != Phase::INITIALIZATION)
+    return fail(inst, "fmi2ExitInitializationMode outside initialization");
+  inst->phase = Phase::STEPPING;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2Terminate(fmi2Component c) {
+  instance(c)->phase = Phase::TERMINATED;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2Reset(fmi2Component c) {
+  Instance *inst = instance(c);
+  Instance fresh;
+  fresh.name = std::move(inst->name);
+  fresh.callbacks = inst->callbacks;
+  fresh.logging = inst->logging;
+  *inst = std::move(fresh);
+  return fmi2OK;
+}
+
+// --------------------------------------------------
+// VARIABLE ACCESS
+// --------------------------------------------------
+
+FMI2_EXPORT fmi2Status fmi2GetReal(fmi2Component c,
+                                   const fmi2ValueReference vr[], size_t nvr,
+                                   fmi2Real value[]) {
+  Instance *inst = instance(c);
+  for (size_t i = 0; i < nvr; i++) {
+    unsigned r = vr[i];
+    if (r >= kFmuInputBase && r < kFmuInputBase + kFmuInputs) {
+      value[i] = inst->inputs[r - kFmuInputBase];
+    } else if (r >= kFmuOutputBase &&
+               r < kFmuOutputBase + kTelemetryChannels) {
+      if (!inst->state)
+        return fail(inst, "outputs are available from initialization on");
+      value[i] =
+          telemetryChannels[r - kFmuOutputBase].sample(inst->state->engine);
+    } else if (double *p = r >= kFmuTunableBase
+                               ? tunable(inst->params, r - kFmuTunableBase)
+                               : nullptr) {
+      value[i] = *p;
+    } else if (r == kFmuStepSizeVr) {
+      value[i] = inst->step_size;
+    } else if (r == kFmuEcuPeriodVr) {
+      value[i] = inst->ecu_period;
+    } else {
+      return fail(inst, "unknown Real value reference " + std::to_string(r));
+    }
+  }
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2SetReal(fmi2Component c,
+                                   const fmi2ValueReference vr[], size_t nvr,
+                                   const fmi2Real value[]) {
+  Instance *inst = instance(c);
+  bool rebuild = false;
+  for (size_t i = 0; i < nvr; i++) {
+    unsigned r = vr[i];
+    if (r >= kFmuInputBase && r < kFmuInputBase + kFmuInputs) {
+      inst->inputs[r - kFmuInputBase] = value[i];
+      continue;
+    }
+    if (!parametersSettable(inst))
+      return fail(inst, "parameters are fixed after initialization");
+    if (double *p = r >= kFmuTunableBase
+                        ? tunable(inst->params, r - kFmuTunableBase)
+                        : nullptr)
+      *p = value[i];
+    else if (r == kFmuStepSizeVr)
+      inst->step_size = value[i];
+    else if (r == kFmuEcuPeriodVr)
+      inst->ecu_period = value[i];
+    else
+      return fail(inst, "Real value reference " + std::to_string(r) +
+                            " cannot be set");
+    rebuild = true;
+  }
+  // A parameter set during initialization applies to the initial state
+  if (rebuild && inst->state)
+    buildState(inst);
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2GetBoolean(fmi2Component c,
+                                      const fmi2ValueReference vr[],
+                                      size_t nvr, fmi2Boolean value[]) {
+  Instance *inst = instance(c);
+  for (size_t i = 0; i < nvr; i++) {
+    if (vr[i] != kFmuErsExternalVr)
+      return fail(inst, "unknown Boolean value reference " +
+                            std::to_string(vr[i]));
+    value[i] = inst->ers_external ? fmi2True : fmi2False;
+  }
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2SetBoolean(fmi2Component c,
+                                      const fmi2ValueReference vr[],
+                                      size_t nvr, const fmi2Boolean value[]) {
+  Instance *inst = instance(c);
+  for (size_t i = 0; i < nvr; i++) {
+    if (vr[i] != kFmuErsExternalVr)
+      return fail(inst, "unknown Boolean value reference " +
+                            std::to_string(vr[i]));
+    if (!parametersSettable(inst))
+      return fail(inst, "parameters are fixed after initialization");
+    inst->ers_external = value[i] != fmi2False;
+  }
+  if (nvr > 0 && inst->state)
+    buildState(inst);
+  return fmi2OK;
+}
+
+// No Integer or String variables
+FMI2_EXPORT fmi2Status fmi2GetInteger(fmi2Component c,
+                                      const fmi2ValueReference[], size_t nvr,
+                                      fmi2Integer[]) {
+  return nvr ? fail(instance(c), "no Integer variables") : fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2SetInteger(fmi2Component c,
+                                      const fmi2ValueReference[], size_t nvr,
+                                      const fmi2Integer[]) {
+  return nvr ? fail(instance(c), "no Integer variables") : fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2GetString(fmi2Component c,
+                                     const fmi2ValueReference[], size_t nvr,
+                                     fmi2String[]) {
+  return nvr ? fail(instance(c), "no String variables") : fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2SetString(fmi2Component c,
+                                     const fmi2ValueReference[], size_t nvr,
+                                     const fmi2String[]) {
+  return nvr ? fail(instance(c), "no String variables") : fmi2OK;
+}
+
+// --------------------------------------------------
+// FMU STATE
+// --------------------------------------------------
+
+FMI2_EXPORT fmi2Status fmi2GetFMUstate(fmi2Component c,
+                                       fmi2FMUstate *FMUstate) {
+  Instance *inst = instance(c);
+  if (!inst->state)
+    return fail(inst, "no state before initialization");
+  if (*FMUstate)
+    *static_cast<State *>(*FMUstate) = *inst->state;
+  else
+    *FMUstate = new State(*inst->state);
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2SetFMUstate(fmi2Component c,
+                                       fmi2FMUstate FMUstate) {
+  Instance *inst = instance(c);
+  if (!FMUstate)
+    return fail(inst, "null FMU state");
+  if (!inst->state)
+    inst->state = std::make_unique<State>(*static_cast<State *>(FMUstate));
+  else
+    *inst->state = *static_cast<State *>(FMUstate);
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2FreeFMUstate(fmi2Component,
+                                        fmi2FMUstate *FMUstate) {
+  delete static_cast<State *>(*FMUstate);
+  *FMUstate = nullptr;
+  return fmi2OK;
+}
+
+// canSerializeFMUstate="false": the ECU strategies are polymorphic objects
+FMI2_EXPORT fmi2Status fmi2SerializedFMUstateSize(fmi2Component c,
+                                                  fmi2FMUstate, size_t *) {
+  return fail(instance(c), "FMU state serialization is not supported");
+}
+
+FMI2_EXPORT fmi2Status fmi2SerializeFMUstate(fmi2Component c, fmi2FMUstate,
+                                             fmi2Byte[], size_t) {
+  return fail(instance(c), "FMU state serialization is not supported");
+}
+
+FMI2_EXPORT fmi2Status fmi2DeSerializeFMUstate(fmi2Component c,
+                                               const fmi2Byte[], size_t,
+                                               fmi2FMUstate *) {
+  return fail(instance(c), "FMU state serialization is not supported");
+}
+
+FMI2_EXPORT fmi2Status fmi2GetDirectionalDerivative(
+    fmi2Component c, const fmi2ValueReference[], size_t,
+    const fmi2ValueReference[], size_t, const fmi2Real[], fmi2Real[]) {
+  return fail(instance(c), "directional derivatives are not provided");
+}
+
+// --------------------------------------------------
+// CO-SIMULATION
+// --------------------------------------------------
+
+FMI2_EXPORT fmi2Status fmi2SetRealInputDerivatives(
+    fmi2Component c, const fmi2ValueReference[], size_t nvr,
+    const fmi2Integer[], const fmi2Real[]) {
+  return nvr ? fail(instance(c), "inputs are not interpolated") : fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2GetRealOutputDerivatives(
+    fmi2Component c, const fmi2ValueReference[], size_t nvr,
+    const fmi2Integer[], fmi2Real[]) {
+  return nvr ? fail(instance(c), "output derivatives are not provided")
+             : fmi2OK;
+}
+
+// Advances whole physics steps up to the step grid point nearest to
+// currentCommunicationPoint + communicationStepSize, holding the inputs.
+FMI2_EXPORT fmi2Status fmi2DoStep(fmi2Component c,
+                                  fmi2Real currentCommunicationPoint,
+                                  fmi2Real communicationStepSize,
+                                  fmi2Boolean) {
+  Instance *inst = instance(c);
+  if (inst->phase != Phase::STEPPING)
+    return fail(inst, "fmi2DoStep outside step mode");
+  State &s = *inst->state;
+  if (std::abs(currentCommunicationPoint - s.time) > 0.5 * inst->step_size)
+    return fail(inst, "communication point " +
+                          std::to_string(currentCommunicationPoint) +
+                          " does not match FMU time " +
+                          std::to_string(s.time));
+  if (communicationStepSize < 0.0)
+    return fail(inst, "negative communication step");
+
+  applyInputs(inst);
+  double end = currentCommunicationPoint + communicationStepSize;
+  int64_t target = std::llround((end - inst->start_time) / inst->step_size);
+  for (; s.steps < target; s.steps++)
+    s.engine.update(inst->step_size);
+  s.time = end;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2CancelStep(fmi2Component c) {
+  return fail(instance(c), "steps are synchronous");
+}
+
+FMI2_EXPORT fmi2Status fmi2GetStatus(fmi2Component c, const fmi2StatusKind,
+                                     fmi2Status *) {
+  logMessage(instance(c), fmi2Discard, "logStatusDiscard",
+             "no asynchronous status");
+  return fmi2Discard;
+}
+
+FMI2_EXPORT fmi2Status fmi2GetRealStatus(fmi2Component c,
+                                         const fmi2StatusKind s,
+                                         fmi2Real *value) {
+  Instance *inst = instance(c);
+  if (s != fmi2LastSuccessfulTime || !inst->state)
+    return fmi2Discard;
+  *value = inst->state->time;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2GetIntegerStatus(fmi2Component,
+                                            const fmi2StatusKind,
+                                            fmi2Integer *) {
+  return fmi2Discard;
+}
+
+FMI2_EXPORT fmi2Status fmi2GetBooleanStatus(fmi2Component c,
+                                            const fmi2StatusKind s,
+                                            fmi2Boolean *value) {
+  if (s != fmi2Terminated)
+    return fmi2Discard;
+  *value = instance(c)->phase == Phase::TERMINATED ? fmi2True : fmi2False;
+  return fmi2OK;
+}
+
+FMI2_EXPORT fmi2Status fmi2GetStringStatus(fmi2Component,
+                                           const fmi2StatusKind,
+                                           fmi2String *) {
+  return fmi2Discard;
+}
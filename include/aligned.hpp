@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+constexpr std::size_t kCacheLine = 64;
+
+// std::allocator replacement that starts every block on a cache line
+template <typename T> struct CacheAlignedAllocator {
+  using value_type = T;
+
+  CacheAlignedAllocator() = default;
+  template <typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t(kCacheLine)));
+  }
+  void deallocate(T *p, std::size_t) noexcept {
+    ::operator delete(p, std::align_val_t(kCacheLine));
+  }
+
+  template <typename U> bool operator==(const CacheAlignedAllocator<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const CacheAlignedAllocator<U> &) const {
+    return false;
+  }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
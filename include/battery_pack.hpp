@@ -0,0 +1,127 @@
+#pragma once
+
+#include "aligned.hpp"
+
+// ---------------- PARAMETERS ----------------
+
+// Series string of identical-design cells, each an equivalent circuit
+// (OCV(SOC), R0, one R1-C1 pair) with a lumped temperature cooled towards
+// the coolant. Capacity and resistances vary from cell to cell by up to
+// ±spread, the same variation on every run.
+struct BatteryPackParams {
+  int cells = 200;
+  double r0 = 1.2e-3;              // Ω per cell at reference_temp
+  double r0_temp_coeff = 0.01;     // R0 rise per K below reference_temp
+  double r1 = 0.6e-3;              // Ω per cell
+  double tau = 5.0;                // s, R1·C1
+  double spread = 0.02;            // relative
+  double heat_capacity = 50.0;     // J/K per cell
+  double cooling = 2.0;            // W/K per cell to the coolant
+  double coolant_temp = 313.15;    // K, also the cells' initial temperature
+  double reference_temp = 313.15;  // K
+  double min_cell_voltage = 2.8;   // V, at the terminals under load
+  double max_cell_voltage = 4.2;   // V
+  double max_current = 250.0;      // A
+  double derate_temp = 333.15;     // K, current limit starts falling
+  double max_temp = 343.15;        // K, current limit reaches zero
+  // s between cell updates, a BMS's typical reporting rate; 0 updates
+  // the cells every step
+  double cell_period = 0.01;
+};
+
+// Cell open-circuit voltage, 3.0 V empty to 4.2 V full
+template <typename T> T cellOpenCircuitVoltage(const T &soc) {
+  return 3.0 + soc * (1.2 + soc * (-0.9 + soc * 0.9));
+}
+
+// ---------------- PACK ----------------
+
+// Cell-resolved pack. Per-cell state lives in structure-of-arrays form
+// (one cache-aligned array per quantity), and both passes of a cell
+// update are plain loops over those arrays with no calls or branches, so
+// the compiler vectorises them. The pack-level sums and extremes are
+// in four independent partial results, which the compiler can hold in
+// one vector register without reordering any sum.
+//
+// The pack's current follows the power every step, and its SOC and
+// energy follow the charge drawn. The cells themselves advance once per
+// cell_period on the mean current and mean squared current since their
+// last update; their fastest time constant is seconds. The RC branch and
+// the temperature take their exact exponential solutions over that
+// interval, so it stays stable however long it is. Cell extremes and the
+// power limits are those of the last cell update.
+template <typename T> class BasicBatteryPack {
+public:
+  // Sized so the cells hold full_energy_J between empty and full
+  BasicBatteryPack(const BatteryPackParams &params, double full_energy_J,
+                   T soc);
+
+  int cellCount() const { return params.cells; }
+  const BatteryPackParams &getParams() const { return params; }
+
+  void setSOC(T soc); // every cell, 0..1
+
+  // dt with the terminals delivering power_W (negative charges the
+  // pack). Power beyond what the pack can deliver is cut to its peak.
+  void step(T power_W, double dt);
+
+  T getSOC() const;    // charge-weighted mean of the cells
+  T getEnergy() const; // J above empty
+  T getCurrent() const;         // A, discharging > 0, last step
+  T getTerminalVoltage() const; // V, under the last step's current
+
+  // As of the last cell update
+  T getOpenCircuitVoltage() const; // V, net of the RC branches
+  T getResistance() const;         // Ω, series R0
+
+  // Largest terminal power the pack accepts or delivers: limited by cell
+  // voltage, current, temperature derating and empty or full cells
+  T getMaxChargePower() const;
+  T getMaxDischargePower() const;
+
+  T getMinCellSOC() const;
+  T getMaxCellSOC() const;
+  T getMaxCellTemperature() const; // K
+
+  T getCellSOC(int i) const { return soc[i]; }
+  T getCellTemperature(int i) const { return temperature[i]; }
+
+private:
+  void updateCells();
+  void refresh();
+
+  BatteryPackParams params;
+
+  // Per-cell state
+  AlignedVector<T> soc;
+  AlignedVector<T> v_rc;        // V across the RC pair
+  AlignedVector<T> temperature; // K
+  AlignedVector<T> r0;          // Ω at the current temperature
+
+  // Per-cell results of the last refresh
+  AlignedVector<T> emf;             // V, OCV less the RC branch
+  AlignedVector<T> discharge_limit; // A, largest current the cell allows
+  AlignedVector<T> charge_limit;    // A
+
+  // Per-cell constants
+  AlignedVector<double> charge_C;   // capacity, A·s
+  AlignedVector<double> inv_charge; // 1 / charge_C
+  AlignedVector<double> r0_ref;     // Ω at reference_temp
+  AlignedVector<double> r1;
+  AlignedVector<double> inv_r1;
+  double total_charge_C = 0.0;
+
+  // Since the last cell update
+  double pending_dt = 0.0; // s
+  T pending_charge;        // A·s drawn
+  T pending_current_sq;    // A²·s
+
+  // Pack quantities as of the last cell update, except pack_soc and
+  // energy, which every step moves on
+  T current;
+  T pack_soc, energy, voc, resistance;
+  T min_soc, max_soc, max_temperature;
+  T max_charge_current, max_discharge_current; // A, both >= 0
+};
+
+using BatteryPack = BasicBatteryPack<double>;
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "engine_params.hpp"
+#include "telemetry.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Channels a calibration can fit, by telemetry column name
+constexpr int kCalibrationChannels = 10;
+extern const char *const calibrationChannelNames[kCalibrationChannels];
+
+// One measured run. Driver throttle comes from its "throttle" column.
+// Rows are taken as logged after the physics step at their timestamp,
+// like the simulator's own log, and a replay starts from the state of a
+// row: omega (or rpm), intake_manifold_pressure, turbo_speed, battery_soc,
+// combustion_torque, exhaust_mass_flow, boost_pressure and turbo_air_flow
+// (any that are missing keep the model default). The ECU holds the
+// commands the row's effective_throttle, mguh_power and mguk_power show
+// until its next update, on a multiple of the control period from t = 0.
+// The model at its own parameters reproduces its own log.
+struct DynoTrace {
+  std::string name;
+  TelemetryTrace data;
+};
+
+struct CalibrationOptions {
+  std::vector<std::string> parameters; // tunables to fit (engine_params.hpp)
+  std::vector<std::string> channels = {"rpm", "torque_output",
+                                       "boost_pressure", "fuel_mass_flow",
+                                       "exhaust_temp"};
+  double dt = 1e-4;   // physics step
+  int stride = 1;     // compare every n-th row
+  // s of trace per replay segment, each from the state logged at its
+  // first row; 0 replays whole traces
+  double segment_length = 1.0;
+  int threads = 0;    // 0 = all cores
+  int max_iterations = 30;
+  double tolerance = 1e-9; // relative cost decrease that ends the fit
+
+  // Optional box constraints, parallel to `parameters` (empty: none)
+  std::vector<double> lower;
+  std::vector<double> upper;
+};
+
+struct CalibrationResult {
+  std::vector<std::string> parameters;
+  std::vector<double> initial;
+  std::vector<double> fitted;
+  std::vector<double> standard_error; // 1 sigma; NaN if not identifiable
+  std::vector<std::vector<double>> correlation;
+  EngineParams params; // start set with the fitted values applied
+
+  int iterations = 0;
+  bool converged = false;
+  size_t residual_count = 0;
+  double initial_cost = 0.0; // 0.5 * sum of squared scaled residuals
+  double final_cost = 0.0;
+
+  // Fit quality at the solution, in channel units
+  std::vector<std::string> channels;
+  std::vector<double> channel_scale;          // residual normalisation
+  std::vector<std::vector<double>> trace_rms; // [trace][channel]
+  std::vector<double> r_squared;              // [channel], all traces
+};
+
+// Nonlinear least squares (Levenberg-Marquardt) of the chosen tunables
+// against the traces. Residuals are model minus measurement divided by
+// the channel's standard deviation over all traces. Jacobians are exact
+// (forward-mode AD, kModelDirections parameters per run); every
+// (segment, parameter group) run of an iteration executes concurrently on
+// a thread pool, as do the trial evaluations.
+//
+// Throws std::invalid_argument on an unknown parameter or channel, or a
+// trace without the needed columns.
+CalibrationResult
+calibrate(const EngineParams &start, const std::vector<DynoTrace> &traces,
+          const CalibrationOptions &options,
+          const std::function<void(int iteration, double cost,
+                                   double lambda)> &progress = {});
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "engine_params.hpp"
+#include "telemetry.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------------- COMPONENTS AND VARIANTS ----------------
+
+// Subsystems that can run on their own against recorded boundary traces
+enum class BenchComponent {
+  TURBO, // Turbocharger
+  MGUH,  // MGU-H
+  ERS,   // MGU-K and the EnergyStore it charges
+};
+
+// turbo, mguh or ers; throws std::invalid_argument for anything else
+BenchComponent parseBenchComponent(const std::string &name);
+const char *benchComponentName(BenchComponent component);
+
+// Construction parameters of one component variant. Defaults are the
+// values the full engine builds its components with; each bench reads
+// only its own keys (benchVariantKeys).
+struct BenchVariant {
+  std::string name = "baseline";
+
+  // turbo
+  double turbo_inertia = constants::turbo_inertia;           // kg·m²
+  double turbine_efficiency = EngineParams().turbine_efficiency;
+  double compressor_efficiency = EngineParams().compressor_efficiency;
+  double bearing_loss = constants::turbo_bearing_loss;       // W per rad/s
+  std::string turbo_map; // map file, empty for closed form
+
+  // mguh
+  double mguh_efficiency = constants::mguh_efficiency;
+  double mguh_max_power = constants::mguh_max_power; // W
+
+  // ers
+  double mguk_efficiency = constants::mguk_efficiency;
+  double mguk_max_power = constants::mguk_max_power;           // W
+  double battery_energy = constants::battery_max_energy_J;     // J
+  double charge_power = constants::battery_max_charge_power;   // W
+  double discharge_power = constants::battery_max_discharge_power; // W
+  double initial_soc = -1.0; // < 0: the trace's first battery_soc
+};
+
+const std::vector<std::string> &benchVariantKeys(BenchComponent component);
+
+// Variants in the sweep plan's form (sweep.hpp), one directive per line
+// (# starts a comment):
+//
+//   base    bearing_loss=0.03
+//   vary    turbo_inertia 1.5e-5 2e-5 3e-5
+//   vary    turbine_efficiency 0.68 0.72 0.76
+//   variant heavy turbo_inertia=4e-5 turbine_efficiency=0.7
+//
+// The full grid of the vary lines over base, each named by its varied
+// values (turbo_inertia=1.5e-5,turbine_efficiency=0.68), then the
+// explicit variants, which start from base as well. Without vary or
+// variant lines the base alone runs, named baseline. Throws
+// std::invalid_argument on a bad line or a key the component lacks.
+std::vector<BenchVariant> parseBenchVariants(const std::string &text,
+                                             BenchComponent component);
+std::vector<BenchVariant> loadBenchVariants(const std::string &path,
+                                            BenchComponent component);
+
+// ---------------- BOUNDARY TRACES ----------------
+
+// Recorded channels a bench is driven by. The ECU is replayed on the
+// recorded measurements to give the component its commands (mode,
+// requested power, target boost), except that it sees the bench's own
+// outputs where the component produces them (boost and turbo speed on
+// the turbo bench, SOC on the ERS bench).
+//
+//   turbo  exhaust_mass_flow exhaust_manifold_pressure exhaust_temp
+//          mguh_torque, and for the ECU throttle omega battery_soc
+//   mguh   turbo_speed, and for the ECU throttle omega boost_pressure
+//          battery_soc
+//   ers    omega, and for the ECU throttle boost_pressure turbo_speed
+const std::vector<std::string> &benchInputs(BenchComponent component);
+
+// Channels a bench writes, under their telemetry names
+//
+//   turbo  turbo_speed boost_pressure compressor_outlet_temp
+//          turbo_air_flow
+//   mguh   mguh_torque mguh_power
+//   ers    mguk_torque mguk_power battery_energy battery_soc
+const std::vector<std::string> &benchOutputs(BenchComponent component);
+
+struct BenchOptions {
+  double dt = 0.0;      // s, bench step; 0 uses the trace's dt
+  int log_interval = 10; // bench steps between output rows
+  int threads = 0;      // 0: one per hardware thread
+  std::string out_dir;  // per-variant .f1pz traces; empty writes none
+};
+
+struct BenchVariantResult {
+  std::string variant;
+  std::string trace_path; // empty without an out_dir
+  // Per output: the final value, and the RMS and largest difference from
+  // the recorded channel (NaN when the trace lacks it)
+  std::vector<double> final_value, rms, max_abs;
+};
+
+struct BenchResult {
+  std::vector<std::string> outputs;
+  std::vector<BenchVariantResult> variants;
+  int64_t steps = 0;     // per variant
+  double seconds = 0.0;  // wall time of the batched runs
+};
+
+// Runs every variant over the trace's time span. Boundary channels are
+// interpolated onto the bench step once and shared; variants run in
+// blocks, each block stepping all its variants together through the
+// trace, and blocks spread over the threads.
+//
+// Step k uses the boundary at the times the full engine would: exhaust
+// flow, crank and turbo speed, boost and SOC from the end of step k - 1,
+// pressures, temperature, MGU-H torque and the pedal from step k. A trace
+// logged every step at the bench's dt therefore reproduces the
+// engine's component outputs exactly, and the ECU keeps its 1 ms
+// schedule from the trace's first row.
+//
+// Throws std::invalid_argument when the trace lacks an input channel or
+// is shorter than two rows, std::runtime_error if a trace cannot be
+// written.
+BenchResult runComponentBench(BenchComponent component,
+                              const TelemetryTrace &trace,
+                              const std::vector<BenchVariant> &variants,
+                              const BenchOptions &options = {});
@@ -54,6 +54,7 @@ double constexpr crank_angle_burn_duration = 35;
 
 constexpr double exhaust_temp_base = 720.0;  // K
 constexpr double exhaust_temp_gain = 2.0e-5; // K / W
+constexpr double exhaust_temp_max = 1273.0;  // K, upper clamp
 
 constexpr double fmepA = 0.4e5;   // Pa
 constexpr double fmepB = 0.02e5;  // Pa / (krpm)
@@ -74,6 +75,8 @@ constexpr double turbo_max_pr = 3.0;  // realistic max PR
 constexpr double turbo_pr_idle = 1.0; // no boost
 
 constexpr double turbo_idle_rad_s = 2100.0;
+constexpr double turbo_inertia = 2e-5;      // kg·m² (rotor)
+constexpr double turbo_bearing_loss = 0.02; // W per rad/s
 
 // ~3,000 rpm
 constexpr double engine_idle_rad_s = 314.159;
@@ -91,6 +94,11 @@ constexpr double battery_max_discharge_power = 120000; // 120 kW
 constexpr double mguk_efficiency = 0.95;    // 95%
 constexpr double mguk_max_power = 120000.0; // 120 kW
 
+// MGU-H
+constexpr double mguh_inertia = 2e-6;       // kg·m²
+constexpr double mguh_efficiency = 0.95;    // 95%
+constexpr double mguh_max_power = 120000.0; // 120 kW
+
 constexpr double idle_base_throttle = 0.05;
 constexpr double idle_throttle_gain = 0.001;
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "job.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct DaemonOptions {
+  std::string socket_path = "/tmp/f1-pu.sock";
+  std::string cache_dir = "data/cache"; // empty disables the disk cache
+  int workers = 0;      // 0 = one per hardware thread
+  int max_queued = 256; // submissions beyond this are rejected
+  int max_clients = 64; // concurrent connections
+};
+
+// Long-lived simulation server on a Unix stream socket.
+//
+// Each request and reply is one line of text:
+//   submit <job>   -> ok <id>               queue a job (see parseJob)
+//   run <job>      -> done <id> ...         submit and wait
+//   wait <id>      -> done <id> ...         block until the job finishes
+//   status <id>    -> queued|running <id>, done ..., failed <id> <why>,
+//                     cancelled <id>
+//   cancel <id>    -> ok <id>
+//   status         -> ok workers=... busy=... queued=... cache_hits=...
+//   shutdown       -> ok
+// A finished job reads "done <id> cached=<0|1> <output>=<value> ...".
+// Errors reply "error <message>".
+//
+// Results are cached in memory and under cache_dir, keyed by jobKey(), so
+// a repeated job is answered without running. A job identical to one
+// still queued or running is attached to it rather than run twice.
+class SimulationDaemon {
+public:
+  explicit SimulationDaemon(const DaemonOptions &options);
+  ~SimulationDaemon();
+
+  SimulationDaemon(const SimulationDaemon &) = delete;
+  SimulationDaemon &operator=(const SimulationDaemon &) = delete;
+
+  // Binds the socket and serves until stop() or a shutdown request.
+  // Throws std::runtime_error if the socket cannot be set up.
+  void serve();
+
+  // Safe to call from a signal handler
+  void stop();
+
+  // Handles one request line (the socket protocol, minus the socket)
+  std::string handle(const std::string &request);
+
+private:
+  enum class JobState { QUEUED, RUNNING, DONE, FAILED, CANCELLED };
+
+  struct Job {
+    long id = 0;
+    SimulationJob spec;
+    std::string key;
+    JobState state = JobState::QUEUED;
+    bool cached = false;
+    std::vector<double> values;
+    std::string error;
+    std::atomic<bool> cancel{false};
+  };
+
+  struct Connection {
+    int fd = -1;
+    bool done = false;
+    std::thread thread{};
+  };
+
+  std::string submit(const std::string &text, bool wait);
+  static bool isFinished(const Job &job);
+  std::string describe(const Job &job) const;
+  std::shared_ptr<Job> findJob(const std::string &id_text);
+  void finish(const std::shared_ptr<Job> &job, JobState state);
+  void forget(); // drops the oldest finished jobs beyond the history limit
+
+  bool loadCached(const std::string &key, std::vector<double> &values);
+  void storeCached(const Job &job, const std::vector<double> &values);
+  std::shared_ptr<const TurboMaps> turboMaps(const std::string &path);
+
+  void workerLoop();
+  void serveClient(Connection &connection);
+  void reapConnections(bool all);
+
+  DaemonOptions options;
+  std::atomic<bool> stopping{false};
+  int listen_fd = -1;
+
+  std::mutex mutex; // guards everything below
+  std::condition_variable work_ready;
+  std::condition_variable job_finished;
+  long next_id = 1;
+  std::map<long, std::shared_ptr<Job>> jobs;
+  std::deque<std::shared_ptr<Job>> queue;
+  std::deque<long> finished_order;
+  std::map<std::string, std::shared_ptr<Job>> in_flight; // by key
+  std::map<std::string, std::vector<double>> memory_cache;
+  std::map<std::string, std::shared_ptr<const TurboMaps>> map_cache;
+  int busy = 0;
+  long cache_hits = 0;
+  long cache_misses = 0;
+  long completed = 0;
+
+  std::vector<std::thread> workers;
+  std::list<Connection> connections; // guarded by mutex
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+// Forward-mode automatic differentiation.
+//
+// Dual<N> carries a value together with N tangent directions. Seeding a
+// model parameter with a unit tangent and running the model once yields the
+// exact derivative of every output with respect to that parameter.
+//
+// The non-smooth helpers (max/min/clamp) follow std:: tie-breaking and pass
+// through the tangent of whichever branch is selected, i.e. a one-sided
+// sub-gradient. A saturated limit therefore has zero sensitivity to anything
+// but the limit itself.
+namespace ad {
+
+template <int N> struct Dual {
+  double v;                // value
+  std::array<double, N> d; // tangents
+
+  Dual() : v(0.0), d{} {}
+  Dual(double value) : v(value), d{} {} // constants carry no tangent
+
+  // Independent variable seeded along one tangent direction
+  static Dual variable(double value, int direction) {
+    Dual x(value);
+    x.d[direction] = 1.0;
+    return x;
+  }
+
+  Dual &operator+=(const Dual &o) {
+    v += o.v;
+    for (int i = 0; i < N; i++)
+      d[i] += o.d[i];
+    return *this;
+  }
+  Dual &operator-=(const Dual &o) {
+    v -= o.v;
+    for (int i = 0; i < N; i++)
+      d[i] -= o.d[i];
+    return *this;
+  }
+  Dual &operator*=(const Dual &o) { return *this = *this * o; }
+  Dual &operator/=(const Dual &o) { return *this = *this / o; }
+  Dual &operator+=(double o) {
+    v += o;
+    return *this;
+  }
+  Dual &operator-=(double o) {
+    v -= o;
+    return *this;
+  }
+  Dual &operator*=(double o) {
+    v *= o;
+    for (int i = 0; i < N; i++)
+      d[i] *= o;
+    return *this;
+  }
+  Dual &operator/=(double o) { return *this *= 1.0 / o; }
+
+  // ---------------- ARITHMETIC ----------------
+  friend Dual operator+(const Dual &a) { return a; }
+  friend Dual operator-(const Dual &a) {
+    Dual r;
+    r.v = -a.v;
+    for (int i = 0; i < N; i++)
+      r.d[i] = -a.d[i];
+    return r;
+  }
+  friend Dual operator+(Dual a, const Dual &b) { return a += b; }
+  friend Dual operator+(Dual a, double b) { return a += b; }
+  friend Dual operator+(double a, Dual b) { return b += a; }
+  friend Dual operator-(Dual a, const Dual &b) { return a -= b; }
+  friend Dual operator-(Dual a, double b) { return a -= b; }
+  friend Dual operator-(double a, const Dual &b) { return -b + a; }
+  friend Dual operator*(const Dual &a, const Dual &b) {
+    Dual r;
+    r.v = a.v * b.v;
+    for (int i = 0; i < N; i++)
+      r.d[i] = a.d[i] * b.v + a.v * b.d[i];
+    return r;
+  }
+  friend Dual operator*(Dual a, double b) { return a *= b; }
+  friend Dual operator*(double a, Dual b) { return b *= a; }
+  friend Dual operator/(const Dual &a, const Dual &b) {
+    Dual r;
+    r.v = a.v / b.v;
+    double inv = 1.0 / b.v;
+    for (int i = 0; i < N; i++)
+      r.d[i] = (a.d[i] - r.v * b.d[i]) * inv;
+    return r;
+  }
+  friend Dual operator/(Dual a, double b) { return a /= b; }
+  friend Dual operator/(double a, const Dual &b) { return Dual(a) / b; }
+
+  // ---------------- COMPARISON (value only) ----------------
+  friend bool operator<(const Dual &a, const Dual &b) { return a.v < b.v; }
+  friend bool operator>(const Dual &a, const Dual &b) { return a.v > b.v; }
+  friend bool operator<=(const Dual &a, const Dual &b) { return a.v <= b.v; }
+  friend bool operator>=(const Dual &a, const Dual &b) { return a.v >= b.v; }
+  friend bool operator==(const Dual &a, const Dual &b) { return a.v == b.v; }
+  friend bool operator!=(const Dual &a, const Dual &b) { return a.v != b.v; }
+  friend bool operator<(const Dual &a, double b) { return a.v < b; }
+  friend bool operator>(const Dual &a, double b) { return a.v > b; }
+  friend bool operator<=(const Dual &a, double b) { return a.v <= b; }
+  friend bool operator>=(const Dual &a, double b) { return a.v >= b; }
+  friend bool operator<(double a, const Dual &b) { return a < b.v; }
+  friend bool operator>(double a, const Dual &b) { return a > b.v; }
+  friend bool operator<=(double a, const Dual &b) { return a <= b.v; }
+  friend bool operator>=(double a, const Dual &b) { return a >= b.v; }
+};
+
+// ---------------- VALUE ACCESS ----------------
+
+inline double value(double x) { return x; }
+template <int N> double value(const Dual<N> &x) { return x.v; }
+
+// ---------------- ELEMENTARY FUNCTIONS ----------------
+
+using std::exp;
+using std::log;
+using std::pow;
+using std::sqrt;
+
+// Applies the chain rule: result value f, derivative df/dx
+template <int N> Dual<N> chain(const Dual<N> &x, double f, double dfdx) {
+  Dual<N> r(f);
+  for (int i = 0; i < N; i++)
+    r.d[i] = dfdx * x.d[i];
+  return r;
+}
+
+template <int N> Dual<N> exp(const Dual<N> &x) {
+  double e = std::exp(x.v);
+  return chain(x, e, e);
+}
+
+template <int N> Dual<N> log(const Dual<N> &x) {
+  return chain(x, std::log(x.v), 1.0 / x.v);
+}
+
+template <int N> Dual<N> sqrt(const Dual<N> &x) {
+  double s = std::sqrt(x.v);
+  return chain(x, s, s > 0.0 ? 0.5 / s : 0.0);
+}
+
+template <int N> Dual<N> pow(const Dual<N> &x, double p) {
+  double f = std::pow(x.v, p);
+  return chain(x, f, x.v != 0.0 ? p * f / x.v : 0.0);
+}
+
+template <int N> Dual<N> pow(double b, const Dual<N> &p) {
+  double f = std::pow(b, p.v);
+  return chain(p, f, b > 0.0 ? f * std::log(b) : 0.0);
+}
+
+template <int N> Dual<N> pow(const Dual<N> &x, const Dual<N> &p) {
+  return exp(p * log(x));
+}
+
+// ---------------- NON-SMOOTH LIMITS ----------------
+
+template <typename A, typename B> struct Promote;
+template <> struct Promote<double, double> {
+  using type = double;
+};
+template <int N> struct Promote<Dual<N>, Dual<N>> {
+  using type = Dual<N>;
+};
+template <int N> struct Promote<Dual<N>, double> {
+  using type = Dual<N>;
+};
+template <int N> struct Promote<double, Dual<N>> {
+  using type = Dual<N>;
+};
+
+template <typename A, typename B>
+using promote_t = typename Promote<A, B>::type;
+
+// Same tie-breaking as std::max / std::min / std::clamp
+template <typename A, typename B>
+promote_t<A, B> max(const A &a, const B &b) {
+  using R = promote_t<A, B>;
+  return (value(a) < value(b)) ? R(b) : R(a);
+}
+
+template <typename A, typename B>
+promote_t<A, B> min(const A &a, const B &b) {
+  using R = promote_t<A, B>;
+  return (value(b) < value(a)) ? R(b) : R(a);
+}
+
+template <typename V, typename L, typename H>
+promote_t<promote_t<V, L>, H> clamp(const V &v, const L &lo, const H &hi) {
+  using R = promote_t<promote_t<V, L>, H>;
+  if (value(v) < value(lo))
+    return R(lo);
+  if (value(hi) < value(v))
+    return R(hi);
+  return R(v);
+}
+
+// Tangent width the power-unit model is compiled for. Sensitivity runs over
+// more parameters than this are split into several passes.
+constexpr int kModelDirections = 4;
+using ModelDual = Dual<kModelDirections>;
+
+} // namespace ad
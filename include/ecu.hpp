@@ -0,0 +1,225 @@
+#pragma once
+
+#include "constants.hpp"
+#include "mgu_h.hpp"
+#include "mgu_k.hpp"
+#include <memory>
+
+// ---------------- ECU SIGNALS ----------------
+
+// Plant measurements sampled by the ECU
+template <typename T> struct BasicEcuInputs {
+  T driver_throttle;  // 0..1 pedal
+  T angular_velocity; // rad/s crank
+  T boost_pressure;   // Pa compressor outlet
+  T turbo_speed;      // rad/s
+  T battery_soc;      // 0..1
+};
+
+// Actuator commands, held by the plant between ECU updates
+template <typename T> struct BasicEcuCommands {
+  T throttle = 0.0; // 0..1 after idle control
+  T target_boost = 4.0 * constants::ambient_pressure; // Pa (wastegate)
+
+  MGUHMode mguh_mode = MGUHMode::IDLE;
+  T mguh_power = 0.0; // W requested
+
+  MGUKMode mguk_mode = MGUKMode::IDLE;
+  T mguk_power = 0.0; // W requested
+
+  // Signed electrical commands: positive motors, negative harvests
+  T signedMguhPower() const {
+    return mguh_mode == MGUHMode::MOTOR       ? mguh_power
+           : mguh_mode == MGUHMode::GENERATOR ? T(-mguh_power)
+                                              : T(0.0);
+  }
+  T signedMgukPower() const {
+    return mguk_mode == MGUKMode::MOTOR       ? mguk_power
+           : mguk_mode == MGUKMode::GENERATOR ? T(-mguk_power)
+                                              : T(0.0);
+  }
+};
+
+// ---------------- STRATEGIES ----------------
+
+// Boost control: sets target_boost and the MGU-H command.
+template <typename T> class BasicBoostStrategy {
+public:
+  virtual ~BasicBoostStrategy() = default;
+  virtual void update(const BasicEcuInputs<T> &in, double period,
+                      BasicEcuCommands<T> &cmd) = 0;
+  virtual std::unique_ptr<BasicBoostStrategy> clone() const = 0;
+};
+
+// ERS deployment: sets the MGU-K command.
+template <typename T> class BasicDeploymentStrategy {
+public:
+  virtual ~BasicDeploymentStrategy() = default;
+  virtual void update(const BasicEcuInputs<T> &in, double period,
+                      BasicEcuCommands<T> &cmd) = 0;
+  virtual std::unique_ptr<BasicDeploymentStrategy> clone() const = 0;
+};
+
+// Motor the MGU-H below target boost, harvest above it (full throttle only).
+// The original inline ICEEngine behaviour.
+template <typename T> class BangBangBoost : public BasicBoostStrategy<T> {
+public:
+  static constexpr double kActiveThrottle = 0.5; // commanded throttle
+
+  void update(const BasicEcuInputs<T> &in, double period,
+              BasicEcuCommands<T> &cmd) override;
+  std::unique_ptr<BasicBoostStrategy<T>> clone() const override;
+};
+
+// PID on boost error; positive output motors the MGU-H, negative harvests.
+// The integrator is clamped to the MGU-H power range (anti-windup) and
+// reset whenever the strategy is inactive (part throttle).
+template <typename T> class PidBoost : public BasicBoostStrategy<T> {
+public:
+  struct Gains {
+    double kp = 0.5;  // W / Pa
+    double ki = 5.0;  // W / (Pa·s)
+    double kd = 0.0;  // W·s / Pa
+    double max_power = 120000.0; // W
+    double active_throttle = 0.5;
+  };
+
+  PidBoost();
+  explicit PidBoost(const Gains &gains);
+
+  void update(const BasicEcuInputs<T> &in, double period,
+              BasicEcuCommands<T> &cmd) override;
+  std::unique_ptr<BasicBoostStrategy<T>> clone() const override;
+
+private:
+  Gains gains;
+  T integral;
+  T prev_error;
+  bool primed;
+};
+
+// Holds an externally set signed MGU-H power (positive motors, negative
+// harvests); the wastegate target is left as is. For linearisation and for
+// driving the actuators directly.
+template <typename T> class ManualBoost : public BasicBoostStrategy<T> {
+public:
+  explicit ManualBoost(T power = 0.0);
+
+  void setPower(T power);
+
+  void update(const BasicEcuInputs<T> &in, double period,
+              BasicEcuCommands<T> &cmd) override;
+  std::unique_ptr<BasicBoostStrategy<T>> clone() const override;
+
+private:
+  T power;
+};
+
+// Deploy in proportion to throttle whenever the pedal is pressed.
+// The original inline ICEEngine behaviour.
+template <typename T>
+class ThrottleDeployment : public BasicDeploymentStrategy<T> {
+public:
+  static constexpr double kDeployThrottle = 0.1; // commanded throttle
+
+  void update(const BasicEcuInputs<T> &in, double period,
+              BasicEcuCommands<T> &cmd) override;
+  std::unique_ptr<BasicDeploymentStrategy<T>> clone() const override;
+};
+
+// Throttle-proportional deployment tapered to zero as SOC approaches a
+// floor, with harvesting on lift-off while below the SOC target.
+template <typename T>
+class SocAwareDeployment : public BasicDeploymentStrategy<T> {
+public:
+  struct Limits {
+    double soc_floor = 0.2;   // no deployment below this
+    double soc_taper = 0.1;   // full deployment above floor + taper
+    double soc_target = 0.6;  // harvest on lift-off below this
+    double harvest_power = 60000.0; // W
+    double deploy_throttle = 0.1;
+  };
+
+  SocAwareDeployment();
+  explicit SocAwareDeployment(const Limits &limits);
+
+  void update(const BasicEcuInputs<T> &in, double period,
+              BasicEcuCommands<T> &cmd) override;
+  std::unique_ptr<BasicDeploymentStrategy<T>> clone() const override;
+
+private:
+  Limits limits;
+};
+
+// Signed MGU-K power set from outside; see ManualBoost.
+template <typename T>
+class ManualDeployment : public BasicDeploymentStrategy<T> {
+public:
+  explicit ManualDeployment(T power = 0.0);
+
+  void setPower(T power);
+
+  void update(const BasicEcuInputs<T> &in, double period,
+              BasicEcuCommands<T> &cmd) override;
+  std::unique_ptr<BasicDeploymentStrategy<T>> clone() const override;
+
+private:
+  T power;
+};
+
+// ---------------- ECU ----------------
+
+// Runs idle control and the boost/deployment strategies once per control
+// period (rounded to whole physics steps) and holds the resulting commands
+// in between, like a real ECU task running slower than the plant.
+template <typename T> class BasicEcu {
+public:
+  static constexpr double kDefaultPeriod = 0.001; // s (1 kHz)
+
+  BasicEcu();
+  BasicEcu(const BasicEcu &other);
+  BasicEcu &operator=(const BasicEcu &other);
+
+  void setControlPeriod(double seconds);
+  double getControlPeriod() const;
+
+  // nullptr restores the default (BangBangBoost, ThrottleDeployment)
+  void setBoostStrategy(std::unique_ptr<BasicBoostStrategy<T>> strategy);
+  void setDeploymentStrategy(
+      std::unique_ptr<BasicDeploymentStrategy<T>> strategy);
+
+  // Called every physics step; recomputes commands when the period is due
+  const BasicEcuCommands<T> &step(const BasicEcuInputs<T> &in, double dt);
+
+  // Picks a run up after physics step `step` (counted from 0, with control
+  // updates on every multiple of the control period): holds `held` until
+  // the next update, which falls where it would have
+  void resume(const BasicEcuCommands<T> &held, long step, double dt);
+
+  // Unconditional control update (for benchmarking the control loop alone)
+  void control(const BasicEcuInputs<T> &in, double period);
+
+  // Pedal plus the idle controller's extra opening, as commanded
+  static T commandedThrottle(T driver_throttle, T angular_velocity);
+
+  const BasicEcuCommands<T> &getCommands() const;
+  long getUpdateCount() const;
+
+private:
+  double control_period;
+  long steps_until_update;
+  long update_count;
+
+  BasicEcuCommands<T> commands;
+  // The default strategies live inline, so an ECU (and an engine) using
+  // them is one block that allocates nothing; strategies set from
+  // outside are held below, null while the default applies
+  BangBangBoost<T> default_boost;
+  ThrottleDeployment<T> default_deployment;
+  std::unique_ptr<BasicBoostStrategy<T>> boost;
+  std::unique_ptr<BasicDeploymentStrategy<T>> deployment;
+};
+
+using EcuInputs = BasicEcuInputs<double>;
+using EcuCommands = BasicEcuCommands<double>;
+using Ecu = BasicEcu<double>;
@@ -1,23 +1,52 @@
 #pragma once
 
-class EnergyStore {
+#include "battery_pack.hpp"
+#include <memory>
+
+template <typename T> class BasicEnergyStore {
 public:
-  EnergyStore(double max_energy_J, double max_charge_power_W,
-              double max_discharge_power_W);
+  BasicEnergyStore(double max_energy_J, double max_charge_power_W,
+                   double max_discharge_power_W);
+
+  BasicEnergyStore(const BasicEnergyStore &other);
+  BasicEnergyStore &operator=(const BasicEnergyStore &other);
+
+  T getEnergy() const;
+  T getSOC() const;
+  void setSOC(T soc); // state override, 0..1
+
+  T getAvailableChargePower() const;
+  T getAvailableDischargePower() const;
 
-  double getEnergy() const;
-  double getSOC() const;
+  void charge(T energy_J);    // add energy
+  void discharge(T energy_J); // remove energy
 
-  double getAvailableChargePower() const;
-  double getAvailableDischargePower() const;
+  // Replaces the single energy state by a cell-resolved pack holding the
+  // same energy when full, starting at the current SOC. Its voltage,
+  // current and temperature limits then replace the fixed power limits.
+  void setPack(const BatteryPackParams &params);
+  const BasicBatteryPack<T> *getPack() const { return pack.get(); }
 
-  void charge(double energy_J);    // add energy
-  void discharge(double energy_J); // remove energy
+  // Brackets one model step. With a pack, charge() and discharge() only
+  // book energy on the DC bus, the available powers are net of what is
+  // already booked, and endStep() runs the cells on the net power. The
+  // single energy state applies every change at once and ignores both.
+  void beginStep(double dt);
+  void endStep();
 
 private:
-  double energy_J;
+  T bookedPower() const; // W into the pack so far this step
+
+  T energy_J;
   double max_energy_J;
 
   double max_charge_power_W;
   double max_discharge_power_W;
+
+  // nullptr for the single energy state
+  std::unique_ptr<BasicBatteryPack<T>> pack;
+  double step_dt = 0.0;
+  T booked_J; // net energy into the pack this step
 };
+
+using EnergyStore = BasicEnergyStore<double>;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "constants.hpp"
+#include <string>
+#include <vector>
+
+// Tunable model parameters. Everything here can be swept, calibrated or
+// seeded as an AD variable; fixed physical constants stay in constants.hpp.
+template <typename T> struct BasicEngineParams {
+  // Friction mean effective pressure (Chen-Flynn style)
+  T fmepA = constants::fmepA; // Pa
+  T fmepB = constants::fmepB; // Pa / krpm
+  T fmepC = constants::fmepC; // Pa / krpm^2
+  T fmepD = constants::fmepD; // load sensitivity
+
+  // Exhaust
+  T exhaust_temp_base = constants::exhaust_temp_base; // K
+  T exhaust_temp_gain = constants::exhaust_temp_gain; // K / W
+  T k_turbine = 1.6e6;           // Pa per kg/s (backpressure relaxation)
+  T turbine_restriction = 1.5e6; // Pa per kg/s
+
+  // Breathing
+  T volumetric_efficiency_peak_rpm = constants::volumetric_efficiency_peak_rpm;
+  T intercooler_eff = 0.85;
+
+  // Turbocharger
+  T turbine_efficiency = 0.72;
+  T compressor_efficiency = 0.74;
+};
+
+using EngineParams = BasicEngineParams<double>;
+
+// Visits every tunable as f(name, field). Single source of truth for
+// name-based lookup (config files, sensitivity and calibration tools).
+template <typename P, typename F> void forEachParameter(P &params, F &&f) {
+  f("fmepA", params.fmepA);
+  f("fmepB", params.fmepB);
+  f("fmepC", params.fmepC);
+  f("fmepD", params.fmepD);
+  f("exhaust_temp_base", params.exhaust_temp_base);
+  f("exhaust_temp_gain", params.exhaust_temp_gain);
+  f("k_turbine", params.k_turbine);
+  f("turbine_restriction", params.turbine_restriction);
+  f("volumetric_efficiency_peak_rpm", params.volumetric_efficiency_peak_rpm);
+  f("intercooler_eff", params.intercooler_eff);
+  f("turbine_efficiency", params.turbine_efficiency);
+  f("compressor_efficiency", params.compressor_efficiency);
+}
+
+// The same values in another scalar type (AD tangents start at zero)
+template <typename T, typename U>
+BasicEngineParams<T> castParams(const BasicEngineParams<U> &params) {
+  std::vector<U> values;
+  forEachParameter(params,
+                   [&](const char *, const U &v) { values.push_back(v); });
+  BasicEngineParams<T> out;
+  size_t k = 0;
+  forEachParameter(out, [&](const char *, T &v) { v = values[k++]; });
+  return out;
+}
+
+// Pointer to the named tunable, or nullptr if there is no such parameter
+template <typename T>
+T *findParameter(BasicEngineParams<T> &params, const std::string &name) {
+  T *found = nullptr;
+  forEachParameter(params, [&](const char *n, T &field) {
+    if (name == n)
+      found = &field;
+  });
+  return found;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "aligned.hpp"
+#include "ice_engine.hpp"
+#include "job.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ---------------- PLACEMENT ----------------
+
+// CPUs of each NUMA node, from /sys/devices/system/node. A single node
+// holding every hardware thread where that is unavailable.
+std::vector<std::vector<int>> numaNodes();
+
+// Restricts the calling thread to `cpus`; false where thread affinity is
+// unsupported or the request was refused
+bool pinCurrentThread(const std::vector<int> &cpus);
+
+// ---------------- ARENA ----------------
+
+// Bump allocator owned by one thread. Chunks are mapped straight from the
+// OS and zero-filled by the thread that asks for them, so under the
+// default first-touch policy their pages sit on that thread's node.
+// Every allocation starts on a cache line, and consecutive ones are
+// contiguous within a chunk. Memory comes back only on reset() or
+// destruction, which also run the destructors of create()d objects in
+// reverse order.
+class Arena {
+public:
+  explicit Arena(size_t chunk_bytes = size_t(4) << 20);
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Uninitialised storage rounded up to whole cache lines
+  void *allocate(size_t bytes);
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    static_assert(alignof(T) <= kCacheLine, "over-aligned type");
+    T *object = new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      destructors.push_back(
+          {[](void *p) { static_cast<T *>(p)->~T(); }, object});
+    return object;
+  }
+
+  // Destroys everything and rewinds to the first chunk, keeping the
+  // mapped chunks for reuse
+  void reset();
+
+  size_t bytesUsed() const;     // handed out since the last reset
+  size_t bytesMapped() const;   // held from the OS
+  size_t chunkCount() const { return chunks.size(); }
+
+private:
+  struct Chunk {
+    char *base;
+    size_t size;
+  };
+  struct Destructor {
+    void (*destroy)(void *);
+    void *object;
+  };
+
+  void destroyAll();
+
+  size_t chunk_bytes;
+  std::vector<Chunk> chunks;
+  size_t current = 0; // chunk being bumped
+  size_t offset = 0;  // into chunks[current]
+  size_t used_before = 0; // bytes used in chunks before `current`
+  std::vector<Destructor> destructors;
+};
+
+// ---------------- RUN POOL ----------------
+
+// One ensemble member in flight: the engine, its place in the job and
+// the telemetry logged so far (rows of kTelemetryChannels values)
+struct EnsembleRun {
+  ICEEngine engine;
+  JobRun run{};
+  int job = -1;
+  double *telemetry = nullptr;
+  size_t capacity = 0; // rows
+  size_t rows = 0;
+};
+
+// Recycles finished runs of one worker. acquire() takes a released run
+// when there is one and overwrites its engine with a freshly built one
+// (an ICEEngine owns no heap memory of its own, so this allocates
+// nothing), keeping the telemetry buffer when it is large enough. New
+// runs and buffers come from the arena, or from the heap without one.
+// Not thread-safe: each worker has its own.
+class RunPool {
+public:
+  explicit RunPool(Arena *arena = nullptr) : arena(arena) {}
+  ~RunPool();
+
+  RunPool(const RunPool &) = delete;
+  RunPool &operator=(const RunPool &) = delete;
+
+  // A run started on `job`, with room for `rows` telemetry rows
+  EnsembleRun *acquire(const SimulationJob &job, int index, size_t rows,
+                       std::shared_ptr<const TurboMaps> maps = nullptr);
+  void release(EnsembleRun *run);
+
+  long created() const { return runs_created; }
+  long reused() const { return runs_reused; }
+
+private:
+  Arena *arena;
+  std::vector<EnsembleRun *> free_runs;
+  std::vector<EnsembleRun *> heap_runs; // owned when there is no arena
+  long runs_created = 0;
+  long runs_reused = 0;
+};
+
+// ---------------- ENSEMBLE ----------------
+
+enum class EnsemblePlacement {
+  ARENA, // per-worker arenas and run pools, workers pinned to nodes
+  HEAP,  // every run and buffer new'd per job, workers left unpinned
+};
+
+struct EnsembleOptions {
+  int workers = 0;        // 0: one per hardware thread
+  int live = 256;         // runs each worker steps together
+  int slice = 100;        // steps a run takes before the next one's turn
+  int log_interval = 10;  // steps between telemetry rows, 0 logs none
+  EnsemblePlacement placement = EnsemblePlacement::ARENA;
+};
+
+struct EnsembleStats {
+  int64_t steps = 0;     // over all members
+  double seconds = 0.0;  // wall time
+  int workers = 0;
+  int nodes = 0;         // NUMA nodes the workers were spread over
+  long runs_created = 0; // engines built in fresh memory
+  long runs_reused = 0;  // taken back from a run pool
+  size_t arena_bytes = 0; // mapped over all workers
+};
+
+// Called on the worker's thread as each member finishes, with its
+// telemetry rows; the buffer is reused once it returns
+using EnsembleSink =
+    std::function<void(int job, const double *rows, size_t count)>;
+
+// Runs every job, each on an engine built with its params, and stores
+// one value per jobOutputs() entry in outputs[job]. Job j belongs to
+// worker j % workers; workers are spread round-robin over the NUMA
+// nodes. Each worker keeps up to `live` of its jobs in flight and steps
+// them a slice at a time in turn, admitting the next job as one
+// finishes. Results do not depend on the placement or the worker count.
+// Rethrows the first exception a job threw.
+EnsembleStats runEnsemble(const std::vector<SimulationJob> &jobs,
+                          const EnsembleOptions &options,
+                          std::vector<std::vector<double>> &outputs,
+                          const EnsembleSink &sink = nullptr);
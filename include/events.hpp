@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ice_engine.hpp"
+#include "scenario.hpp"
+#include <string>
+#include <vector>
+
+// ---------------- SWITCHING FUNCTIONS ----------------
+
+// A discontinuity of the model as a scalar function of the engine state
+// and the pedal: the switch is on while the value is > 0 and flips where
+// it crosses zero. Clamps and saturations read 0 while engaged.
+struct SwitchFunction {
+  const char *name;
+  double (*value)(const ICEEngine &engine, double driver_throttle);
+};
+
+constexpr int kSwitchFunctions = 8;
+
+// mguh_active    commanded throttle above BangBangBoost's 0.5
+// mguk_deploy    commanded throttle above ThrottleDeployment's 0.1
+// boost_error    boost below the ECU's target (MGU-H motors, else harvests)
+// intake_floor   intake manifold pressure above its 0.3 bar clamp
+// intake_ceiling intake manifold pressure below the compressor outlet
+// idle_floor     crank speed above engine_idle_rad_s
+// battery_empty  SOC above 0
+// battery_full   SOC below 1
+extern const SwitchFunction switchFunctions[kSwitchFunctions];
+
+// Index into switchFunctions, or -1 for an unknown name
+int findSwitchFunction(const std::string &name);
+
+// A step of the driver input: a throttle breakpoint of the scenario
+constexpr int kThrottleBreakpoint = -1;
+
+struct SwitchEvent {
+  double time; // s
+  int function; // switchFunctions index or kThrottleBreakpoint
+  // Value went from <= 0 to > 0; at a breakpoint, the pedal stepped up
+  // or its slope increased
+  bool rising;
+};
+
+const char *switchEventName(const SwitchEvent &event);
+
+// ---------------- EVENT-LOCATING INTEGRATION ----------------
+
+struct EventIntegratorOptions {
+  double initial_step = 1e-4; // s, also the step after every event
+  double min_step = 1e-6;     // s
+  double max_step = 5e-3;     // s
+  // Local error per step from step doubling, in units of 1000 rad/s,
+  // 1 bar, 10000 rad/s and full SOC; 0 disables step-size control and
+  // every step is initial_step, still cut at events
+  double tolerance = 1e-5;
+  double event_tolerance = 1e-8; // s, width of the final root bracket
+};
+
+struct EventIntegratorStats {
+  long steps = 0;     // accepted
+  long rejected = 0;  // by the error test
+  long updates = 0;   // model steps, trials and root finding included
+  long root_updates = 0;
+  double min_step = 0.0, max_step = 0.0; // s, accepted steps
+};
+
+// Variable-step integration of a scenario that ends a step on every
+// switching instant.
+//
+// Each step is tried on a copy of the engine. When a switching function
+// has changed sign over it, the earliest crossing is bracketed on the
+// fraction of the step taken (Illinois, bisection where a clamp reads
+// flat zero) until the bracket is narrower than event_tolerance, and
+// only the step up to just past the crossing is kept. Scenario
+// breakpoints end steps as well. After every event the ECU recomputes
+// its commands and the step restarts from initial_step, so no step spans
+// a mode change. Between events the step grows as the error test allows.
+//
+// The pedal is held over a step at its value at the start, as in the
+// fixed-step loop. The ECU recomputes its commands every step (its
+// control period is set to 0): with variable steps a 1 ms schedule would
+// itself be a switch.
+class EventIntegrator {
+public:
+  EventIntegrator(const ICEEngine &initial, const Scenario &scenario,
+                  const EventIntegratorOptions &options = {});
+
+  // Takes one step, no further than `end`; returns its size
+  double step(double end);
+  void advanceTo(double end);
+
+  double getTime() const { return time; }
+  const ICEEngine &getEngine() const { return engine; }
+  const std::vector<SwitchEvent> &getEvents() const { return events; }
+  const EventIntegratorStats &getStats() const { return stats; }
+
+  // Events as CSV (time, event, direction); throws std::runtime_error if
+  // it cannot be written
+  void write(const std::string &path) const;
+
+private:
+  // engine after one step of h from the current state
+  ICEEngine trial(double h);
+  void signs(const ICEEngine &at, double t, bool *positive) const;
+  double nextBreakpoint() const;
+  bool pedalRises() const;
+  void accept(const ICEEngine &next, double h);
+
+  ICEEngine engine;
+  Scenario scenario;
+  EventIntegratorOptions options;
+
+  double time = 0.0;
+  double h;
+  size_t breakpoint = 0; // first scenario point after `time`
+  bool positive[kSwitchFunctions];
+
+  std::vector<SwitchEvent> events;
+  EventIntegratorStats stats;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "telemetry.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Condition on one telemetry row: "<channel><op><number or channel>",
+// op one of < <= > >=, e.g. "battery_soc<=0" or
+// "intake_manifold_pressure>=boost_pressure".
+struct RecorderTrigger {
+  enum class Op { LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+
+  std::string text;
+  int channel = 0;
+  Op op = Op::LESS;
+  int rhs_channel = -1; // compare against this channel when >= 0
+  double threshold = 0.0;
+
+  // Throws std::invalid_argument on a malformed condition or unknown channel
+  static RecorderTrigger parse(const std::string &text);
+
+  bool test(const double *row) const;
+};
+
+// SOC empty, intake pressure on its lower clamp, turbo at idle speed and
+// negative net combustion torque
+std::vector<RecorderTrigger> defaultRecorderTriggers();
+
+enum class RecorderFormat { CSV, F1PZ };
+
+struct FlightRecorderOptions {
+  double pre_seconds = 0.05;  // kept before the trigger
+  double post_seconds = 0.05; // recorded after it
+  std::string directory = "data/flight";
+  RecorderFormat format = RecorderFormat::CSV;
+  int max_dumps = 16; // later events are counted but not written
+  std::vector<RecorderTrigger> triggers = defaultRecorderTriggers();
+};
+
+// Keeps every physics step's telemetry row in a preallocated ring and
+// writes a pre/post window around each trigger event to its own file.
+//
+// Triggers are edge-sensitive: one fires when its condition becomes true
+// and re-arms once it is false again, so a condition that holds for
+// seconds (a clamp, an empty battery) produces one dump. Conditions true
+// on the first recorded step count as already fired. Events that fire
+// while a window is still being recorded are listed with that dump rather
+// than starting a new one.
+class FlightRecorder {
+public:
+  FlightRecorder(const FlightRecorderOptions &options, double dt);
+
+  // Once per physics step, after update(). Steps must increase by one.
+  void record(int64_t step, const ICEEngine &engine);
+
+  // Writes a pending dump with the post-trigger rows recorded so far
+  void flush();
+
+  struct Dump {
+    std::string path;
+    int64_t trigger_step;
+    std::vector<std::string> triggers; // every condition that fired
+  };
+  const std::vector<Dump> &getDumps() const;
+  long getEventCount() const;
+
+private:
+  void writeDump();
+
+  FlightRecorderOptions options;
+  double dt;
+  size_t capacity;  // rows
+  int64_t pre_rows;
+  int64_t post_rows;
+
+  std::vector<double> rows;   // [capacity][kTelemetryChannels]
+  std::vector<int64_t> steps; // [capacity]
+  uint64_t recorded = 0;
+
+  std::vector<char> armed; // per trigger
+  bool pending = false;
+  int64_t pending_step = 0;
+  std::vector<std::string> pending_triggers;
+
+  long events = 0;
+  std::vector<Dump> dumps;
+};
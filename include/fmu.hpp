@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// ---------------- FMI 2.0 CO-SIMULATION INTERFACE ----------------
+//
+// Variable table shared by the FMU library (fmu/fmi2.cpp) and the
+// modelDescription.xml it ships with, so value references cannot drift.
+
+constexpr const char *kFmuModelIdentifier = "f1pu";
+// Changes whenever the variable table or the model changes (kModelVersion)
+std::string fmuGuid();
+
+struct FmuVariable {
+  enum class Kind { INPUT, OUTPUT, PARAMETER };
+  enum class Type { REAL, BOOLEAN };
+
+  std::string name;
+  unsigned value_reference;
+  Kind kind;
+  Type type;
+  double start; // inputs and parameters
+  std::string description;
+};
+
+// Value-reference ranges
+constexpr unsigned kFmuInputBase = 0;       // fmuInputNames order
+constexpr unsigned kFmuOutputBase = 100;    // telemetryChannels order
+constexpr unsigned kFmuTunableBase = 200;   // forEachParameter order
+constexpr unsigned kFmuStepSizeVr = 300;    // internal physics step, s
+constexpr unsigned kFmuEcuPeriodVr = 301;   // ECU control period, s
+constexpr unsigned kFmuErsExternalVr = 302; // Boolean
+
+// Inputs: driver throttle 0..1, signed MGU-K / MGU-H power commands (W,
+// positive motoring; used when ers_external is true) and an external
+// crank load torque (Nm)
+constexpr int kFmuInputs = 4;
+extern const char *const fmuInputNames[kFmuInputs];
+
+std::vector<FmuVariable> fmuVariables();
+
+// Complete modelDescription.xml text
+std::string fmuModelDescription();
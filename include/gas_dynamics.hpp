@@ -0,0 +1,203 @@
+#pragma once
+
+#include "aligned.hpp"
+#include <vector>
+
+// ---------------- PARAMETERS ----------------
+
+// Straight pipe of constant section, split into equal cells
+struct PipeGeometry {
+  double length;   // m
+  double diameter; // m
+  int cells;
+};
+
+// Runners and collector of the engine's gas-dynamics model. Valve events
+// are in crank degrees from the cylinder's firing TDC (0..720).
+struct GasDynamicsParams {
+  PipeGeometry exhaust_runner{0.40, 0.040, 8};    // one per cylinder
+  PipeGeometry exhaust_collector{0.30, 0.060, 6}; // junction to turbine
+  double collector_volume = 0.5e-3;               // m³, junction
+  PipeGeometry intake_runner{0.20, 0.045, 6};     // plenum to valve
+  double cfl = 0.7; // Courant number of every pipe's own step
+  double exhaust_open_deg = 130.0;
+  double exhaust_close_deg = 370.0;
+  double intake_open_deg = 350.0;
+  double intake_close_deg = 590.0;
+};
+
+// ---------------- PIPE NETWORK ----------------
+
+enum class PipeEnd { INLET, OUTLET }; // x = 0 and x = length
+
+// Quasi-1D inviscid flow in straight adiabatic pipes joined at 0D volumes
+// (nodes). Cells are finite volumes; interface fluxes are HLL between
+// MUSCL-Hancock face states (minmod slopes, half-step predictor), which
+// is second order in space and time with one flux evaluation per step.
+//
+// Cell data is structure-of-arrays over the whole network, pipe after
+// pipe with one constant padding cell between neighbours, so each kernel
+// is a single branch-free loop over a run of pipes and the compiler
+// vectorises it. Padding cells never change (zero 1/dx) and the fluxes
+// computed across them are replaced by the pipes' boundary fluxes.
+//
+// Local time stepping: every step, each pipe takes the power-of-two
+// fraction of dt its own CFL limit needs, so only the pipes with the
+// fastest waves take the finest steps. Nodes advance at the finest step
+// on the latest flux of every pipe end, so their mass and energy balance
+// exactly with the pipes'. Boundary inputs are held over a step.
+template <typename T> class BasicPipeNetwork {
+public:
+  explicit BasicPipeNetwork(double gamma = 1.4, double cfl = 0.7);
+
+  // ---------------- SETUP ----------------
+  // Both return the new index. Pipes start at rest with both ends closed.
+  int addNode(double volume, T pressure, T temperature);
+  int addPipe(const PipeGeometry &geometry, T pressure, T temperature);
+
+  void connect(int pipe, PipeEnd end, int node);
+  // Outflow (p - downstream_pressure) / pa_per_kg_s, never inflow
+  void setRestriction(int pipe, PipeEnd end, T pa_per_kg_s,
+                      double downstream_pressure);
+
+  // Every cell and node at rest at the given state
+  void reset(T pressure, T temperature);
+
+  // ---------------- BOUNDARY INPUTS ----------------
+  // kg/s into the pipe (negative draws gas out); inflowing gas has the
+  // given stagnation temperature. Zero is a closed end.
+  void setMassFlow(int pipe, PipeEnd end, T kg_s, T temperature);
+  void setNodeInflow(int node, T kg_s, T temperature); // from outside
+  // Adds or removes gas at the node's temperature to keep it in bounds
+  void clampNodePressure(int node, T min_pressure, T max_pressure);
+
+  void step(double dt);
+
+  // ---------------- STATE ----------------
+  T getPressure(int pipe, PipeEnd end) const;    // Pa, end cell
+  T getTemperature(int pipe, PipeEnd end) const; // K, end cell
+  T getFlow(int pipe, PipeEnd end) const; // kg/s in, mean over last step
+  T getNodePressure(int node) const;
+  T getNodeTemperature(int node) const;
+
+  bool empty() const { return pipes.empty(); }
+  int cellCount() const; // without padding
+  int getSubsteps() const { return substeps; } // finest, last step
+
+private:
+  enum class EndKind { MASS_FLOW, RESTRICTION, NODE };
+
+  struct End {
+    EndKind kind = EndKind::MASS_FLOW;
+    int node = -1;
+    T mass_flow = 0.0;   // kg/s into the pipe
+    T temperature = 0.0; // K, of inflowing gas
+    T restriction = 0.0; // Pa per kg/s
+    double downstream_pressure = 0.0;
+    // Into the pipe over its last step: kg/s, W of stagnation enthalpy
+    T flow = 0.0, enthalpy_flow = 0.0;
+    T flow_sum = 0.0; // kg over the network step
+  };
+
+  struct Pipe {
+    int begin, cells; // first cell, count
+    double dx, area;
+    int level;
+    End end[2];
+  };
+
+  struct Node {
+    double volume;
+    T mass, energy; // kg, J internal
+    T density, pressure, sound_speed; // follow mass and energy
+    T inflow = 0.0, inflow_temperature = 0.0;
+  };
+
+  void advance(int first, int last, double h); // pipes first..last
+  void boundaryFluxes(Pipe &pipe);
+  void updateNodes(double h);
+  void refreshNode(Node &node) const;
+  T cellPressure(int i) const;
+
+  double gamma, cfl;
+  std::vector<Pipe> pipes;
+  std::vector<Node> nodes;
+  int substeps = 0;
+  double step_dt = 0.0;
+
+  // Per cell (index 0 and one after each pipe are padding)
+  AlignedVector<T> rho, mom, ene;   // conserved, per m³
+  AlignedVector<T> u, p, c;         // primitives, sound speed
+  AlignedVector<T> l_rho, l_u, l_p; // predicted, at the cell's x- face
+  AlignedVector<T> r_rho, r_u, r_p; // and at its x+ face
+  AlignedVector<double> inv_dx;     // 0 in padding
+  AlignedVector<double> interior;   // 1 where a slope is allowed
+  // Per face; face i lies between cells i - 1 and i
+  AlignedVector<T> f_rho, f_mom, f_ene;
+};
+
+// ---------------- ENGINE RUNNERS ----------------
+
+// Exhaust runner per cylinder into a collector volume, a collector pipe
+// to the turbine (the engine's turbine restriction as its outlet), and
+// an intake runner per cylinder from the plenum to the intake valve.
+//
+// The engine's mean cylinder outflow and inflow are split over the
+// cylinders whose valves are open, weighted by a half-sine lift profile,
+// so each runner sees its own pulse train at firing frequency. The
+// cylinder breathes at the pressure seen by its open intake valves, and
+// pumps against the pressure at its open exhaust valves.
+template <typename T> class BasicGasDynamics {
+public:
+  BasicGasDynamics() = default; // disabled
+  BasicGasDynamics(const GasDynamicsParams &params, double plenum_volume,
+                   T intake_pressure, T intake_temperature,
+                   T exhaust_pressure, T exhaust_temperature);
+
+  bool enabled() const { return !exhaust.empty(); }
+  const GasDynamicsParams &getParams() const { return params; }
+
+  // dt with the cylinders delivering exhaust_flow and drawing air_flow,
+  // and throttle_flow entering the plenum; crank angle advances with
+  // angular_velocity
+  void step(double dt, T angular_velocity, T exhaust_flow,
+            T exhaust_temperature, T throttle_flow, T intake_temperature,
+            T air_flow, T turbine_restriction);
+
+  // Intake side at rest at the given plenum pressure (state override)
+  void setPlenumPressure(T pressure);
+  // The bounds the engine's lumped plenum keeps (its floor stands in for
+  // the idle air the throttle model lacks)
+  void clampPlenumPressure(T min_pressure, T max_pressure);
+
+  // At the current crank angle
+  T getIntakeValvePressure() const;  // Pa, mean over open valves
+  T getExhaustValvePressure() const; // Pa, mean over open valves
+  double getCrankAngle() const { return crank_deg; } // 0..720
+
+  T getPlenumPressure() const;
+  T getTurbineInletPressure() const;
+  T getTurbineInletTemperature() const;
+  T getTurbineMassFlow() const; // kg/s, mean over the last step
+
+  int cellCount() const;
+  int getSubsteps() const; // finest of either side, last step
+
+  const BasicPipeNetwork<T> &getExhaust() const { return exhaust; }
+  const BasicPipeNetwork<T> &getIntake() const { return intake; }
+
+private:
+  // Lift weight of each cylinder's valve; returns their sum
+  double valveWeights(double open_deg, double close_deg, double *w) const;
+  T valvePressure(const BasicPipeNetwork<T> &network, PipeEnd end,
+                  double open_deg, double close_deg) const;
+
+  GasDynamicsParams params;
+  BasicPipeNetwork<T> exhaust, intake;
+  int collector = 0; // pipe index, exhaust side
+  int plenum = 0;    // node index, intake side
+  double crank_deg = 0.0;
+};
+
+using PipeNetwork = BasicPipeNetwork<double>;
+using GasDynamics = BasicGasDynamics<double>;
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "scenario.hpp"
+#include "telemetry.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------------- REFERENCE SCENARIOS ----------------
+
+// A fixed run whose telemetry is kept as a golden trace, so a change to
+// the model can be checked against it for both accuracy and speed
+struct GoldenScenario {
+  Scenario scenario;        // name, dt, iterations, throttle
+  double initial_soc = -1.0; // battery SOC at start; < 0 keeps the default
+  int log_interval = 50;     // steps between trace rows (5 ms)
+};
+
+// ramp (the default run), tip_in_lift_off, idle_hold, ers_depleted
+const std::vector<GoldenScenario> &goldenScenarios();
+
+// Throws std::invalid_argument for an unknown name
+const GoldenScenario &findGoldenScenario(const std::string &name);
+
+struct GoldenRun {
+  TelemetryTrace trace; // every channel, one row per log_interval
+  int64_t steps = 0;
+  double seconds = 0.0; // wall time of the step loop, best of the repeats
+};
+
+// Runs the scenario `repeat` times (the trace of the first run is kept;
+// runs are deterministic) and times each
+GoldenRun runGoldenScenario(const GoldenScenario &scenario, int repeat = 1);
+
+// Path of a scenario's golden trace under `dir`
+std::string goldenTracePath(const std::string &dir, const std::string &name);
+
+// Writes the trace bit-exact (.f1pz, EXACT coding); throws
+// std::runtime_error if it cannot be written
+void writeGoldenTrace(const std::string &path, const TelemetryTrace &trace);
+
+// ---------------- TOLERANCES ----------------
+
+// Per-channel limits on each error metric; infinity leaves it unchecked
+struct ChannelTolerance {
+  double max_abs;     // max |candidate - golden|
+  double max_rel;     // max of that over |golden| (see ChannelDiff)
+  double rms;         // RMS of the difference
+  double event_shift; // s, largest shift of a level crossing
+};
+
+// Text form, one line per channel or * for every channel (# starts a
+// comment); a channel line starts from the * limits:
+//
+//   *            rel=1e-6 shift=0.001
+//   battery_soc  abs=1e-9
+//   bsfc         rel=1e-4
+struct GoldenTolerances {
+  ChannelTolerance defaults;
+  std::vector<ChannelTolerance> channels; // [kTelemetryChannels]
+
+  GoldenTolerances(); // everything unchecked
+  const ChannelTolerance &of(int channel) const {
+    return channels[channel];
+  }
+};
+
+// Throws std::invalid_argument on an unknown channel or malformed line
+GoldenTolerances parseGoldenTolerances(const std::string &text);
+GoldenTolerances loadGoldenTolerances(const std::string &path);
+
+// ---------------- COMPARISON ----------------
+
+struct ChannelDiff {
+  std::string channel;
+  double max_abs = 0.0;
+  // |candidate - golden| / max(|golden|, 1e-3 * peak |golden|): the floor
+  // keeps channels that cross zero from reporting huge relative errors
+  double max_rel = 0.0;
+  double rms = 0.0;
+  double max_abs_time = 0.0; // s, where max_abs occurred
+  // Crossings of 25, 50 and 75% of the golden range, matched in order;
+  // infinite when the candidate crosses a level a different number of
+  // times
+  double event_shift = 0.0;
+  int events = 0; // golden crossings
+  bool pass = true;
+};
+
+// Compares every channel of the golden trace. Throws std::runtime_error
+// when a channel is missing or the row times differ.
+std::vector<ChannelDiff> compareTraces(const TelemetryTrace &golden,
+                                       const TelemetryTrace &candidate,
+                                       const GoldenTolerances &tolerances);
+
+struct GoldenResult {
+  std::string scenario;
+  bool pass = false;
+  std::string error; // set when the scenario could not be compared
+  int64_t steps = 0;
+  double seconds = 0.0;
+  double simulated = 0.0; // s
+  std::vector<ChannelDiff> channels;
+
+  double stepsPerSecond() const { return seconds > 0 ? steps / seconds : 0; }
+};
+
+// Runs each scenario and compares it with its golden trace in `dir`
+GoldenResult checkGoldenScenario(const GoldenScenario &scenario,
+                                 const std::string &dir,
+                                 const GoldenTolerances &tolerances,
+                                 int repeat = 1);
+
+// Verdict and throughput per scenario, with every channel's errors, as
+// JSON; throws std::runtime_error if it cannot be written
+void writeGoldenReport(const std::string &path,
+                       const std::vector<GoldenResult> &results);
@@ -1,107 +1,181 @@
 #pragma once
 
+#include "../include/ecu.hpp"
+#include "../include/engine_params.hpp"
+#include "../include/gas_dynamics.hpp"
 #include "../include/mgu_h.hpp"
 #include "../include/mgu_k.hpp"
 #include "../include/turbocharger.hpp"
-class ICEEngine {
+
+// Dynamic states kept by the reduced plant (linear_model.hpp). Every other
+// engine quantity is either algebraic or a one-step lag of these.
+template <typename T> struct BasicPlantState {
+  T angular_velocity;         // rad/s crank
+  T intake_manifold_pressure; // Pa
+  T turbo_speed;              // rad/s
+  T battery_soc;              // 0..1
+};
+
+// The one-step lags update() reads from the previous step. With the plant
+// state and the ECU's commands and schedule they make up everything a run
+// carries from one step to the next, so a run can be resumed from a row
+// of its own log (calibration.hpp).
+template <typename T> struct BasicLaggedState {
+  T combustion_torque; // Nm, sets the exhaust temperature
+  T exhaust_mass_flow; // kg/s, drives the turbine
+  T boost_pressure;    // Pa, compressor outlet
+  T turbo_air_flow;    // kg/s, loads the compressor
+};
+
+// T is the model scalar: double for normal runs, ad::Dual<N> to carry
+// parameter sensitivities through the same code (see dual.hpp).
+template <typename T> class BasicICEEngine {
 public:
-  ICEEngine();
+  explicit BasicICEEngine(const BasicEngineParams<T> &params = {});
+
+  void setThrottle(T t);  // 0..1
+  void update(double dt); // physics step
+
+  // Extra crank load from outside the power unit (driveline, vehicle),
+  // added to the built-in load curve
+  void setExternalLoadTorque(T nm);
+  T getExternalLoadTorque() const;
+
+  const BasicEngineParams<T> &getParams() const;
 
-  void setThrottle(double t); // 0..1
-  void update(double dt);     // physics step
+  // Compressor/turbine maps (nullptr: closed-form turbo); see turbo_map.hpp
+  void setTurboMaps(std::shared_ptr<const TurboMaps> maps);
 
-  double getRPM() const;
-  double getTorqueOutput() const;
-  double getAngularVelocity() const;
-  double getNetPower() const;
-  double getThrottleAirMassFlow(double throttle, double P_down) const;
-  double getExhaustMassFlowRate() const;
+  // Reduced-plant state; setting it leaves every other quantity as is
+  BasicPlantState<T> getPlantState() const;
+  void setPlantState(const BasicPlantState<T> &state);
+
+  BasicLaggedState<T> getLaggedState() const;
+  void setLaggedState(const BasicLaggedState<T> &state);
+
+  // With the state logged after physics step `step` (counted from 0): the
+  // ECU holds the commands in force then until its next update, which
+  // falls where the run's did
+  void resumeControl(const BasicEcuCommands<T> &commands, long step,
+                     double dt);
+
+  // Control strategies and rate; see ecu.hpp
+  BasicEcu<T> &getEcu();
+  const BasicEcu<T> &getEcu() const;
+
+  T getRPM() const;
+  T getTorqueOutput() const;
+  T getAngularVelocity() const;
+  T getNetPower() const;
+  T getThrottleAirMassFlow(T throttle, T P_down) const;
+  T getExhaustMassFlowRate() const;
 
   // ---------------- ENGINE / CRANK ----------------
-  double getCombustionTorque() const;
-  double getLoadTorque() const;
-  double getFrictionTorque() const;
-  double getPumpingTorque() const;
-  double getIndicatedTorque() const;
-  double getNetTorque() const;
+  T getCombustionTorque() const;
+  T getLoadTorque() const;
+  T getFrictionTorque() const;
+  T getPumpingTorque() const;
+  T getIndicatedTorque() const;
+  T getNetTorque() const;
 
   // ---------------- THROTTLE / AIRFLOW ----------------
-  double getThrottle() const;
-  double getEffectiveThrottle() const;
-  double getNAAirFlow() const;
-  double getActualAirFlow() const;
-  double getFuelMassFlow() const;
-  double getVolumetricEfficiency() const;
+  T getThrottle() const;
+  T getEffectiveThrottle() const;
+  T getNAAirFlow() const;
+  T getActualAirFlow() const;
+  T getFuelMassFlow() const;
+  T getVolumetricEfficiency() const;
 
   // ---------------- TURBO / INTAKE ----------------
-  double getTurboSpeed() const;
-  double getTurboSpeedRPM() const;
-  double getBoostPressure() const;
-  double getPlenumPressure() const;
-  double getIntakeManifoldPressure() const;
-  double getIntakeManifoldTemperature() const;
-  double getAirMassFlow() const;
-  double getCompressorOutletTemperature() const;
+  T getTurboSpeed() const;
+  T getTurboSpeedRPM() const;
+  T getBoostPressure() const;
+  T getPlenumPressure() const;
+  T getIntakeManifoldPressure() const;
+  T getIntakeManifoldTemperature() const;
+  T getAirMassFlow() const;
+  T getCompressorOutletTemperature() const;
 
   // ---------------- EXHAUST ----------------
-  double getExhaustManifoldPressure() const;
-  double getExhaustTemperature() const;
+  T getExhaustManifoldPressure() const; // at the turbine inlet
+  T getExhaustTemperature() const;
+
+  // 1D finite-volume runners and collector in place of the lumped
+  // exhaust backpressure and intake volume (see gas_dynamics.hpp). The
+  // intake manifold pressure is then the plenum's.
+  void setGasDynamics(const GasDynamicsParams &params);
+  const BasicGasDynamics<T> *getGasDynamics() const; // nullptr without
 
   // ---------------- ERS ----------------
-  double getMGUHTorque() const;
-  double getMGUHPower() const;
+  T getMGUHTorque() const;
+  T getMGUHPower() const;
+
+  T getMGUKTorque() const;
+  T getMGUKPower() const;
 
-  double getMGUKTorque() const;
-  double getMGUKPower() const;
+  T getBatteryEnergy() const;
+  T getBatterySOC() const;
 
-  double getBatteryEnergy() const;
-  double getBatterySOC() const;
+  // Cell-resolved battery in place of the single energy state (see
+  // battery_pack.hpp). Its limits then bound both the MGU-K and the
+  // MGU-H, which share the pack's DC bus; without a pack the MGU-H's
+  // power does not pass through the battery.
+  void setBatteryPack(const BatteryPackParams &params);
+  const BasicBatteryPack<T> *getBatteryPack() const; // nullptr without
 
   // ---------------- PERFORMANCE METRICS ----------------
-  double getBMEP() const; // Brake Mean Effective Pressure
-  double getIMEP() const; // Indicated Mean Effective Pressure
-  double getFMEP() const; // Friction Mean Effective Pressure
-  double getBSFC() const; // Brake Specific Fuel Consumption
-  double getThermalEfficiency() const;
-  double getMechanicalEfficiency() const;
-  double getTotalPower() const; // ICE + MGU-K power
-  double getICEPower() const;   // Pure ICE power (combustion - losses)
+  T getBMEP() const; // Brake Mean Effective Pressure
+  T getIMEP() const; // Indicated Mean Effective Pressure
+  T getFMEP() const; // Friction Mean Effective Pressure
+  T getBSFC() const; // Brake Specific Fuel Consumption
+  T getThermalEfficiency() const;
+  T getMechanicalEfficiency() const;
+  T getTotalPower() const; // ICE + MGU-K power
+  T getICEPower() const;   // Pure ICE power (combustion - losses)
 
 private:
-  Turbocharger turbo;
-  MGUH mguh;
-  MGUK mguk;
-  EnergyStore battery;
+  BasicEngineParams<T> params;
+
+  BasicTurbocharger<T> turbo;
+  BasicMGUH<T> mguh;
+  BasicMGUK<T> mguk;
+  BasicEnergyStore<T> battery;
+  BasicEcu<T> ecu;
+  BasicGasDynamics<T> gas; // disabled by default
 
   // state
-  double angular_velocity;             // rad/s
-  double throttle;                     // 0..1
-  double effective_throttle;           // 0..1 (after idle control)
-  double torque_output;                // Nm
-  double intake_manifold_pressure;     // Pa
-  double exhaust_manifold_pressure;    // Pa
-  double intake_manifold_temperature;  // K
-  double exhaust_manifold_temperature; // K
-  double load_torque;                  // Nm
-  double plenum_pressure;              // Pa
-  double spark_advance_deg;            // BTDC
-  double exhaust_mass_flow_rate;
-  double mguk_torque;
-
-  double combustion_torque;
-  double friction_torque;
-  double pumping_torque;
-  double indicated_torque;
-  double net_torque;
+  T angular_velocity;             // rad/s
+  T throttle;                     // 0..1
+  T effective_throttle;           // 0..1 (after idle control)
+  T torque_output;                // Nm
+  T intake_manifold_pressure;     // Pa
+  T exhaust_manifold_pressure;    // Pa
+  T intake_manifold_temperature;  // K
+  T exhaust_manifold_temperature; // K
+  T load_torque;                  // Nm
+  T external_load_torque;         // Nm
+  T plenum_pressure;              // Pa
+  T spark_advance_deg;            // BTDC
+  T exhaust_mass_flow_rate;
+  T mguk_torque;
+
+  T combustion_torque;
+  T friction_torque;
+  T pumping_torque;
+  T indicated_torque;
+  T net_torque;
 
   // Airflow telemetry
-  double na_air_flow;
-  double actual_air_flow;
-  double fuel_mass_flow;
-  double volumetric_efficiency;
+  T na_air_flow;
+  T actual_air_flow;
+  T fuel_mass_flow;
+  T volumetric_efficiency;
 
   // Performance metrics
-  double imep;
-  double fmep;
-  double bmep;
+  T imep;
+  T fmep;
+  T bmep;
 };
+
+using PlantState = BasicPlantState<double>;
+using ICEEngine = BasicICEEngine<double>;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ecu.hpp"
+#include "engine_params.hpp"
+#include "ice_engine.hpp"
+#include "scenario.hpp"
+#include "turbo_map.hpp"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Bump whenever a model change alters run outputs. It is part of every
+// result cache key, so results from an older model are never served.
+constexpr int kModelVersion = 2;
+
+// One self-contained simulation request: tunables, driver scenario, ECU
+// rate, optional turbo map and the outputs wanted back.
+struct SimulationJob {
+  EngineParams params;
+  Scenario scenario;
+  double control_period = Ecu::kDefaultPeriod; // s
+  std::string turbo_map;            // map file, empty for closed form
+  std::vector<std::string> outputs; // empty selects every RunOutputs name
+};
+
+// Single-line text form, whitespace-separated key=value fields, e.g.
+//   dt=1e-4 iterations=20000 throttle=0:0.3,0.07:1 ecu_period=0.001
+//   turbo_map=data/turbo_map.txt outputs=final_rpm,rpm fmepA=2e5
+// Any tunable from engine_params.hpp may be set by name. Outputs are
+// RunOutputs names (integrated over the run) or telemetry channel names
+// (value at the end of the run). Throws std::invalid_argument on an
+// unknown key or malformed value, including an empty throttle list and an
+// ecu_period that is not a positive number.
+SimulationJob parseJob(const std::string &text);
+
+// Every field spelled out in a fixed order with round-trippable doubles,
+// so equal jobs have equal text
+std::string canonicalJob(const SimulationJob &job);
+
+// Content address of a job's result: 128-bit FNV-1a (32 hex digits) of
+// the canonical job, the turbo map file contents and kModelVersion
+std::string jobKey(const SimulationJob &job);
+
+// Resolved output names (the defaults when the job lists none)
+std::vector<std::string> jobOutputs(const SimulationJob &job);
+
+class JobCancelled : public std::runtime_error {
+public:
+  JobCancelled() : std::runtime_error("job cancelled") {}
+};
+
+// runJob one slice at a time, for runners that interleave many jobs on
+// one thread. The engine is the caller's, built with job.params.
+class JobRun {
+public:
+  // `maps` overrides loading job.turbo_map, as for runJob
+  void start(const SimulationJob &job, ICEEngine &engine,
+             std::shared_ptr<const TurboMaps> maps = nullptr);
+
+  // Takes up to `steps` more steps; true once the scenario is finished
+  bool advance(ICEEngine &engine, int steps);
+
+  bool done() const { return step >= job->scenario.iterations; }
+  int getStep() const { return step; }
+
+  // One value per jobOutputs() entry, once done
+  std::vector<double> outputs(const ICEEngine &engine) const;
+
+private:
+  const SimulationJob *job = nullptr;
+  int step = 0;
+  double energy = 0.0;
+  double fuel = 0.0;
+  double peak_boost = 0.0;
+};
+
+// Runs the job and returns one value per jobOutputs() entry. `maps`
+// overrides loading job.turbo_map (callers may share loaded maps). Throws
+// JobCancelled soon after *cancel becomes true.
+std::vector<double> runJob(const SimulationJob &job,
+                           std::shared_ptr<const TurboMaps> maps = nullptr,
+                           const std::atomic<bool> *cancel = nullptr);
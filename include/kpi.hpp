@@ -0,0 +1,141 @@
+#pragma once
+
+#include "telemetry.hpp"
+#include <string>
+#include <vector>
+
+// ---------------- DEFINITION ----------------
+
+// Which KPIs to aggregate, over telemetry channels. Text form, one per
+// line (# starts a comment):
+//
+//   stats rpm boost_pressure             mean, std, min, max
+//   histogram boost_pressure 1e5 4e5 30  fixed bins over [lo, hi)
+//   quantiles rpm 0.5 0.9 0.99           within 0.1% (QuantileSketch)
+//   zones rpm 0 8000 12000 15000 x throttle 0 0.5 1.01
+//                                        time in each band (or band pair)
+//
+// Energy integrals (fuel energy, ICE work, ERS energy in and out of the
+// battery) are always kept.
+struct KpiSpec {
+  struct Histogram {
+    int channel;
+    double lo, hi;
+    int bins;
+  };
+  struct Quantiles {
+    int channel;
+    std::vector<double> probabilities;
+  };
+  struct Zones {
+    int channel;
+    std::vector<double> edges;
+    int cross_channel = -1; // second axis, -1 for one-dimensional zones
+    std::vector<double> cross_edges;
+  };
+
+  std::vector<int> stats;
+  std::vector<Histogram> histograms;
+  std::vector<Quantiles> quantiles;
+  std::vector<Zones> zones;
+};
+
+// Throws std::invalid_argument on an unknown channel or a malformed line
+KpiSpec parseKpiSpec(const std::string &text);
+KpiSpec loadKpiSpec(const std::string &path);
+
+// What python-client/main.py summarises from the full log
+KpiSpec defaultKpiSpec();
+
+// ---------------- AGGREGATION ----------------
+
+// Relative-error quantile sketch (DDSketch). Values are counted in
+// logarithmic buckets, so any quantile comes back within
+// `relative_accuracy` of a sample of the right rank, ties and plateaus
+// included. O(1) per sample; memory grows with the logarithm of the
+// values' dynamic range, not with the sample count.
+class QuantileSketch {
+public:
+  explicit QuantileSketch(double relative_accuracy = 1e-3);
+
+  void add(double x);
+  double quantile(double p) const; // NaN before the first sample
+  long count() const { return total; }
+
+private:
+  // Bucket counts for indices offset .. offset + counts.size() - 1
+  struct Store {
+    int offset = 0;
+    std::vector<long> counts;
+    void add(int index);
+  };
+
+  int indexOf(double magnitude) const;
+  double valueOf(int index) const; // bucket midpoint
+
+  double gamma, log_gamma;
+  Store positive, negative; // negative holds magnitudes
+  long zeros = 0;
+  long total = 0;
+};
+
+// Updates every KPI of a spec once per physics step. Each channel is
+// sampled once per step however many KPIs use it. Only the quantile
+// sketches allocate after construction, and only when a value lands
+// outside the range they have seen.
+class KpiAggregator {
+public:
+  explicit KpiAggregator(const KpiSpec &spec);
+
+  // Before the first update(), with the initial state
+  void begin(const ICEEngine &engine);
+
+  // After each update(), with the step just taken
+  void record(const ICEEngine &engine, double dt);
+
+  // Summary as JSON; throws std::runtime_error if it cannot be written
+  void write(const std::string &path) const;
+
+  double getDuration() const { return duration; }
+
+private:
+  struct Stats {
+    int slot; // index into `values`
+    long count = 0;
+    double mean = 0.0, m2 = 0.0; // Welford
+    double min = 0.0, max = 0.0;
+  };
+  struct Histogram {
+    KpiSpec::Histogram spec;
+    int slot;
+    std::vector<double> seconds; // [bins + 2]: below, bins..., above
+  };
+  struct Quantiles {
+    int slot;
+    std::vector<double> probabilities;
+    QuantileSketch sketch;
+  };
+  struct Zones {
+    KpiSpec::Zones spec;
+    int slot, cross_slot;
+    std::vector<double> seconds; // [cross band][band]; last: outside
+  };
+
+  std::vector<int> channels; // sampled channels, one slot each
+  std::vector<double> values; // this step's sample per slot
+
+  std::vector<Stats> stats;
+  std::vector<Histogram> histograms;
+  std::vector<Quantiles> quantiles;
+  std::vector<Zones> zones;
+
+  double duration = 0.0;
+  long steps = 0;
+
+  // Energy integrals, J
+  double fuel_mass = 0.0; // kg
+  double ice_work = 0.0;  // positive ICE power only
+  double mguk_deployed = 0.0, mguk_harvested = 0.0;
+  double mguh_deployed = 0.0, mguh_harvested = 0.0;
+  double battery_start = 0.0, battery_end = 0.0;
+};
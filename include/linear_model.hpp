@@ -0,0 +1,97 @@
+#pragma once
+
+#include "dual.hpp"
+#include "ice_engine.hpp"
+#include "scenario.hpp"
+#include <string>
+#include <vector>
+
+// ---------------- LINEARISATION ----------------
+
+// Discrete-time linearisation of the power unit over one sample period Ts:
+//
+//   x[k+1] = x0 + dx0 + A (x[k] - x0) + B (u[k] - u0)
+//   y[k]   = y0 + C (x[k] - x0) + D (u[k] - u0)
+//
+// x = (crank speed, intake manifold pressure, turbo speed, SOC),
+// u = (driver throttle, signed MGU-K power, signed MGU-H power) with
+// positive power motoring, y = (brake torque, total power, boost pressure,
+// fuel flow) measured after the first physics step of the period. dx0 is
+// the drift over one period at the operating point (zero at a trim point).
+struct LinearModel {
+  static constexpr int kStates = 4;
+  static constexpr int kInputs = 3;
+  static constexpr int kOutputs = 4;
+  static const char *const state_names[kStates];
+  static const char *const input_names[kInputs];
+  static const char *const output_names[kOutputs];
+
+  double period = 0.0; // s (Ts)
+
+  double x0[kStates];
+  double dx0[kStates];
+  double u0[kInputs];
+  double y0[kOutputs];
+
+  double A[kStates][kStates];
+  double B[kStates][kInputs];
+  double C[kOutputs][kStates];
+  double D[kOutputs][kInputs];
+};
+
+// Exact Jacobians by forward-mode AD through `period / dt` physics steps
+// with the actuators held at the ECU's current commands (two AD passes).
+// Lagged algebraic quantities (exhaust flow, combustion torque) start the
+// period at their operating-point values.
+LinearModel linearize(const BasicICEEngine<ad::ModelDual> &engine,
+                      double dt, double period);
+
+// Reduced state and inputs of a running engine, in LinearModel order
+void plantVector(const ICEEngine &engine, double *x);
+void inputVector(const ICEEngine &engine, double *u);
+void outputVector(const ICEEngine &engine, double *y);
+
+// ---------------- SURROGATE ----------------
+
+// Gridded linear-parameter-varying surrogate. Local linear models are
+// taken along training runs; each node of a (crank speed x throttle) grid
+// holds the model nearest to it, and a step blends the four surrounding
+// nodes' affine predictions bilinearly. One step advances one period.
+class LpvSurrogate {
+public:
+  static constexpr int kSpeedNodes = 24;
+  static constexpr int kThrottleNodes = 11;
+
+  // Linearises every `stride` periods along each training scenario
+  static LpvSurrogate build(const EngineParams &params,
+                            const std::vector<Scenario> &training,
+                            double period, int stride);
+
+  double getPeriod() const;
+  size_t getModelCount() const;
+
+  // x and y in LinearModel order; x is advanced in place
+  void step(double *x, const double *u, double *y) const;
+
+  // Plain-text coefficients; load throws std::runtime_error on a bad file
+  void save(const std::string &path) const;
+  static LpvSurrogate load(const std::string &path);
+
+private:
+  // Affine form of one node: x+ = F x + G u + h, y = P x + Q u + r
+  struct Node {
+    double F[LinearModel::kStates][LinearModel::kStates];
+    double G[LinearModel::kStates][LinearModel::kInputs];
+    double h[LinearModel::kStates];
+    double P[LinearModel::kOutputs][LinearModel::kStates];
+    double Q[LinearModel::kOutputs][LinearModel::kInputs];
+    double r[LinearModel::kOutputs];
+  };
+
+  static Node affine(const LinearModel &m);
+
+  double period = 0.0;
+  double speed_min = 0.0, speed_step = 1.0; // rad/s
+  size_t model_count = 0;
+  std::vector<Node> nodes; // [throttle node][speed node]
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ice_engine.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Live counters and gauges of one simulation. The step loop writes them
+// with relaxed atomic stores; MetricsExporter reads them from its own
+// thread, so publishing never touches the loop.
+struct SimulationMetrics {
+  std::atomic<uint64_t> steps{0};
+  std::atomic<double> simulated_seconds{0.0};
+  std::atomic<uint64_t> telemetry_bytes{0};
+  // Rows waiting in an asynchronous writer (0 for the synchronous ones)
+  std::atomic<int64_t> writer_queue_depth{0};
+  std::atomic<double> rpm{0.0};
+  std::atomic<double> battery_soc{0.0};
+
+  // Once per physics step, after update()
+  void recordStep(uint64_t step_count, double time, const ICEEngine &engine) {
+    steps.store(step_count, std::memory_order_relaxed);
+    simulated_seconds.store(time, std::memory_order_relaxed);
+    rpm.store(engine.getRPM(), std::memory_order_relaxed);
+    battery_soc.store(engine.getBatterySOC(), std::memory_order_relaxed);
+  }
+};
+
+struct MetricsExporterOptions {
+  double period = 1.0;     // s between samples
+  std::string run = "f1-pu"; // value of the `run` label
+  std::string textfile;    // Prometheus text file, rewritten atomically
+  std::string socket_path; // Unix socket; each connection gets one scrape
+  bool console = true;     // one progress line per sample on stdout
+};
+
+// Background publisher for SimulationMetrics. Every period it samples the
+// counters, derives steps/s and the realtime factor (simulated over wall
+// seconds) and publishes them: Prometheus text exposition to a file
+// (for node_exporter's textfile collector) and/or to whoever connects to
+// the socket, and optionally a console progress line.
+class MetricsExporter {
+public:
+  // Starts the thread. Throws std::runtime_error if the socket cannot be
+  // set up.
+  MetricsExporter(const SimulationMetrics &metrics,
+                  const MetricsExporterOptions &options);
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+  // Publishes a final sample and joins the thread
+  void stop();
+
+private:
+  struct Sample {
+    double wall = 0.0; // s since start
+    uint64_t steps = 0;
+    double simulated = 0.0;
+    uint64_t telemetry_bytes = 0;
+    int64_t queue_depth = 0;
+    double rpm = 0.0;
+    double soc = 0.0;
+    double steps_per_second = 0.0;
+    double realtime_factor = 0.0;
+  };
+
+  void run();
+  Sample sample(const Sample &previous) const;
+  std::string render(const Sample &s) const;
+  void publish(const Sample &s);
+
+  const SimulationMetrics &metrics;
+  MetricsExporterOptions options;
+  double start_wall;
+
+  int listen_fd = -1;
+  int wake_pipe[2] = {-1, -1};
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+};
@@ -2,17 +2,17 @@
 
 enum class MGUHMode { MOTOR, GENERATOR, IDLE };
 
-class MGUH {
+template <typename T> class BasicMGUH {
 public:
-  MGUH(double inertia, double efficiency, double max_power);
+  BasicMGUH(double inertia, double efficiency, double max_power);
 
   void setMode(MGUHMode m);
-  void setRequestedPower(double p); // W
+  void setRequestedPower(T p); // W
 
-  void update(double dt, double turbo_omega);
+  void update(double dt, T turbo_omega);
 
-  double getTorque() const;          // Nm (applied on turbo shaft)
-  double getElectricalPower() const; // W (+gen, -motor)
+  T getTorque() const;          // Nm (applied on turbo shaft)
+  T getElectricalPower() const; // W (+gen, -motor)
 
 private:
   // parameters
@@ -21,10 +21,12 @@ private:
   double maxPower;   // W
 
   // state
-  double omega;           // rad/s
-  double torque;          // Nm
-  double electricalPower; // W
-  double requestedPower;  // W
+  T omega;           // rad/s
+  T torque;          // Nm
+  T electricalPower; // W
+  T requestedPower;  // W
 
   MGUHMode mode;
 };
+
+using MGUH = BasicMGUH<double>;
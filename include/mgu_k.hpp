@@ -8,24 +8,26 @@ enum class MGUKMode {
   IDLE
 };
 
-class MGUK {
+template <typename T> class BasicMGUK {
 public:
-  MGUK(double efficiency, double max_power);
+  BasicMGUK(double efficiency, double max_power);
 
   void setMode(MGUKMode m);
-  void setRequestedPower(double p);
+  void setRequestedPower(T p);
 
-  void update(double dt, double crank_omega, EnergyStore &battery);
+  void update(double dt, T crank_omega, BasicEnergyStore<T> &battery);
 
-  double getTorque() const;
-  double getElectricalPower() const;
+  T getTorque() const;
+  T getElectricalPower() const;
 
 private:
   MGUKMode mode;
   double efficiency;
   double max_power;
 
-  double requested_power;
-  double torque;
-  double electrical_power;
+  T requested_power;
+  T torque;
+  T electrical_power;
 };
+
+using MGUK = BasicMGUK<double>;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ice_engine.hpp"
+#include "scenario.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class LpvSurrogate;
+
+struct PararealOptions {
+  int segments = 0;        // time slices; 0 selects one per worker
+  int workers = 0;         // fine-propagator threads; 0 = all cores
+  int coarse_factor = 5;   // coarse step = coarse_factor * scenario.dt
+  // Coarse propagator: the LPV surrogate (linear_model.hpp) when set,
+  // otherwise the full model at the coarse step. The model is only stable
+  // up to about 5 x dt, so the surrogate is far cheaper.
+  std::shared_ptr<const LpvSurrogate> surrogate;
+  double tolerance = 1e-7; // on the scaled boundary-state change
+  int max_iterations = 0;  // 0: until converged (at most `segments`)
+  int log_interval = 0;    // >0: keep telemetry every n fine steps
+};
+
+struct PararealResult {
+  ICEEngine final_state;
+  int iterations = 0; // fine sweeps
+  bool converged = false;
+  std::vector<double> residuals; // after each sweep
+
+  double coarse_seconds = 0.0; // wall time in the serial coarse sweeps
+  double fine_seconds = 0.0;   // wall time in the parallel fine sweeps
+  // Sum over sweeps of the slowest segment's CPU time: the fine sweeps'
+  // wall time with one core per segment
+  double longest_segment_seconds = 0.0;
+
+  // Telemetry from the last fine sweep when log_interval > 0
+  std::vector<int64_t> steps;
+  std::vector<double> rows; // [sample][kTelemetryChannels]
+};
+
+// Parareal parallel-in-time integration of one long run.
+//
+// The run is cut into segments. A coarse propagator (the surrogate, or
+// the same model at coarse_factor times the step) predicts the state at every segment
+// boundary serially; the fine propagator (the normal step) then re-runs
+// all unconverged segments concurrently from the current boundary
+// states, and the boundary states are corrected
+//
+//   U[n+1] = G(U[n]) + F(U_old[n]) - G(U_old[n])
+//
+// until they stop changing. Corrections apply to the dynamic plant state
+// (PlantState); the rest of the engine (ECU, lagged algebraic quantities)
+// is taken from the fine run. The first k segments are exact after k
+// sweeps, so at most `segments` sweeps reproduce the serial run exactly;
+// a smooth trajectory converges in two or three.
+//
+// The residual is the largest boundary change in units of 1000 rad/s,
+// 1 bar, 10000 rad/s and full SOC.
+PararealResult runParareal(const ICEEngine &initial, const Scenario &scenario,
+                           const PararealOptions &options);
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "telemetry.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------------- RULES ----------------
+
+// Limit rules over the engine state. Text form, one rule per line (#
+// starts a comment), fields separated by whitespace:
+//
+//   <name> <lhs> <op> <rhs> [for <s>] [hysteresis <amount>]
+//          [severity info|warn|error]
+//
+//   overspeed  rpm > 15000 for 0.01 hysteresis 200
+//   overboost  boost_pressure > turbo_max_pr*ambient_pressure
+//   soc_low    battery_soc < 0.05 hysteresis 0.01 severity error
+//   mguk_power abs(mguk_power) > mguk_max_power
+//   deployment integral(neg(mguk_power)) > 4e6
+//
+// op is one of < <= > >=. lhs is a telemetry channel or one of abs(x),
+// pos(x) (max(x, 0)), neg(x) (max(-x, 0)) and integral(x) (∫x dt since
+// the start of the run), nested freely. rhs is another such expression
+// or numbers and named constants (see ruleConstants()) joined by * and /.
+//
+// A rule raises once its condition has held for `for` seconds (default:
+// on the first step) and clears when the lhs has come back past the rhs
+// by more than `hysteresis`, in the lhs' units.
+struct Rule {
+  enum class Op { LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+  enum class Severity { INFO, WARN, ERROR };
+
+  std::string name;
+  std::string lhs, rhs; // expression text
+  Op op = Op::GREATER;
+  double duration = 0.0;   // s
+  double hysteresis = 0.0; // lhs units, >= 0
+  Severity severity = Severity::WARN;
+};
+
+// Throws std::invalid_argument on a malformed rule, an unknown channel or
+// constant, or a repeated rule name
+std::vector<Rule> parseRules(const std::string &text);
+std::vector<Rule> loadRules(const std::string &path);
+
+// Names usable in a constant rhs: the limits in constants.hpp
+struct RuleConstant {
+  const char *name;
+  double value;
+};
+const std::vector<RuleConstant> &ruleConstants();
+
+const char *severityName(Rule::Severity severity);
+
+// ---------------- MONITOR ----------------
+
+struct RuleEvent {
+  int64_t step;
+  int64_t onset_step; // first step of the condition that raised it
+  int rule;
+  bool raised; // false: cleared
+  double value, threshold;
+};
+
+// Evaluates compiled rules once per physics step. Construction turns the
+// rules into a flat program: each channel is sampled once into a slot,
+// derived terms (abs, integrals, lhs - rhs for a channel rhs, ...) are a
+// straight list of operations over slots, and every rule becomes a
+// threshold on one slot. Rules on the same slot and direction share a
+// sorted threshold table with a cursor at the slot's current value, so a
+// step costs the samples, the operations and a comparison per table;
+// only rules whose threshold was crossed do any work. Hundreds of limits
+// on a few dozen terms cost about as much as the terms alone.
+class RuleMonitor {
+public:
+  RuleMonitor(const std::vector<Rule> &rules, double dt);
+
+  // Once per physics step, after update(). Steps must increase by one.
+  void record(int64_t step, const ICEEngine &engine);
+
+  const std::vector<Rule> &getRules() const { return rules; }
+  const std::vector<RuleEvent> &getEvents() const { return events; }
+  bool isActive(int rule) const { return active[rule] != 0; }
+  long getRaisedCount(int rule) const { return raised_count[rule]; }
+  double getActiveSeconds(int rule) const;
+
+  // Events as CSV (time, rule, event, severity, value, threshold,
+  // onset); throws std::runtime_error if it cannot be written
+  void write(const std::string &path) const;
+
+private:
+  int compile(const std::string &term); // slot holding the term's value
+  int difference(int a, int b);         // slot holding slot a - slot b
+  void raise(int rule, int64_t step);
+  void clear(int rule, int64_t step);
+
+  std::vector<Rule> rules;
+  double dt;
+
+  // Slots hold sampled channels, constants and derived terms; `program`
+  // computes the derived ones, sources first
+  std::vector<int> channels, channel_slots; // sampled each step
+  std::vector<double> slots;
+  std::vector<std::string> slot_terms; // while compiling, to share slots
+  std::vector<uint8_t> slot_constant;  // while compiling
+
+  enum class OpCode { ABS, POS, NEG, INTEGRAL, DIFFERENCE };
+  struct Operation {
+    OpCode code;
+    int src, src2, dst;
+  };
+  std::vector<Operation> program;
+
+  // With y = sign * slot, a rule is over while y > its `on` threshold and
+  // clears once y < its `clear` threshold (on minus the hysteresis). Each
+  // table holds its rules twice, sorted by either threshold, in
+  // [begin, end) of the flat arrays below. `over` rules are the first
+  // over_count by on threshold; `clear` rules all but the first
+  // kept_count by clear threshold.
+  struct Table {
+    int slot;
+    double sign;
+    int begin, end;
+    int over_count = 0, kept_count = 0;
+    // Thresholds either side of the cursors: while on_below < y <=
+    // on_above and clear_below <= y < clear_above, nothing can change
+    double on_below = 0.0, on_above = 0.0, clear_below = 0.0,
+           clear_above = 0.0;
+  };
+  std::vector<Table> tables;
+  void setBounds(Table &table) const;
+  std::vector<double> on_threshold, clear_threshold;
+  std::vector<int> on_rule, clear_rule;
+
+  // Per rule
+  std::vector<int> lhs_slot, rhs_slot; // reported with events
+  std::vector<int64_t> need_steps;
+  std::vector<int64_t> onset; // step the condition began, -1 while not over
+  std::vector<uint8_t> active;
+  std::vector<int> pending; // over, not yet held for long enough
+
+  std::vector<long> raised_count;
+  std::vector<int64_t> active_steps, active_since;
+  int64_t last_step = -1;
+
+  std::vector<RuleEvent> events;
+};
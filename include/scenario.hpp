@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct ThrottlePoint {
+  double time;     // s
+  double throttle; // 0..1
+};
+
+// Open-loop driver input for one run. Throttle is linearly interpolated
+// between points and held after the last one; two points at the same time
+// form a step.
+struct Scenario {
+  std::string name = "ramp";
+  double dt = 0.0001;      // s
+  int iterations = 100000; // physics steps
+  std::vector<ThrottlePoint> throttle = {{0.0, 0.3}, {0.07, 1.0}};
+
+  double duration() const { return dt * iterations; }
+  double throttleAt(double t) const;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "engine_params.hpp"
+#include "scenario.hpp"
+#include <string>
+#include <vector>
+
+// Scalar run outputs tracked by sensitivity studies
+struct RunOutputs {
+  static constexpr int count = 5;
+  static const char *const names[count];
+};
+
+// Output values and their exact derivatives with respect to a set of
+// tunables, from forward-mode AD through the full power-unit model.
+struct SensitivityReport {
+  std::vector<std::string> parameters;
+  std::vector<double> values;                   // [output]
+  std::vector<std::vector<double>> derivatives; // [output][parameter]
+};
+
+// Plain double-precision run of the same outputs
+std::vector<double> evaluateOutputs(const EngineParams &params,
+                                    const Scenario &scenario);
+
+// Parameters are processed ad::kModelDirections at a time, so N tunables
+// cost ceil(N / kModelDirections) model runs. Throws std::invalid_argument
+// on an unknown parameter name.
+SensitivityReport
+computeSensitivities(const EngineParams &params,
+                     const std::vector<std::string> &parameters,
+                     const Scenario &scenario);
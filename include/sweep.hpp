@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// ---------------- SWEEP DEFINITION ----------------
+
+// A design-of-experiments sweep: the full grid of the varied job fields
+// over a base job, plus any jobs listed explicitly. Text form, one
+// directive per line (# starts a comment):
+//
+//   base iterations=20000 outputs=energy_J,fuel_kg,final_rpm
+//   vary fmepA 3e4 4e4 5e4
+//   vary throttle 0:0.3,0.07:1 0:1
+//   job iterations=5000 throttle=0:1
+//
+// Job fields are those of parseJob (job.hpp); a varied value is appended
+// to the base text, so it overrides a base field of the same name.
+struct SweepPlan {
+  struct Point {
+    std::vector<std::string> values; // one per key; empty for explicit jobs
+    std::string job;                 // parseJob text
+  };
+
+  std::vector<std::string> keys; // varied fields, in grid order
+  std::vector<Point> points;
+};
+
+// Throws std::invalid_argument on a bad directive or job
+SweepPlan parseSweep(const std::string &text);
+SweepPlan loadSweep(const std::string &path);
+
+// ---------------- SHARED-DIRECTORY QUEUE ----------------
+//
+// A sweep directory on a filesystem every node mounts:
+//
+//   jobs.txt             every point: index, varied values, job text
+//   pending/<shard>.a<n> shard files waiting for attempt n
+//   leased/<shard>.a<n>.<worker>  claimed; mtime is the worker's heartbeat
+//   done/<shard>         finished shards
+//   failed/<shard>       shards that used up their attempts
+//   results/<shard>.csv  one row per job of the shard
+//   clock/<worker>       touched to read the filesystem's clock
+//
+// Every state change is a rename(2) within the directory, which is atomic,
+// so exactly one worker wins each claim or reclaim. A lease whose mtime is
+// older than the lease time (measured on the filesystem's clock, so node
+// clocks need not agree) is abandoned; any worker moves it back to
+// pending for another attempt. Jobs are deterministic, so a shard finished
+// twice (by a slow worker and its replacement) writes identical results.
+
+// Writes the plan into `dir` (created; must be empty) as shards of
+// `shard_size` jobs. Returns the number of shards. Throws
+// std::runtime_error on I/O failure.
+int planSweep(const std::string &dir, const SweepPlan &plan, int shard_size);
+
+struct SweepWorkerOptions {
+  std::string worker_id;     // default: host name and pid
+  double lease_seconds = 60; // heartbeat every quarter of this
+  int max_attempts = 3;      // claims of one shard before it is failed
+  int threads = 0;           // jobs of a shard run concurrently; 0 = all
+  double poll_seconds = 1.0; // wait while other workers hold the leases
+};
+
+struct SweepWorkerReport {
+  int shards = 0;    // run to completion by this worker
+  int jobs = 0;
+  int job_errors = 0; // jobs that threw (recorded in their result row)
+  int reclaimed = 0;  // abandoned leases moved back to pending
+  int lost = 0;       // own leases reclaimed by others before finishing
+};
+
+// Claims and runs shards until none are pending or leased. Safe to run
+// any number of times concurrently, on any nodes.
+SweepWorkerReport runSweepWorker(const std::string &dir,
+                                 const SweepWorkerOptions &options);
+
+struct SweepStatus {
+  int shards = 0;
+  int pending = 0;
+  int leased = 0;
+  int stale = 0; // leased but past the lease time
+  int done = 0;
+  int failed = 0;
+};
+
+SweepStatus sweepStatus(const std::string &dir, double lease_seconds = 60);
+
+// Joins jobs.txt with every shard's results into one CSV in job order:
+// index, the varied keys, status, then the outputs. Returns the rows
+// written. Throws std::runtime_error if a shard has no results yet or the
+// shards disagree on their output columns.
+size_t mergeSweep(const std::string &dir, const std::string &out_path);
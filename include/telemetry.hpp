@@ -0,0 +1,125 @@
+#pragma once
+
+#include "ice_engine.hpp"
+#include "telemetry_codec.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// ---------------- CHANNELS ----------------
+
+constexpr int kTelemetryChannels = 40;
+
+struct TelemetryChannel {
+  const char *name;
+  double (*sample)(const ICEEngine &engine);
+};
+
+// Logged channels in CSV column order (after "time")
+extern const TelemetryChannel telemetryChannels[kTelemetryChannels];
+
+std::vector<std::string> telemetryChannelNames();
+
+// Index into telemetryChannels, or -1 for an unknown name
+int findTelemetryChannel(const std::string &name);
+
+// Fills out[0..kTelemetryChannels) from the current engine state
+void sampleTelemetry(const ICEEngine &engine, double *out);
+
+// ---------------- WRITERS ----------------
+
+// Sink for logged rows; a row's timestamp is step * dt.
+class TelemetryWriter {
+public:
+  virtual ~TelemetryWriter() = default;
+
+  virtual void write(int64_t step, const double *values) = 0;
+  virtual void close() = 0;
+
+  virtual uint64_t bytesWritten() const = 0;
+};
+
+// Text log, fixed 6 decimals (data/engine_log.csv format)
+class CsvTelemetryWriter : public TelemetryWriter {
+public:
+  CsvTelemetryWriter(const std::string &path,
+                     const std::vector<std::string> &channels, double dt);
+
+  void write(int64_t step, const double *values) override;
+  void close() override;
+  uint64_t bytesWritten() const override;
+
+private:
+  std::ofstream out;
+  std::string line; // reused row buffer
+  uint64_t bytes = 0;
+  size_t channel_count;
+  double dt;
+};
+
+// How .f1pz value streams are coded
+enum class TelemetryCoding : uint8_t {
+  // Bit-exact doubles, XOR coded
+  EXACT = 0,
+  // Values rounded to 1e-6 exactly as the CSV's %.6f rounds them (sign
+  // included), then delta-of-delta coded as integers; decodes to the same
+  // CSV text. The writer throws std::domain_error on a non-finite value or
+  // one of 4.5e9 or more in magnitude.
+  MICRO = 1,
+};
+
+// Per-channel Gorilla coding (.f1pz).
+//
+// Layout, little-endian:
+//   "F1PZ" u16 version u16 channels u8 coding f64 dt { u8 len, name }*
+//   blocks: u32 rows, u32 bytes, time stream, { u32 bytes, value stream }*
+// Each block restarts its encoders so it can be decoded on its own.
+class CompressedTelemetryWriter : public TelemetryWriter {
+public:
+  static constexpr uint32_t kBlockRows = 4096;
+
+  CompressedTelemetryWriter(const std::string &path,
+                            const std::vector<std::string> &channels,
+                            double dt,
+                            TelemetryCoding coding = TelemetryCoding::EXACT);
+  ~CompressedTelemetryWriter() override;
+
+  void write(int64_t step, const double *values) override;
+  void close() override;
+  uint64_t bytesWritten() const override;
+
+private:
+  void flushBlock();
+
+  std::ofstream out;
+  TelemetryCoding coding;
+  uint64_t bytes = 0;
+  uint32_t rows = 0;
+
+  DeltaOfDeltaEncoder time_encoder;
+  BitWriter time_bits;
+  std::vector<XorEncoder> xor_encoders;         // EXACT
+  std::vector<DeltaOfDeltaEncoder> dod_encoders; // MICRO
+  std::vector<BitWriter> channel_bits;
+};
+
+// ---------------- READING ----------------
+
+struct TelemetryTrace {
+  double dt = 0.0;
+  TelemetryCoding coding = TelemetryCoding::EXACT;
+  std::vector<std::string> channels;
+  std::vector<double> time;                // s
+  std::vector<std::vector<double>> values; // [channel][row]
+};
+
+// Throws std::runtime_error on a missing or malformed file
+TelemetryTrace readCompressedTelemetry(const std::string &path);
+
+// CSV in the simulator's format ("time" then one column per channel; any
+// channel subset). dt is the spacing of the first two rows.
+TelemetryTrace readCsvTelemetry(const std::string &path);
+
+// .f1pz by extension, otherwise CSV
+TelemetryTrace readTelemetry(const std::string &path);
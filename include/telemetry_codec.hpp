@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Gorilla-style lossless time-series coding (Pelkonen et al., VLDB 2015).
+//
+// Integer sequences (step indices, fixed-point values) are coded as
+// delta-of-delta in variable-width buckets; doubles as the XOR of
+// consecutive IEEE-754 bit patterns with leading/trailing-zero packing.
+// Slowly varying channels collapse to one or a few bits per sample.
+
+// MSB-first bit packer
+class BitWriter {
+public:
+  void write(uint64_t bits, int count); // count in [0, 64]
+
+  // Pads the final partial byte with zeros
+  const std::vector<uint8_t> &finish();
+  void clear();
+
+private:
+  std::vector<uint8_t> out;
+  uint64_t acc = 0; // pending bits (fewer than 8 after each write)
+  int pending = 0;
+};
+
+class BitReader {
+public:
+  BitReader(const uint8_t *data, size_t size);
+
+  uint64_t read(int count); // count in [0, 64]; zeros past the end
+
+private:
+  const uint8_t *data;
+  size_t size;
+  size_t bit_pos = 0;
+};
+
+// ---------------- INTEGER SEQUENCES ----------------
+
+// Buckets: 0 | 10+7 | 110+9 | 1110+12 | 11110+32 | 11111+64 bits
+class DeltaOfDeltaEncoder {
+public:
+  void encode(int64_t value, BitWriter &out);
+  void reset();
+
+private:
+  bool started = false;
+  int64_t prev = 0;
+  int64_t prev_delta = 0;
+};
+
+class DeltaOfDeltaDecoder {
+public:
+  int64_t decode(BitReader &in);
+  void reset();
+
+private:
+  bool started = false;
+  int64_t prev = 0;
+  int64_t prev_delta = 0;
+};
+
+// ---------------- VALUES ----------------
+
+class XorEncoder {
+public:
+  void encode(double value, BitWriter &out);
+  void reset();
+
+private:
+  bool started = false;
+  uint64_t prev = 0;
+  int prev_leading = -1; // -1: no reusable window yet
+  int prev_trailing = 0;
+};
+
+class XorDecoder {
+public:
+  double decode(BitReader &in);
+  void reset();
+
+private:
+  bool started = false;
+  uint64_t prev = 0;
+  int prev_leading = 0;
+  int prev_trailing = 0;
+};
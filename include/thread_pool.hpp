@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork-join batches. parallelFor hands
+// out indices one at a time, so uneven tasks (traces of different length,
+// segments that converge early) balance themselves.
+class ThreadPool {
+public:
+  // threads <= 0 selects one per hardware thread. The calling thread
+  // works too, so a pool of N runs N tasks at once with N - 1 workers.
+  explicit ThreadPool(int threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  int size() const;
+
+  // Runs fn(0) .. fn(count - 1) and returns when all have finished.
+  // Rethrows the first exception a task threw. Not reentrant: tasks must
+  // not call parallelFor on the same pool.
+  void parallelFor(int count, const std::function<void(int)> &fn);
+
+private:
+  void work();
+  void drain();
+
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable batch_ready;
+  std::condition_variable batch_done;
+  bool stopping = false;
+
+  // Current batch, guarded by mutex
+  const std::function<void(int)> *task = nullptr;
+  int count = 0;
+  int next = 0;
+  int running = 0; // tasks handed out but not finished
+  long generation = 0;
+  std::exception_ptr error;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "engine_params.hpp"
+#include <string>
+#include <vector>
+
+// ---------------- STEP-RESPONSE DETECTOR ----------------
+
+// Step-response metrics of one signal, times from the step in seconds.
+// NaN where the signal did not move (change under the detector's
+// resolution) or did not settle inside the window.
+struct StepMetrics {
+  double initial = 0.0;
+  double final = 0.0;     // mean over the closing window
+  double t10 = 0.0;       // first reaches 10% of the change
+  double t90 = 0.0;       // first reaches 90% of the change
+  double rise_time = 0.0; // t90 - t10
+  double overshoot = 0.0; // peak beyond final, fraction of the change
+  double settling_time = 0.0; // last time outside the band around final
+};
+
+// Streaming step-response analysis. Samples are consumed one at a time
+// and never stored: the detector keeps the running-extreme envelopes (for
+// first-passage times) and the suffix-extreme staircases (for settling),
+// each thinned to `resolution`, so memory is bounded by the signal's
+// range over the resolution, not by the length of the run. The latest
+// running extreme is always kept exactly, with the sample before it, so
+// a passage is interpolated between the two samples that straddle it
+// unless thinning dropped the record that made it.
+class StepResponseDetector {
+public:
+  // initial: value at the step. resolution: smallest change that matters
+  // (signal units). final_from: samples at or after this time form the
+  // final-value average.
+  StepResponseDetector(double initial, double resolution, double final_from);
+
+  void add(double t, double y);
+
+  // band: settling band as a fraction of the change
+  StepMetrics finish(double band = 0.02) const;
+
+  size_t storedPoints() const;
+
+private:
+  struct Point {
+    double t, y;
+  };
+  // A new running extreme and the sample just before it
+  struct Record {
+    Point before, at;
+  };
+
+  double initial, resolution, final_from;
+  Point last; // previous sample
+  double final_sum = 0.0;
+  long final_count = 0;
+
+  // Running max / min envelopes: a record whenever the extreme advances by
+  // more than the resolution
+  std::vector<Record> rising, falling;
+  Record peak, trough; // latest records, on every sample
+
+  // Suffix max / min staircases: values non-increasing (max) or
+  // non-decreasing (min) in time
+  std::vector<Point> suffix_max, suffix_min;
+};
+
+// ---------------- CHARACTERIZATION SUITE ----------------
+
+// One throttle step from a warmed-up operating point
+struct TransientCase {
+  double rpm = 8000.0;         // held during warm-up
+  double throttle_from = 0.2;  // warm-up throttle
+  double throttle_to = 1.0;    // after the step
+  bool mguh_assist = true;     // ECU boost strategy; off holds the MGU-H idle
+
+  std::string name() const; // e.g. "tip-in 8000rpm 0.20->1.00 mguh-on"
+};
+
+struct TransientOptions {
+  std::vector<double> rpm = {6000.0, 8000.0, 10000.0, 11500.0};
+  // Part-throttle levels: tip-in from each to full, lift-off from full to
+  // each
+  std::vector<double> part_throttle = {0.0, 0.2, 0.4};
+
+  double dt = 1e-4;
+  double warmup = 2.0;        // s at the held speed before the step
+  double duration = 3.0;      // s recorded after the step
+  double final_window = 0.25; // closing seconds averaged for final values
+  double band = 0.02;         // settling band, fraction of the change
+  // After the step the crank drives a road-load dyno absorbing the
+  // warm-up torque plus dyno_slope * (omega - omega_0)
+  double dyno_slope = 2.0; // N·m·s/rad
+  int threads = 0;         // 0 = all cores
+};
+
+struct TransientResult {
+  TransientCase test;
+  StepMetrics boost;       // boost pressure, Pa
+  StepMetrics torque;      // brake torque, N·m
+  StepMetrics turbo_speed; // rad/s
+  StepMetrics crank_speed; // rad/s
+  double dyno_torque = 0.0; // absorbed at the step, N·m
+  size_t detector_points = 0; // envelope points held by the detectors
+};
+
+// Tip-in and lift-off for every rpm x part-throttle point, with MGU-H
+// assist on and off
+std::vector<TransientCase> transientMatrix(const TransientOptions &options);
+
+// Runs every case concurrently. Each distinct operating point
+// (rpm, throttle, assist) is warmed up once with the crank held at speed
+// by an ideal dyno; its cases then start from copies of that state.
+std::vector<TransientResult>
+characterizeTransients(const EngineParams &params,
+                       const std::vector<TransientCase> &cases,
+                       const TransientOptions &options);
+
+// One row per case; throws std::runtime_error if the file cannot be
+// written
+void writeTransientSummary(const std::string &path,
+                           const std::vector<TransientResult> &results);
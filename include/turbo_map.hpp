@@ -0,0 +1,94 @@
+#pragma once
+
+#include "aligned.hpp"
+#include <string>
+#include <vector>
+
+// ---------------- GRIDS ----------------
+
+// Monotonic breakpoints with precomputed inverse spans
+struct MapAxis {
+  std::vector<double> points;
+  std::vector<double> inv_span; // 1 / (points[i+1] - points[i])
+
+  explicit MapAxis(std::vector<double> points = {});
+  int size() const { return int(points.size()); }
+};
+
+// Last cell visited; kept by the caller so consecutive lookups from a
+// slowly moving operating point skip the search entirely.
+struct MapCursor {
+  int i = 0;
+  int j = 0;
+};
+
+// Bilinear table over (x, y) with several fields stored per node, so one
+// cell fetch serves every field. Nodes are row-major in y, fields
+// interleaved: data[((j * nx) + i) * fields + f]. Outside the grid the
+// edge values are held.
+class Map2D {
+public:
+  Map2D() = default;
+  Map2D(MapAxis x, MapAxis y, int fields, std::vector<double> values);
+
+  // Writes `fields` interpolated values to out
+  template <typename T>
+  void lookup(const T &x, const T &y, MapCursor &cursor, T *out) const;
+
+  // Inverse along y: the largest y at which `field`, interpolated at x,
+  // still reaches `target` (e.g. the flow a compressor speed line passes at
+  // a pressure ratio). The field must be non-increasing in y. Holds the
+  // first y when target is never reached, the last when it always is.
+  template <typename T>
+  T lastYReaching(const T &x, int field, const T &target,
+                  MapCursor &cursor) const;
+
+  const MapAxis &xAxis() const { return x; }
+  const MapAxis &yAxis() const { return y; }
+  int fieldCount() const { return fields; }
+
+private:
+  MapAxis x, y;
+  int fields = 0;
+  AlignedVector<double> data;
+};
+
+// ---------------- TURBO MAPS ----------------
+
+// Compressor: x = corrected speed ratio (N / turbo_nominal_speed),
+//             y = corrected mass flow (kg/s), fields = {PR, efficiency};
+//             PR non-increasing in flow along each speed line
+// Turbine:    x = corrected speed ratio (N / turbo_nominal_speed divided by
+//             sqrt(T_in / turbine_reference_temp)),
+//             y = expansion ratio (p_in / p_out), fields = {efficiency}
+struct TurboMaps {
+  static constexpr int kCompressorPR = 0;
+  static constexpr int kCompressorEfficiency = 1;
+  static constexpr int kTurbineEfficiency = 0;
+
+  static constexpr double turbine_reference_temp = 873.0; // K
+
+  Map2D compressor;
+  Map2D turbine;
+
+  // Text format, '#' comments, whitespace separated:
+  //   compressor
+  //   speed <n> s0 s1 ...
+  //   flow <m> f0 f1 ...
+  //   pr <n*m values, one speed row per line>
+  //   efficiency <n*m values>
+  //   turbine
+  //   speed <n> ...
+  //   expansion <m> ...
+  //   efficiency <n*m values>
+  // Throws std::runtime_error on missing or malformed input.
+  static TurboMaps load(const std::string &path);
+
+  // Grids reproducing the closed-form turbocharger's pressure ratio
+  // (linear speed-to-PR ramp) and constant efficiencies; useful to
+  // validate the map path. Its speed lines are flat in flow, so they never
+  // choke below the exhaust flow the way the closed-form flow capacity
+  // (linear in speed) can.
+  static TurboMaps closedForm(double turbine_efficiency,
+                              double compressor_efficiency);
+};
@@ -1,33 +1,49 @@
 #pragma once
 
-class Turbocharger {
+#include "turbo_map.hpp"
+#include <memory>
+
+template <typename T> class BasicTurbocharger {
 public:
-  Turbocharger(double inertia, double turbine_efficiency,
-               double compressor_efficiency, double bearing_loss_coeff);
+  BasicTurbocharger(double inertia, T turbine_efficiency,
+                    T compressor_efficiency, double bearing_loss_coeff);
 
   void update(double dt,
-              double exhaust_mass_flow,     // kg/s
-              double exhaust_pressure,      // Pa
-              double exhaust_temperature,   // K
-              double target_boost_pressure, // Pa (wastegate control)
-              double mgu_torque);
+              T exhaust_mass_flow,     // kg/s
+              T exhaust_pressure,      // Pa
+              T exhaust_temperature,   // K
+              T target_boost_pressure, // Pa (wastegate control)
+              T mgu_torque);
+
+  // Map-based compressor/turbine (shared, immutable); nullptr selects the
+  // closed-form speed ramp and constant efficiencies
+  void setMaps(std::shared_ptr<const TurboMaps> maps);
 
   // Outputs to engine
-  double getCompressorOutletPressure() const;
-  double getCompressorOutletTemperature() const;
-  double getAvailableAirMassFlow() const;
+  T getCompressorOutletPressure() const;
+  T getCompressorOutletTemperature() const;
+  T getAvailableAirMassFlow() const;
 
-  double getShaftAngularSpeed() const;
+  T getShaftAngularSpeed() const;
+  void setShaftAngularSpeed(T omega); // rad/s (state override)
+  void setAvailableAirMassFlow(T kg_s); // kg/s (state override)
+  void setCompressorOutletPressure(T pa); // Pa (state override)
 
 private:
-  double shaft_angular_speed; // rad/s
+  T shaft_angular_speed; // rad/s
 
-  double turbo_inertia;         // kg·m²
-  double turbine_efficiency;    // 0–1
-  double compressor_efficiency; // 0–1
-  double bearing_loss_coeff;    // W per rad/s
+  double turbo_inertia;    // kg·m²
+  T turbine_efficiency;    // 0–1
+  T compressor_efficiency; // 0–1
+  double bearing_loss_coeff; // W per rad/s
 
-  double compressor_outlet_pressure;    // Pa
-  double compressor_outlet_temperature; // K
-  double available_air_mass_flow;       // kg/s
+  T compressor_outlet_pressure;    // Pa
+  T compressor_outlet_temperature; // K
+  T available_air_mass_flow;       // kg/s
+
+  std::shared_ptr<const TurboMaps> maps;
+  MapCursor compressor_cursor;
+  MapCursor turbine_cursor;
 };
+
+using Turbocharger = BasicTurbocharger<double>;
@@ -0,0 +1,223 @@
+"""Decoder for compressed f1-pu telemetry (.f1pz).
+
+Mirrors CompressedTelemetryWriter in src/telemetry.cpp: per-channel Gorilla
+streams, step indices and MICRO-coded values as delta-of-delta integers,
+EXACT-coded values as XOR of consecutive IEEE-754 bit patterns.
+
+Each block stream is expanded to ASCII bits in one conversion. Runs of
+codes with the same layout (repeats, a reused XOR window, a delta-of-delta
+bucket) are found with strided slices and decoded together in numpy, so
+the Python loop only runs once per run rather than once per sample.
+`read_f1pz_dataframe` additionally needs pandas.
+"""
+
+import struct
+
+import numpy as np
+
+EXACT = 0
+MICRO = 1
+
+ZERO, ONE = ord("0"), ord("1")
+
+# Bits past the end of a stream read as zeros (BitReader in C++)
+_PAD = b"0" * 192
+
+# Longest run handed to numpy at once; bounds the strided scan
+_SPAN = 512
+
+# Shorter runs are cheaper to decode one code at a time
+_BULK = 16
+
+# Delta-of-delta buckets: (prefix, payload bits, bias or None if signed)
+_BUCKETS = [
+    (b"10", 7, 63),
+    (b"110", 9, 255),
+    (b"1110", 12, 2047),
+    (b"11110", 32, None),
+    (b"11111", 64, None),
+]
+
+
+def _bits(data):
+    """MSB-first ASCII bits of one block stream, zero padded."""
+    digits = format(int.from_bytes(data, "big"), f"0{len(data) * 8}b")
+    return digits.encode() + _PAD
+
+
+def _run(bits, pos, count, stride, prefix):
+    """How many of the next `count` codes of `stride` bits start with `prefix`."""
+    for i, bit in enumerate(prefix):
+        column = bits[pos + i : pos + count * stride : stride]
+        end = column.find(b"0" if bit == ONE else b"1")
+        count = min(count, len(column)) if end < 0 else min(count, end)
+    return count
+
+
+def _fields(bits, pos, count, stride, skip):
+    """The `stride - skip` low bits of `count` codes, as uint64."""
+    grid = np.frombuffer(bits, np.uint8, count * stride, pos)
+    grid = grid.reshape(count, stride)[:, skip:] - ZERO
+    padded = np.zeros((count, 64), np.uint8)
+    padded[:, 64 - (stride - skip) :] = grid
+    return np.packbits(padded, axis=1).view(">u8").ravel().astype(np.uint64)
+
+
+def _signed(value, width):
+    return value - (1 << width) if value >= 1 << (width - 1) else value
+
+
+def _decode_dod(bits, rows):
+    """Delta-of-delta integers: 0 | 10+7 | 110+9 | 1110+12 | 11110+32 | 11111+64."""
+    prev = _signed(int(bits[:64], 2), 64)
+    out = [prev]
+    delta = 0
+    pos, left = 64, rows - 1
+    while left:
+        if bits[pos] == ZERO:
+            # Zero dods continue the same delta
+            end = bits.find(b"1", pos)
+            run = left if end < 0 else min(end - pos, left)
+            if delta:
+                out.extend(range(prev + delta, prev + delta * (run + 1), delta))
+                prev += delta * run
+            else:
+                out.extend([prev] * run)
+            pos += run
+            left -= run
+            continue
+        ones = bits.find(b"0", pos, pos + 5)
+        prefix, width, bias = _BUCKETS[(5 if ones < 0 else ones - pos) - 1]
+        skip = len(prefix)
+        stride = skip + width
+        run = _run(bits, pos, min(left, _BULK), stride, prefix)
+        if run < _BULK:
+            for _ in range(run):
+                dod = int(bits[pos + skip : pos + stride], 2)
+                delta += dod - bias if bias is not None else _signed(dod, width)
+                prev += delta
+                out.append(prev)
+                pos += stride
+            left -= run
+            continue
+        run = _run(bits, pos, min(left, _SPAN), stride, prefix)
+        fields = _fields(bits, pos, run, stride, skip)
+        if bias is not None:
+            dods = fields.astype(np.int64) - bias
+        elif width == 32:
+            dods = fields.astype(np.int64)
+            dods[dods >= 1 << 31] -= 1 << 32
+        else:
+            dods = fields.view(np.int64)
+        deltas = np.cumsum(dods) + delta
+        values = np.cumsum(deltas) + prev
+        out.extend(values.tolist())
+        delta, prev = int(deltas[-1]), int(values[-1])
+        pos += run * stride
+        left -= run
+    return np.array(out, np.int64)
+
+
+def _decode_xor(bits, rows):
+    """IEEE-754 bit patterns: 0 | 10+window | 11+5+6+meaningful."""
+    out = np.empty(rows, np.uint64)
+    prev = int(bits[:64], 2)
+    out[0] = prev
+    width, trailing = 64, 0
+    pos, row = 64, 1
+    while row < rows:
+        if bits[pos] == ZERO:
+            end = bits.find(b"1", pos)
+            run = rows - row if end < 0 else min(end - pos, rows - row)
+            out[row : row + run] = prev
+            pos += run
+            row += run
+            continue
+        if bits[pos + 1] == ONE:
+            leading = int(bits[pos + 2 : pos + 7], 2)
+            width = int(bits[pos + 7 : pos + 13], 2) or 64
+            trailing = 64 - leading - width
+            pos += 13
+            prev ^= int(bits[pos : pos + width], 2) << trailing
+            out[row] = prev
+            pos += width
+            row += 1
+            continue
+        # Consecutive samples reusing the same window
+        stride = 2 + width
+        run = _run(bits, pos, min(rows - row, _SPAN), stride, b"10")
+        xors = _fields(bits, pos, run, stride, 2) << np.uint64(trailing)
+        xors[0] ^= np.uint64(prev)
+        np.bitwise_xor.accumulate(xors, out=out[row : row + run])
+        prev = int(out[row + run - 1])
+        pos += run * stride
+        row += run
+    return out
+
+
+def _from_micro(q):
+    """MICRO integers to values; negatives are stored one lower (sign of zero)."""
+    negative = q < 0
+    return np.copysign((q + negative) / 1e6, np.where(negative, -1.0, 1.0))
+
+
+def read_f1pz(path):
+    """Returns {"time": array, channel: array, ...} in logging order."""
+    with open(path, "rb") as f:
+        buf = f.read()
+
+    if buf[:4] != b"F1PZ":
+        raise ValueError(f"{path}: not an f1pz file")
+    version, channels, coding = struct.unpack_from("<HHB", buf, 4)
+    if version != 1:
+        raise ValueError(f"{path}: unsupported f1pz version {version}")
+    (dt,) = struct.unpack_from("<d", buf, 9)
+    pos = 17
+
+    names = []
+    for _ in range(channels):
+        length = buf[pos]
+        names.append(buf[pos + 1 : pos + 1 + length].decode())
+        pos += 1 + length
+
+    decode = _decode_dod if coding == MICRO else _decode_xor
+    steps = []
+    columns = [[] for _ in names]
+    while pos < len(buf):
+        rows, size = struct.unpack_from("<II", buf, pos)
+        pos += 8
+        steps.append(_decode_dod(_bits(buf[pos : pos + size]), rows))
+        pos += size
+
+        for column in columns:
+            (size,) = struct.unpack_from("<I", buf, pos)
+            column.append(decode(_bits(buf[pos + 4 : pos + 4 + size]), rows))
+            pos += 4 + size
+
+    def join(blocks, dtype):
+        return np.concatenate(blocks) if blocks else np.empty(0, dtype)
+
+    result = {"time": join(steps, np.int64) * dt}
+    for name, column in zip(names, columns):
+        if coding == MICRO:
+            result[name] = _from_micro(join(column, np.int64))
+        else:
+            result[name] = join(column, np.uint64).view(np.float64)
+    return result
+
+
+def read_f1pz_dataframe(path):
+    import pandas as pd
+
+    return pd.DataFrame(read_f1pz(path))
+
+
+if __name__ == "__main__":
+    import sys
+
+    data = read_f1pz(sys.argv[1])
+    rows = len(data["time"])
+    print(f"{rows} rows x {len(data) - 1} channels")
+    for name, values in data.items():
+        if len(values):
+            print(f"  {name:28s} first={values[0]:.6f} last={values[-1]:.6f}")
@@ -1,6 +1,7 @@
 # %% F1 Power Unit Telemetry Analysis Dashboard
 # Professional diagnostic plots used by F1 teams for engine development and testing
 
+import os
 import warnings
 
 import matplotlib.pyplot as plt
@@ -8,6 +9,8 @@ import numpy as np
 import pandas as pd
 from matplotlib.gridspec import GridSpec
 
+from f1pz import read_f1pz_dataframe
+
 warnings.filterwarnings("ignore")
 
 # Set professional styling
@@ -18,8 +21,11 @@ plt.rcParams["font.family"] = "sans-serif"
 plt.rcParams["font.size"] = 10
 
 # %%
-# Load telemetry data
-df = pd.read_csv("../data/engine_log.csv")
+# Load telemetry data (compressed log from `f1-pu --compressed` if present)
+if os.path.exists("../data/engine_log.f1pz"):
+    df = read_f1pz_dataframe("../data/engine_log.f1pz")
+else:
+    df = pd.read_csv("../data/engine_log.csv")
 print(f"Loaded {len(df)} data points")
 print(f"Columns: {list(df.columns)}")
 df.head()
@@ -0,0 +1,315 @@
+#include "../include/battery_pack.hpp"
+#include "../include/dual.hpp"
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+// Partial results per pack-level reduction; four doubles fill one AVX
+// register, two SSE2 registers
+constexpr int kLanes = 4;
+
+// ∫ OCV d(soc) from empty, V
+template <typename T> static T cellEnergyIntegral(const T &soc) {
+  return soc * (3.0 + soc * (0.6 + soc * (-0.3 + soc * 0.225)));
+}
+
+// Fixed pseudo-random value in [-1, 1) for cell i, property k
+static double cellVariation(int i, int k) {
+  uint64_t z = uint64_t(i) * 2 + uint64_t(k) + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return double(z >> 11) * 0x1.0p-52 - 1.0;
+}
+
+template <typename T>
+BasicBatteryPack<T>::BasicBatteryPack(const BatteryPackParams &p,
+                                      double full_energy_J, T initial_soc)
+    : params(p), pending_charge(0.0), pending_current_sq(0.0),
+      current(0.0) {
+  if (p.cells < 1)
+    throw std::invalid_argument("battery pack needs at least one cell");
+  int n = p.cells;
+  soc.assign(n, ad::clamp(initial_soc, 0.0, 1.0));
+  v_rc.assign(n, T(0.0));
+  temperature.assign(n, T(p.coolant_temp));
+  r0.assign(n, T(p.r0));
+  emf.resize(n);
+  discharge_limit.resize(n);
+  charge_limit.resize(n);
+  charge_C.resize(n);
+  inv_charge.resize(n);
+  r0_ref.resize(n);
+  r1.resize(n);
+  inv_r1.resize(n);
+
+  double capacity_sum = 0.0;
+  for (int i = 0; i < n; i++) {
+    charge_C[i] = 1.0 + p.spread * cellVariation(i, 0);
+    capacity_sum += charge_C[i];
+  }
+  // Scaled so the whole string holds exactly full_energy_J
+  double unit = full_energy_J / (cellEnergyIntegral(1.0) * capacity_sum);
+  for (int i = 0; i < n; i++) {
+    double resistance = 1.0 + p.spread * cellVariation(i, 1);
+    charge_C[i] *= unit;
+    inv_charge[i] = 1.0 / charge_C[i];
+    r0_ref[i] = p.r0 * resistance;
+    r1[i] = p.r1 * resistance;
+    inv_r1[i] = 1.0 / r1[i];
+    total_charge_C += charge_C[i];
+  }
+  refresh();
+}
+
+template <typename T> void BasicBatteryPack<T>::setSOC(T value) {
+  T s = ad::clamp(value, 0.0, 1.0);
+  for (T &cell : soc)
+    cell = s;
+  pending_dt = 0.0;
+  pending_charge = pending_current_sq = 0.0;
+  refresh();
+}
+
+// --------------------------------------------------
+// CELL KERNELS
+// --------------------------------------------------
+
+// Free functions over raw arrays: restrict only holds for parameters, and
+// without it every store could move the member arrays
+
+// Advances every cell by h on the mean current and mean squared current
+// over it
+template <typename T>
+static void stepCells(int n, T current, T current_sq, double h,
+                      double rc_decay, double heat_decay, double coolant,
+                      double cooling, T *__restrict soc, T *__restrict v_rc,
+                      T *__restrict temperature, const T *__restrict r0,
+                      const double *__restrict r1,
+                      const double *__restrict inv_r1,
+                      const double *__restrict inv_charge) {
+  const T rc_gain = current * (1.0 - rc_decay);
+  const T discharged = current * h;
+  const double inv_cooling = 1.0 / cooling;
+  for (int i = 0; i < n; i++) {
+    T v = v_rc[i] * rc_decay + r1[i] * rc_gain;
+    v_rc[i] = v;
+    soc[i] = ad::clamp(soc[i] - discharged * inv_charge[i], 0.0, 1.0);
+    // Joule heat of R0 and R1; temperature relaxes towards its balance
+    T balance = coolant + (current_sq * r0[i] + v * v * inv_r1[i]) *
+                              inv_cooling;
+    temperature[i] = balance + (temperature[i] - balance) * heat_decay;
+  }
+}
+
+// R0 at each cell's temperature, the EMF net of the RC branch and the
+// largest discharge and charge current the cell allows
+template <typename T>
+static void cellLimits(int n, const BatteryPackParams &p,
+                       const T *__restrict soc, const T *__restrict v_rc,
+                       const T *__restrict temperature,
+                       const double *__restrict r0_ref, T *__restrict r0,
+                       T *__restrict emf, T *__restrict discharge_limit,
+                       T *__restrict charge_limit) {
+  const double derate = p.max_current / (p.max_temp - p.derate_temp);
+  for (int i = 0; i < n; i++) {
+    T t = temperature[i];
+    T r = r0_ref[i] *
+          ad::max(1.0 + p.r0_temp_coeff * (p.reference_temp - t), 0.5);
+    T e = cellOpenCircuitVoltage(soc[i]) - v_rc[i];
+    T thermal = ad::clamp((p.max_temp - t) * derate, 0.0, p.max_current);
+    r0[i] = r;
+    emf[i] = e;
+    discharge_limit[i] = ad::min(thermal, (e - p.min_cell_voltage) / r);
+    charge_limit[i] = ad::min(thermal, (p.max_cell_voltage - e) / r);
+  }
+}
+
+template <typename T> struct PackTotals {
+  T emf, resistance, charge, energy;
+  T min_soc, max_soc, max_temperature;
+  T discharge_current, charge_current;
+};
+
+// Sums and extremes over the cells. Lane l takes cells l, l + kLanes, ...
+// so the lanes of each quantity sit side by side and one vector
+// instruction advances all of them.
+template <typename T>
+static PackTotals<T>
+packTotals(int n, const T *__restrict soc, const T *__restrict temperature,
+           const T *__restrict r0, const T *__restrict emf,
+           const T *__restrict discharge_limit,
+           const T *__restrict charge_limit,
+           const double *__restrict charge_C) {
+  T emf_sum[kLanes], r_sum[kLanes], charge_sum[kLanes], energy_sum[kLanes];
+  T soc_lo[kLanes], soc_hi[kLanes], temp_hi[kLanes];
+  T discharge_lo[kLanes], charge_lo[kLanes];
+  for (int l = 0; l < kLanes; l++) {
+    emf_sum[l] = r_sum[l] = charge_sum[l] = energy_sum[l] = 0.0;
+    soc_lo[l] = soc_hi[l] = soc[0];
+    temp_hi[l] = temperature[0];
+    discharge_lo[l] = discharge_limit[0];
+    charge_lo[l] = charge_limit[0];
+  }
+
+  const int whole = n / kLanes * kLanes;
+  for (int i = 0; i < whole; i += kLanes) {
+    for (int l = 0; l < kLanes; l++) {
+      T s = soc[i + l];
+      emf_sum[l] += emf[i + l];
+      r_sum[l] += r0[i + l];
+      charge_sum[l] += charge_C[i + l] * s;
+      energy_sum[l] += charge_C[i + l] * cellEnergyIntegral(s);
+      soc_lo[l] = ad::min(soc_lo[l], s);
+      soc_hi[l] = ad::max(soc_hi[l], s);
+      temp_hi[l] = ad::max(temp_hi[l], temperature[i + l]);
+      discharge_lo[l] = ad::min(discharge_lo[l], discharge_limit[i + l]);
+      charge_lo[l] = ad::min(charge_lo[l], charge_limit[i + l]);
+    }
+  }
+
+  PackTotals<T> total{0.0,       0.0,        0.0,
+                      0.0,       soc_lo[0],  soc_hi[0],
+                      temp_hi[0], discharge_lo[0], charge_lo[0]};
+  for (int l = 0; l < kLanes; l++) {
+    total.emf += emf_sum[l];
+    total.resistance += r_sum[l];
+    total.charge += charge_sum[l];
+    total.energy += energy_sum[l];
+    total.min_soc = ad::min(total.min_soc, soc_lo[l]);
+    total.max_soc = ad::max(total.max_soc, soc_hi[l]);
+    total.max_temperature = ad::max(total.max_temperature, temp_hi[l]);
+    total.discharge_current =
+        ad::min(total.discharge_current, discharge_lo[l]);
+    total.charge_current = ad::min(total.charge_current, charge_lo[l]);
+  }
+  for (int i = whole; i < n; i++) {
+    T s = soc[i];
+    total.emf += emf[i];
+    total.resistance += r0[i];
+    total.charge += charge_C[i] * s;
+    total.energy += charge_C[i] * cellEnergyIntegral(s);
+    total.min_soc = ad::min(total.min_soc, s);
+    total.max_soc = ad::max(total.max_soc, s);
+    total.max_temperature = ad::max(total.max_temperature, temperature[i]);
+    total.discharge_current =
+        ad::min(total.discharge_current, discharge_limit[i]);
+    total.charge_current = ad::min(total.charge_current, charge_limit[i]);
+  }
+  return total;
+}
+
+template <typename T> void BasicBatteryPack<T>::step(T power_W, double dt) {
+  if (dt <= 0.0)
+    return;
+
+  // P = I (voc - I R), on the branch through I = 0; the form avoids
+  // cancellation at small power
+  T disc = voc * voc - 4.0 * resistance * power_W;
+  current = disc > 0.0 ? 2.0 * power_W / (voc + ad::sqrt(disc))
+                       : voc / (2.0 * resistance);
+
+  pending_dt += dt;
+  pending_charge += current * dt;
+  pending_current_sq += current * current * dt;
+  // Every cell of the string carries the full current
+  pack_soc = ad::clamp(
+      pack_soc - current * dt * double(params.cells) / total_charge_C, 0.0,
+      1.0);
+  energy = ad::max(energy - voc * current * dt, 0.0);
+
+  // The tolerance keeps rounding in the sum of steps from adding a step
+  if (pending_dt >= params.cell_period * (1.0 - 1e-9))
+    updateCells();
+}
+
+template <typename T> void BasicBatteryPack<T>::updateCells() {
+  double h = pending_dt;
+  stepCells(params.cells, pending_charge / h, pending_current_sq / h, h,
+            std::exp(-h / params.tau),
+            std::exp(-h * params.cooling / params.heat_capacity),
+            params.coolant_temp, params.cooling, soc.data(), v_rc.data(),
+            temperature.data(), r0.data(), r1.data(), inv_r1.data(),
+            inv_charge.data());
+  pending_dt = 0.0;
+  pending_charge = pending_current_sq = 0.0;
+  refresh();
+}
+
+template <typename T> void BasicBatteryPack<T>::refresh() {
+  const int n = params.cells;
+  cellLimits(n, params, soc.data(), v_rc.data(), temperature.data(),
+             r0_ref.data(), r0.data(), emf.data(), discharge_limit.data(),
+             charge_limit.data());
+  PackTotals<T> total =
+      packTotals(n, soc.data(), temperature.data(), r0.data(), emf.data(),
+                 discharge_limit.data(), charge_limit.data(),
+                 charge_C.data());
+
+  voc = total.emf;
+  resistance = total.resistance;
+  pack_soc = total.charge / total_charge_C;
+  energy = total.energy;
+  min_soc = total.min_soc;
+  max_soc = total.max_soc;
+  max_temperature = total.max_temperature;
+
+  // Beyond voc / 2R more current delivers less power
+  max_discharge_current =
+      min_soc <= 0.0 ? T(0.0)
+                     : ad::clamp(total.discharge_current, 0.0,
+                                 voc / (2.0 * resistance));
+  max_charge_current =
+      max_soc >= 1.0 ? T(0.0) : ad::max(total.charge_current, 0.0);
+}
+
+// --------------------------------------------------
+// QUERIES
+// --------------------------------------------------
+
+template <typename T> T BasicBatteryPack<T>::getSOC() const {
+  return pack_soc;
+}
+
+template <typename T> T BasicBatteryPack<T>::getEnergy() const {
+  return energy;
+}
+
+template <typename T> T BasicBatteryPack<T>::getOpenCircuitVoltage() const {
+  return voc;
+}
+
+template <typename T> T BasicBatteryPack<T>::getResistance() const {
+  return resistance;
+}
+
+template <typename T> T BasicBatteryPack<T>::getCurrent() const {
+  return current;
+}
+
+template <typename T> T BasicBatteryPack<T>::getTerminalVoltage() const {
+  return voc - current * resistance;
+}
+
+template <typename T> T BasicBatteryPack<T>::getMaxChargePower() const {
+  return max_charge_current * (voc + max_charge_current * resistance);
+}
+
+template <typename T> T BasicBatteryPack<T>::getMaxDischargePower() const {
+  return max_discharge_current * (voc - max_discharge_current * resistance);
+}
+
+template <typename T> T BasicBatteryPack<T>::getMinCellSOC() const {
+  return min_soc;
+}
+
+template <typename T> T BasicBatteryPack<T>::getMaxCellSOC() const {
+  return max_soc;
+}
+
+template <typename T> T BasicBatteryPack<T>::getMaxCellTemperature() const {
+  return max_temperature;
+}
+
+template class BasicBatteryPack<double>;
+template class BasicBatteryPack<ad::ModelDual>;
@@ -0,0 +1,545 @@
+#include "../include/calibration.hpp"
+#include "../include/constants.hpp"
+#include "../include/dual.hpp"
+#include "../include/ice_engine.hpp"
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using Dual = ad::ModelDual;
+
+const char *const calibrationChannelNames[kCalibrationChannels] = {
+    "rpm",           "torque_output", "boost_pressure",
+    "intake_manifold_pressure",      "exhaust_manifold_pressure",
+    "exhaust_temp",  "fuel_mass_flow", "turbo_speed",
+    "ice_power",     "total_power"};
+
+// Same quantities as the telemetry channels of the same name
+template <typename T>
+static T channelValue(const BasicICEEngine<T> &e, int channel) {
+  switch (channel) {
+  case 0:
+    return e.getRPM();
+  case 1:
+    return e.getTorqueOutput();
+  case 2:
+    return e.getBoostPressure();
+  case 3:
+    return e.getIntakeManifoldPressure();
+  case 4:
+    return e.getExhaustManifoldPressure();
+  case 5:
+    return e.getExhaustTemperature();
+  case 6:
+    return e.getFuelMassFlow();
+  case 7:
+    return e.getTurboSpeed();
+  case 8:
+    return e.getICEPower();
+  default:
+    return e.getTotalPower();
+  }
+}
+
+static int columnIndex(const TelemetryTrace &t, const std::string &name) {
+  for (size_t c = 0; c < t.channels.size(); c++)
+    if (t.channels[c] == name)
+      return int(c);
+  return -1;
+}
+
+// --------------------------------------------------
+// TRACES
+// --------------------------------------------------
+
+namespace {
+
+// State columns restored at the start of a segment, in the order of
+// PlantState then LaggedState; the throttle is restored with them
+constexpr int kStateColumns = 8;
+const char *const stateColumns[kStateColumns] = {
+    "omega",          "intake_manifold_pressure", "turbo_speed",
+    "battery_soc",    "combustion_torque",        "exhaust_mass_flow",
+    "boost_pressure", "turbo_air_flow"};
+
+// ECU commands in force at that row, from what the actuators did
+constexpr int kCommandColumns = 3;
+const char *const commandColumns[kCommandColumns] = {
+    "effective_throttle", "mguh_power", "mguk_power"};
+
+// A stretch of a trace resampled onto the physics step grid, replayed
+// from the state logged at its first row
+struct Prepared {
+  int trace = 0;
+  int64_t first_step = 0; // initial state is the state after this step
+  std::vector<double> throttle;       // steps first_step + 1 ...
+  std::vector<int64_t> compare_steps; // rows compared, in order
+  std::vector<double> measured;       // [compare][fit channel]
+  double initial[kStateColumns];      // NaN: model default
+  double initial_throttle = 0.0;
+  double commands[kCommandColumns];   // NaN: model default
+};
+
+} // namespace
+
+// The trace split into segments of about o.segment_length, each starting
+// at the last row compared by the one before
+static std::vector<Prepared> prepare(const DynoTrace &trace, int index,
+                                     const CalibrationOptions &o,
+                                     const std::vector<int> &fit_columns) {
+  const TelemetryTrace &t = trace.data;
+  int throttle = columnIndex(t, "throttle");
+  if (throttle < 0)
+    throw std::invalid_argument(trace.name + ": no throttle column");
+  if (t.time.size() < 2)
+    throw std::invalid_argument(trace.name + ": fewer than two rows");
+
+  std::vector<int> columns;
+  for (int c : fit_columns) {
+    int col = columnIndex(t, calibrationChannelNames[c]);
+    if (col < 0)
+      throw std::invalid_argument(trace.name + ": no " +
+                                  calibrationChannelNames[c] + " column");
+    columns.push_back(col);
+  }
+  int state[kStateColumns], command[kCommandColumns];
+  for (int k = 0; k < kStateColumns; k++)
+    state[k] = columnIndex(t, stateColumns[k]);
+  for (int k = 0; k < kCommandColumns; k++)
+    command[k] = columnIndex(t, commandColumns[k]);
+  int rpm = columnIndex(t, "rpm");
+
+  // Throttle linearly interpolated between rows, for every step
+  const std::vector<double> &pedal = t.values[throttle];
+  const int64_t trace_first = std::llround(t.time.front() / o.dt);
+  const int64_t trace_last = std::llround(t.time.back() / o.dt);
+  std::vector<double> steps_throttle;
+  size_t row = 0;
+  for (int64_t s = trace_first + 1; s <= trace_last; s++) {
+    double time = s * o.dt;
+    while (row + 2 < t.time.size() && t.time[row + 1] <= time)
+      row++;
+    double span = t.time[row + 1] - t.time[row];
+    double f = span > 0.0 ? (time - t.time[row]) / span : 0.0;
+    f = std::clamp(f, 0.0, 1.0);
+    steps_throttle.push_back(pedal[row] + f * (pedal[row + 1] - pedal[row]));
+  }
+
+  auto begin = [&](size_t r) {
+    Prepared p;
+    p.trace = index;
+    p.first_step = std::llround(t.time[r] / o.dt);
+    for (int k = 0; k < kStateColumns; k++)
+      p.initial[k] = state[k] >= 0 ? t.values[state[k]][r] : NAN;
+    if (state[0] < 0 && rpm >= 0)
+      p.initial[0] = t.values[rpm][r] * 2.0 * constants::PI / 60.0;
+    p.initial_throttle = pedal[r];
+    for (int k = 0; k < kCommandColumns; k++)
+      p.commands[k] = command[k] >= 0 ? t.values[command[k]][r] : NAN;
+    return p;
+  };
+  auto finish = [&](Prepared &p) {
+    int64_t last = std::min(p.compare_steps.back(), trace_last);
+    for (int64_t s = p.first_step + 1; s <= last; s++)
+      p.throttle.push_back(steps_throttle[size_t(s - trace_first - 1)]);
+  };
+
+  std::vector<Prepared> segments;
+  Prepared p = begin(0);
+  size_t start = 0, last_compared = 0;
+  for (size_t r = 1; r < t.time.size(); r += size_t(std::max(o.stride, 1))) {
+    if (o.segment_length > 0.0 && !p.compare_steps.empty() &&
+        t.time[r] - t.time[start] > o.segment_length) {
+      finish(p);
+      segments.push_back(std::move(p));
+      start = last_compared;
+      p = begin(start);
+    }
+    p.compare_steps.push_back(std::llround(t.time[r] / o.dt));
+    for (int col : columns)
+      p.measured.push_back(t.values[col][r]);
+    last_compared = r;
+  }
+  finish(p);
+  segments.push_back(std::move(p));
+  return segments;
+}
+
+// Model values at every compared row, [compare][fit channel]
+template <typename T>
+static std::vector<T> simulate(const Prepared &p,
+                               const BasicEngineParams<T> &params, double dt,
+                               const std::vector<int> &fit_channels) {
+  BasicICEEngine<T> engine(params);
+  BasicPlantState<T> s = engine.getPlantState();
+  BasicLaggedState<T> lagged = engine.getLaggedState();
+  T *fields[kStateColumns] = {
+      &s.angular_velocity,       &s.intake_manifold_pressure,
+      &s.turbo_speed,            &s.battery_soc,
+      &lagged.combustion_torque, &lagged.exhaust_mass_flow,
+      &lagged.boost_pressure,    &lagged.turbo_air_flow};
+  for (int k = 0; k < kStateColumns; k++)
+    if (!std::isnan(p.initial[k]))
+      *fields[k] = p.initial[k];
+  engine.setPlantState(s);
+  engine.setLaggedState(lagged);
+  engine.setThrottle(p.initial_throttle);
+
+  // Electrical power is positive generating and, unless at a limit, the
+  // power requested
+  BasicEcuCommands<T> cmd = engine.getEcu().getCommands();
+  cmd.throttle = std::isnan(p.commands[0])
+                     ? BasicEcu<T>::commandedThrottle(p.initial_throttle,
+                                                      s.angular_velocity)
+                     : T(p.commands[0]);
+  if (!std::isnan(p.commands[1])) {
+    double w = p.commands[1];
+    cmd.mguh_mode = w > 0.0   ? MGUHMode::GENERATOR
+                    : w < 0.0 ? MGUHMode::MOTOR
+                              : MGUHMode::IDLE;
+    cmd.mguh_power = std::abs(w);
+  }
+  if (!std::isnan(p.commands[2])) {
+    double w = p.commands[2];
+    cmd.mguk_mode = w > 0.0   ? MGUKMode::GENERATOR
+                    : w < 0.0 ? MGUKMode::MOTOR
+                              : MGUKMode::IDLE;
+    cmd.mguk_power = std::abs(w);
+  }
+  engine.resumeControl(cmd, long(p.first_step), dt);
+
+  std::vector<T> out;
+  out.reserve(p.compare_steps.size() * fit_channels.size());
+  size_t next = 0;
+  for (size_t i = 0; i < p.throttle.size(); i++) {
+    int64_t step = p.first_step + 1 + int64_t(i);
+    engine.setThrottle(p.throttle[i]);
+    engine.update(dt);
+    for (; next < p.compare_steps.size() && p.compare_steps[next] <= step;
+         next++)
+      for (int c : fit_channels)
+        out.push_back(channelValue(engine, c));
+  }
+  // Rows past the end of the throttle data repeat the final state
+  for (; next < p.compare_steps.size(); next++)
+    for (int c : fit_channels)
+      out.push_back(channelValue(engine, c));
+  return out;
+}
+
+// --------------------------------------------------
+// DENSE LINEAR ALGEBRA (n = number of fitted parameters)
+// --------------------------------------------------
+
+// Cholesky factor of a symmetric n x n matrix in place (lower triangle);
+// false if it is not positive definite
+static bool cholesky(std::vector<double> &a, int n) {
+  for (int j = 0; j < n; j++) {
+    double d = a[j * n + j];
+    for (int k = 0; k < j; k++)
+      d -= a[j * n + k] * a[j * n + k];
+    if (!(d > 0.0))
+      return false;
+    a[j * n + j] = std::sqrt(d);
+    for (int i = j + 1; i < n; i++) {
+      double v = a[i * n + j];
+      for (int k = 0; k < j; k++)
+        v -= a[i * n + k] * a[j * n + k];
+      a[i * n + j] = v / a[j * n + j];
+    }
+  }
+  return true;
+}
+
+static std::vector<double> choleskySolve(const std::vector<double> &l, int n,
+                                         std::vector<double> b) {
+  for (int i = 0; i < n; i++) {
+    for (int k = 0; k < i; k++)
+      b[i] -= l[i * n + k] * b[k];
+    b[i] /= l[i * n + i];
+  }
+  for (int i = n - 1; i >= 0; i--) {
+    for (int k = i + 1; k < n; k++)
+      b[i] -= l[k * n + i] * b[k];
+    b[i] /= l[i * n + i];
+  }
+  return b;
+}
+
+// --------------------------------------------------
+// LEVENBERG-MARQUARDT
+// --------------------------------------------------
+
+CalibrationResult
+calibrate(const EngineParams &start, const std::vector<DynoTrace> &traces,
+          const CalibrationOptions &options,
+          const std::function<void(int, double, double)> &progress) {
+  const int n = int(options.parameters.size());
+  if (n == 0)
+    throw std::invalid_argument("no parameters to fit");
+  if (traces.empty())
+    throw std::invalid_argument("no traces");
+
+  std::vector<double> x(n), unit(n);
+  for (int j = 0; j < n; j++) {
+    EngineParams probe = start;
+    double *field = findParameter(probe, options.parameters[j]);
+    if (!field)
+      throw std::invalid_argument("unknown parameter: " +
+                                  options.parameters[j]);
+    x[j] = *field;
+    unit[j] = *field != 0.0 ? std::abs(*field) : 1.0; // step scaling
+  }
+  auto bounded = [&](int j, double v) {
+    if (j < int(options.lower.size()))
+      v = std::max(v, options.lower[j]);
+    if (j < int(options.upper.size()))
+      v = std::min(v, options.upper[j]);
+    return v;
+  };
+  for (int j = 0; j < n; j++)
+    x[j] = bounded(j, x[j]);
+
+  std::vector<int> fit_channels;
+  for (const std::string &name : options.channels) {
+    int found = -1;
+    for (int c = 0; c < kCalibrationChannels; c++)
+      if (name == calibrationChannelNames[c])
+        found = c;
+    if (found < 0)
+      throw std::invalid_argument("channel cannot be fitted: " + name);
+    fit_channels.push_back(found);
+  }
+  const int nc = int(fit_channels.size());
+
+  std::vector<Prepared> prepared; // segments of every trace, in order
+  std::vector<size_t> offset;     // first residual of each segment
+  size_t m = 0;
+  for (size_t t = 0; t < traces.size(); t++)
+    for (Prepared &p : prepare(traces[t], int(t), options, fit_channels)) {
+      offset.push_back(m);
+      m += p.measured.size();
+      prepared.push_back(std::move(p));
+    }
+  if (m <= size_t(n))
+    throw std::invalid_argument("fewer residuals than parameters");
+
+  // Residual normalisation: each channel's spread over all traces
+  std::vector<double> scale(nc);
+  for (int c = 0; c < nc; c++) {
+    double sum = 0.0, sum_sq = 0.0;
+    size_t count = 0;
+    for (const Prepared &p : prepared)
+      for (size_t k = c; k < p.measured.size(); k += nc) {
+        sum += p.measured[k];
+        sum_sq += p.measured[k] * p.measured[k];
+        count++;
+      }
+    double mean = sum / double(count);
+    double var = std::max(sum_sq / double(count) - mean * mean, 0.0);
+    scale[c] = var > 0.0 ? std::sqrt(var) : std::max(std::abs(mean), 1.0);
+  }
+
+  auto paramsAt = [&](const std::vector<double> &values) {
+    EngineParams p = start;
+    for (int j = 0; j < n; j++)
+      *findParameter(p, options.parameters[j]) = values[j];
+    return p;
+  };
+
+  ThreadPool pool(options.threads);
+  const int groups = (n + ad::kModelDirections - 1) / ad::kModelDirections;
+
+  // Residuals r and Jacobian J (m x n, with respect to x / unit) at x
+  std::vector<double> r(m), J(m * size_t(n));
+  auto evaluateJacobian = [&](const std::vector<double> &at) {
+    BasicEngineParams<Dual> base = castParams<Dual>(paramsAt(at));
+    pool.parallelFor(int(prepared.size()) * groups, [&](int task) {
+      int t = task / groups, g = task % groups;
+      BasicEngineParams<Dual> seeded = base;
+      int first = g * ad::kModelDirections;
+      int count = std::min(ad::kModelDirections, n - first);
+      for (int d = 0; d < count; d++)
+        *findParameter(seeded, options.parameters[first + d]) =
+            Dual::variable(at[first + d], d);
+
+      std::vector<Dual> out =
+          simulate(prepared[t], seeded, options.dt, fit_channels);
+      const std::vector<double> &meas = prepared[t].measured;
+      for (size_t k = 0; k < out.size(); k++) {
+        size_t i = offset[t] + k;
+        double s = scale[k % nc];
+        if (g == 0)
+          r[i] = (out[k].v - meas[k]) / s;
+        for (int d = 0; d < count; d++)
+          J[i * n + first + d] = out[k].d[d] * unit[first + d] / s;
+      }
+    });
+  };
+
+  // Cost only, plain double runs
+  std::vector<double> trial_r(m);
+  auto evaluateCost = [&](const std::vector<double> &at) {
+    EngineParams p = paramsAt(at);
+    pool.parallelFor(int(prepared.size()), [&](int t) {
+      std::vector<double> out =
+          simulate(prepared[t], p, options.dt, fit_channels);
+      const std::vector<double> &meas = prepared[t].measured;
+      for (size_t k = 0; k < out.size(); k++)
+        trial_r[offset[t] + k] = (out[k] - meas[k]) / scale[k % nc];
+    });
+    double cost = 0.0;
+    for (double v : trial_r)
+      cost += 0.5 * v * v;
+    return cost;
+  };
+
+  CalibrationResult result;
+  result.parameters = options.parameters;
+  result.residual_count = m;
+
+  double lambda = 1e-3;
+  std::vector<double> A(size_t(n) * n), g(n);
+  bool finished = false;
+  for (;;) {
+    evaluateJacobian(x);
+    double cost = 0.0;
+    for (double v : r)
+      cost += 0.5 * v * v;
+    if (result.iterations == 0)
+      result.initial_cost = cost;
+    result.final_cost = cost;
+
+    // Normal equations: A = J'J, g = J'r
+    std::fill(A.begin(), A.end(), 0.0);
+    std::fill(g.begin(), g.end(), 0.0);
+    for (size_t i = 0; i < m; i++) {
+      const double *row = &J[i * n];
+      for (int a = 0; a < n; a++) {
+        g[a] += row[a] * r[i];
+        for (int b = 0; b <= a; b++)
+          A[a * n + b] += row[a] * row[b];
+      }
+    }
+    for (int a = 0; a < n; a++)
+      for (int b = 0; b < a; b++)
+        A[b * n + a] = A[a * n + b];
+
+    if (finished || result.iterations >= options.max_iterations)
+      break;
+    if (progress)
+      progress(result.iterations, cost, lambda);
+
+    // Damped steps until one lowers the cost. A rejected step only raises
+    // lambda; the normal equations at x are reused, not re-simulated.
+    double diag_floor = 0.0;
+    for (int a = 0; a < n; a++)
+      diag_floor = std::max(diag_floor, A[a * n + a]);
+    diag_floor = std::max(diag_floor * 1e-12, 1e-300);
+    bool accepted = false;
+    while (!accepted && lambda < 1e12) {
+      std::vector<double> damped = A;
+      for (int a = 0; a < n; a++)
+        damped[a * n + a] += lambda * std::max(A[a * n + a], diag_floor);
+      if (!cholesky(damped, n)) {
+        lambda *= 4.0;
+        continue;
+      }
+      std::vector<double> minus_g(n);
+      for (int a = 0; a < n; a++)
+        minus_g[a] = -g[a];
+      std::vector<double> step = choleskySolve(damped, n, minus_g);
+
+      std::vector<double> candidate(n);
+      double largest = 0.0;
+      for (int j = 0; j < n; j++) {
+        candidate[j] = bounded(j, x[j] + step[j] * unit[j]);
+        largest = std::max(largest, std::abs(candidate[j] - x[j]) / unit[j]);
+      }
+      double trial = evaluateCost(candidate);
+      if (trial < cost) {
+        accepted = true;
+        x = candidate;
+        lambda = std::max(lambda / 3.0, 1e-12);
+        if ((cost - trial) <= options.tolerance * cost || largest < 1e-12)
+          finished = true;
+      } else {
+        lambda *= 4.0;
+      }
+    }
+    if (!accepted) {
+      // No descent direction left: a (local) minimum. r, J and A are
+      // still those at x, so they are kept rather than evaluated again.
+      finished = true;
+      break;
+    }
+    result.iterations++;
+  }
+  result.converged = finished;
+
+  // Covariance from the Gauss-Newton Hessian at the solution
+  result.initial.resize(n);
+  EngineParams start_probe = start;
+  for (int j = 0; j < n; j++)
+    result.initial[j] = *findParameter(start_probe, options.parameters[j]);
+  result.fitted = x;
+  result.params = paramsAt(x);
+  result.standard_error.assign(n, NAN);
+  result.correlation.assign(n, std::vector<double>(n, NAN));
+
+  std::vector<double> l = A;
+  if (cholesky(l, n)) {
+    double sigma2 = 2.0 * result.final_cost / double(m - n);
+    std::vector<double> cov(size_t(n) * n);
+    for (int j = 0; j < n; j++) {
+      std::vector<double> e(n, 0.0);
+      e[j] = 1.0;
+      std::vector<double> col = choleskySolve(l, n, e);
+      for (int i = 0; i < n; i++)
+        cov[i * n + j] = sigma2 * col[i];
+    }
+    for (int i = 0; i < n; i++) {
+      result.standard_error[i] = std::sqrt(cov[i * n + i]) * unit[i];
+      for (int j = 0; j < n; j++)
+        result.correlation[i][j] =
+            cov[i * n + j] / std::sqrt(cov[i * n + i] * cov[j * n + j]);
+    }
+  }
+
+  // Fit quality in channel units
+  result.channels = options.channels;
+  result.channel_scale = scale;
+  std::vector<double> ss_res(nc, 0.0), ss_tot(nc, 0.0), mean(nc, 0.0);
+  std::vector<size_t> count(nc, 0);
+  for (const Prepared &p : prepared)
+    for (size_t k = 0; k < p.measured.size(); k++) {
+      mean[k % nc] += p.measured[k];
+      count[k % nc]++;
+    }
+  for (int c = 0; c < nc; c++)
+    mean[c] /= double(count[c]);
+
+  result.trace_rms.assign(traces.size(), std::vector<double>(nc, 0.0));
+  std::vector<size_t> rows(traces.size(), 0);
+  for (size_t s = 0; s < prepared.size(); s++) {
+    const Prepared &p = prepared[s];
+    std::vector<double> &sum_sq = result.trace_rms[p.trace];
+    for (size_t k = 0; k < p.measured.size(); k++) {
+      int c = int(k % nc);
+      double err = r[offset[s] + k] * scale[c];
+      double dev = p.measured[k] - mean[c];
+      sum_sq[c] += err * err;
+      ss_res[c] += err * err;
+      ss_tot[c] += dev * dev;
+    }
+    rows[p.trace] += p.measured.size() / nc;
+  }
+  for (size_t t = 0; t < traces.size(); t++)
+    for (double &v : result.trace_rms[t])
+      v = std::sqrt(v / double(rows[t]));
+  for (int c = 0; c < nc; c++)
+    result.r_squared.push_back(ss_tot[c] > 0.0 ? 1.0 - ss_res[c] / ss_tot[c]
+                                               : NAN);
+  return result;
+}
@@ -0,0 +1,541 @@
+#include "../include/component_bench.hpp"
+#include "../include/ecu.hpp"
+#include "../include/energy_store.hpp"
+#include "../include/mgu_h.hpp"
+#include "../include/mgu_k.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/turbocharger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+// --------------------------------------------------
+// COMPONENTS AND VARIANTS
+// --------------------------------------------------
+
+BenchComponent parseBenchComponent(const std::string &name) {
+  if (name == "turbo")
+    return BenchComponent::TURBO;
+  if (name == "mguh")
+    return BenchComponent::MGUH;
+  if (name == "ers")
+    return BenchComponent::ERS;
+  throw std::invalid_argument("unknown component '" + name +
+                              "' (turbo, mguh or ers)");
+}
+
+const char *benchComponentName(BenchComponent component) {
+  switch (component) {
+  case BenchComponent::TURBO:
+    return "turbo";
+  case BenchComponent::MGUH:
+    return "mguh";
+  case BenchComponent::ERS:
+  default:
+    return "ers";
+  }
+}
+
+struct VariantKey {
+  const char *name;
+  BenchComponent component;
+  double BenchVariant::*field;
+};
+
+static const VariantKey variantKeys[] = {
+    {"turbo_inertia", BenchComponent::TURBO, &BenchVariant::turbo_inertia},
+    {"turbine_efficiency", BenchComponent::TURBO,
+     &BenchVariant::turbine_efficiency},
+    {"compressor_efficiency", BenchComponent::TURBO,
+     &BenchVariant::compressor_efficiency},
+    {"bearing_loss", BenchComponent::TURBO, &BenchVariant::bearing_loss},
+    {"mguh_efficiency", BenchComponent::MGUH, &BenchVariant::mguh_efficiency},
+    {"mguh_max_power", BenchComponent::MGUH, &BenchVariant::mguh_max_power},
+    {"mguk_efficiency", BenchComponent::ERS, &BenchVariant::mguk_efficiency},
+    {"mguk_max_power", BenchComponent::ERS, &BenchVariant::mguk_max_power},
+    {"battery_energy", BenchComponent::ERS, &BenchVariant::battery_energy},
+    {"charge_power", BenchComponent::ERS, &BenchVariant::charge_power},
+    {"discharge_power", BenchComponent::ERS, &BenchVariant::discharge_power},
+    {"initial_soc", BenchComponent::ERS, &BenchVariant::initial_soc},
+};
+
+const std::vector<std::string> &benchVariantKeys(BenchComponent component) {
+  static const std::vector<std::vector<std::string>> keys = [] {
+    std::vector<std::vector<std::string>> k(3);
+    for (const VariantKey &key : variantKeys)
+      k[int(key.component)].push_back(key.name);
+    k[int(BenchComponent::TURBO)].push_back("turbo_map");
+    return k;
+  }();
+  return keys[int(component)];
+}
+
+static void setField(BenchVariant &v, BenchComponent component,
+                     const std::string &field, int line) {
+  std::string where = "line " + std::to_string(line) + ": ";
+  size_t eq = field.find('=');
+  if (eq == std::string::npos)
+    throw std::invalid_argument(where + "expected key=value, got '" + field +
+                                "'");
+  std::string key = field.substr(0, eq);
+  std::string value = field.substr(eq + 1);
+  if (key == "turbo_map" && component == BenchComponent::TURBO) {
+    v.turbo_map = value;
+    return;
+  }
+  for (const VariantKey &k : variantKeys) {
+    if (key != k.name || k.component != component)
+      continue;
+    char *end = nullptr;
+    double number = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !std::isfinite(number))
+      throw std::invalid_argument(where + "bad value for " + key + ": '" +
+                                  value + "'");
+    v.*k.field = number;
+    return;
+  }
+  throw std::invalid_argument(where + "no key '" + key + "' on the " +
+                              benchComponentName(component) + " bench");
+}
+
+// A key=value field and the line it came from
+struct VariantField {
+  std::string text;
+  int line;
+};
+
+std::vector<BenchVariant> parseBenchVariants(const std::string &text,
+                                             BenchComponent component) {
+  std::vector<VariantField> base;
+  std::vector<std::vector<VariantField>> axes;
+  std::vector<std::pair<std::string, std::vector<VariantField>>> named;
+
+  std::istringstream lines(text);
+  std::string line;
+  int number = 0;
+  while (std::getline(lines, line)) {
+    number++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.resize(hash);
+    std::istringstream words(line);
+    std::string directive, word;
+    if (!(words >> directive))
+      continue;
+
+    BenchVariant check; // every field is validated where it is written
+    if (directive == "base") {
+      while (words >> word) {
+        setField(check, component, word, number);
+        base.push_back({word, number});
+      }
+    } else if (directive == "vary") {
+      std::string key;
+      std::vector<VariantField> axis;
+      words >> key;
+      while (words >> word) {
+        setField(check, component, key + "=" + word, number);
+        axis.push_back({key + "=" + word, number});
+      }
+      if (key.empty() || axis.empty())
+        throw std::invalid_argument("line " + std::to_string(number) +
+                                    ": vary needs a key and values");
+      axes.push_back(axis);
+    } else if (directive == "variant") {
+      std::string name;
+      std::vector<VariantField> fields;
+      if (!(words >> name) || name.find('=') != std::string::npos)
+        throw std::invalid_argument("line " + std::to_string(number) +
+                                    ": variant needs a name");
+      while (words >> word) {
+        setField(check, component, word, number);
+        fields.push_back({word, number});
+      }
+      named.push_back({name, fields});
+    } else {
+      throw std::invalid_argument("line " + std::to_string(number) +
+                                  ": unknown directive '" + directive + "'");
+    }
+  }
+
+  BenchVariant start;
+  for (const VariantField &f : base)
+    setField(start, component, f.text, f.line);
+
+  // Full grid, last key fastest, as in parseSweep
+  std::vector<BenchVariant> variants;
+  if (!axes.empty()) {
+    std::vector<size_t> at(axes.size(), 0);
+    for (;;) {
+      BenchVariant v = start;
+      v.name.clear();
+      for (size_t k = 0; k < axes.size(); k++) {
+        const VariantField &f = axes[k][at[k]];
+        setField(v, component, f.text, f.line);
+        v.name += (k ? "," : "") + f.text;
+      }
+      variants.push_back(v);
+
+      size_t k = axes.size();
+      while (k > 0 && ++at[k - 1] == axes[k - 1].size())
+        at[--k] = 0;
+      if (k == 0)
+        break;
+    }
+  }
+  for (const auto &[name, fields] : named) {
+    BenchVariant v = start;
+    v.name = name;
+    for (const VariantField &f : fields)
+      setField(v, component, f.text, f.line);
+    variants.push_back(v);
+  }
+  if (variants.empty())
+    variants.push_back(start);
+  return variants;
+}
+
+std::vector<BenchVariant> loadBenchVariants(const std::string &path,
+                                            BenchComponent component) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("cannot open " + path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return parseBenchVariants(text.str(), component);
+}
+
+// --------------------------------------------------
+// BOUNDARY TRACES
+// --------------------------------------------------
+
+const std::vector<std::string> &benchInputs(BenchComponent component) {
+  static const std::vector<std::string> inputs[3] = {
+      {"exhaust_mass_flow", "exhaust_manifold_pressure", "exhaust_temp",
+       "mguh_torque", "throttle", "omega", "battery_soc"},
+      {"turbo_speed", "throttle", "omega", "boost_pressure", "battery_soc"},
+      {"omega", "throttle", "boost_pressure", "turbo_speed"},
+  };
+  return inputs[int(component)];
+}
+
+const std::vector<std::string> &benchOutputs(BenchComponent component) {
+  static const std::vector<std::string> outputs[3] = {
+      {"turbo_speed", "boost_pressure", "compressor_outlet_temp",
+       "turbo_air_flow"},
+      {"mguh_torque", "mguh_power"},
+      {"mguk_torque", "mguk_power", "battery_energy", "battery_soc"},
+  };
+  return outputs[int(component)];
+}
+
+// Recorded channels on the bench grid t0 + j * dt, j = 0..steps
+struct Boundary {
+  double dt;
+  int64_t steps;
+  std::vector<std::vector<double>> inputs;   // benchInputs order
+  std::vector<std::vector<double>> recorded; // benchOutputs order; empty
+                                             // when the trace lacks one
+};
+
+// Linear interpolation, held beyond the ends
+static std::vector<double> resample(const std::vector<double> &time,
+                                    const std::vector<double> &values,
+                                    double t0, double dt, int64_t steps) {
+  std::vector<double> out(steps + 1);
+  size_t i = 0;
+  for (int64_t j = 0; j <= steps; j++) {
+    double t = t0 + j * dt;
+    while (i + 1 < time.size() && time[i + 1] <= t)
+      i++;
+    if (i + 1 >= time.size() || t <= time[i]) {
+      out[j] = values[i];
+    } else {
+      double w = (t - time[i]) / (time[i + 1] - time[i]);
+      out[j] = values[i] + (values[i + 1] - values[i]) * w;
+    }
+  }
+  return out;
+}
+
+// --------------------------------------------------
+// BENCHES
+// --------------------------------------------------
+//
+// One unit per variant: the component, and the ECU replayed on the
+// boundary. step(j) takes bench step j from row j - 1 to row j; step(0)
+// only runs the ECU, standing in for the engine step that produced the
+// first row so the ECU's schedule lines up with the trace.
+
+struct TurboUnit {
+  enum { FLOW, EXHAUST_PRESSURE, EXHAUST_TEMP, MGUH_TORQUE, THROTTLE, OMEGA,
+         SOC };
+  Turbocharger turbo;
+  Ecu ecu;
+
+  TurboUnit(const BenchVariant &v, const Boundary &b,
+            std::shared_ptr<const TurboMaps> maps)
+      : turbo(v.turbo_inertia, v.turbine_efficiency, v.compressor_efficiency,
+              v.bearing_loss) {
+    if (maps)
+      turbo.setMaps(maps);
+    if (!b.recorded[0].empty())
+      turbo.setShaftAngularSpeed(b.recorded[0][0]);
+    if (!b.recorded[3].empty())
+      turbo.setAvailableAirMassFlow(b.recorded[3][0]);
+  }
+
+  void step(const Boundary &b, int64_t j) {
+    const std::vector<std::vector<double>> &in = b.inputs;
+    int64_t k = j > 0 ? j - 1 : 0;
+    const EcuCommands &cmd =
+        ecu.step({in[THROTTLE][j], in[OMEGA][k],
+                  turbo.getCompressorOutletPressure(),
+                  turbo.getShaftAngularSpeed(), in[SOC][k]},
+                 b.dt);
+    if (j > 0)
+      turbo.update(b.dt, in[FLOW][k], in[EXHAUST_PRESSURE][j],
+                   in[EXHAUST_TEMP][j], cmd.target_boost,
+                   in[MGUH_TORQUE][j]);
+  }
+
+  void sample(double *out) const {
+    out[0] = turbo.getShaftAngularSpeed();
+    out[1] = turbo.getCompressorOutletPressure();
+    out[2] = turbo.getCompressorOutletTemperature();
+    out[3] = turbo.getAvailableAirMassFlow();
+  }
+};
+
+struct MguhUnit {
+  enum { TURBO_SPEED, THROTTLE, OMEGA, BOOST, SOC };
+  MGUH mguh;
+  Ecu ecu;
+
+  MguhUnit(const BenchVariant &v, const Boundary &,
+           std::shared_ptr<const TurboMaps>)
+      : mguh(constants::mguh_inertia, v.mguh_efficiency, v.mguh_max_power) {}
+
+  void step(const Boundary &b, int64_t j) {
+    const std::vector<std::vector<double>> &in = b.inputs;
+    int64_t k = j > 0 ? j - 1 : 0;
+    const EcuCommands &cmd =
+        ecu.step({in[THROTTLE][j], in[OMEGA][k], in[BOOST][k],
+                  in[TURBO_SPEED][k], in[SOC][k]},
+                 b.dt);
+    if (j > 0) {
+      mguh.setMode(cmd.mguh_mode);
+      mguh.setRequestedPower(cmd.mguh_power);
+      mguh.update(b.dt, in[TURBO_SPEED][k]);
+    }
+  }
+
+  void sample(double *out) const {
+    out[0] = mguh.getTorque();
+    out[1] = mguh.getElectricalPower();
+  }
+};
+
+struct ErsUnit {
+  enum { OMEGA, THROTTLE, BOOST, TURBO_SPEED };
+  MGUK mguk;
+  EnergyStore battery;
+  Ecu ecu;
+
+  ErsUnit(const BenchVariant &v, const Boundary &b,
+          std::shared_ptr<const TurboMaps>)
+      : mguk(v.mguk_efficiency, v.mguk_max_power),
+        battery(v.battery_energy, v.charge_power, v.discharge_power) {
+    if (v.initial_soc >= 0.0)
+      battery.setSOC(v.initial_soc);
+    else if (!b.recorded[3].empty())
+      battery.setSOC(b.recorded[3][0]);
+  }
+
+  void step(const Boundary &b, int64_t j) {
+    const std::vector<std::vector<double>> &in = b.inputs;
+    int64_t k = j > 0 ? j - 1 : 0;
+    const EcuCommands &cmd =
+        ecu.step({in[THROTTLE][j], in[OMEGA][k], in[BOOST][k],
+                  in[TURBO_SPEED][k], battery.getSOC()},
+                 b.dt);
+    if (j > 0) {
+      mguk.setMode(cmd.mguk_mode);
+      mguk.setRequestedPower(cmd.mguk_power);
+      mguk.update(b.dt, in[OMEGA][k], battery);
+    }
+  }
+
+  void sample(double *out) const {
+    out[0] = mguk.getTorque();
+    out[1] = mguk.getElectricalPower();
+    out[2] = battery.getEnergy();
+    out[3] = battery.getSOC();
+  }
+};
+
+// Variants per block: enough to amortize reading the boundary, few
+// enough that the block's units stay in cache
+constexpr int kBenchBlock = 16;
+
+template <typename Unit>
+static void runBlock(const Boundary &b, const std::vector<BenchVariant> &all,
+                     int first, int count,
+                     const std::vector<std::shared_ptr<const TurboMaps>> &maps,
+                     const BenchOptions &options, double t0,
+                     const std::vector<std::string> &outputs,
+                     std::vector<BenchVariantResult> &results) {
+  size_t n_out = outputs.size();
+  std::vector<Unit> units;
+  units.reserve(count);
+  for (int v = 0; v < count; v++)
+    units.emplace_back(all[first + v], b, maps[first + v]);
+
+  std::vector<std::unique_ptr<CompressedTelemetryWriter>> writers(count);
+  if (!options.out_dir.empty())
+    for (int v = 0; v < count; v++)
+      writers[v] = std::make_unique<CompressedTelemetryWriter>(
+          results[first + v].trace_path, outputs, b.dt,
+          TelemetryCoding::EXACT);
+  int64_t step0 = std::llround(t0 / b.dt);
+
+  // Squared and largest differences from the recorded outputs
+  std::vector<double> sum(count * n_out, 0.0), worst(count * n_out, 0.0);
+  double row[8];
+  for (int64_t j = 0; j <= b.steps; j++) {
+    for (int v = 0; v < count; v++) {
+      Unit &unit = units[v];
+      unit.step(b, j);
+      if (j == 0)
+        continue;
+      unit.sample(row);
+      for (size_t o = 0; o < n_out; o++) {
+        if (b.recorded[o].empty())
+          continue;
+        double d = std::abs(row[o] - b.recorded[o][j]);
+        sum[v * n_out + o] += d * d;
+        worst[v * n_out + o] = std::max(worst[v * n_out + o], d);
+      }
+      if (writers[v] && j % options.log_interval == 0)
+        writers[v]->write(step0 + j, row);
+    }
+  }
+
+  for (int v = 0; v < count; v++) {
+    if (writers[v])
+      writers[v]->close();
+    BenchVariantResult &r = results[first + v];
+    units[v].sample(row);
+    for (size_t o = 0; o < n_out; o++) {
+      bool have = !b.recorded[o].empty();
+      double nan = std::numeric_limits<double>::quiet_NaN();
+      r.final_value.push_back(row[o]);
+      r.rms.push_back(have ? std::sqrt(sum[v * n_out + o] / b.steps) : nan);
+      r.max_abs.push_back(have ? worst[v * n_out + o] : nan);
+    }
+  }
+}
+
+BenchResult runComponentBench(BenchComponent component,
+                              const TelemetryTrace &trace,
+                              const std::vector<BenchVariant> &variants,
+                              const BenchOptions &options) {
+  if (trace.time.size() < 2)
+    throw std::invalid_argument("boundary trace needs at least two rows");
+  auto channel = [&](const std::string &name) {
+    for (size_t c = 0; c < trace.channels.size(); c++)
+      if (trace.channels[c] == name)
+        return int(c);
+    return -1;
+  };
+
+  Boundary b;
+  b.dt = options.dt > 0 ? options.dt : trace.dt;
+  if (!(b.dt > 0))
+    throw std::invalid_argument("bench step must be positive");
+  double t0 = trace.time.front();
+  b.steps = int64_t((trace.time.back() - t0) / b.dt + 1e-9);
+  if (b.steps < 1)
+    throw std::invalid_argument("boundary trace is shorter than one step");
+  for (const std::string &name : benchInputs(component)) {
+    int c = channel(name);
+    if (c < 0)
+      throw std::invalid_argument("boundary trace has no '" + name +
+                                  "' channel");
+    b.inputs.push_back(
+        resample(trace.time, trace.values[c], t0, b.dt, b.steps));
+  }
+  BenchResult result;
+  result.outputs = benchOutputs(component);
+  for (const std::string &name : result.outputs) {
+    int c = channel(name);
+    b.recorded.push_back(c < 0 ? std::vector<double>()
+                               : resample(trace.time, trace.values[c], t0,
+                                          b.dt, b.steps));
+  }
+
+  // Each map file is loaded once and shared by the variants naming it
+  std::map<std::string, std::shared_ptr<const TurboMaps>> loaded;
+  std::vector<std::shared_ptr<const TurboMaps>> maps;
+  for (const BenchVariant &v : variants) {
+    if (!v.turbo_map.empty() && !loaded.count(v.turbo_map))
+      loaded[v.turbo_map] =
+          std::make_shared<TurboMaps>(TurboMaps::load(v.turbo_map));
+    maps.push_back(v.turbo_map.empty() ? nullptr : loaded[v.turbo_map]);
+  }
+
+  result.variants.resize(variants.size());
+  if (!options.out_dir.empty())
+    std::filesystem::create_directories(options.out_dir);
+  for (size_t v = 0; v < variants.size(); v++) {
+    result.variants[v].variant = variants[v].name;
+    if (!options.out_dir.empty()) {
+      char file[64];
+      std::snprintf(file, sizeof file, "/%s_%03zu.f1pz",
+                    benchComponentName(component), v);
+      result.variants[v].trace_path = options.out_dir + file;
+    }
+  }
+
+  BenchOptions o = options;
+  o.log_interval = std::max(1, o.log_interval);
+  int blocks = int((variants.size() + kBenchBlock - 1) / kBenchBlock);
+  ThreadPool pool(std::min(options.threads > 0
+                               ? options.threads
+                               : int(std::thread::hardware_concurrency()),
+                           std::max(blocks, 1)));
+  auto start = std::chrono::steady_clock::now();
+  pool.parallelFor(blocks, [&](int block) {
+    int first = block * kBenchBlock;
+    int count = std::min(kBenchBlock, int(variants.size()) - first);
+    switch (component) {
+    case BenchComponent::TURBO:
+      runBlock<TurboUnit>(b, variants, first, count, maps, o, t0,
+                          result.outputs, result.variants);
+      break;
+    case BenchComponent::MGUH:
+      runBlock<MguhUnit>(b, variants, first, count, maps, o, t0,
+                         result.outputs, result.variants);
+      break;
+    case BenchComponent::ERS:
+      runBlock<ErsUnit>(b, variants, first, count, maps, o, t0,
+                        result.outputs, result.variants);
+      break;
+    }
+  });
+  std::chrono::duration<double> took =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = took.count();
+  result.steps = b.steps;
+  return result;
+}
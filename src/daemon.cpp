@@ -0,0 +1,467 @@
+#include "../include/daemon.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// Finished jobs kept for status/wait queries
+static constexpr size_t kJobHistory = 4096;
+// In-memory results; the disk cache keeps everything
+static constexpr size_t kMemoryCacheEntries = 65536;
+
+// --------------------------------------------------
+// LIFECYCLE
+// --------------------------------------------------
+
+SimulationDaemon::SimulationDaemon(const DaemonOptions &opts)
+    : options(opts) {
+  if (options.workers <= 0)
+    options.workers = std::max(1u, std::thread::hardware_concurrency());
+  if (!options.cache_dir.empty())
+    fs::create_directories(options.cache_dir);
+
+  for (int w = 0; w < options.workers; w++)
+    workers.emplace_back([this] { workerLoop(); });
+}
+
+SimulationDaemon::~SimulationDaemon() {
+  stop();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : jobs)
+      entry.second->cancel = true;
+  }
+  work_ready.notify_all();
+  job_finished.notify_all();
+  for (std::thread &t : workers)
+    t.join();
+  reapConnections(true);
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    unlink(options.socket_path.c_str());
+  }
+}
+
+void SimulationDaemon::stop() { stopping = true; }
+
+// --------------------------------------------------
+// SOCKET
+// --------------------------------------------------
+
+void SimulationDaemon::serve() {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (options.socket_path.size() >= sizeof addr.sun_path)
+    throw std::runtime_error("socket path too long: " + options.socket_path);
+  std::strcpy(addr.sun_path, options.socket_path.c_str());
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+
+  // Replace a stale socket file, but never a live daemon's
+  struct stat st;
+  if (stat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = connect(probe, (sockaddr *)&addr, sizeof addr) == 0;
+    close(probe);
+    if (live)
+      throw std::runtime_error("a daemon is already listening on " +
+                               options.socket_path);
+    unlink(addr.sun_path);
+  }
+
+  if (bind(listen_fd, (sockaddr *)&addr, sizeof addr) < 0 ||
+      listen(listen_fd, 64) < 0)
+    throw std::runtime_error(options.socket_path + ": " +
+                             std::strerror(errno));
+
+  while (!stopping) {
+    reapConnections(false);
+
+    // Poll with a timeout so stop() from a signal handler is noticed
+    pollfd pfd{listen_fd, POLLIN, 0};
+    if (poll(&pfd, 1, 200) <= 0)
+      continue;
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (int(connections.size()) >= options.max_clients) {
+      const char reply[] = "error too many clients\n";
+      send(fd, reply, sizeof reply - 1, MSG_NOSIGNAL);
+      close(fd);
+      continue;
+    }
+    connections.push_back(Connection{fd});
+    Connection &c = connections.back();
+    c.thread = std::thread([this, &c] { serveClient(c); });
+  }
+
+  // Wake blocked waits and disconnect clients
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Connection &c : connections)
+      if (!c.done)
+        shutdown(c.fd, SHUT_RDWR);
+  }
+  job_finished.notify_all();
+  reapConnections(true);
+}
+
+void SimulationDaemon::serveClient(Connection &connection) {
+  std::string buffer;
+  char chunk[4096];
+
+  for (;;) {
+    ssize_t n = recv(connection.fd, chunk, sizeof chunk, 0);
+    if (n <= 0)
+      break;
+    buffer.append(chunk, size_t(n));
+
+    size_t newline;
+    while ((newline = buffer.find('\n')) != std::string::npos) {
+      std::string reply = handle(buffer.substr(0, newline)) + "\n";
+      buffer.erase(0, newline + 1);
+      if (send(connection.fd, reply.data(), reply.size(), MSG_NOSIGNAL) < 0)
+        break;
+    }
+  }
+
+  close(connection.fd);
+  std::lock_guard<std::mutex> lock(mutex);
+  connection.done = true;
+}
+
+void SimulationDaemon::reapConnections(bool all) {
+  std::list<Connection> finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = connections.begin(); it != connections.end();) {
+      auto next = std::next(it);
+      if (all || it->done)
+        finished.splice(finished.end(), connections, it);
+      it = next;
+    }
+  }
+  for (Connection &c : finished)
+    c.thread.join();
+}
+
+// --------------------------------------------------
+// REQUESTS
+// --------------------------------------------------
+
+std::string SimulationDaemon::handle(const std::string &request) {
+  std::istringstream words(request);
+  std::string verb;
+  words >> verb;
+  std::string rest;
+  std::getline(words, rest);
+
+  try {
+    if (verb == "submit" || verb == "run")
+      return submit(rest, verb == "run");
+
+    if (verb == "status" && rest.find_first_not_of(' ') == std::string::npos) {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::ostringstream out;
+      out << "ok workers=" << options.workers << " busy=" << busy
+          << " queued=" << queue.size() << " max_queued=" << options.max_queued
+          << " clients=" << connections.size() << " completed=" << completed
+          << " cache_hits=" << cache_hits << " cache_misses=" << cache_misses
+          << " model=" << kModelVersion;
+      return out.str();
+    }
+
+    if (verb == "status" || verb == "wait") {
+      std::shared_ptr<Job> job = findJob(rest);
+      std::unique_lock<std::mutex> lock(mutex);
+      if (verb == "wait")
+        job_finished.wait(
+            lock, [&] { return isFinished(*job) || stopping; });
+      return describe(*job);
+    }
+
+    if (verb == "cancel") {
+      std::shared_ptr<Job> job = findJob(rest);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (job->state == JobState::QUEUED) {
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+          if (*it == job) {
+            queue.erase(it);
+            break;
+          }
+        finish(job, JobState::CANCELLED);
+      } else if (job->state == JobState::RUNNING) {
+        job->cancel = true; // the worker reports it cancelled
+      } else {
+        return "error job " + std::to_string(job->id) + " already finished";
+      }
+      return "ok " + std::to_string(job->id);
+    }
+
+    if (verb == "shutdown") {
+      stop();
+      return "ok";
+    }
+    return "error unknown request '" + verb + "'";
+  } catch (const std::exception &e) {
+    return std::string("error ") + e.what();
+  }
+}
+
+std::string SimulationDaemon::submit(const std::string &text, bool wait) {
+  SimulationJob spec = parseJob(text);
+  std::string key = jobKey(spec);
+
+  // Disk lookups happen outside the lock
+  std::vector<double> values;
+  bool hit;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = memory_cache.find(key);
+    hit = cached != memory_cache.end();
+    if (hit)
+      values = cached->second;
+  }
+  if (!hit && loadCached(key, values)) {
+    hit = true;
+    std::lock_guard<std::mutex> lock(mutex);
+    memory_cache[key] = values;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if (stopping)
+    return "error shutting down";
+
+  std::shared_ptr<Job> job;
+  auto running = in_flight.find(key);
+  if (!hit && running != in_flight.end()) {
+    job = running->second; // identical job already queued or running
+  } else {
+    if (!hit && int(queue.size()) >= options.max_queued)
+      return "error queue full (" + std::to_string(options.max_queued) +
+             " jobs)";
+
+    job = std::make_shared<Job>();
+    job->id = next_id++;
+    job->spec = std::move(spec);
+    job->key = key;
+    jobs[job->id] = job;
+
+    if (hit) {
+      cache_hits++;
+      job->cached = true;
+      job->values = std::move(values);
+      finish(job, JobState::DONE);
+    } else {
+      cache_misses++;
+      queue.push_back(job);
+      in_flight[key] = job;
+      work_ready.notify_one();
+    }
+  }
+
+  if (!wait)
+    return "ok " + std::to_string(job->id);
+  job_finished.wait(lock,
+                    [&] { return isFinished(*job) || stopping; });
+  return describe(*job);
+}
+
+bool SimulationDaemon::isFinished(const Job &job) {
+  return job.state != JobState::QUEUED && job.state != JobState::RUNNING;
+}
+
+std::string SimulationDaemon::describe(const Job &job) const {
+  std::string id = std::to_string(job.id);
+  switch (job.state) {
+  case JobState::QUEUED:
+    return "queued " + id;
+  case JobState::RUNNING:
+    return "running " + id;
+  case JobState::CANCELLED:
+    return "cancelled " + id;
+  case JobState::FAILED:
+    return "failed " + id + " " + job.error;
+  case JobState::DONE:
+    break;
+  }
+
+  std::string out = "done " + id + " cached=" + (job.cached ? "1" : "0");
+  std::vector<std::string> names = jobOutputs(job.spec);
+  char buf[32];
+  for (size_t k = 0; k < names.size() && k < job.values.size(); k++) {
+    std::snprintf(buf, sizeof buf, "%.17g", job.values[k]);
+    out += " " + names[k] + "=" + buf;
+  }
+  return out;
+}
+
+std::shared_ptr<SimulationDaemon::Job>
+SimulationDaemon::findJob(const std::string &id_text) {
+  long id = 0;
+  std::istringstream in(id_text);
+  if (!(in >> id))
+    throw std::invalid_argument("expected a job id");
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = jobs.find(id);
+  if (it == jobs.end())
+    throw std::invalid_argument("no such job " + std::to_string(id));
+  return it->second;
+}
+
+// Caller holds the mutex
+void SimulationDaemon::finish(const std::shared_ptr<Job> &job,
+                              JobState state) {
+  job->state = state;
+  auto running = in_flight.find(job->key);
+  if (running != in_flight.end() && running->second == job)
+    in_flight.erase(running);
+
+  completed++;
+  finished_order.push_back(job->id);
+  forget();
+  job_finished.notify_all();
+}
+
+void SimulationDaemon::forget() {
+  while (finished_order.size() > kJobHistory) {
+    jobs.erase(finished_order.front());
+    finished_order.pop_front();
+  }
+}
+
+// --------------------------------------------------
+// RESULT CACHE
+// --------------------------------------------------
+
+// One file per key: the canonical job as a comment line, then one value
+// per line. Written to a temporary name and renamed into place, so
+// readers (including other daemons sharing the directory) never see a
+// partial file.
+
+bool SimulationDaemon::loadCached(const std::string &key,
+                                  std::vector<double> &values) {
+  if (options.cache_dir.empty())
+    return false;
+  std::ifstream in(options.cache_dir + "/" + key);
+  if (!in)
+    return false;
+
+  std::string line;
+  std::getline(in, line); // canonical job
+  values.clear();
+  while (std::getline(in, line))
+    values.push_back(std::strtod(line.c_str(), nullptr));
+  return !values.empty();
+}
+
+void SimulationDaemon::storeCached(const Job &job,
+                                   const std::vector<double> &values) {
+  const std::string &key = job.key;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (memory_cache.size() >= kMemoryCacheEntries)
+      memory_cache.clear();
+    memory_cache[key] = values;
+  }
+  if (options.cache_dir.empty())
+    return;
+
+  std::string path = options.cache_dir + "/" + key;
+  std::string tmp = path + ".tmp" + std::to_string(getpid()) + "-" +
+                    std::to_string(std::hash<std::thread::id>()(
+                        std::this_thread::get_id()));
+  FILE *f = std::fopen(tmp.c_str(), "w");
+  if (!f)
+    return; // the cache is an optimisation; a full disk is not an error
+  std::fprintf(f, "# %s", canonicalJob(job.spec).c_str());
+  for (double v : values)
+    std::fprintf(f, "\n%.17g", v);
+  std::fprintf(f, "\n");
+  bool ok = std::fclose(f) == 0;
+  if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+    std::remove(tmp.c_str());
+}
+
+// Loaded maps are shared by all jobs naming the same unchanged file
+std::shared_ptr<const TurboMaps>
+SimulationDaemon::turboMaps(const std::string &path) {
+  if (path.empty())
+    return nullptr;
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    throw std::runtime_error("cannot open turbo map " + path);
+  std::string version = path + "@" + std::to_string(st.st_mtim.tv_sec) + "." +
+                        std::to_string(st.st_mtim.tv_nsec);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = map_cache.find(version);
+    if (it != map_cache.end())
+      return it->second;
+  }
+  auto maps = std::make_shared<const TurboMaps>(TurboMaps::load(path));
+  std::lock_guard<std::mutex> lock(mutex);
+  map_cache[version] = maps;
+  return maps;
+}
+
+// --------------------------------------------------
+// WORKERS
+// --------------------------------------------------
+
+void SimulationDaemon::workerLoop() {
+  // Warm-up: fault in the model code and data before the first real job
+  {
+    SimulationJob warm;
+    warm.scenario.iterations = 200;
+    runJob(warm);
+  }
+
+  for (;;) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      work_ready.wait(lock, [&] { return stopping || !queue.empty(); });
+      if (stopping)
+        return;
+      job = queue.front();
+      queue.pop_front();
+      job->state = JobState::RUNNING;
+      busy++;
+    }
+
+    JobState outcome = JobState::DONE;
+    std::vector<double> values;
+    std::string error;
+    try {
+      values = runJob(job->spec, turboMaps(job->spec.turbo_map), &job->cancel);
+      storeCached(*job, values);
+    } catch (const JobCancelled &) {
+      outcome = JobState::CANCELLED;
+    } catch (const std::exception &e) {
+      outcome = JobState::FAILED;
+      error = e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    busy--;
+    job->values = std::move(values);
+    job->error = std::move(error);
+    finish(job, outcome);
+  }
+}
@@ -0,0 +1,293 @@
+#include "../include/ecu.hpp"
+#include "../include/dual.hpp"
+#include <algorithm>
+#include <cmath>
+
+// --------------------------------------------------
+// BOOST STRATEGIES
+// --------------------------------------------------
+
+template <typename T>
+void BangBangBoost<T>::update(const BasicEcuInputs<T> &in, double /*period*/,
+                              BasicEcuCommands<T> &cmd) {
+  T boost_error = cmd.target_boost - in.boost_pressure;
+
+  // Below half throttle the last command is held
+  if (cmd.throttle > kActiveThrottle) {
+    if (boost_error > 0) {
+      cmd.mguh_mode = MGUHMode::MOTOR;
+      // Use more aggressive power to overcome compressor drag at high RPM
+      cmd.mguh_power = constants::mguk_max_power * in.driver_throttle;
+    } else {
+      cmd.mguh_mode = MGUHMode::GENERATOR;
+      cmd.mguh_power = ad::min(120000.0, -boost_error * 0.2);
+    }
+  }
+}
+
+template <typename T>
+std::unique_ptr<BasicBoostStrategy<T>> BangBangBoost<T>::clone() const {
+  return std::make_unique<BangBangBoost<T>>(*this);
+}
+
+template <typename T> PidBoost<T>::PidBoost() : PidBoost(Gains{}) {}
+
+template <typename T>
+PidBoost<T>::PidBoost(const Gains &gains)
+    : gains(gains), integral(0.0), prev_error(0.0), primed(false) {}
+
+template <typename T>
+void PidBoost<T>::update(const BasicEcuInputs<T> &in, double period,
+                         BasicEcuCommands<T> &cmd) {
+  if (cmd.throttle <= gains.active_throttle) {
+    cmd.mguh_mode = MGUHMode::IDLE;
+    cmd.mguh_power = 0.0;
+    integral = 0.0;
+    primed = false;
+    return;
+  }
+
+  T error = cmd.target_boost - in.boost_pressure;
+
+  integral = ad::clamp(integral + gains.ki * error * period, -gains.max_power,
+                       gains.max_power);
+  T derivative = primed ? (error - prev_error) / period : T(0.0);
+  prev_error = error;
+  primed = true;
+
+  T output = ad::clamp(gains.kp * error + integral + gains.kd * derivative,
+                       -gains.max_power, gains.max_power);
+
+  if (output >= 0.0) {
+    cmd.mguh_mode = MGUHMode::MOTOR;
+    cmd.mguh_power = output;
+  } else {
+    cmd.mguh_mode = MGUHMode::GENERATOR;
+    cmd.mguh_power = -output;
+  }
+}
+
+template <typename T>
+std::unique_ptr<BasicBoostStrategy<T>> PidBoost<T>::clone() const {
+  return std::make_unique<PidBoost<T>>(*this);
+}
+
+template <typename T> ManualBoost<T>::ManualBoost(T power) : power(power) {}
+
+template <typename T> void ManualBoost<T>::setPower(T p) { power = p; }
+
+template <typename T>
+void ManualBoost<T>::update(const BasicEcuInputs<T> & /*in*/,
+                            double /*period*/, BasicEcuCommands<T> &cmd) {
+  if (power >= 0.0) {
+    cmd.mguh_mode = MGUHMode::MOTOR;
+    cmd.mguh_power = power;
+  } else {
+    cmd.mguh_mode = MGUHMode::GENERATOR;
+    cmd.mguh_power = -power;
+  }
+}
+
+template <typename T>
+std::unique_ptr<BasicBoostStrategy<T>> ManualBoost<T>::clone() const {
+  return std::make_unique<ManualBoost<T>>(*this);
+}
+
+// --------------------------------------------------
+// DEPLOYMENT STRATEGIES
+// --------------------------------------------------
+
+template <typename T>
+void ThrottleDeployment<T>::update(const BasicEcuInputs<T> & /*in*/,
+                                   double /*period*/,
+                                   BasicEcuCommands<T> &cmd) {
+  if (cmd.throttle > kDeployThrottle) {
+    cmd.mguk_mode = MGUKMode::MOTOR;
+    cmd.mguk_power = constants::mguk_max_power * cmd.throttle;
+  } else {
+    cmd.mguk_mode = MGUKMode::IDLE;
+  }
+}
+
+template <typename T>
+std::unique_ptr<BasicDeploymentStrategy<T>>
+ThrottleDeployment<T>::clone() const {
+  return std::make_unique<ThrottleDeployment<T>>(*this);
+}
+
+template <typename T>
+SocAwareDeployment<T>::SocAwareDeployment() : SocAwareDeployment(Limits{}) {}
+
+template <typename T>
+SocAwareDeployment<T>::SocAwareDeployment(const Limits &limits)
+    : limits(limits) {}
+
+template <typename T>
+void SocAwareDeployment<T>::update(const BasicEcuInputs<T> &in,
+                                   double /*period*/,
+                                   BasicEcuCommands<T> &cmd) {
+  if (cmd.throttle > limits.deploy_throttle) {
+    T taper = ad::clamp((in.battery_soc - limits.soc_floor) / limits.soc_taper,
+                        0.0, 1.0);
+    cmd.mguk_mode = MGUKMode::MOTOR;
+    cmd.mguk_power = constants::mguk_max_power * cmd.throttle * taper;
+  } else if (in.battery_soc < limits.soc_target) {
+    cmd.mguk_mode = MGUKMode::GENERATOR;
+    cmd.mguk_power = limits.harvest_power;
+  } else {
+    cmd.mguk_mode = MGUKMode::IDLE;
+    cmd.mguk_power = 0.0;
+  }
+}
+
+template <typename T>
+std::unique_ptr<BasicDeploymentStrategy<T>>
+SocAwareDeployment<T>::clone() const {
+  return std::make_unique<SocAwareDeployment<T>>(*this);
+}
+
+template <typename T>
+ManualDeployment<T>::ManualDeployment(T power) : power(power) {}
+
+template <typename T> void ManualDeployment<T>::setPower(T p) { power = p; }
+
+template <typename T>
+void ManualDeployment<T>::update(const BasicEcuInputs<T> & /*in*/,
+                                 double /*period*/,
+                                 BasicEcuCommands<T> &cmd) {
+  if (power >= 0.0) {
+    cmd.mguk_mode = MGUKMode::MOTOR;
+    cmd.mguk_power = power;
+  } else {
+    cmd.mguk_mode = MGUKMode::GENERATOR;
+    cmd.mguk_power = -power;
+  }
+}
+
+template <typename T>
+std::unique_ptr<BasicDeploymentStrategy<T>>
+ManualDeployment<T>::clone() const {
+  return std::make_unique<ManualDeployment<T>>(*this);
+}
+
+// --------------------------------------------------
+// ECU
+// --------------------------------------------------
+
+template <typename T>
+BasicEcu<T>::BasicEcu()
+    : control_period(kDefaultPeriod), steps_until_update(0), update_count(0) {}
+
+template <typename T>
+BasicEcu<T>::BasicEcu(const BasicEcu &other)
+    : control_period(other.control_period),
+      steps_until_update(other.steps_until_update),
+      update_count(other.update_count), commands(other.commands),
+      boost(other.boost ? other.boost->clone() : nullptr),
+      deployment(other.deployment ? other.deployment->clone() : nullptr) {}
+
+template <typename T>
+BasicEcu<T> &BasicEcu<T>::operator=(const BasicEcu &other) {
+  if (this != &other) {
+    control_period = other.control_period;
+    steps_until_update = other.steps_until_update;
+    update_count = other.update_count;
+    commands = other.commands;
+    boost = other.boost ? other.boost->clone() : nullptr;
+    deployment = other.deployment ? other.deployment->clone() : nullptr;
+  }
+  return *this;
+}
+
+template <typename T> void BasicEcu<T>::setControlPeriod(double seconds) {
+  control_period = seconds;
+  steps_until_update = 0; // re-sync on the next step
+}
+
+template <typename T> double BasicEcu<T>::getControlPeriod() const {
+  return control_period;
+}
+
+template <typename T>
+void BasicEcu<T>::setBoostStrategy(
+    std::unique_ptr<BasicBoostStrategy<T>> strategy) {
+  boost = std::move(strategy);
+}
+
+template <typename T>
+void BasicEcu<T>::setDeploymentStrategy(
+    std::unique_ptr<BasicDeploymentStrategy<T>> strategy) {
+  deployment = std::move(strategy);
+}
+
+template <typename T>
+const BasicEcuCommands<T> &BasicEcu<T>::step(const BasicEcuInputs<T> &in,
+                                             double dt) {
+  if (steps_until_update <= 0) {
+    long steps = std::max(1L, std::lround(control_period / dt));
+    control(in, steps * dt);
+    steps_until_update = steps;
+  }
+  steps_until_update--;
+  return commands;
+}
+
+template <typename T>
+void BasicEcu<T>::resume(const BasicEcuCommands<T> &held, long step,
+                         double dt) {
+  long steps = std::max(1L, std::lround(control_period / dt));
+  commands = held;
+  steps_until_update = steps - 1 - step % steps;
+}
+
+template <typename T>
+void BasicEcu<T>::control(const BasicEcuInputs<T> &in, double period) {
+  commands.throttle =
+      commandedThrottle(in.driver_throttle, in.angular_velocity);
+
+  if (boost)
+    boost->update(in, period, commands);
+  else
+    default_boost.update(in, period, commands);
+  if (deployment)
+    deployment->update(in, period, commands);
+  else
+    default_deployment.update(in, period, commands);
+  update_count++;
+}
+
+template <typename T>
+T BasicEcu<T>::commandedThrottle(T driver_throttle, T angular_velocity) {
+  /* ============================================================
+     IDLE THROTTLE CONTROL (physical: airflow, not torque)
+     ============================================================ */
+  T idle_error = constants::engine_idle_rad_s - angular_velocity;
+  // Only add throttle if we are below idle speed
+  T idle_contribution =
+      ad::max(0.0, constants::idle_throttle_gain * idle_error);
+  return ad::clamp(driver_throttle + idle_contribution, 0.0, 1.0);
+}
+
+template <typename T>
+const BasicEcuCommands<T> &BasicEcu<T>::getCommands() const {
+  return commands;
+}
+
+template <typename T> long BasicEcu<T>::getUpdateCount() const {
+  return update_count;
+}
+
+template class BangBangBoost<double>;
+template class BangBangBoost<ad::ModelDual>;
+template class PidBoost<double>;
+template class PidBoost<ad::ModelDual>;
+template class ManualBoost<double>;
+template class ManualBoost<ad::ModelDual>;
+template class ThrottleDeployment<double>;
+template class ThrottleDeployment<ad::ModelDual>;
+template class SocAwareDeployment<double>;
+template class SocAwareDeployment<ad::ModelDual>;
+template class ManualDeployment<double>;
+template class ManualDeployment<ad::ModelDual>;
+template class BasicEcu<double>;
+template class BasicEcu<ad::ModelDual>;
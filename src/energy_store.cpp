@@ -1,24 +1,71 @@
 #include "../include/energy_store.hpp"
+#include "../include/dual.hpp"
 
-EnergyStore::EnergyStore(double maxE, double maxChargeP,
-                         double maxDischargeP)
+template <typename T>
+BasicEnergyStore<T>::BasicEnergyStore(double maxE, double maxChargeP,
+                                      double maxDischargeP)
     : energy_J(0.5 * maxE), // start at 50% SOC
       max_energy_J(maxE), max_charge_power_W(maxChargeP),
-      max_discharge_power_W(maxDischargeP) {}
+      max_discharge_power_W(maxDischargeP), booked_J(0.0) {}
+
+template <typename T>
+BasicEnergyStore<T>::BasicEnergyStore(const BasicEnergyStore &other)
+    : energy_J(other.energy_J), max_energy_J(other.max_energy_J),
+      max_charge_power_W(other.max_charge_power_W),
+      max_discharge_power_W(other.max_discharge_power_W),
+      pack(other.pack ? std::make_unique<BasicBatteryPack<T>>(*other.pack)
+                      : nullptr),
+      step_dt(other.step_dt), booked_J(other.booked_J) {}
+
+template <typename T>
+BasicEnergyStore<T> &
+BasicEnergyStore<T>::operator=(const BasicEnergyStore &other) {
+  if (this != &other) {
+    energy_J = other.energy_J;
+    max_energy_J = other.max_energy_J;
+    max_charge_power_W = other.max_charge_power_W;
+    max_discharge_power_W = other.max_discharge_power_W;
+    if (!other.pack)
+      pack.reset();
+    else if (pack)
+      *pack = *other.pack; // reuses the cell arrays
+    else
+      pack = std::make_unique<BasicBatteryPack<T>>(*other.pack);
+    step_dt = other.step_dt;
+    booked_J = other.booked_J;
+  }
+  return *this;
+}
 
 // Queries
 
-double EnergyStore::getEnergy() const { return energy_J; }
+template <typename T> T BasicEnergyStore<T>::getEnergy() const {
+  return pack ? pack->getEnergy() : energy_J;
+}
 
-double EnergyStore::getSOC() const { return energy_J / max_energy_J; }
+template <typename T> T BasicEnergyStore<T>::getSOC() const {
+  return pack ? pack->getSOC() : energy_J / max_energy_J;
+}
 
-double EnergyStore::getAvailableChargePower() const {
+template <typename T> void BasicEnergyStore<T>::setSOC(T soc) {
+  if (pack)
+    pack->setSOC(soc);
+  else
+    energy_J = ad::clamp(soc, 0.0, 1.0) * max_energy_J;
+}
+
+template <typename T> T BasicEnergyStore<T>::getAvailableChargePower() const {
+  if (pack)
+    return ad::max(pack->getMaxChargePower() - bookedPower(), 0.0);
   if (energy_J >= max_energy_J)
     return 0.0;
   return max_charge_power_W;
 }
 
-double EnergyStore::getAvailableDischargePower() const {
+template <typename T>
+T BasicEnergyStore<T>::getAvailableDischargePower() const {
+  if (pack)
+    return ad::max(pack->getMaxDischargePower() + bookedPower(), 0.0);
   if (energy_J <= 0.0)
     return 0.0;
   return max_discharge_power_W;
@@ -26,9 +73,13 @@ double EnergyStore::getAvailableDischargePower() const {
 
 // Update States
 
-void EnergyStore::charge(double energy_in_J) {
+template <typename T> void BasicEnergyStore<T>::charge(T energy_in_J) {
   if (energy_in_J <= 0.0)
     return;
+  if (pack) {
+    booked_J += energy_in_J;
+    return;
+  }
 
   energy_J += energy_in_J;
 
@@ -37,9 +88,13 @@ void EnergyStore::charge(double energy_in_J) {
   }
 }
 
-void EnergyStore::discharge(double energy_out_J) {
+template <typename T> void BasicEnergyStore<T>::discharge(T energy_out_J) {
   if (energy_out_J <= 0.0)
     return;
+  if (pack) {
+    booked_J -= energy_out_J;
+    return;
+  }
 
   energy_J -= energy_out_J;
 
@@ -47,3 +102,30 @@ void EnergyStore::discharge(double energy_out_J) {
     energy_J = 0.0;
   }
 }
+
+// Cell-Resolved Pack
+
+template <typename T>
+void BasicEnergyStore<T>::setPack(const BatteryPackParams &params) {
+  pack = std::make_unique<BasicBatteryPack<T>>(params, max_energy_J,
+                                               getSOC());
+  booked_J = 0.0;
+}
+
+template <typename T> void BasicEnergyStore<T>::beginStep(double dt) {
+  step_dt = dt;
+  booked_J = 0.0;
+}
+
+template <typename T> void BasicEnergyStore<T>::endStep() {
+  if (pack && step_dt > 0.0)
+    pack->step(-booked_J / step_dt, step_dt);
+  booked_J = 0.0;
+}
+
+template <typename T> T BasicEnergyStore<T>::bookedPower() const {
+  return step_dt > 0.0 ? booked_J / step_dt : T(0.0);
+}
+
+template class BasicEnergyStore<double>;
+template class BasicEnergyStore<ad::ModelDual>;
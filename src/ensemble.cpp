@@ -0,0 +1,383 @@
+#include "../include/ensemble.hpp"
+#include "../include/telemetry.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// --------------------------------------------------
+// PLACEMENT
+// --------------------------------------------------
+
+// "0-3,8-11" to {0, 1, 2, 3, 8, 9, 10, 11}
+static std::vector<int> parseCpuList(const std::string &text) {
+  std::vector<int> cpus;
+  std::istringstream in(text);
+  std::string range;
+  while (std::getline(in, range, ',')) {
+    int first = 0, last = 0;
+    if (std::sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+      for (int cpu = first; cpu <= last; cpu++)
+        cpus.push_back(cpu);
+    } else if (std::sscanf(range.c_str(), "%d", &first) == 1) {
+      cpus.push_back(first);
+    }
+  }
+  return cpus;
+}
+
+std::vector<std::vector<int>> numaNodes() {
+  // Node numbers may have gaps; nodes without CPUs are skipped
+  std::map<int, std::vector<int>> found;
+  std::error_code ec;
+  for (const fs::directory_entry &entry :
+       fs::directory_iterator("/sys/devices/system/node", ec)) {
+    int node = 0;
+    char tail = 0;
+    std::string name = entry.path().filename().string();
+    if (std::sscanf(name.c_str(), "node%d%c", &node, &tail) != 1)
+      continue;
+    std::ifstream in(entry.path() / "cpulist");
+    std::string text;
+    std::getline(in, text);
+    std::vector<int> cpus = parseCpuList(text);
+    if (!cpus.empty())
+      found[node] = cpus;
+  }
+
+  std::vector<std::vector<int>> nodes;
+  for (auto &node : found)
+    nodes.push_back(std::move(node.second));
+  if (nodes.empty()) {
+    int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    nodes.emplace_back();
+    for (int cpu = 0; cpu < threads; cpu++)
+      nodes.back().push_back(cpu);
+  }
+  return nodes;
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return CPU_COUNT(&set) > 0 &&
+         pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+// --------------------------------------------------
+// ARENA
+// --------------------------------------------------
+
+static size_t roundToLine(size_t bytes) {
+  return (bytes + kCacheLine - 1) / kCacheLine * kCacheLine;
+}
+
+Arena::Arena(size_t chunk_bytes) : chunk_bytes(roundToLine(chunk_bytes)) {}
+
+Arena::~Arena() {
+  destroyAll();
+  for (const Chunk &c : chunks)
+    munmap(c.base, c.size);
+}
+
+void *Arena::allocate(size_t bytes) {
+  bytes = roundToLine(std::max<size_t>(bytes, 1));
+  while (current < chunks.size()) {
+    if (offset + bytes <= chunks[current].size) {
+      void *p = chunks[current].base + offset;
+      offset += bytes;
+      return p;
+    }
+    // Kept chunks are tried in turn after a reset
+    used_before += offset;
+    offset = 0;
+    if (current + 1 == chunks.size())
+      break;
+    current++;
+  }
+
+  // Page-aligned, hence cache-line aligned. Writing every byte here
+  // places the pages on the calling thread's node.
+  size_t size = std::max(chunk_bytes, bytes);
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    throw std::bad_alloc();
+  std::memset(base, 0, size);
+  chunks.push_back({static_cast<char *>(base), size});
+  current = chunks.size() - 1;
+  offset = bytes;
+  return base;
+}
+
+void Arena::destroyAll() {
+  for (auto d = destructors.rbegin(); d != destructors.rend(); ++d)
+    d->destroy(d->object);
+  destructors.clear();
+}
+
+void Arena::reset() {
+  destroyAll();
+  current = 0;
+  offset = 0;
+  used_before = 0;
+}
+
+size_t Arena::bytesUsed() const { return used_before + offset; }
+
+size_t Arena::bytesMapped() const {
+  size_t total = 0;
+  for (const Chunk &c : chunks)
+    total += c.size;
+  return total;
+}
+
+// --------------------------------------------------
+// RUN POOL
+// --------------------------------------------------
+
+RunPool::~RunPool() {
+  for (EnsembleRun *run : heap_runs) {
+    delete[] run->telemetry;
+    delete run;
+  }
+}
+
+EnsembleRun *RunPool::acquire(const SimulationJob &job, int index,
+                              size_t rows,
+                              std::shared_ptr<const TurboMaps> maps) {
+  EnsembleRun *run;
+  if (!free_runs.empty()) {
+    run = free_runs.back();
+    free_runs.pop_back();
+    run->engine = ICEEngine(job.params);
+    runs_reused++;
+  } else {
+    run = arena ? arena->create<EnsembleRun>() : new EnsembleRun;
+    if (!arena)
+      heap_runs.push_back(run);
+    run->engine = ICEEngine(job.params);
+    runs_created++;
+  }
+
+  if (run->capacity < rows) {
+    // An outgrown arena buffer stays behind until the arena is reset
+    size_t values = rows * kTelemetryChannels;
+    if (arena) {
+      run->telemetry =
+          static_cast<double *>(arena->allocate(values * sizeof(double)));
+    } else {
+      delete[] run->telemetry;
+      run->telemetry = new double[values];
+    }
+    run->capacity = rows;
+  }
+  run->job = index;
+  run->rows = 0;
+  run->run.start(job, run->engine, std::move(maps));
+  return run;
+}
+
+void RunPool::release(EnsembleRun *run) { free_runs.push_back(run); }
+
+// --------------------------------------------------
+// ENSEMBLE
+// --------------------------------------------------
+
+namespace {
+struct Worker {
+  int index = 0;
+  std::vector<int> cpus; // empty: not pinned
+  int64_t steps = 0;
+  long created = 0;
+  long reused = 0;
+  size_t arena_bytes = 0;
+  std::exception_ptr error;
+};
+
+// Runs of the HEAP placement: a fresh engine and buffer per job, as a
+// plain loop over runJob-style code would get them
+EnsembleRun *newHeapRun(const SimulationJob &job, int index, size_t rows) {
+  EnsembleRun *run = new EnsembleRun{ICEEngine(job.params)};
+  run->telemetry = new double[std::max<size_t>(rows, 1) * kTelemetryChannels];
+  run->capacity = rows;
+  run->job = index;
+  run->run.start(job, run->engine);
+  return run;
+}
+
+void deleteHeapRun(EnsembleRun *run) {
+  delete[] run->telemetry;
+  delete run;
+}
+} // namespace
+
+static size_t telemetryRows(const SimulationJob &job, int log_interval) {
+  return log_interval > 0 ? size_t(job.scenario.iterations / log_interval)
+                          : 0;
+}
+
+// Takes up to `steps` steps, logging a row after every log_interval-th
+// step of the run; true once the run has finished
+static bool advanceLogged(EnsembleRun &run, int steps, int log_interval) {
+  if (log_interval <= 0)
+    return run.run.advance(run.engine, steps);
+  while (steps > 0 && !run.run.done()) {
+    int n = std::min(steps, log_interval - run.run.getStep() % log_interval);
+    run.run.advance(run.engine, n);
+    steps -= n;
+    if (run.run.getStep() % log_interval == 0 && run.rows < run.capacity)
+      sampleTelemetry(run.engine,
+                      run.telemetry + run.rows++ * kTelemetryChannels);
+  }
+  return run.run.done();
+}
+
+static void runWorker(Worker &w, int workers,
+                      const std::vector<SimulationJob> &jobs,
+                      const EnsembleOptions &options,
+                      std::vector<std::vector<double>> &outputs,
+                      const EnsembleSink &sink) {
+  if (!w.cpus.empty())
+    pinCurrentThread(w.cpus);
+  bool pooled = options.placement == EnsemblePlacement::ARENA;
+  // Built after pinning so the arena's chunks are touched on the node
+  Arena arena;
+  RunPool pool(&arena);
+
+  int live = std::max(1, options.live);
+  int slice = std::max(1, options.slice);
+  std::vector<EnsembleRun *> running;
+  running.reserve(live);
+  size_t next = w.index;
+
+  auto admit = [&]() -> EnsembleRun * {
+    if (next >= jobs.size())
+      return nullptr;
+    int j = int(next);
+    next += workers;
+    size_t rows = telemetryRows(jobs[j], options.log_interval);
+    if (pooled)
+      return pool.acquire(jobs[j], j, rows);
+    w.created++;
+    return newHeapRun(jobs[j], j, rows);
+  };
+
+  try {
+    while (int(running.size()) < live)
+      if (EnsembleRun *run = admit())
+        running.push_back(run);
+      else
+        break;
+
+    while (!running.empty()) {
+      for (size_t i = 0; i < running.size();) {
+        EnsembleRun *run = running[i];
+        int before = run->run.getStep();
+        bool finished = advanceLogged(*run, slice, options.log_interval);
+        w.steps += run->run.getStep() - before;
+        if (!finished) {
+          i++;
+          continue;
+        }
+
+        outputs[run->job] = run->run.outputs(run->engine);
+        if (sink)
+          sink(run->job, run->telemetry, run->rows);
+        if (pooled)
+          pool.release(run);
+        else
+          deleteHeapRun(run);
+
+        if (EnsembleRun *replacement = admit()) {
+          running[i++] = replacement;
+        } else {
+          running[i] = running.back();
+          running.pop_back();
+        }
+      }
+    }
+  } catch (...) {
+    w.error = std::current_exception();
+    if (!pooled)
+      for (EnsembleRun *run : running)
+        deleteHeapRun(run);
+  }
+
+  if (pooled) {
+    w.created = pool.created();
+    w.reused = pool.reused();
+  }
+  w.arena_bytes = arena.bytesMapped();
+}
+
+EnsembleStats runEnsemble(const std::vector<SimulationJob> &jobs,
+                          const EnsembleOptions &options,
+                          std::vector<std::vector<double>> &outputs,
+                          const EnsembleSink &sink) {
+  EnsembleStats stats;
+  int workers = options.workers > 0
+                    ? options.workers
+                    : int(std::max(1u, std::thread::hardware_concurrency()));
+  workers = std::max(1, std::min<int>(workers, int(jobs.size())));
+  outputs.assign(jobs.size(), {});
+  stats.workers = workers;
+  if (jobs.empty())
+    return stats;
+
+  std::vector<Worker> state(workers);
+  std::vector<std::vector<int>> nodes = numaNodes();
+  bool pin = options.placement == EnsemblePlacement::ARENA;
+  for (int i = 0; i < workers; i++) {
+    state[i].index = i;
+    if (pin)
+      state[i].cpus = nodes[i % nodes.size()];
+  }
+  stats.nodes = pin ? int(std::min(nodes.size(), size_t(workers))) : 1;
+
+  auto start = std::chrono::steady_clock::now();
+  // Every worker gets its own thread, so pinning never sticks to the
+  // caller
+  std::vector<std::thread> threads;
+  for (int i = 0; i < workers; i++)
+    threads.emplace_back(runWorker, std::ref(state[i]), workers,
+                         std::cref(jobs), std::cref(options),
+                         std::ref(outputs), std::cref(sink));
+  for (std::thread &t : threads)
+    t.join();
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+
+  for (const Worker &w : state) {
+    if (w.error)
+      std::rethrow_exception(w.error);
+    stats.steps += w.steps;
+    stats.runs_created += w.created;
+    stats.runs_reused += w.reused;
+    stats.arena_bytes += w.arena_bytes;
+  }
+  return stats;
+}
@@ -0,0 +1,273 @@
+#include "../include/events.hpp"
+#include "../include/constants.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+
+// --------------------------------------------------
+// SWITCHING FUNCTIONS
+// --------------------------------------------------
+
+static double commanded(const ICEEngine &e, double driver_throttle) {
+  return Ecu::commandedThrottle(driver_throttle, e.getAngularVelocity());
+}
+
+const SwitchFunction switchFunctions[kSwitchFunctions] = {
+    {"mguh_active",
+     [](const ICEEngine &e, double pedal) {
+       return commanded(e, pedal) - BangBangBoost<double>::kActiveThrottle;
+     }},
+    {"mguk_deploy",
+     [](const ICEEngine &e, double pedal) {
+       return commanded(e, pedal) -
+              ThrottleDeployment<double>::kDeployThrottle;
+     }},
+    {"boost_error",
+     [](const ICEEngine &e, double) {
+       return e.getEcu().getCommands().target_boost - e.getBoostPressure();
+     }},
+    {"intake_floor",
+     [](const ICEEngine &e, double) {
+       return e.getIntakeManifoldPressure() -
+              0.3 * constants::ambient_pressure;
+     }},
+    {"intake_ceiling",
+     [](const ICEEngine &e, double) {
+       return e.getBoostPressure() - e.getIntakeManifoldPressure();
+     }},
+    {"idle_floor",
+     [](const ICEEngine &e, double) {
+       return e.getAngularVelocity() - constants::engine_idle_rad_s;
+     }},
+    {"battery_empty",
+     [](const ICEEngine &e, double) { return e.getBatterySOC(); }},
+    {"battery_full",
+     [](const ICEEngine &e, double) { return 1.0 - e.getBatterySOC(); }},
+};
+
+int findSwitchFunction(const std::string &name) {
+  for (int i = 0; i < kSwitchFunctions; i++)
+    if (name == switchFunctions[i].name)
+      return i;
+  return -1;
+}
+
+const char *switchEventName(const SwitchEvent &event) {
+  return event.function == kThrottleBreakpoint
+             ? "throttle_breakpoint"
+             : switchFunctions[event.function].name;
+}
+
+// Same scaling as the parareal residual
+static double stateChange(const PlantState &a, const PlantState &b) {
+  return std::max(
+      {std::abs(a.angular_velocity - b.angular_velocity) / 1000.0,
+       std::abs(a.intake_manifold_pressure - b.intake_manifold_pressure) /
+           1e5,
+       std::abs(a.turbo_speed - b.turbo_speed) / 1e4,
+       std::abs(a.battery_soc - b.battery_soc)});
+}
+
+// --------------------------------------------------
+// EVENT-LOCATING INTEGRATION
+// --------------------------------------------------
+
+EventIntegrator::EventIntegrator(const ICEEngine &initial,
+                                 const Scenario &scenario,
+                                 const EventIntegratorOptions &options)
+    : engine(initial), scenario(scenario), options(options),
+      h(options.initial_step) {
+  if (!(options.initial_step > 0) || !(options.min_step > 0) ||
+      options.max_step < options.min_step || options.event_tolerance <= 0)
+    throw std::invalid_argument("event integrator: bad step limits");
+  engine.getEcu().setControlPeriod(0.0);
+  while (breakpoint < scenario.throttle.size() &&
+         scenario.throttle[breakpoint].time <= 0.0)
+    breakpoint++;
+  signs(engine, 0.0, positive);
+}
+
+ICEEngine EventIntegrator::trial(double step) {
+  ICEEngine next = engine;
+  next.setThrottle(scenario.throttleAt(time));
+  next.update(step);
+  stats.updates++;
+  return next;
+}
+
+void EventIntegrator::signs(const ICEEngine &at, double t,
+                            bool *out) const {
+  double pedal = scenario.throttleAt(t);
+  for (int i = 0; i < kSwitchFunctions; i++)
+    out[i] = switchFunctions[i].value(at, pedal) > 0;
+}
+
+double EventIntegrator::nextBreakpoint() const {
+  return breakpoint < scenario.throttle.size()
+             ? scenario.throttle[breakpoint].time
+             : std::numeric_limits<double>::infinity();
+}
+
+// At the breakpoint under the cursor: the pedal steps up, or its slope
+// increases
+bool EventIntegrator::pedalRises() const {
+  const std::vector<ThrottlePoint> &p = scenario.throttle;
+  size_t first = breakpoint, last = breakpoint;
+  while (last + 1 < p.size() && p[last + 1].time <= p[first].time)
+    last++;
+  if (p[last].throttle != p[first].throttle)
+    return p[last].throttle > p[first].throttle;
+  double before = first > 0 ? (p[first].throttle - p[first - 1].throttle) /
+                                  (p[first].time - p[first - 1].time)
+                            : 0.0;
+  double after = last + 1 < p.size()
+                     ? (p[last + 1].throttle - p[last].throttle) /
+                           (p[last + 1].time - p[last].time)
+                     : 0.0;
+  return after > before;
+}
+
+double EventIntegrator::step(double end) {
+  double limit = std::min(end, nextBreakpoint());
+  double span = limit - time;
+  if (span <= 0)
+    return 0.0;
+  double step = std::min(h, span);
+
+  // Step doubling: the two half steps are kept, their difference from
+  // the full step is the error estimate (first order, so ~h^2)
+  ICEEngine next = engine, full = engine;
+  double grow = 2.0;
+  bool rejected = false;
+  for (;;) {
+    full = trial(step);
+    if (options.tolerance <= 0) {
+      next = full;
+      break;
+    }
+    next = trial(step / 2);
+    next.setThrottle(scenario.throttleAt(time + step / 2));
+    next.update(step / 2);
+    stats.updates++;
+
+    double error = stateChange(full.getPlantState(), next.getPlantState());
+    double factor = error > 0 ? 0.9 * std::sqrt(options.tolerance / error)
+                              : 2.0;
+    if (error <= options.tolerance || step <= options.min_step) {
+      grow = std::min(rejected ? 1.0 : 1.2, factor);
+      break;
+    }
+    stats.rejected++;
+    rejected = true;
+    step = std::max(options.min_step, step * std::max(0.2, factor));
+  }
+
+  bool after[kSwitchFunctions];
+  signs(next, time + step, after);
+  bool crossed = false;
+  for (int i = 0; i < kSwitchFunctions; i++)
+    crossed = crossed || after[i] != positive[i];
+
+  if (crossed) {
+    // Earliest crossing over the fraction of the single step taken, each
+    // bracketed by Illinois on [0, 1]. A function that changed sign only
+    // along the half steps is taken to cross at the end.
+    double pedal = scenario.throttleAt(time);
+    double end_pedal = scenario.throttleAt(time + step);
+    double first = 1.0;
+    for (int i = 0; i < kSwitchFunctions; i++) {
+      if (after[i] == positive[i])
+        continue;
+      const SwitchFunction &f = switchFunctions[i];
+      double lo = 0.0, hi = first;
+      double f_lo = f.value(engine, pedal);
+      double f_hi = hi == 1.0 ? f.value(full, end_pedal)
+                              : f.value(trial(hi * step),
+                                        scenario.throttleAt(time + hi * step));
+      if ((f_hi > 0) == (f_lo > 0))
+        continue; // crosses after `first`, or only along the half steps
+      int side = 0;
+      while ((hi - lo) * step > options.event_tolerance) {
+        double m = hi - f_hi * (hi - lo) / (f_hi - f_lo);
+        double margin = 0.01 * (hi - lo);
+        if (!(m > lo + margin && m < hi - margin))
+          m = 0.5 * (lo + hi); // a clamp reading flat zero
+        ICEEngine at = trial(m * step);
+        stats.root_updates++;
+        double f_m = f.value(at, scenario.throttleAt(time + m * step));
+        if ((f_m > 0) == (f_hi > 0)) {
+          hi = m;
+          f_hi = f_m;
+          if (side == 1)
+            f_lo *= 0.5;
+          side = 1;
+        } else {
+          lo = m;
+          f_lo = f_m;
+          if (side == -1)
+            f_hi *= 0.5;
+          side = -1;
+        }
+      }
+      first = hi;
+    }
+    if (first < 1.0) {
+      step *= first;
+      next = trial(step);
+      signs(next, time + step, after);
+    }
+  }
+
+  bool on_breakpoint = step == span && limit == nextBreakpoint();
+  accept(next, on_breakpoint ? limit - time : step);
+  if (on_breakpoint) {
+    time = limit; // exactly, whatever the rounding of the sum
+    events.push_back({time, kThrottleBreakpoint, pedalRises()});
+    while (breakpoint < scenario.throttle.size() &&
+           scenario.throttle[breakpoint].time <= time)
+      breakpoint++;
+    signs(engine, time, after); // the pedal may have stepped
+  }
+
+  bool switched = on_breakpoint;
+  for (int i = 0; i < kSwitchFunctions; i++) {
+    if (after[i] == positive[i])
+      continue;
+    events.push_back({time, i, after[i]});
+    positive[i] = after[i];
+    switched = true;
+  }
+  // Restart after a switch: the ECU sees the new mode on the next step
+  // and the step size starts over
+  h = switched ? options.initial_step
+               : std::clamp(step * grow, options.min_step, options.max_step);
+  return step;
+}
+
+void EventIntegrator::accept(const ICEEngine &next, double step) {
+  engine = next;
+  time += step;
+  stats.min_step = stats.steps ? std::min(stats.min_step, step) : step;
+  stats.max_step = std::max(stats.max_step, step);
+  stats.steps++;
+}
+
+void EventIntegrator::advanceTo(double end) {
+  while (end - time > 1e-12)
+    step(end);
+}
+
+void EventIntegrator::write(const std::string &path) const {
+  FILE *out = std::fopen(path.c_str(), "w");
+  if (!out)
+    throw std::runtime_error("cannot write " + path);
+  std::fprintf(out, "time,event,direction\n");
+  for (const SwitchEvent &e : events)
+    std::fprintf(out, "%.9f,%s,%s\n", e.time, switchEventName(e),
+                 e.rising ? "rising" : "falling");
+  bool failed = std::ferror(out) != 0;
+  if (std::fclose(out) != 0 || failed)
+    throw std::runtime_error("cannot write " + path);
+}
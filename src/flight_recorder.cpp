@@ -0,0 +1,163 @@
+#include "../include/flight_recorder.hpp"
+#include "../include/constants.hpp"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+
+// --------------------------------------------------
+// TRIGGERS
+// --------------------------------------------------
+
+RecorderTrigger RecorderTrigger::parse(const std::string &text) {
+  RecorderTrigger t;
+  t.text = text;
+
+  size_t pos = text.find_first_of("<>");
+  if (pos == std::string::npos || pos == 0)
+    throw std::invalid_argument("bad trigger '" + text +
+                                "' (expected channel<op>value)");
+  bool equal = pos + 1 < text.size() && text[pos + 1] == '=';
+  if (text[pos] == '<')
+    t.op = equal ? Op::LESS_EQUAL : Op::LESS;
+  else
+    t.op = equal ? Op::GREATER_EQUAL : Op::GREATER;
+
+  std::string lhs = text.substr(0, pos);
+  std::string rhs = text.substr(pos + (equal ? 2 : 1));
+  t.channel = findTelemetryChannel(lhs);
+  if (t.channel < 0)
+    throw std::invalid_argument("unknown channel in trigger: " + lhs);
+
+  t.rhs_channel = findTelemetryChannel(rhs);
+  if (t.rhs_channel < 0) {
+    size_t used = 0;
+    try {
+      t.threshold = std::stod(rhs, &used);
+    } catch (const std::exception &) {
+      used = 0;
+    }
+    if (used == 0 || used != rhs.size())
+      throw std::invalid_argument("bad trigger value: " + rhs);
+  }
+  return t;
+}
+
+bool RecorderTrigger::test(const double *row) const {
+  double a = row[channel];
+  double b = rhs_channel >= 0 ? row[rhs_channel] : threshold;
+  switch (op) {
+  case Op::LESS:
+    return a < b;
+  case Op::LESS_EQUAL:
+    return a <= b;
+  case Op::GREATER:
+    return a > b;
+  case Op::GREATER_EQUAL:
+    return a >= b;
+  }
+  return false;
+}
+
+std::vector<RecorderTrigger> defaultRecorderTriggers() {
+  char intake_clamp[64];
+  std::snprintf(intake_clamp, sizeof intake_clamp,
+                "intake_manifold_pressure<=%.17g",
+                0.3 * constants::ambient_pressure);
+  char turbo_idle[64];
+  std::snprintf(turbo_idle, sizeof turbo_idle, "turbo_speed<=%.17g",
+                constants::turbo_idle_rad_s);
+
+  return {RecorderTrigger::parse("battery_soc<=0"),
+          RecorderTrigger::parse(intake_clamp),
+          RecorderTrigger::parse(turbo_idle),
+          RecorderTrigger::parse("combustion_torque<0")};
+}
+
+// --------------------------------------------------
+// RECORDER
+// --------------------------------------------------
+
+FlightRecorder::FlightRecorder(const FlightRecorderOptions &opts, double dt)
+    : options(opts), dt(dt),
+      pre_rows(std::llround(opts.pre_seconds / dt)),
+      post_rows(std::llround(opts.post_seconds / dt)),
+      armed(opts.triggers.size(), 0) {
+  capacity = size_t(pre_rows + post_rows + 1);
+  // Touch the whole ring now so recording never allocates or faults
+  rows.assign(capacity * kTelemetryChannels, 0.0);
+  steps.assign(capacity, 0);
+  std::filesystem::create_directories(options.directory);
+}
+
+void FlightRecorder::record(int64_t step, const ICEEngine &engine) {
+  size_t slot = size_t(recorded % capacity);
+  double *row = &rows[slot * kTelemetryChannels];
+  sampleTelemetry(engine, row);
+  steps[slot] = step;
+  recorded++;
+
+  for (size_t k = 0; k < options.triggers.size(); k++) {
+    bool now = options.triggers[k].test(row);
+    if (now && armed[k]) {
+      events++;
+      if (!pending) {
+        pending = true;
+        pending_step = step;
+        pending_triggers.clear();
+      }
+      pending_triggers.push_back(options.triggers[k].text);
+    }
+    armed[k] = !now;
+  }
+
+  if (pending && step >= pending_step + post_rows)
+    writeDump();
+}
+
+void FlightRecorder::flush() {
+  if (pending)
+    writeDump();
+}
+
+void FlightRecorder::writeDump() {
+  pending = false;
+  if (int(dumps.size()) >= options.max_dumps)
+    return;
+
+  // File name from the first trigger, reduced to [A-Za-z0-9_]
+  std::string tag;
+  for (char ch : pending_triggers.front())
+    tag += std::isalnum((unsigned char)ch) ? ch : '_';
+  bool csv = options.format == RecorderFormat::CSV;
+  std::string path = options.directory + "/flight_" +
+                     std::to_string(pending_step) + "_" + tag +
+                     (csv ? ".csv" : ".f1pz");
+
+  std::unique_ptr<TelemetryWriter> out;
+  if (csv)
+    out = std::make_unique<CsvTelemetryWriter>(path, telemetryChannelNames(),
+                                               dt);
+  else
+    out = std::make_unique<CompressedTelemetryWriter>(
+        path, telemetryChannelNames(), dt, TelemetryCoding::EXACT);
+
+  // Oldest retained row first
+  uint64_t available = recorded < capacity ? recorded : capacity;
+  for (uint64_t r = recorded - available; r < recorded; r++) {
+    size_t slot = size_t(r % capacity);
+    if (steps[slot] >= pending_step - pre_rows)
+      out->write(steps[slot], &rows[slot * kTelemetryChannels]);
+  }
+  out->close();
+
+  dumps.push_back({path, pending_step, pending_triggers});
+}
+
+const std::vector<FlightRecorder::Dump> &FlightRecorder::getDumps() const {
+  return dumps;
+}
+
+long FlightRecorder::getEventCount() const { return events; }
@@ -0,0 +1,139 @@
+#include "../include/fmu.hpp"
+#include "../include/ecu.hpp"
+#include "../include/engine_params.hpp"
+#include "../include/job.hpp"
+#include "../include/telemetry.hpp"
+#include <cstdio>
+
+const char *const fmuInputNames[kFmuInputs] = {
+    "driver_throttle", "mguk_power_command", "mguh_power_command",
+    "external_load_torque"};
+
+static const char *const input_descriptions[kFmuInputs] = {
+    "Driver throttle pedal, 0..1",
+    "MGU-K power command in W, positive motoring (ers_external only)",
+    "MGU-H power command in W, positive motoring (ers_external only)",
+    "Crank load from the driveline and vehicle in Nm"};
+
+std::string fmuGuid() {
+  char guid[64];
+  std::snprintf(guid, sizeof guid, "{4f1e7c2a-0b5d-4d8e-9a61-%012d}",
+                kModelVersion);
+  return guid;
+}
+
+// --------------------------------------------------
+// VARIABLE TABLE
+// --------------------------------------------------
+
+std::vector<FmuVariable> fmuVariables() {
+  using Kind = FmuVariable::Kind;
+  using Type = FmuVariable::Type;
+  std::vector<FmuVariable> vars;
+
+  for (int i = 0; i < kFmuInputs; i++)
+    vars.push_back({fmuInputNames[i], kFmuInputBase + i, Kind::INPUT,
+                    Type::REAL, 0.0, input_descriptions[i]});
+
+  for (int c = 0; c < kTelemetryChannels; c++)
+    vars.push_back({telemetryChannels[c].name, kFmuOutputBase + c,
+                    Kind::OUTPUT, Type::REAL, 0.0, "Telemetry channel"});
+
+  EngineParams defaults;
+  unsigned vr = kFmuTunableBase;
+  forEachParameter(defaults, [&](const char *name, double value) {
+    vars.push_back({name, vr++, Kind::PARAMETER, Type::REAL, value,
+                    "Tunable (engine_params.hpp)"});
+  });
+
+  vars.push_back({"step_size", kFmuStepSizeVr, Kind::PARAMETER, Type::REAL,
+                  1e-4, "Internal physics step in s"});
+  vars.push_back({"ecu_period", kFmuEcuPeriodVr, Kind::PARAMETER, Type::REAL,
+                  Ecu::kDefaultPeriod, "ECU control period in s"});
+  vars.push_back({"ers_external", kFmuErsExternalVr, Kind::PARAMETER,
+                  Type::BOOLEAN, 0.0,
+                  "Take MGU-K/MGU-H power from the inputs instead of the "
+                  "ECU strategies"});
+  return vars;
+}
+
+// --------------------------------------------------
+// MODEL DESCRIPTION
+// --------------------------------------------------
+
+std::string fmuModelDescription() {
+  std::string xml;
+  char line[512];
+
+  xml += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+  std::snprintf(line, sizeof line,
+                "<fmiModelDescription fmiVersion=\"2.0\" modelName=\"%s\" "
+                "guid=\"%s\"\n"
+                "  description=\"F1 power unit: ICE, turbocharger, MGU-H, "
+                "MGU-K, energy store and ECU\"\n"
+                "  generationTool=\"f1-pu\" "
+                "variableNamingConvention=\"flat\" "
+                "numberOfEventIndicators=\"0\">\n",
+                kFmuModelIdentifier, fmuGuid().c_str());
+  xml += line;
+  std::snprintf(line, sizeof line,
+                "  <CoSimulation modelIdentifier=\"%s\"\n"
+                "    canHandleVariableCommunicationStepSize=\"true\"\n"
+                "    canGetAndSetFMUstate=\"true\" "
+                "canSerializeFMUstate=\"false\"\n"
+                "    providesDirectionalDerivative=\"false\" "
+                "canInterpolateInputs=\"false\"\n"
+                "    maxOutputDerivativeOrder=\"0\" "
+                "canNotUseMemoryManagementFunctions=\"true\"/>\n",
+                kFmuModelIdentifier);
+  xml += line;
+  xml += "  <DefaultExperiment startTime=\"0\" stepSize=\"0.001\"/>\n";
+
+  xml += "  <ModelVariables>\n";
+  std::vector<FmuVariable> vars = fmuVariables();
+  for (const FmuVariable &v : vars) {
+    const char *causality = v.kind == FmuVariable::Kind::INPUT ? "input"
+                            : v.kind == FmuVariable::Kind::OUTPUT
+                                ? "output"
+                                : "parameter";
+    const char *timing = v.kind == FmuVariable::Kind::PARAMETER
+                             ? "variability=\"fixed\" initial=\"exact\""
+                         : v.kind == FmuVariable::Kind::OUTPUT
+                             ? "variability=\"continuous\" "
+                               "initial=\"calculated\""
+                             : "variability=\"continuous\"";
+    std::snprintf(line, sizeof line,
+                  "    <ScalarVariable name=\"%s\" valueReference=\"%u\" "
+                  "causality=\"%s\" %s\n      description=\"%s\">\n",
+                  v.name.c_str(), v.value_reference, causality, timing,
+                  v.description.c_str());
+    xml += line;
+    if (v.type == FmuVariable::Type::BOOLEAN)
+      std::snprintf(line, sizeof line, "      <Boolean start=\"%s\"/>\n",
+                    v.start != 0.0 ? "true" : "false");
+    else if (v.kind == FmuVariable::Kind::OUTPUT)
+      std::snprintf(line, sizeof line, "      <Real/>\n");
+    else
+      std::snprintf(line, sizeof line, "      <Real start=\"%.17g\"/>\n",
+                    v.start);
+    xml += line;
+    xml += "    </ScalarVariable>\n";
+  }
+  xml += "  </ModelVariables>\n";
+
+  // Outputs by 1-based position in ModelVariables
+  std::string unknowns;
+  for (size_t i = 0; i < vars.size(); i++) {
+    if (vars[i].kind != FmuVariable::Kind::OUTPUT)
+      continue;
+    std::snprintf(line, sizeof line, "      <Unknown index=\"%zu\"/>\n",
+                  i + 1);
+    unknowns += line;
+  }
+  xml += "  <ModelStructure>\n";
+  xml += "    <Outputs>\n" + unknowns + "    </Outputs>\n";
+  xml += "    <InitialUnknowns>\n" + unknowns + "    </InitialUnknowns>\n";
+  xml += "  </ModelStructure>\n";
+  xml += "</fmiModelDescription>\n";
+  return xml;
+}
@@ -0,0 +1,626 @@
+#include "../include/gas_dynamics.hpp"
+#include "../include/constants.hpp"
+#include "../include/dual.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Floor against round-off in near-vacuum cells, Pa
+constexpr double kMinPressure = 100.0;
+constexpr double kMinDensity = 1e-4; // kg/m³, likewise
+// At most 2^kMaxLevel steps per network step
+constexpr int kMaxLevel = 12;
+// Cylinders, spaced evenly over the 720° cycle in firing order
+constexpr int kCylinders = int(constants::NUM_CYLINDERS);
+
+template <typename T> struct Flux {
+  T mass, momentum, energy; // per m² and s
+};
+
+// --------------------------------------------------
+// CELL KERNELS
+// --------------------------------------------------
+
+// Free functions over raw arrays: restrict only holds for parameters, and
+// without it every store could move the member arrays
+
+// Harten-Lax-van Leer flux between two states, with Davis's wave speed
+// bounds from the sound speeds c_l and c_r of the cells either side (so
+// the face kernel needs no square root). With both bounds clamped to
+// their side of zero, the one expression also gives the upwind flux in
+// supersonic flow, so it has no branches.
+template <typename T>
+static inline Flux<T> hllFlux(T rho_l, T u_l, T p_l, T c_l, T rho_r, T u_r,
+                              T p_r, T c_r, double gamma) {
+  const double g1 = 1.0 / (gamma - 1.0);
+  T s_l = ad::min(ad::min(u_l - c_l, u_r - c_r), 0.0);
+  T s_r = ad::max(ad::max(u_l + c_l, u_r + c_r), 0.0);
+  T m_l = rho_l * u_l, m_r = rho_r * u_r;
+  T e_l = p_l * g1 + 0.5 * m_l * u_l;
+  T e_r = p_r * g1 + 0.5 * m_r * u_r;
+  T inv = 1.0 / (s_r - s_l);
+  T w = s_l * s_r;
+  return {(s_r * m_l - s_l * m_r + w * (rho_r - rho_l)) * inv,
+          (s_r * (m_l * u_l + p_l) - s_l * (m_r * u_r + p_r) +
+           w * (m_r - m_l)) *
+              inv,
+          (s_r * u_l * (e_l + p_l) - s_l * u_r * (e_r + p_r) +
+           w * (e_r - e_l)) *
+              inv};
+}
+
+// Zero across an extremum, else the smaller of the two
+template <typename T> static inline T minmod(T a, T b) {
+  return ad::max(ad::min(a, b), 0.0) + ad::min(ad::max(a, b), 0.0);
+}
+
+// Velocity, pressure and sound speed of every cell. The square roots
+// are a loop of their own: they keep a call for errno, which would stop
+// the rest from vectorising.
+template <typename T>
+static void primitives(int begin, int end, double gamma,
+                       const T *__restrict rho, const T *__restrict mom,
+                       const T *__restrict ene, T *__restrict u,
+                       T *__restrict p, T *__restrict c) {
+  for (int i = begin; i < end; i++) {
+    T inv_rho = 1.0 / rho[i];
+    T v = mom[i] * inv_rho;
+    T pressure = ad::max((gamma - 1.0) * (ene[i] - 0.5 * mom[i] * v),
+                         kMinPressure);
+    u[i] = v;
+    p[i] = pressure;
+    c[i] = gamma * pressure * inv_rho;
+  }
+  for (int i = begin; i < end; i++)
+    c[i] = ad::sqrt(c[i]);
+}
+
+// MUSCL-Hancock: limited slopes, then each cell's primitives moved on by
+// half a step with them, evaluated at both faces. Reads one cell either
+// side of the range; cells without a slope keep their own state.
+template <typename T>
+static void faceStates(int begin, int end, double h, double gamma,
+                       const double *__restrict interior,
+                       const double *__restrict inv_dx,
+                       const T *__restrict rho, const T *__restrict u,
+                       const T *__restrict p, T *__restrict l_rho,
+                       T *__restrict l_u, T *__restrict l_p,
+                       T *__restrict r_rho, T *__restrict r_u,
+                       T *__restrict r_p) {
+  for (int i = begin; i < end; i++) {
+    T d_rho = interior[i] * minmod(rho[i] - rho[i - 1], rho[i + 1] - rho[i]);
+    T d_u = interior[i] * minmod(u[i] - u[i - 1], u[i + 1] - u[i]);
+    T d_p = interior[i] * minmod(p[i] - p[i - 1], p[i + 1] - p[i]);
+    double k = 0.5 * h * inv_dx[i];
+    T rho_h = rho[i] - k * (u[i] * d_rho + rho[i] * d_u);
+    T u_h = u[i] - k * (u[i] * d_u + d_p / rho[i]);
+    T p_h = p[i] - k * (gamma * p[i] * d_u + u[i] * d_p);
+    l_rho[i] = ad::max(rho_h - 0.5 * d_rho, kMinDensity);
+    l_u[i] = u_h - 0.5 * d_u;
+    l_p[i] = ad::max(p_h - 0.5 * d_p, kMinPressure);
+    r_rho[i] = ad::max(rho_h + 0.5 * d_rho, kMinDensity);
+    r_u[i] = u_h + 0.5 * d_u;
+    r_p[i] = ad::max(p_h + 0.5 * d_p, kMinPressure);
+  }
+}
+
+// Faces begin..end - 1, each between cells i - 1 and i
+template <typename T>
+static void faceFluxes(int begin, int end, double gamma,
+                       const T *__restrict c, const T *__restrict l_rho,
+                       const T *__restrict l_u, const T *__restrict l_p,
+                       const T *__restrict r_rho, const T *__restrict r_u,
+                       const T *__restrict r_p, T *__restrict f_rho,
+                       T *__restrict f_mom, T *__restrict f_ene) {
+  for (int i = begin; i < end; i++) {
+    Flux<T> f = hllFlux(r_rho[i - 1], r_u[i - 1], r_p[i - 1], c[i - 1],
+                        l_rho[i], l_u[i], l_p[i], c[i], gamma);
+    f_rho[i] = f.mass;
+    f_mom[i] = f.momentum;
+    f_ene[i] = f.energy;
+  }
+}
+
+// U -= h dF/dx
+template <typename T>
+static void updateCells(int begin, int end, double h,
+                        const double *__restrict inv_dx,
+                        const T *__restrict f_rho, const T *__restrict f_mom,
+                        const T *__restrict f_ene, T *__restrict rho,
+                        T *__restrict mom, T *__restrict ene) {
+  for (int i = begin; i < end; i++) {
+    double k = h * inv_dx[i];
+    rho[i] -= k * (f_rho[i + 1] - f_rho[i]);
+    mom[i] -= k * (f_mom[i + 1] - f_mom[i]);
+    ene[i] -= k * (f_ene[i + 1] - f_ene[i]);
+  }
+}
+
+// --------------------------------------------------
+// PIPE NETWORK SETUP
+// --------------------------------------------------
+
+template <typename T>
+BasicPipeNetwork<T>::BasicPipeNetwork(double g, double c)
+    : gamma(g), cfl(c) {}
+
+template <typename T>
+int BasicPipeNetwork<T>::addNode(double volume, T pressure, T temperature) {
+  if (volume <= 0.0)
+    throw std::invalid_argument("pipe network node needs a volume");
+  Node node;
+  node.volume = volume;
+  node.mass = pressure * volume / (constants::R * temperature);
+  node.energy = pressure * volume / (gamma - 1.0);
+  refreshNode(node);
+  nodes.push_back(node);
+  return int(nodes.size()) - 1;
+}
+
+template <typename T>
+int BasicPipeNetwork<T>::addPipe(const PipeGeometry &g, T pressure,
+                                 T temperature) {
+  if (g.cells < 2 || g.length <= 0.0 || g.diameter <= 0.0)
+    throw std::invalid_argument(
+        "pipe needs a length, a diameter and at least two cells");
+  T density = pressure / (constants::R * temperature);
+  T energy = pressure / (gamma - 1.0);
+
+  // The leading padding cell, then the pipe and the one after it
+  if (rho.empty()) {
+    rho.push_back(density);
+    mom.push_back(0.0);
+    ene.push_back(energy);
+    inv_dx.push_back(0.0);
+    interior.push_back(0.0);
+  }
+  Pipe pipe;
+  pipe.begin = int(rho.size());
+  pipe.cells = g.cells;
+  pipe.dx = g.length / g.cells;
+  pipe.area = 0.25 * constants::PI * g.diameter * g.diameter;
+  pipe.level = 0;
+  for (int i = 0; i <= g.cells; i++) {
+    bool cell = i < g.cells;
+    rho.push_back(density);
+    mom.push_back(0.0);
+    ene.push_back(energy);
+    inv_dx.push_back(cell ? 1.0 / pipe.dx : 0.0);
+    interior.push_back(cell && i > 0 && i < g.cells - 1 ? 1.0 : 0.0);
+  }
+  pipes.push_back(pipe);
+
+  size_t n = rho.size();
+  u.resize(n);
+  p.resize(n);
+  c.resize(n);
+  l_rho.resize(n);
+  l_u.resize(n);
+  l_p.resize(n);
+  r_rho.resize(n);
+  r_u.resize(n);
+  r_p.resize(n);
+  f_rho.resize(n + 1);
+  f_mom.resize(n + 1);
+  f_ene.resize(n + 1);
+  primitives(0, int(n), gamma, rho.data(), mom.data(), ene.data(), u.data(),
+             p.data(), c.data());
+  return int(pipes.size()) - 1;
+}
+
+template <typename T>
+void BasicPipeNetwork<T>::connect(int pipe, PipeEnd end, int node) {
+  End &e = pipes.at(pipe).end[int(end)];
+  e.kind = EndKind::NODE;
+  e.node = node;
+}
+
+template <typename T>
+void BasicPipeNetwork<T>::setRestriction(int pipe, PipeEnd end,
+                                         T pa_per_kg_s,
+                                         double downstream_pressure) {
+  End &e = pipes.at(pipe).end[int(end)];
+  e.kind = EndKind::RESTRICTION;
+  e.restriction = pa_per_kg_s;
+  e.downstream_pressure = downstream_pressure;
+}
+
+template <typename T>
+void BasicPipeNetwork<T>::reset(T pressure, T temperature) {
+  T density = pressure / (constants::R * temperature);
+  T energy = pressure / (gamma - 1.0);
+  for (size_t i = 0; i < rho.size(); i++) {
+    rho[i] = density;
+    mom[i] = 0.0;
+    ene[i] = energy;
+  }
+  primitives(0, int(rho.size()), gamma, rho.data(), mom.data(), ene.data(),
+             u.data(), p.data(), c.data());
+  for (Node &node : nodes) {
+    node.mass = density * node.volume;
+    node.energy = energy * node.volume;
+    refreshNode(node);
+  }
+}
+
+template <typename T>
+void BasicPipeNetwork<T>::setMassFlow(int pipe, PipeEnd end, T kg_s,
+                                      T temperature) {
+  End &e = pipes[pipe].end[int(end)];
+  e.mass_flow = kg_s;
+  e.temperature = temperature;
+}
+
+template <typename T>
+void BasicPipeNetwork<T>::setNodeInflow(int node, T kg_s, T temperature) {
+  nodes[node].inflow = kg_s;
+  nodes[node].inflow_temperature = temperature;
+}
+
+template <typename T>
+void BasicPipeNetwork<T>::clampNodePressure(int index, T min_pressure,
+                                            T max_pressure) {
+  Node &node = nodes[index];
+  T scale = ad::clamp(node.pressure, min_pressure, max_pressure) /
+            node.pressure;
+  node.mass *= scale;
+  node.energy *= scale;
+  refreshNode(node);
+}
+
+// --------------------------------------------------
+// PIPE NETWORK STEP
+// --------------------------------------------------
+
+template <typename T> void BasicPipeNetwork<T>::step(double dt) {
+  if (dt <= 0.0 || pipes.empty())
+    return;
+
+  // Each pipe's level from its fastest wave
+  primitives(0, int(rho.size()), gamma, rho.data(), mom.data(), ene.data(),
+             u.data(), p.data(), c.data());
+  int finest = 0;
+  for (Pipe &pipe : pipes) {
+    double speed = 0.0;
+    for (int i = pipe.begin; i < pipe.begin + pipe.cells; i++)
+      speed = std::max(speed,
+                       std::fabs(ad::value(u[i])) + ad::value(c[i]));
+    double ratio = dt * speed / (cfl * pipe.dx);
+    pipe.level = 0;
+    while (double(1 << pipe.level) < ratio && pipe.level < kMaxLevel)
+      pipe.level++;
+    finest = std::max(finest, pipe.level);
+    for (End &e : pipe.end)
+      e.flow = e.enthalpy_flow = e.flow_sum = 0.0;
+  }
+  substeps = 1 << finest;
+  step_dt = dt;
+  const double h = dt / substeps;
+
+  for (int s = 0; s < substeps; s++) {
+    // Runs of neighbouring pipes on the same level share kernel calls
+    for (int first = 0; first < int(pipes.size());) {
+      int level = pipes[first].level;
+      int last = first;
+      while (last + 1 < int(pipes.size()) && pipes[last + 1].level == level)
+        last++;
+      int stride = 1 << (finest - level);
+      if (s % stride == 0) {
+        advance(first, last, h * stride);
+        for (int k = first; k <= last; k++)
+          for (End &e : pipes[k].end)
+            e.flow_sum += e.flow * (h * stride);
+      }
+      first = last + 1;
+    }
+    updateNodes(h);
+  }
+}
+
+template <typename T>
+void BasicPipeNetwork<T>::advance(int first, int last, double h) {
+  const int begin = pipes[first].begin;
+  const int end = pipes[last].begin + pipes[last].cells;
+  primitives(begin, end, gamma, rho.data(), mom.data(), ene.data(), u.data(),
+             p.data(), c.data());
+  faceStates(begin, end, h, gamma, interior.data(), inv_dx.data(),
+             rho.data(), u.data(), p.data(), l_rho.data(), l_u.data(),
+             l_p.data(), r_rho.data(), r_u.data(), r_p.data());
+  faceFluxes(begin + 1, end, gamma, c.data(), l_rho.data(), l_u.data(),
+             l_p.data(), r_rho.data(), r_u.data(), r_p.data(), f_rho.data(),
+             f_mom.data(), f_ene.data());
+  for (int k = first; k <= last; k++)
+    boundaryFluxes(pipes[k]);
+  updateCells(begin, end, h, inv_dx.data(), f_rho.data(), f_mom.data(),
+              f_ene.data(), rho.data(), mom.data(), ene.data());
+}
+
+// Flux into a pipe end from a node, from the node's stagnation state and
+// the Riemann invariant w - 2c / (gamma - 1) the end cell sends towards
+// it (w is the velocity into the pipe). Gas entering the pipe expands
+// isentropically from the node; gas leaving it arrives at the node's
+// pressure with its own entropy.
+template <typename T>
+static Flux<T> nodeFlux(T rho0, T p0, T c0, T rho_i, T u_i, T p_i, T c_i,
+                        double inward, double gamma) {
+  const double g1 = gamma - 1.0;
+  T invariant = inward * u_i - 2.0 * c_i / g1;
+
+  // Inflow: c² + (g1 / 2) w² = c0² on the invariant
+  double a = 1.0 + 2.0 / g1;
+  T b = 2.0 * invariant;
+  T k = 0.5 * g1 * invariant * invariant - c0 * c0;
+  T c = (-b + ad::sqrt(ad::max(b * b - 4.0 * a * k, 0.0))) / (2.0 * a);
+  T w = invariant + 2.0 * c / g1;
+  T rho_b, p_b;
+  if (w > 0.0) {
+    rho_b = rho0 * ad::pow(c / c0, 2.0 / g1);
+    p_b = rho_b * c * c / gamma;
+  } else {
+    p_b = p0;
+    rho_b = rho_i * ad::pow(p0 / p_i, 1.0 / gamma);
+    w = ad::min(invariant + 2.0 * ad::sqrt(gamma * p_b / rho_b) / g1, 0.0);
+  }
+  T u_b = inward * w;
+  T m = rho_b * u_b;
+  return {m, m * u_b + p_b, u_b * (p_b / g1 + 0.5 * m * u_b + p_b)};
+}
+
+// Fluxes through both end faces of a pipe, written over whatever the
+// interior kernel left there, from the end cells' state at the start of
+// the step
+template <typename T>
+void BasicPipeNetwork<T>::boundaryFluxes(Pipe &pipe) {
+  const double cp = gamma * constants::R / (gamma - 1.0);
+  for (int side = 0; side < 2; side++) {
+    End &e = pipe.end[side];
+    int cell = side == 0 ? pipe.begin : pipe.begin + pipe.cells - 1;
+    int face = side == 0 ? pipe.begin : pipe.begin + pipe.cells;
+    double inward = side == 0 ? 1.0 : -1.0; // +x into the pipe
+    Flux<T> f;
+
+    if (e.kind == EndKind::NODE) {
+      const Node &node = nodes[e.node];
+      f = nodeFlux(node.density, node.pressure, node.sound_speed, rho[cell],
+                   u[cell], p[cell], c[cell], inward, gamma);
+    } else {
+      // Prescribed mass flow; inflow at the end cell's pressure and the
+      // given stagnation temperature, outflow with the cell's own state
+      T in = e.mass_flow;
+      if (e.kind == EndKind::RESTRICTION)
+        in = -ad::max(p[cell] - e.downstream_pressure, 0.0) / e.restriction;
+      T flux = inward * in / pipe.area; // kg/(m² s), +x
+      T density = in > 0.0 ? p[cell] / (constants::R * e.temperature)
+                           : rho[cell];
+      T enthalpy = in > 0.0 ? cp * e.temperature
+                            : (ene[cell] + p[cell]) / rho[cell];
+      f = {flux, flux * flux / density + p[cell], flux * enthalpy};
+    }
+
+    f_rho[face] = f.mass;
+    f_mom[face] = f.momentum;
+    f_ene[face] = f.energy;
+    e.flow = inward * f.mass * pipe.area;
+    e.enthalpy_flow = inward * f.energy * pipe.area;
+  }
+}
+
+template <typename T> void BasicPipeNetwork<T>::updateNodes(double h) {
+  const double cp = gamma * constants::R / (gamma - 1.0);
+  for (Node &node : nodes) {
+    node.mass += node.inflow * h;
+    node.energy += node.inflow * cp * node.inflow_temperature * h;
+  }
+  for (const Pipe &pipe : pipes)
+    for (const End &e : pipe.end)
+      if (e.kind == EndKind::NODE) {
+        nodes[e.node].mass -= e.flow * h;
+        nodes[e.node].energy -= e.enthalpy_flow * h;
+      }
+  for (Node &node : nodes) {
+    node.mass = ad::max(node.mass, 1e-9 * node.volume);
+    node.energy = ad::max(node.energy, kMinPressure * node.volume /
+                                           (gamma - 1.0));
+    refreshNode(node);
+  }
+}
+
+template <typename T> void BasicPipeNetwork<T>::refreshNode(Node &node) const {
+  node.density = node.mass / node.volume;
+  node.pressure = (gamma - 1.0) * node.energy / node.volume;
+  node.sound_speed = ad::sqrt(gamma * node.pressure / node.density);
+}
+
+// --------------------------------------------------
+// PIPE NETWORK QUERIES
+// --------------------------------------------------
+
+template <typename T> T BasicPipeNetwork<T>::cellPressure(int i) const {
+  return ad::max((gamma - 1.0) * (ene[i] - 0.5 * mom[i] * mom[i] / rho[i]),
+                 kMinPressure);
+}
+
+template <typename T>
+T BasicPipeNetwork<T>::getPressure(int pipe, PipeEnd end) const {
+  const Pipe &p = pipes[pipe];
+  return cellPressure(end == PipeEnd::INLET ? p.begin
+                                            : p.begin + p.cells - 1);
+}
+
+template <typename T>
+T BasicPipeNetwork<T>::getTemperature(int pipe, PipeEnd end) const {
+  const Pipe &p = pipes[pipe];
+  int i = end == PipeEnd::INLET ? p.begin : p.begin + p.cells - 1;
+  return cellPressure(i) / (constants::R * rho[i]);
+}
+
+template <typename T>
+T BasicPipeNetwork<T>::getFlow(int pipe, PipeEnd end) const {
+  const End &e = pipes[pipe].end[int(end)];
+  return step_dt > 0.0 ? e.flow_sum / step_dt : e.flow;
+}
+
+template <typename T> T BasicPipeNetwork<T>::getNodePressure(int node) const {
+  return nodes[node].pressure;
+}
+
+template <typename T>
+T BasicPipeNetwork<T>::getNodeTemperature(int node) const {
+  const Node &n = nodes[node];
+  return n.pressure / (constants::R * n.density);
+}
+
+template <typename T> int BasicPipeNetwork<T>::cellCount() const {
+  int n = 0;
+  for (const Pipe &pipe : pipes)
+    n += pipe.cells;
+  return n;
+}
+
+// --------------------------------------------------
+// ENGINE RUNNERS
+// --------------------------------------------------
+
+template <typename T>
+BasicGasDynamics<T>::BasicGasDynamics(const GasDynamicsParams &p,
+                                      double plenum_volume,
+                                      T intake_pressure,
+                                      T intake_temperature,
+                                      T exhaust_pressure,
+                                      T exhaust_temperature)
+    : params(p), exhaust(constants::gamma_exhaust, p.cfl),
+      intake(constants::gamma, p.cfl) {
+  // Runner k belongs to the k-th cylinder in firing order
+  int junction = exhaust.addNode(p.collector_volume, exhaust_pressure,
+                                 exhaust_temperature);
+  for (int k = 0; k < kCylinders; k++) {
+    int runner = exhaust.addPipe(p.exhaust_runner, exhaust_pressure,
+                                 exhaust_temperature);
+    exhaust.connect(runner, PipeEnd::OUTLET, junction);
+  }
+  collector = exhaust.addPipe(p.exhaust_collector, exhaust_pressure,
+                              exhaust_temperature);
+  exhaust.connect(collector, PipeEnd::INLET, junction);
+  exhaust.setRestriction(collector, PipeEnd::OUTLET, T(1.0),
+                         constants::ambient_pressure);
+
+  plenum = intake.addNode(plenum_volume, intake_pressure, intake_temperature);
+  for (int k = 0; k < kCylinders; k++) {
+    int runner =
+        intake.addPipe(p.intake_runner, intake_pressure, intake_temperature);
+    intake.connect(runner, PipeEnd::INLET, plenum);
+  }
+}
+
+template <typename T>
+double BasicGasDynamics<T>::valveWeights(double open_deg, double close_deg,
+                                         double *w) const {
+  double sum = 0.0;
+  for (int k = 0; k < kCylinders; k++) {
+    double angle = crank_deg + k * (720.0 / kCylinders);
+    double x = std::fmod(angle - open_deg + 1440.0, 720.0) /
+               (close_deg - open_deg);
+    w[k] = x < 1.0 ? std::sin(constants::PI * x) : 0.0;
+    sum += w[k];
+  }
+  return sum;
+}
+
+template <typename T>
+T BasicGasDynamics<T>::valvePressure(const BasicPipeNetwork<T> &network,
+                                     PipeEnd end, double open_deg,
+                                     double close_deg) const {
+  double w[kCylinders];
+  double sum = valveWeights(open_deg, close_deg, w);
+  T pressure = 0.0;
+  for (int k = 0; k < kCylinders; k++)
+    pressure += network.getPressure(k, end) *
+                (sum > 0.0 ? w[k] / sum : 1.0 / kCylinders);
+  return pressure;
+}
+
+template <typename T>
+void BasicGasDynamics<T>::step(double dt, T angular_velocity, T exhaust_flow,
+                               T exhaust_temperature, T throttle_flow,
+                               T intake_temperature, T air_flow,
+                               T turbine_restriction) {
+  if (!enabled() || dt <= 0.0)
+    return;
+
+  double w[kCylinders];
+  double sum = valveWeights(params.exhaust_open_deg, params.exhaust_close_deg,
+                            w);
+  for (int k = 0; k < kCylinders; k++)
+    exhaust.setMassFlow(k, PipeEnd::INLET,
+                        exhaust_flow * (sum > 0.0 ? w[k] / sum : 0.0),
+                        exhaust_temperature);
+  exhaust.setRestriction(collector, PipeEnd::OUTLET, turbine_restriction,
+                         constants::ambient_pressure);
+
+  sum = valveWeights(params.intake_open_deg, params.intake_close_deg, w);
+  for (int k = 0; k < kCylinders; k++)
+    intake.setMassFlow(k, PipeEnd::OUTLET,
+                       -air_flow * (sum > 0.0 ? w[k] / sum : 0.0),
+                       intake_temperature);
+  intake.setNodeInflow(plenum, throttle_flow, intake_temperature);
+
+  exhaust.step(dt);
+  intake.step(dt);
+
+  crank_deg = std::fmod(crank_deg + ad::value(angular_velocity) * dt *
+                                        (180.0 / constants::PI),
+                        720.0);
+}
+
+template <typename T>
+void BasicGasDynamics<T>::setPlenumPressure(T pressure) {
+  if (enabled())
+    intake.reset(pressure, intake.getNodeTemperature(plenum));
+}
+
+template <typename T>
+void BasicGasDynamics<T>::clampPlenumPressure(T min_pressure,
+                                              T max_pressure) {
+  if (enabled())
+    intake.clampNodePressure(plenum, min_pressure, max_pressure);
+}
+
+template <typename T> T BasicGasDynamics<T>::getIntakeValvePressure() const {
+  return valvePressure(intake, PipeEnd::OUTLET, params.intake_open_deg,
+                       params.intake_close_deg);
+}
+
+template <typename T> T BasicGasDynamics<T>::getExhaustValvePressure() const {
+  return valvePressure(exhaust, PipeEnd::INLET, params.exhaust_open_deg,
+                       params.exhaust_close_deg);
+}
+
+template <typename T> T BasicGasDynamics<T>::getPlenumPressure() const {
+  return intake.getNodePressure(plenum);
+}
+
+template <typename T> T BasicGasDynamics<T>::getTurbineInletPressure() const {
+  return exhaust.getPressure(collector, PipeEnd::OUTLET);
+}
+
+template <typename T>
+T BasicGasDynamics<T>::getTurbineInletTemperature() const {
+  return exhaust.getTemperature(collector, PipeEnd::OUTLET);
+}
+
+template <typename T> T BasicGasDynamics<T>::getTurbineMassFlow() const {
+  return -exhaust.getFlow(collector, PipeEnd::OUTLET);
+}
+
+template <typename T> int BasicGasDynamics<T>::cellCount() const {
+  return exhaust.cellCount() + intake.cellCount();
+}
+
+template <typename T> int BasicGasDynamics<T>::getSubsteps() const {
+  return std::max(exhaust.getSubsteps(), intake.getSubsteps());
+}
+
+template class BasicPipeNetwork<double>;
+template class BasicPipeNetwork<ad::ModelDual>;
+template class BasicGasDynamics<double>;
+template class BasicGasDynamics<ad::ModelDual>;
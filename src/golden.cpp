@@ -0,0 +1,451 @@
+#include "../include/golden.hpp"
+#include "../include/ice_engine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+static const double kUnchecked = std::numeric_limits<double>::infinity();
+
+// --------------------------------------------------
+// REFERENCE SCENARIOS
+// --------------------------------------------------
+
+static GoldenScenario makeScenario(const std::string &name, int iterations,
+                                   std::vector<ThrottlePoint> throttle,
+                                   double initial_soc = -1.0) {
+  GoldenScenario g;
+  g.scenario.name = name;
+  g.scenario.iterations = iterations;
+  g.scenario.throttle = std::move(throttle);
+  g.initial_soc = initial_soc;
+  return g;
+}
+
+const std::vector<GoldenScenario> &goldenScenarios() {
+  static const std::vector<GoldenScenario> scenarios = {
+      // The default run: 0.3 to full throttle in 70 ms, 10 s
+      makeScenario("ramp", 100000, {{0.0, 0.3}, {0.07, 1.0}}),
+      // Part-throttle cruise, full-throttle step, then a lift to closed
+      makeScenario("tip_in_lift_off", 40000,
+                   {{0.0, 0.15}, {1.0, 0.15}, {1.0, 1.0}, {2.5, 1.0},
+                    {2.5, 0.0}}),
+      // Closed throttle: the ECU's idle control holds the speed
+      makeScenario("idle_hold", 30000, {{0.0, 0.0}}),
+      // The ramp with an empty battery, so the MGU-K cannot deploy
+      makeScenario("ers_depleted", 50000, {{0.0, 0.3}, {0.07, 1.0}}, 0.0),
+  };
+  return scenarios;
+}
+
+const GoldenScenario &findGoldenScenario(const std::string &name) {
+  for (const GoldenScenario &g : goldenScenarios())
+    if (g.scenario.name == name)
+      return g;
+  throw std::invalid_argument("unknown golden scenario '" + name + "'");
+}
+
+GoldenRun runGoldenScenario(const GoldenScenario &g, int repeat) {
+  const Scenario &s = g.scenario;
+  GoldenRun run;
+  run.steps = s.iterations;
+  run.seconds = kUnchecked;
+
+  TelemetryTrace &trace = run.trace;
+  trace.dt = s.dt;
+  trace.coding = TelemetryCoding::EXACT;
+  trace.channels = telemetryChannelNames();
+  int rows = (s.iterations + g.log_interval - 1) / g.log_interval;
+  trace.time.reserve(rows);
+  trace.values.assign(kTelemetryChannels, std::vector<double>());
+  for (std::vector<double> &column : trace.values)
+    column.reserve(rows);
+
+  double row[kTelemetryChannels];
+  for (int r = 0; r < std::max(repeat, 1); r++) {
+    ICEEngine engine;
+    if (g.initial_soc >= 0.0) {
+      PlantState state = engine.getPlantState();
+      state.battery_soc = g.initial_soc;
+      engine.setPlantState(state);
+    }
+    bool keep = r == 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < s.iterations; i++) {
+      engine.setThrottle(s.throttleAt(i * s.dt));
+      engine.update(s.dt);
+      if (keep && i % g.log_interval == 0) {
+        sampleTelemetry(engine, row);
+        trace.time.push_back(i * s.dt);
+        for (int c = 0; c < kTelemetryChannels; c++)
+          trace.values[c].push_back(row[c]);
+      }
+    }
+    std::chrono::duration<double> took =
+        std::chrono::steady_clock::now() - start;
+    run.seconds = std::min(run.seconds, took.count());
+  }
+  return run;
+}
+
+std::string goldenTracePath(const std::string &dir, const std::string &name) {
+  return dir + "/" + name + ".f1pz";
+}
+
+void writeGoldenTrace(const std::string &path, const TelemetryTrace &trace) {
+  CompressedTelemetryWriter out(path, trace.channels, trace.dt,
+                                TelemetryCoding::EXACT);
+  std::vector<double> row(trace.channels.size());
+  for (size_t i = 0; i < trace.time.size(); i++) {
+    for (size_t c = 0; c < row.size(); c++)
+      row[c] = trace.values[c][i];
+    out.write(std::llround(trace.time[i] / trace.dt), row.data());
+  }
+  out.close();
+}
+
+// --------------------------------------------------
+// TOLERANCES
+// --------------------------------------------------
+
+GoldenTolerances::GoldenTolerances()
+    : defaults{kUnchecked, kUnchecked, kUnchecked, kUnchecked},
+      channels(kTelemetryChannels, defaults) {}
+
+GoldenTolerances parseGoldenTolerances(const std::string &text) {
+  struct Entry {
+    int channel; // -1 for *
+    std::string key;
+    double value;
+  };
+  std::vector<Entry> entries;
+
+  std::istringstream lines(text);
+  std::string line;
+  int number = 0;
+  while (std::getline(lines, line)) {
+    number++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.resize(hash);
+    std::istringstream words(line);
+    std::string name, field;
+    if (!(words >> name))
+      continue;
+    std::string where = "line " + std::to_string(number) + ": ";
+    int channel = -1;
+    if (name != "*") {
+      channel = findTelemetryChannel(name);
+      if (channel < 0)
+        throw std::invalid_argument(where + "unknown channel '" + name +
+                                    "'");
+    }
+    while (words >> field) {
+      size_t eq = field.find('=');
+      std::string key = field.substr(0, eq);
+      if (eq == std::string::npos ||
+          (key != "abs" && key != "rel" && key != "rms" && key != "shift"))
+        throw std::invalid_argument(where + "expected abs=, rel=, rms= or " +
+                                    "shift=, got '" + field + "'");
+      std::string number_text = field.substr(eq + 1);
+      char *end = nullptr;
+      double value = std::strtod(number_text.c_str(), &end);
+      if (number_text.empty() || *end != '\0' || !(value >= 0.0))
+        throw std::invalid_argument(where + key +
+                                    " needs a non-negative number");
+      entries.push_back({channel, key, value});
+    }
+  }
+
+  auto apply = [](ChannelTolerance &t, const Entry &e) {
+    if (e.key == "abs")
+      t.max_abs = e.value;
+    else if (e.key == "rel")
+      t.max_rel = e.value;
+    else if (e.key == "rms")
+      t.rms = e.value;
+    else
+      t.event_shift = e.value;
+  };
+  GoldenTolerances tolerances;
+  for (const Entry &e : entries)
+    if (e.channel < 0)
+      apply(tolerances.defaults, e);
+  tolerances.channels.assign(kTelemetryChannels, tolerances.defaults);
+  for (const Entry &e : entries)
+    if (e.channel >= 0)
+      apply(tolerances.channels[e.channel], e);
+  return tolerances;
+}
+
+GoldenTolerances loadGoldenTolerances(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::invalid_argument("cannot open " + path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return parseGoldenTolerances(text.str());
+}
+
+// --------------------------------------------------
+// COMPARISON
+// --------------------------------------------------
+
+namespace {
+
+// Four independent accumulators per reduction, so the loops carry no
+// serial dependency and the compiler keeps them in vector registers
+constexpr int kLanes = 4;
+
+double peakMagnitude(const double *g, size_t n) {
+  double peak[kLanes] = {0.0, 0.0, 0.0, 0.0};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes)
+    for (int l = 0; l < kLanes; l++) {
+      double m = std::fabs(g[i + l]);
+      peak[l] = m > peak[l] ? m : peak[l];
+    }
+  for (; i < n; i++)
+    peak[0] = std::max(peak[0], std::fabs(g[i]));
+  return std::max(std::max(peak[0], peak[1]), std::max(peak[2], peak[3]));
+}
+
+// |a - g| with equal values (infinities included) and NaN against NaN
+// counting as no error, and NaN against a number as an infinite one
+inline double absoluteError(double a, double g) {
+  double d = a == g || (a != a && g != g) ? 0.0 : std::fabs(a - g);
+  return d == d ? d : kUnchecked;
+}
+
+struct Errors {
+  double max_abs, max_rel, sum_squares;
+};
+
+Errors errorsOf(const double *a, const double *g, size_t n, double floor) {
+  double max_abs[kLanes] = {}, max_rel[kLanes] = {}, squares[kLanes] = {};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes)
+    for (int l = 0; l < kLanes; l++) {
+      double d = absoluteError(a[i + l], g[i + l]);
+      double scale = std::fabs(g[i + l]);
+      double rel = d / (scale > floor ? scale : floor);
+      max_abs[l] = d > max_abs[l] ? d : max_abs[l];
+      max_rel[l] = rel > max_rel[l] ? rel : max_rel[l];
+      squares[l] += d * d;
+    }
+  for (; i < n; i++) {
+    double d = absoluteError(a[i], g[i]);
+    max_abs[0] = std::max(max_abs[0], d);
+    max_rel[0] = std::max(max_rel[0], d / std::max(std::fabs(g[i]), floor));
+    squares[0] += d * d;
+  }
+  Errors e{0.0, 0.0, 0.0};
+  for (int l = 0; l < kLanes; l++) {
+    e.max_abs = std::max(e.max_abs, max_abs[l]);
+    e.max_rel = std::max(e.max_rel, max_rel[l]);
+    e.sum_squares += squares[l];
+  }
+  return e;
+}
+
+// Times at which `v` crosses `level`, debounced by `band` either side so
+// that noise around the level is one crossing, interpolated between the
+// two rows either side of the level
+std::vector<double> crossings(const std::vector<double> &time,
+                              const double *v, size_t n, double level,
+                              double band) {
+  std::vector<double> times;
+  int side = 0;    // -1 below level - band, +1 above level + band
+  size_t last = 0; // last row on the far side of the level
+  for (size_t i = 0; i < n; i++) {
+    if (!(v[i] == v[i]))
+      continue;
+    if (side <= 0 && v[i] <= level)
+      last = i;
+    if (side >= 0 && v[i] >= level)
+      last = i;
+    int now = v[i] > level + band ? 1 : v[i] < level - band ? -1 : 0;
+    if (now == 0 || now == side)
+      continue;
+    if (side != 0 && last + 1 < n) {
+      double a = v[last], b = v[last + 1];
+      double f = b != a ? (level - a) / (b - a) : 0.0;
+      f = std::min(std::max(f, 0.0), 1.0);
+      times.push_back(time[last] + f * (time[last + 1] - time[last]));
+    }
+    side = now;
+    last = i;
+  }
+  return times;
+}
+
+} // namespace
+
+std::vector<ChannelDiff> compareTraces(const TelemetryTrace &golden,
+                                       const TelemetryTrace &candidate,
+                                       const GoldenTolerances &tolerances) {
+  size_t n = golden.time.size();
+  if (candidate.time.size() != n)
+    throw std::runtime_error("trace has " +
+                             std::to_string(candidate.time.size()) +
+                             " rows, golden has " + std::to_string(n));
+  for (size_t i = 0; i < n; i++)
+    if (std::fabs(candidate.time[i] - golden.time[i]) > 1e-9)
+      throw std::runtime_error("row times differ from the golden trace at " +
+                               std::to_string(golden.time[i]) + " s");
+
+  std::vector<ChannelDiff> diffs;
+  for (size_t c = 0; c < golden.channels.size(); c++) {
+    const std::string &name = golden.channels[c];
+    auto found = std::find(candidate.channels.begin(),
+                           candidate.channels.end(), name);
+    if (found == candidate.channels.end())
+      throw std::runtime_error("channel " + name + " missing from the run");
+    const double *g = golden.values[c].data();
+    const double *a = candidate.values[found - candidate.channels.begin()]
+                          .data();
+
+    ChannelDiff d;
+    d.channel = name;
+    double peak = peakMagnitude(g, n);
+    Errors e = errorsOf(a, g, n, std::max(1e-3 * peak, DBL_MIN));
+    d.max_abs = e.max_abs;
+    d.max_rel = e.max_rel;
+    d.rms = n ? std::sqrt(e.sum_squares / double(n)) : 0.0;
+    if (d.max_abs > 0.0)
+      for (size_t i = 0; i < n; i++)
+        if (absoluteError(a[i], g[i]) == d.max_abs) {
+          d.max_abs_time = golden.time[i];
+          break;
+        }
+
+    double lo = kUnchecked, hi = -kUnchecked;
+    for (size_t i = 0; i < n; i++)
+      if (std::isfinite(g[i])) {
+        lo = std::min(lo, g[i]);
+        hi = std::max(hi, g[i]);
+      }
+    if (hi > lo) {
+      for (double fraction : {0.25, 0.5, 0.75}) {
+        double level = lo + fraction * (hi - lo);
+        double band = 0.01 * (hi - lo);
+        std::vector<double> want = crossings(golden.time, g, n, level, band);
+        std::vector<double> got =
+            crossings(golden.time, a, n, level, band);
+        d.events += int(want.size());
+        if (got.size() != want.size()) {
+          d.event_shift = kUnchecked;
+          continue;
+        }
+        for (size_t k = 0; k < want.size(); k++)
+          d.event_shift = std::max(d.event_shift, std::fabs(got[k] - want[k]));
+      }
+    }
+
+    int channel = findTelemetryChannel(name);
+    ChannelTolerance t =
+        channel >= 0 ? tolerances.of(channel) : tolerances.defaults;
+    d.pass = d.max_abs <= t.max_abs && d.max_rel <= t.max_rel &&
+             d.rms <= t.rms && d.event_shift <= t.event_shift;
+    diffs.push_back(d);
+  }
+  return diffs;
+}
+
+GoldenResult checkGoldenScenario(const GoldenScenario &scenario,
+                                 const std::string &dir,
+                                 const GoldenTolerances &tolerances,
+                                 int repeat) {
+  GoldenResult result;
+  result.scenario = scenario.scenario.name;
+  result.simulated = scenario.scenario.duration();
+  try {
+    GoldenRun run = runGoldenScenario(scenario, repeat);
+    result.steps = run.steps;
+    result.seconds = run.seconds;
+    TelemetryTrace golden = readCompressedTelemetry(
+        goldenTracePath(dir, scenario.scenario.name));
+    result.channels = compareTraces(golden, run.trace, tolerances);
+    result.pass = std::all_of(result.channels.begin(), result.channels.end(),
+                              [](const ChannelDiff &d) { return d.pass; });
+  } catch (const std::exception &e) {
+    result.error = e.what();
+    result.pass = false;
+  }
+  return result;
+}
+
+// --------------------------------------------------
+// REPORT
+// --------------------------------------------------
+
+static std::string jsonNumber(double v) {
+  if (!std::isfinite(v))
+    return "null";
+  char text[32];
+  std::snprintf(text, sizeof text, "%.9g", v);
+  return text;
+}
+
+static std::string jsonString(const std::string &s) {
+  std::string out = "\"";
+  for (char ch : s) {
+    if (ch == '"' || ch == '\\')
+      out += '\\';
+    out += ch == '\n' ? ' ' : ch;
+  }
+  return out + "\"";
+}
+
+void writeGoldenReport(const std::string &path,
+                       const std::vector<GoldenResult> &results) {
+  bool pass = std::all_of(results.begin(), results.end(),
+                          [](const GoldenResult &r) { return r.pass; });
+  std::string out = "{\n";
+  out += std::string("  \"pass\": ") + (pass ? "true" : "false") + ",\n";
+  out += "  \"scenarios\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const GoldenResult &r = results[i];
+    out += std::string(i ? "," : "") + "\n    {\"name\": " +
+           jsonString(r.scenario) + ", \"pass\": " +
+           (r.pass ? "true" : "false") + ", \"error\": " +
+           (r.error.empty() ? "null" : jsonString(r.error)) + ",\n";
+    out += "     \"steps\": " + std::to_string(r.steps) +
+           ", \"seconds\": " + jsonNumber(r.seconds) +
+           ", \"steps_per_second\": " + jsonNumber(r.stepsPerSecond()) +
+           ", \"realtime_factor\": " +
+           jsonNumber(r.seconds > 0 ? r.simulated / r.seconds : NAN) + ",\n";
+    out += "     \"failed_channels\": [";
+    bool first = true;
+    for (const ChannelDiff &d : r.channels)
+      if (!d.pass) {
+        out += (first ? "" : ", ") + jsonString(d.channel);
+        first = false;
+      }
+    out += "],\n     \"channels\": {";
+    for (size_t c = 0; c < r.channels.size(); c++) {
+      const ChannelDiff &d = r.channels[c];
+      out += std::string(c ? "," : "") + "\n       " +
+             jsonString(d.channel) + ": {\"max_abs\": " +
+             jsonNumber(d.max_abs) + ", \"max_abs_time\": " +
+             jsonNumber(d.max_abs_time) + ", \"max_rel\": " +
+             jsonNumber(d.max_rel) + ", \"rms\": " + jsonNumber(d.rms) +
+             ", \"event_shift\": " + jsonNumber(d.event_shift) +
+             ", \"events\": " + std::to_string(d.events) +
+             ", \"pass\": " + (d.pass ? "true" : "false") + "}";
+    }
+    out += r.channels.empty() ? "}}" : "\n     }}";
+  }
+  out += results.empty() ? "]\n}\n" : "\n  ]\n}\n";
+
+  std::ofstream f(path);
+  f << out;
+  if (!f)
+    throw std::runtime_error("cannot write " + path);
+}
@@ -1,24 +1,29 @@
 #include "../include/ice_engine.hpp"
 #include "../include/constants.hpp"
-#include <algorithm>
+#include "../include/dual.hpp"
 #include <cmath>
 
-ICEEngine::ICEEngine()
-    : angular_velocity(constants::engine_idle_rad_s), throttle(0.0),
+template <typename T>
+BasicICEEngine<T>::BasicICEEngine(const BasicEngineParams<T> &p)
+    : params(p),
+      turbo(constants::turbo_inertia, p.turbine_efficiency,
+            p.compressor_efficiency, constants::turbo_bearing_loss),
+      mguh(constants::mguh_inertia, constants::mguh_efficiency,
+           constants::mguh_max_power),
+      mguk(constants::mguk_efficiency, constants::mguk_max_power),
+      battery(constants::battery_max_energy_J,
+              constants::battery_max_charge_power,
+              constants::battery_max_discharge_power),
+      angular_velocity(constants::engine_idle_rad_s), throttle(0.0),
       effective_throttle(0.0), torque_output(0.0),
       intake_manifold_pressure(constants::ambient_pressure),
-      intake_manifold_temperature(constants::ambient_temperature),
       exhaust_manifold_pressure(constants::ambient_pressure),
-      exhaust_manifold_temperature(900.0),
+      intake_manifold_temperature(constants::ambient_temperature),
+      exhaust_manifold_temperature(900.0), external_load_torque(0.0),
       plenum_pressure(constants::ambient_pressure), spark_advance_deg(10.0),
-      turbo(2e-5, 0.72, 0.74, 0.02), mguh(2e-6, 0.95, 120000.0),
-      battery(constants::battery_max_energy_J,
-              constants::battery_max_charge_power,
-              constants::battery_max_discharge_power),
-      mguk(constants::mguk_efficiency, constants::mguk_max_power),
-      mguk_torque(0.0), combustion_torque(0.0), friction_torque(0.0),
-      pumping_torque(0.0), indicated_torque(0.0), net_torque(0.0),
-      exhaust_mass_flow_rate(0.0), na_air_flow(0.0), actual_air_flow(0.0),
+      exhaust_mass_flow_rate(0.0), mguk_torque(0.0), combustion_torque(0.0),
+      friction_torque(0.0), pumping_torque(0.0), indicated_torque(0.0),
+      net_torque(0.0), na_air_flow(0.0), actual_air_flow(0.0),
       fuel_mass_flow(0.0), volumetric_efficiency(0.0), imep(0.0), fmep(0.0),
       bmep(0.0) {}
 
@@ -26,23 +31,88 @@ ICEEngine::ICEEngine()
 // BASIC SETTERS/GETTERS
 // --------------------------------------------------
 
-void ICEEngine::setThrottle(double t) { throttle = std::clamp(t, 0.0, 1.0); }
+template <typename T> void BasicICEEngine<T>::setThrottle(T t) {
+  throttle = ad::clamp(t, 0.0, 1.0);
+}
+
+template <typename T> void BasicICEEngine<T>::setExternalLoadTorque(T nm) {
+  external_load_torque = nm;
+}
+
+template <typename T> T BasicICEEngine<T>::getExternalLoadTorque() const {
+  return external_load_torque;
+}
+
+template <typename T>
+const BasicEngineParams<T> &BasicICEEngine<T>::getParams() const {
+  return params;
+}
+
+template <typename T>
+void BasicICEEngine<T>::setTurboMaps(std::shared_ptr<const TurboMaps> maps) {
+  turbo.setMaps(std::move(maps));
+}
+
+template <typename T>
+BasicPlantState<T> BasicICEEngine<T>::getPlantState() const {
+  return {angular_velocity, intake_manifold_pressure,
+          turbo.getShaftAngularSpeed(), battery.getSOC()};
+}
+
+template <typename T>
+void BasicICEEngine<T>::setPlantState(const BasicPlantState<T> &state) {
+  angular_velocity = state.angular_velocity;
+  intake_manifold_pressure = state.intake_manifold_pressure;
+  turbo.setShaftAngularSpeed(state.turbo_speed);
+  battery.setSOC(state.battery_soc);
+  gas.setPlenumPressure(state.intake_manifold_pressure);
+}
+
+template <typename T>
+BasicLaggedState<T> BasicICEEngine<T>::getLaggedState() const {
+  return {combustion_torque, exhaust_mass_flow_rate,
+          turbo.getCompressorOutletPressure(),
+          turbo.getAvailableAirMassFlow()};
+}
+
+template <typename T>
+void BasicICEEngine<T>::setLaggedState(const BasicLaggedState<T> &state) {
+  combustion_torque = state.combustion_torque;
+  exhaust_mass_flow_rate = state.exhaust_mass_flow;
+  turbo.setCompressorOutletPressure(state.boost_pressure);
+  turbo.setAvailableAirMassFlow(state.turbo_air_flow);
+}
 
-double ICEEngine::getRPM() const {
+template <typename T>
+void BasicICEEngine<T>::resumeControl(const BasicEcuCommands<T> &commands,
+                                      long step, double dt) {
+  ecu.resume(commands, step, dt);
+  effective_throttle = commands.throttle;
+}
+
+template <typename T> BasicEcu<T> &BasicICEEngine<T>::getEcu() { return ecu; }
+
+template <typename T> const BasicEcu<T> &BasicICEEngine<T>::getEcu() const {
+  return ecu;
+}
+
+template <typename T> T BasicICEEngine<T>::getRPM() const {
   return angular_velocity * 60.0 / (2.0 * constants::PI);
 }
 
-double ICEEngine::getAngularVelocity() const { return angular_velocity; }
+template <typename T> T BasicICEEngine<T>::getAngularVelocity() const {
+  return angular_velocity;
+}
 
-double ICEEngine::getTorqueOutput() const {
+template <typename T> T BasicICEEngine<T>::getTorqueOutput() const {
   return combustion_torque + mguk_torque;
 }
 
-double ICEEngine::getNetPower() const {
+template <typename T> T BasicICEEngine<T>::getNetPower() const {
   return (combustion_torque + mguk_torque) * angular_velocity;
 }
 
-double ICEEngine::getExhaustMassFlowRate() const {
+template <typename T> T BasicICEEngine<T>::getExhaustMassFlowRate() const {
   return exhaust_mass_flow_rate;
 }
 
@@ -50,36 +120,57 @@ double ICEEngine::getExhaustMassFlowRate() const {
 // ENGINE / CRANK GETTERS
 // --------------------------------------------------
 
-double ICEEngine::getCombustionTorque() const { return combustion_torque; }
+template <typename T> T BasicICEEngine<T>::getCombustionTorque() const {
+  return combustion_torque;
+}
 
-double ICEEngine::getLoadTorque() const {
+template <typename T> T BasicICEEngine<T>::getLoadTorque() const {
   return constants::load_A + constants::load_B * angular_velocity +
-         constants::load_C * angular_velocity * angular_velocity;
+         constants::load_C * angular_velocity * angular_velocity +
+         external_load_torque;
 }
 
-double ICEEngine::getFrictionTorque() const { return friction_torque; }
+template <typename T> T BasicICEEngine<T>::getFrictionTorque() const {
+  return friction_torque;
+}
 
-double ICEEngine::getPumpingTorque() const { return pumping_torque; }
+template <typename T> T BasicICEEngine<T>::getPumpingTorque() const {
+  return pumping_torque;
+}
 
-double ICEEngine::getIndicatedTorque() const { return indicated_torque; }
+template <typename T> T BasicICEEngine<T>::getIndicatedTorque() const {
+  return indicated_torque;
+}
 
-double ICEEngine::getNetTorque() const { return net_torque; }
+template <typename T> T BasicICEEngine<T>::getNetTorque() const {
+  return net_torque;
+}
 
 // --------------------------------------------------
 // THROTTLE / AIRFLOW GETTERS
 // --------------------------------------------------
 
-double ICEEngine::getThrottle() const { return throttle; }
+template <typename T> T BasicICEEngine<T>::getThrottle() const {
+  return throttle;
+}
 
-double ICEEngine::getEffectiveThrottle() const { return effective_throttle; }
+template <typename T> T BasicICEEngine<T>::getEffectiveThrottle() const {
+  return effective_throttle;
+}
 
-double ICEEngine::getNAAirFlow() const { return na_air_flow; }
+template <typename T> T BasicICEEngine<T>::getNAAirFlow() const {
+  return na_air_flow;
+}
 
-double ICEEngine::getActualAirFlow() const { return actual_air_flow; }
+template <typename T> T BasicICEEngine<T>::getActualAirFlow() const {
+  return actual_air_flow;
+}
 
-double ICEEngine::getFuelMassFlow() const { return fuel_mass_flow; }
+template <typename T> T BasicICEEngine<T>::getFuelMassFlow() const {
+  return fuel_mass_flow;
+}
 
-double ICEEngine::getVolumetricEfficiency() const {
+template <typename T> T BasicICEEngine<T>::getVolumetricEfficiency() const {
   return volumetric_efficiency;
 }
 
@@ -87,31 +178,37 @@ double ICEEngine::getVolumetricEfficiency() const {
 // TURBO / INTAKE GETTERS
 // --------------------------------------------------
 
-double ICEEngine::getTurboSpeed() const { return turbo.getShaftAngularSpeed(); }
+template <typename T> T BasicICEEngine<T>::getTurboSpeed() const {
+  return turbo.getShaftAngularSpeed();
+}
 
-double ICEEngine::getTurboSpeedRPM() const {
+template <typename T> T BasicICEEngine<T>::getTurboSpeedRPM() const {
   return turbo.getShaftAngularSpeed() * 60.0 / (2.0 * constants::PI);
 }
 
-double ICEEngine::getBoostPressure() const {
+template <typename T> T BasicICEEngine<T>::getBoostPressure() const {
   return turbo.getCompressorOutletPressure();
 }
 
-double ICEEngine::getPlenumPressure() const { return plenum_pressure; }
+template <typename T> T BasicICEEngine<T>::getPlenumPressure() const {
+  return plenum_pressure;
+}
 
-double ICEEngine::getIntakeManifoldPressure() const {
+template <typename T> T BasicICEEngine<T>::getIntakeManifoldPressure() const {
   return intake_manifold_pressure;
 }
 
-double ICEEngine::getIntakeManifoldTemperature() const {
+template <typename T>
+T BasicICEEngine<T>::getIntakeManifoldTemperature() const {
   return intake_manifold_temperature;
 }
 
-double ICEEngine::getAirMassFlow() const {
+template <typename T> T BasicICEEngine<T>::getAirMassFlow() const {
   return turbo.getAvailableAirMassFlow();
 }
 
-double ICEEngine::getCompressorOutletTemperature() const {
+template <typename T>
+T BasicICEEngine<T>::getCompressorOutletTemperature() const {
   return turbo.getCompressorOutletTemperature();
 }
 
@@ -119,73 +216,109 @@ double ICEEngine::getCompressorOutletTemperature() const {
 // EXHAUST GETTERS
 // --------------------------------------------------
 
-double ICEEngine::getExhaustManifoldPressure() const {
+template <typename T> T BasicICEEngine<T>::getExhaustManifoldPressure() const {
   return exhaust_manifold_pressure;
 }
 
-double ICEEngine::getExhaustTemperature() const {
+template <typename T> T BasicICEEngine<T>::getExhaustTemperature() const {
   return exhaust_manifold_temperature;
 }
 
+template <typename T>
+void BasicICEEngine<T>::setGasDynamics(const GasDynamicsParams &p) {
+  gas = BasicGasDynamics<T>(p, constants::intake_manifold_volume,
+                            intake_manifold_pressure,
+                            intake_manifold_temperature,
+                            exhaust_manifold_pressure,
+                            exhaust_manifold_temperature);
+}
+
+template <typename T>
+const BasicGasDynamics<T> *BasicICEEngine<T>::getGasDynamics() const {
+  return gas.enabled() ? &gas : nullptr;
+}
+
 // --------------------------------------------------
 // ERS GETTERS
 // --------------------------------------------------
 
-double ICEEngine::getMGUHTorque() const { return mguh.getTorque(); }
+template <typename T> T BasicICEEngine<T>::getMGUHTorque() const {
+  return mguh.getTorque();
+}
+
+template <typename T> T BasicICEEngine<T>::getMGUHPower() const {
+  return mguh.getElectricalPower();
+}
+
+template <typename T> T BasicICEEngine<T>::getMGUKTorque() const {
+  return mguk.getTorque();
+}
 
-double ICEEngine::getMGUHPower() const { return mguh.getElectricalPower(); }
+template <typename T> T BasicICEEngine<T>::getMGUKPower() const {
+  return mguk.getElectricalPower();
+}
 
-double ICEEngine::getMGUKTorque() const { return mguk.getTorque(); }
+template <typename T> T BasicICEEngine<T>::getBatteryEnergy() const {
+  return battery.getEnergy();
+}
 
-double ICEEngine::getMGUKPower() const { return mguk.getElectricalPower(); }
+template <typename T> T BasicICEEngine<T>::getBatterySOC() const {
+  return battery.getSOC();
+}
 
-double ICEEngine::getBatteryEnergy() const { return battery.getEnergy(); }
+template <typename T>
+void BasicICEEngine<T>::setBatteryPack(const BatteryPackParams &params) {
+  battery.setPack(params);
+}
 
-double ICEEngine::getBatterySOC() const { return battery.getSOC(); }
+template <typename T>
+const BasicBatteryPack<T> *BasicICEEngine<T>::getBatteryPack() const {
+  return battery.getPack();
+}
 
 // --------------------------------------------------
 // PERFORMANCE METRICS GETTERS
 // --------------------------------------------------
 
-double ICEEngine::getBMEP() const { return bmep; }
+template <typename T> T BasicICEEngine<T>::getBMEP() const { return bmep; }
 
-double ICEEngine::getIMEP() const { return imep; }
+template <typename T> T BasicICEEngine<T>::getIMEP() const { return imep; }
 
-double ICEEngine::getFMEP() const { return fmep; }
+template <typename T> T BasicICEEngine<T>::getFMEP() const { return fmep; }
 
-double ICEEngine::getBSFC() const {
+template <typename T> T BasicICEEngine<T>::getBSFC() const {
   // Brake Specific Fuel Consumption (g/kWh)
-  double brake_power = combustion_torque * angular_velocity;
+  T brake_power = combustion_torque * angular_velocity;
   if (brake_power <= 0.0)
     return 0.0;
   // fuel_mass_flow is in kg/s, convert to g/h and divide by kW
   return (fuel_mass_flow * 1000.0 * 3600.0) / (brake_power / 1000.0);
 }
 
-double ICEEngine::getThermalEfficiency() const {
+template <typename T> T BasicICEEngine<T>::getThermalEfficiency() const {
   // Thermal efficiency = Brake power / Fuel energy input
-  double fuel_power = fuel_mass_flow * constants::LHV_fuel;
+  T fuel_power = fuel_mass_flow * constants::LHV_fuel;
   if (fuel_power <= 0.0)
     return 0.0;
-  double brake_power = combustion_torque * angular_velocity;
+  T brake_power = combustion_torque * angular_velocity;
   return brake_power / fuel_power;
 }
 
-double ICEEngine::getMechanicalEfficiency() const {
+template <typename T> T BasicICEEngine<T>::getMechanicalEfficiency() const {
   // Mechanical efficiency = Brake power / Indicated power
-  double indicated_power = indicated_torque * angular_velocity;
+  T indicated_power = indicated_torque * angular_velocity;
   if (indicated_power <= 0.0)
     return 0.0;
-  double brake_power = combustion_torque * angular_velocity;
+  T brake_power = combustion_torque * angular_velocity;
   return brake_power / indicated_power;
 }
 
-double ICEEngine::getTotalPower() const {
+template <typename T> T BasicICEEngine<T>::getTotalPower() const {
   // ICE + MGU-K combined power
   return (combustion_torque + mguk_torque) * angular_velocity;
 }
 
-double ICEEngine::getICEPower() const {
+template <typename T> T BasicICEEngine<T>::getICEPower() const {
   // Pure ICE brake power
   return combustion_torque * angular_velocity;
 }
@@ -194,115 +327,126 @@ double ICEEngine::getICEPower() const {
 // THROTTLE MASS FLOW
 // --------------------------------------------------
 
-double ICEEngine::getThrottleAirMassFlow(double throttle_cmd,
-                                         double P_down) const {
-  double P_up = plenum_pressure;
-  double T_up = turbo.getCompressorOutletTemperature();
+template <typename T>
+T BasicICEEngine<T>::getThrottleAirMassFlow(T throttle_cmd, T P_down) const {
+  T P_up = plenum_pressure;
+  T T_up = turbo.getCompressorOutletTemperature();
 
-  double area = throttle_cmd * throttle_cmd * constants::throttle_area;
+  T area = throttle_cmd * throttle_cmd * constants::throttle_area;
   if (area <= 0.0 || P_down >= P_up)
     return 0.0;
 
-  double pr = std::clamp(P_down / P_up, 0.0, 1.0);
+  T pr = ad::clamp(P_down / P_up, 0.0, 1.0);
 
   double crit_pr = std::pow(2.0 / (constants::gamma + 1.0),
                             constants::gamma / (constants::gamma - 1.0));
 
-  double base = constants::discharge_coefficient * area * P_up *
-                std::sqrt(constants::gamma / (constants::R * T_up));
+  T base = constants::discharge_coefficient * area * P_up *
+                ad::sqrt(constants::gamma / (constants::R * T_up));
 
   if (pr <= crit_pr) {
-    double choked =
-        std::pow(2.0 / (constants::gamma + 1.0),
+    T choked =
+        ad::pow(2.0 / (constants::gamma + 1.0),
                  (constants::gamma + 1.0) / (2.0 * (constants::gamma - 1.0)));
     return base * choked;
   }
 
-  double term = (2.0 / (constants::gamma - 1.0)) *
-                (std::pow(pr, 2.0 / constants::gamma) -
-                 std::pow(pr, (constants::gamma + 1.0) / constants::gamma));
+  T term = (2.0 / (constants::gamma - 1.0)) *
+                (ad::pow(pr, 2.0 / constants::gamma) -
+                 ad::pow(pr, (constants::gamma + 1.0) / constants::gamma));
 
-  return term > 0.0 ? base * std::sqrt(term) : 0.0;
+  return term > 0.0 ? base * ad::sqrt(term) : 0.0;
 }
 
 // --------------------------------------------------
 // MAIN UPDATE
 // --------------------------------------------------
 
-void ICEEngine::update(double dt) {
+template <typename T> void BasicICEEngine<T>::update(double dt) {
+  battery.beginStep(dt);
 
   /* ============================================================
-     IDLE THROTTLE CONTROL (physical: airflow, not torque)
+     ECU (idle control, boost and deployment at the control rate)
      ============================================================ */
-  double idle_error = constants::engine_idle_rad_s - angular_velocity;
-  // Only add throttle if we are below idle speed
-  double idle_contribution =
-      std::max(0.0, constants::idle_throttle_gain * idle_error);
-  effective_throttle = std::clamp(throttle + idle_contribution, 0.0, 1.0);
+  const BasicEcuCommands<T> &cmd =
+      ecu.step({throttle, angular_velocity, turbo.getCompressorOutletPressure(),
+                turbo.getShaftAngularSpeed(), battery.getSOC()},
+               dt);
+  effective_throttle = cmd.throttle;
 
   /* ============================================================
      BASIC SPEED / CYCLE INFO
      ============================================================ */
-  double rpm = std::max(getRPM(), 1.0);
-  double cycles_per_sec = rpm / 120.0; // 4-stroke
+  T rpm = ad::max(getRPM(), 1.0);
+  T cycles_per_sec = rpm / 120.0; // 4-stroke
 
   /* ============================================================
        EXHAUST DYNAMICS
        ============================================================ */
   // Update exhaust temperature based on engine power
-  double engine_power_output =
-      std::max(0.0, combustion_torque * angular_velocity);
+  T engine_power_output =
+      ad::max(0.0, combustion_torque * angular_velocity);
   exhaust_manifold_temperature =
-      constants::exhaust_temp_base +
-      constants::exhaust_temp_gain * engine_power_output;
+      params.exhaust_temp_base +
+      params.exhaust_temp_gain * engine_power_output;
   exhaust_manifold_temperature =
-      std::clamp(exhaust_manifold_temperature, 400.0, 1273.0);
+      ad::clamp(exhaust_manifold_temperature, 400.0,
+                constants::exhaust_temp_max);
 
   // Update exhaust pressure (backpressure increases with mass flow)
   // Higher backpressure drives the turbine but increases pumping losses
-  double k_turbine = 1.6e6;
-  double target_exh_press =
-      constants::ambient_pressure + (exhaust_mass_flow_rate * k_turbine);
+  T target_exh_press = constants::ambient_pressure +
+                       (exhaust_mass_flow_rate * params.k_turbine);
   exhaust_manifold_pressure +=
       (target_exh_press - exhaust_manifold_pressure) * 10.0 * dt;
 
   /* ============================================================
-     TURBO + MGU-H CONTROL (PID-like behavior)
+     TURBO + MGU-H
      ============================================================ */
-  double target_boost = 4.0 * constants::ambient_pressure;
-  double boost_error = target_boost - turbo.getCompressorOutletPressure();
-
-  if (effective_throttle > 0.5) {
-    if (boost_error > 0) {
-      mguh.setMode(MGUHMode::MOTOR);
-      // Use more aggressive power to overcome compressor drag at high RPM
-      mguh.setRequestedPower(constants::mguk_max_power * throttle);
-    } else {
-      mguh.setMode(MGUHMode::GENERATOR);
-      mguh.setRequestedPower(std::min(120000.0, -boost_error * 0.2));
-    }
+  mguh.setMode(cmd.mguh_mode);
+  if (battery.getPack()) {
+    // The MGU-H draws from and charges the pack like the MGU-K
+    T limit = cmd.mguh_mode == MGUHMode::GENERATOR
+                  ? battery.getAvailableChargePower()
+                  : battery.getAvailableDischargePower();
+    mguh.setRequestedPower(ad::min(cmd.mguh_power, limit));
+  } else {
+    mguh.setRequestedPower(cmd.mguh_power);
   }
-
   mguh.update(dt, turbo.getShaftAngularSpeed());
+  if (battery.getPack()) {
+    T power = mguh.getElectricalPower(); // > 0 generating
+    battery.charge(power * dt);
+    battery.discharge(-power * dt);
+  }
 
-  // Exhaust pressure increases with mass flow (turbine restriction)
-  double turbine_restriction = 1.5e6;
-  exhaust_manifold_pressure = constants::ambient_pressure +
-                              (exhaust_mass_flow_rate * turbine_restriction);
+  T turbine_flow = exhaust_mass_flow_rate;
+  T turbine_temperature = exhaust_manifold_temperature;
+  if (gas.enabled()) {
+    // Turbine inlet of the pipe model, as the last step left it
+    exhaust_manifold_pressure = gas.getTurbineInletPressure();
+    turbine_flow = gas.getTurbineMassFlow();
+    turbine_temperature = gas.getTurbineInletTemperature();
+  } else {
+    // Exhaust pressure increases with mass flow (turbine restriction)
+    exhaust_manifold_pressure =
+        constants::ambient_pressure +
+        (exhaust_mass_flow_rate * params.turbine_restriction);
+  }
 
   // Update plenum pressure from turbo compressor
   plenum_pressure = turbo.getCompressorOutletPressure();
 
-  turbo.update(dt, exhaust_mass_flow_rate, exhaust_manifold_pressure,
-               exhaust_manifold_temperature, target_boost, mguh.getTorque());
+  turbo.update(dt, turbine_flow, exhaust_manifold_pressure,
+               turbine_temperature, cmd.target_boost, mguh.getTorque());
 
   /* ============================================================
      INTAKE AIRFLOW (WITH INTERCOOLER)
      ============================================================ */
-  double intercooler_eff = 0.85;
-  double t_comp = turbo.getCompressorOutletTemperature();
+  T t_comp = turbo.getCompressorOutletTemperature();
   intake_manifold_temperature =
-      t_comp - intercooler_eff * (t_comp - constants::ambient_temperature);
+      t_comp -
+      params.intercooler_eff * (t_comp - constants::ambient_temperature);
 
   // Naturally aspirated airflow through throttle
   // Airflow through throttle from plenum to manifold
@@ -312,25 +456,31 @@ void ICEEngine::update(double dt) {
   // Calculate Volumetric Efficiency based on current RPM
   volumetric_efficiency =
       constants::volumetric_efficiency_max *
-      std::exp(-std::pow(
-          (rpm - constants::volumetric_efficiency_peak_rpm) / 12500.0, 2));
+      ad::exp(-ad::pow(
+          (rpm - params.volumetric_efficiency_peak_rpm) / 12500.0, 2));
+
+  // With runners, the cylinders breathe at their open intake valves
+  T valve_pressure = gas.enabled() ? gas.getIntakeValvePressure()
+                                   : intake_manifold_pressure;
 
   // The engine "swallows" air based on displacement and manifold state
   actual_air_flow = (constants::NUM_CYLINDERS * constants::Volume_displacement *
                      cycles_per_sec) *
-                    (intake_manifold_pressure /
+                    (valve_pressure /
                      (constants::R * intake_manifold_temperature)) *
                     volumetric_efficiency;
 
   // Manifold pressure changes based on (Throttle Flow In - Engine Consumption
-  // Out)
-  intake_manifold_pressure += (constants::R * intake_manifold_temperature /
-                               constants::intake_manifold_volume) *
-                              (na_air_flow - actual_air_flow) * dt;
-
-  intake_manifold_pressure =
-      std::clamp(intake_manifold_pressure, 0.3 * constants::ambient_pressure,
-                 turbo.getCompressorOutletPressure());
+  // Out); the pipe model integrates its plenum itself
+  if (!gas.enabled()) {
+    intake_manifold_pressure += (constants::R * intake_manifold_temperature /
+                                 constants::intake_manifold_volume) *
+                                (na_air_flow - actual_air_flow) * dt;
+
+    intake_manifold_pressure =
+        ad::clamp(intake_manifold_pressure, 0.3 * constants::ambient_pressure,
+                  turbo.getCompressorOutletPressure());
+  }
 
   /* ============================================================
      FUEL FLOW (DIRECTLY COUPLED TO AIRFLOW)
@@ -338,23 +488,23 @@ void ICEEngine::update(double dt) {
   fuel_mass_flow =
       actual_air_flow / (constants::AFR_stoich * constants::lambda);
 
-  double fuel_mass_per_cycle =
+  T fuel_mass_per_cycle =
       fuel_mass_flow / (cycles_per_sec * constants::NUM_CYLINDERS);
 
   /* ============================================================
      COMBUSTION & INDICATED TORQUE
      ============================================================ */
-  double chemical_energy = fuel_mass_per_cycle * constants::LHV_fuel;
+  T chemical_energy = fuel_mass_per_cycle * constants::LHV_fuel;
 
-  double thermal_energy = chemical_energy * constants::combustion_efficiency;
+  T thermal_energy = chemical_energy * constants::combustion_efficiency;
 
-  double CA50 =
+  T CA50 =
       360.0 - spark_advance_deg + 0.5 * constants::crank_angle_burn_duration;
 
-  double phasing_eff = std::exp(
-      -std::pow((CA50 - constants::CA50_opt) / constants::CA50_sigma, 2.0));
+  T phasing_eff = ad::exp(
+      -ad::pow((CA50 - constants::CA50_opt) / constants::CA50_sigma, 2.0));
 
-  double indicated_work =
+  T indicated_work =
       thermal_energy * constants::thermal_efficiency * phasing_eff;
 
   imep = indicated_work / constants::Volume_displacement;
@@ -365,19 +515,23 @@ void ICEEngine::update(double dt) {
   /* ============================================================
      LOSSES (FRICTION + PUMPING)
      ============================================================ */
-  double rpm_krpm = rpm / 1000.0;
+  T rpm_krpm = rpm / 1000.0;
 
-  fmep = constants::fmepA + constants::fmepB * rpm_krpm +
-         constants::fmepC * rpm_krpm * rpm_krpm + constants::fmepD * imep;
+  fmep = params.fmepA + params.fmepB * rpm_krpm +
+         params.fmepC * rpm_krpm * rpm_krpm + params.fmepD * imep;
 
   friction_torque = fmep * constants::Volume_displacement /
                     (constants::PI * 4.0) * constants::NUM_CYLINDERS;
 
-  double pumping_pressure =
-      std::max(exhaust_manifold_pressure - intake_manifold_pressure, 0.0);
+  T exhaust_valve_pressure = gas.enabled() ? gas.getExhaustValvePressure()
+                                           : exhaust_manifold_pressure;
+  T intake_valve_pressure =
+      gas.enabled() ? valve_pressure : intake_manifold_pressure;
+  T pumping_pressure =
+      ad::max(exhaust_valve_pressure - intake_valve_pressure, 0.0);
 
   pumping_pressure =
-      std::min(pumping_pressure, 0.15 * constants::ambient_pressure);
+      ad::min(pumping_pressure, 0.15 * constants::ambient_pressure);
 
   pumping_torque = pumping_pressure * constants::Volume_displacement /
                    (constants::PI * 4.0) * constants::NUM_CYLINDERS;
@@ -396,24 +550,32 @@ void ICEEngine::update(double dt) {
      ============================================================ */
   exhaust_mass_flow_rate = actual_air_flow + fuel_mass_flow;
 
+  if (gas.enabled()) {
+    gas.step(dt, angular_velocity, exhaust_mass_flow_rate,
+             exhaust_manifold_temperature, na_air_flow,
+             intake_manifold_temperature, actual_air_flow,
+             params.turbine_restriction);
+    gas.clampPlenumPressure(0.3 * constants::ambient_pressure,
+                            turbo.getCompressorOutletPressure());
+    intake_manifold_pressure = gas.getPlenumPressure();
+  }
+
   /* ============================================================
      MGU-K
      ============================================================ */
-  if (effective_throttle > 0.1) {
-    mguk.setMode(MGUKMode::MOTOR);
-    mguk.setRequestedPower(constants::mguk_max_power * effective_throttle);
-  } else {
-    mguk.setMode(MGUKMode::IDLE);
-  }
+  mguk.setMode(cmd.mguk_mode);
+  mguk.setRequestedPower(cmd.mguk_power);
   mguk.update(dt, angular_velocity, battery);
   mguk_torque = mguk.getTorque();
+  battery.endStep();
 
   /* ============================================================
      CRANKSHAFT DYNAMICS
      ============================================================ */
-  double load_torque = constants::load_A +
+  T load_torque = constants::load_A +
                        constants::load_B * angular_velocity +
-                       constants::load_C * angular_velocity * angular_velocity;
+                       constants::load_C * angular_velocity * angular_velocity +
+                       external_load_torque;
 
   net_torque = combustion_torque - load_torque + mguk_torque;
 
@@ -421,7 +583,10 @@ void ICEEngine::update(double dt) {
   if (angular_velocity < 10.0)
     angular_velocity = 10.0; // safety lower bound only
 
-  angular_velocity = std::max(angular_velocity, constants::engine_idle_rad_s);
+  angular_velocity = ad::max(angular_velocity, constants::engine_idle_rad_s);
 
   torque_output = combustion_torque;
 }
+
+template class BasicICEEngine<double>;
+template class BasicICEEngine<ad::ModelDual>;
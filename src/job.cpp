@@ -0,0 +1,264 @@
+#include "../include/job.hpp"
+#include "../include/ice_engine.hpp"
+#include "../include/sensitivity.hpp"
+#include "../include/telemetry.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+// --------------------------------------------------
+// TEXT FORM
+// --------------------------------------------------
+
+static double parseNumber(const std::string &key, const std::string &text) {
+  size_t used = 0;
+  double v = 0.0;
+  try {
+    v = std::stod(text, &used);
+  } catch (const std::exception &) {
+    used = 0;
+  }
+  if (used == 0 || used != text.size())
+    throw std::invalid_argument("bad value for " + key + ": '" + text + "'");
+  return v;
+}
+
+static std::vector<std::string> splitList(const std::string &text) {
+  std::vector<std::string> items;
+  std::string item;
+  std::istringstream in(text);
+  while (std::getline(in, item, ','))
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+static bool isOutputName(const std::string &name) {
+  for (const char *n : RunOutputs::names)
+    if (name == n)
+      return true;
+  for (const TelemetryChannel &c : telemetryChannels)
+    if (name == c.name)
+      return true;
+  return false;
+}
+
+SimulationJob parseJob(const std::string &text) {
+  SimulationJob job;
+  std::istringstream words(text);
+  std::string field;
+
+  while (words >> field) {
+    size_t eq = field.find('=');
+    if (eq == std::string::npos)
+      throw std::invalid_argument("expected key=value, got '" + field + "'");
+    std::string key = field.substr(0, eq);
+    std::string value = field.substr(eq + 1);
+
+    if (key == "dt") {
+      job.scenario.dt = parseNumber(key, value);
+      if (!(job.scenario.dt > 0.0))
+        throw std::invalid_argument("dt must be positive");
+    } else if (key == "iterations") {
+      double n = parseNumber(key, value);
+      if (n < 1 || n > 1e9 || n != double(int(n)))
+        throw std::invalid_argument("bad iteration count: " + value);
+      job.scenario.iterations = int(n);
+    } else if (key == "throttle") {
+      std::vector<std::string> points = splitList(value);
+      if (points.empty())
+        throw std::invalid_argument("bad value for " + key + ": '" + value +
+                                    "'");
+      job.scenario.throttle.clear();
+      for (const std::string &point : points) {
+        size_t colon = point.find(':');
+        if (colon == std::string::npos)
+          throw std::invalid_argument("throttle points are time:value");
+        job.scenario.throttle.push_back(
+            {parseNumber(key, point.substr(0, colon)),
+             parseNumber(key, point.substr(colon + 1))});
+      }
+    } else if (key == "ecu_period") {
+      job.control_period = parseNumber(key, value);
+      if (!(job.control_period > 0.0))
+        throw std::invalid_argument("bad value for " + key + ": '" + value +
+                                    "'");
+    } else if (key == "turbo_map") {
+      job.turbo_map = value;
+    } else if (key == "outputs") {
+      job.outputs = splitList(value);
+      for (const std::string &name : job.outputs)
+        if (!isOutputName(name))
+          throw std::invalid_argument("unknown output: " + name);
+    } else if (double *param = findParameter(job.params, key)) {
+      *param = parseNumber(key, value);
+    } else {
+      throw std::invalid_argument("unknown job field: " + key);
+    }
+  }
+  return job;
+}
+
+static void appendNumber(std::string &out, double v) {
+  char buf[32];
+  std::snprintf(buf, sizeof buf, "%.17g", v);
+  out += buf;
+}
+
+std::string canonicalJob(const SimulationJob &job) {
+  std::string out = "dt=";
+  appendNumber(out, job.scenario.dt);
+  out += " iterations=" + std::to_string(job.scenario.iterations);
+
+  out += " throttle=";
+  for (size_t i = 0; i < job.scenario.throttle.size(); i++) {
+    if (i > 0)
+      out += ',';
+    appendNumber(out, job.scenario.throttle[i].time);
+    out += ':';
+    appendNumber(out, job.scenario.throttle[i].throttle);
+  }
+
+  out += " ecu_period=";
+  appendNumber(out, job.control_period);
+  if (!job.turbo_map.empty())
+    out += " turbo_map=" + job.turbo_map;
+
+  out += " outputs=";
+  std::vector<std::string> outputs = jobOutputs(job);
+  for (size_t i = 0; i < outputs.size(); i++)
+    out += (i > 0 ? "," : "") + outputs[i];
+
+  forEachParameter(job.params, [&](const char *name, const double &v) {
+    out += ' ';
+    out += name;
+    out += '=';
+    appendNumber(out, v);
+  });
+  return out;
+}
+
+// --------------------------------------------------
+// CONTENT ADDRESS
+// --------------------------------------------------
+
+namespace {
+// FNV-1a, 128-bit variant
+class Fnv128 {
+public:
+  void add(const std::string &bytes) {
+    for (unsigned char c : bytes) {
+      state ^= c;
+      state *= kPrime;
+    }
+  }
+
+  std::string hex() const {
+    char buf[33];
+    std::snprintf(buf, sizeof buf, "%016llx%016llx",
+                  (unsigned long long)(state >> 64),
+                  (unsigned long long)state);
+    return buf;
+  }
+
+private:
+  static constexpr unsigned __int128 kPrime =
+      (unsigned __int128)1 << 88 | 0x13b;
+  unsigned __int128 state = (unsigned __int128)0x6c62272e07bb0142ULL << 64 |
+                            0x62b821756295c58dULL;
+};
+} // namespace
+
+std::string jobKey(const SimulationJob &job) {
+  // The map is addressed by content, so the path itself is left out
+  SimulationJob addressed = job;
+  addressed.turbo_map.clear();
+
+  Fnv128 h;
+  h.add("f1-pu model " + std::to_string(kModelVersion) + "\n");
+  h.add(canonicalJob(addressed));
+  if (!job.turbo_map.empty()) {
+    std::ifstream in(job.turbo_map, std::ios::binary);
+    if (!in)
+      throw std::invalid_argument("cannot open turbo map " + job.turbo_map);
+    h.add("\nturbo_map\n");
+    h.add(std::string(std::istreambuf_iterator<char>(in), {}));
+  }
+  return h.hex();
+}
+
+// --------------------------------------------------
+// RUNNING
+// --------------------------------------------------
+
+std::vector<std::string> jobOutputs(const SimulationJob &job) {
+  if (!job.outputs.empty())
+    return job.outputs;
+  return std::vector<std::string>(RunOutputs::names,
+                                  RunOutputs::names + RunOutputs::count);
+}
+
+void JobRun::start(const SimulationJob &spec, ICEEngine &engine,
+                   std::shared_ptr<const TurboMaps> maps) {
+  job = &spec;
+  step = 0;
+  energy = 0.0;
+  fuel = 0.0;
+
+  engine.getEcu().setControlPeriod(spec.control_period);
+  if (!maps && !spec.turbo_map.empty())
+    maps = std::make_shared<TurboMaps>(TurboMaps::load(spec.turbo_map));
+  if (maps)
+    engine.setTurboMaps(maps);
+  peak_boost = engine.getBoostPressure();
+}
+
+bool JobRun::advance(ICEEngine &engine, int steps) {
+  const Scenario &s = job->scenario;
+  int end = std::min(s.iterations, step + steps);
+  for (; step < end; step++) {
+    engine.setThrottle(s.throttleAt(step * s.dt));
+    engine.update(s.dt);
+
+    energy += engine.getTotalPower() * s.dt;
+    fuel += engine.getFuelMassFlow() * s.dt;
+    peak_boost = std::max(peak_boost, engine.getBoostPressure());
+  }
+  return done();
+}
+
+std::vector<double> JobRun::outputs(const ICEEngine &engine) const {
+  // Same order as RunOutputs::names
+  const double run_outputs[RunOutputs::count] = {
+      energy, fuel, peak_boost, engine.getRPM(), engine.getBatterySOC()};
+
+  std::vector<double> values;
+  for (const std::string &name : jobOutputs(*job)) {
+    const char *const *run =
+        std::find(RunOutputs::names, RunOutputs::names + RunOutputs::count,
+                  name);
+    if (run != RunOutputs::names + RunOutputs::count) {
+      values.push_back(run_outputs[run - RunOutputs::names]);
+      continue;
+    }
+    for (const TelemetryChannel &c : telemetryChannels)
+      if (name == c.name)
+        values.push_back(c.sample(engine));
+  }
+  return values;
+}
+
+std::vector<double> runJob(const SimulationJob &job,
+                           std::shared_ptr<const TurboMaps> maps,
+                           const std::atomic<bool> *cancel) {
+  ICEEngine engine(job.params);
+  JobRun run;
+  run.start(job, engine, maps);
+  do {
+    if (cancel && cancel->load(std::memory_order_relaxed))
+      throw JobCancelled();
+  } while (!run.advance(engine, 1024));
+  return run.outputs(engine);
+}
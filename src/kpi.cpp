@@ -0,0 +1,422 @@
+#include "../include/kpi.hpp"
+#include "../include/constants.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// --------------------------------------------------
+// DEFINITION
+// --------------------------------------------------
+
+static int channelNamed(const std::string &name, int line) {
+  int c = findTelemetryChannel(name);
+  if (c < 0)
+    throw std::invalid_argument("line " + std::to_string(line) +
+                                ": unknown channel '" + name + "'");
+  return c;
+}
+
+static double numberFrom(const std::string &word, int line) {
+  char *end = nullptr;
+  double v = std::strtod(word.c_str(), &end);
+  if (word.empty() || *end != '\0')
+    throw std::invalid_argument("line " + std::to_string(line) +
+                                ": expected a number, got '" + word + "'");
+  return v;
+}
+
+static double numberAt(std::istringstream &words, int line) {
+  std::string word;
+  words >> word;
+  return numberFrom(word, line);
+}
+
+static std::vector<double> edgesFrom(const std::vector<std::string> &words,
+                                     int line) {
+  std::vector<double> edges;
+  for (const std::string &w : words) {
+    double v = numberFrom(w, line);
+    if (!edges.empty() && !(v > edges.back()))
+      throw std::invalid_argument("line " + std::to_string(line) +
+                                  ": zone edges must be increasing numbers");
+    edges.push_back(v);
+  }
+  if (edges.size() < 2)
+    throw std::invalid_argument("line " + std::to_string(line) +
+                                ": a zone axis needs at least two edges");
+  return edges;
+}
+
+KpiSpec parseKpiSpec(const std::string &text) {
+  KpiSpec spec;
+  std::istringstream lines(text);
+  std::string line;
+  int number = 0;
+  while (std::getline(lines, line)) {
+    number++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.resize(hash);
+    std::istringstream words(line);
+    std::string kind, name;
+    if (!(words >> kind))
+      continue;
+
+    if (kind == "stats") {
+      while (words >> name)
+        spec.stats.push_back(channelNamed(name, number));
+    } else if (kind == "histogram") {
+      words >> name;
+      KpiSpec::Histogram h{channelNamed(name, number), 0.0, 0.0, 0};
+      h.lo = numberAt(words, number);
+      h.hi = numberAt(words, number);
+      double bins = numberAt(words, number);
+      if (!(h.hi > h.lo) || bins < 1 || bins > 1e6 ||
+          bins != std::floor(bins))
+        throw std::invalid_argument("line " + std::to_string(number) +
+                                    ": histogram needs lo < hi and bins");
+      h.bins = int(bins);
+      spec.histograms.push_back(h);
+    } else if (kind == "quantiles") {
+      words >> name;
+      KpiSpec::Quantiles q{channelNamed(name, number), {}};
+      std::string word;
+      while (words >> word) {
+        double p = numberFrom(word, number);
+        if (!(p > 0.0 && p < 1.0))
+          throw std::invalid_argument("line " + std::to_string(number) +
+                                      ": quantiles lie strictly in (0, 1)");
+        q.probabilities.push_back(p);
+      }
+      if (q.probabilities.empty())
+        throw std::invalid_argument("line " + std::to_string(number) +
+                                    ": no quantiles listed");
+      spec.quantiles.push_back(q);
+    } else if (kind == "zones") {
+      words >> name;
+      KpiSpec::Zones z;
+      z.channel = channelNamed(name, number);
+      std::vector<std::string> first, second;
+      std::string word, cross;
+      bool crossed = false;
+      while (words >> word) {
+        if (word == "x" && !crossed) {
+          crossed = true;
+          if (!(words >> cross))
+            throw std::invalid_argument("line " + std::to_string(number) +
+                                        ": channel expected after x");
+          z.cross_channel = channelNamed(cross, number);
+        } else {
+          (crossed ? second : first).push_back(word);
+        }
+      }
+      z.edges = edgesFrom(first, number);
+      if (crossed)
+        z.cross_edges = edgesFrom(second, number);
+      spec.zones.push_back(z);
+    } else {
+      throw std::invalid_argument("line " + std::to_string(number) +
+                                  ": unknown KPI '" + kind + "'");
+    }
+  }
+  return spec;
+}
+
+KpiSpec loadKpiSpec(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::invalid_argument("cannot open " + path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return parseKpiSpec(text.str());
+}
+
+KpiSpec defaultKpiSpec() {
+  return parseKpiSpec(
+      "stats rpm torque_output ice_power total_power boost_pressure\n"
+      "stats turbo_speed_rpm battery_soc thermal_efficiency\n"
+      "histogram boost_pressure 100000 400000 30\n"
+      "histogram rpm 0 15000 30\n"
+      "quantiles rpm 0.05 0.5 0.95\n"
+      "quantiles boost_pressure 0.5 0.9 0.99\n"
+      "zones rpm 0 4000 8000 10000 12000 15000 x throttle 0 0.25 0.5 "
+      "0.75 1.0001\n");
+}
+
+// --------------------------------------------------
+// QUANTILE SKETCH
+// --------------------------------------------------
+
+// Magnitudes below this count as zero
+static constexpr double kSketchMinMagnitude = 1e-12;
+
+QuantileSketch::QuantileSketch(double relative_accuracy)
+    : gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+      log_gamma(std::log(gamma)) {}
+
+int QuantileSketch::indexOf(double magnitude) const {
+  return int(std::ceil(std::log(magnitude) / log_gamma));
+}
+
+double QuantileSketch::valueOf(int index) const {
+  return 2.0 * std::pow(gamma, index) / (gamma + 1.0);
+}
+
+void QuantileSketch::Store::add(int index) {
+  if (counts.empty()) {
+    offset = index;
+    counts.push_back(0);
+  } else if (index < offset) {
+    counts.insert(counts.begin(), size_t(offset - index), 0);
+    offset = index;
+  } else if (index >= offset + int(counts.size())) {
+    counts.resize(size_t(index - offset) + 1, 0);
+  }
+  counts[size_t(index - offset)]++;
+}
+
+void QuantileSketch::add(double x) {
+  if (std::isnan(x))
+    return;
+  total++;
+  if (x > kSketchMinMagnitude)
+    positive.add(indexOf(x));
+  else if (x < -kSketchMinMagnitude)
+    negative.add(indexOf(-x));
+  else
+    zeros++;
+}
+
+double QuantileSketch::quantile(double p) const {
+  if (total == 0)
+    return NAN;
+  double rank = std::clamp(p, 0.0, 1.0) * double(total - 1);
+
+  // Ascending: negatives from the largest magnitude, zeros, positives
+  long seen = 0;
+  for (size_t i = negative.counts.size(); i-- > 0;) {
+    seen += negative.counts[i];
+    if (double(seen) > rank)
+      return -valueOf(negative.offset + int(i));
+  }
+  seen += zeros;
+  if (double(seen) > rank)
+    return 0.0;
+  for (size_t i = 0; i < positive.counts.size(); i++) {
+    seen += positive.counts[i];
+    if (double(seen) > rank)
+      return valueOf(positive.offset + int(i));
+  }
+  return valueOf(positive.offset + int(positive.counts.size()) - 1);
+}
+
+// --------------------------------------------------
+// AGGREGATOR
+// --------------------------------------------------
+
+KpiAggregator::KpiAggregator(const KpiSpec &spec) {
+  auto slotOf = [&](int channel) {
+    for (size_t s = 0; s < channels.size(); s++)
+      if (channels[s] == channel)
+        return int(s);
+    channels.push_back(channel);
+    return int(channels.size()) - 1;
+  };
+
+  for (int c : spec.stats)
+    stats.push_back({slotOf(c)});
+  for (const KpiSpec::Histogram &h : spec.histograms)
+    histograms.push_back(
+        {h, slotOf(h.channel), std::vector<double>(h.bins + 2, 0.0)});
+  for (const KpiSpec::Quantiles &q : spec.quantiles)
+    quantiles.push_back({slotOf(q.channel), q.probabilities, QuantileSketch()});
+  for (const KpiSpec::Zones &z : spec.zones) {
+    int cross_slot = z.cross_channel >= 0 ? slotOf(z.cross_channel) : -1;
+    size_t bands = z.edges.size() - 1;
+    size_t cross_bands = z.cross_channel >= 0 ? z.cross_edges.size() - 1 : 1;
+    zones.push_back({z, slotOf(z.channel), cross_slot,
+                     std::vector<double>(bands * cross_bands + 1, 0.0)});
+  }
+  values.resize(channels.size());
+}
+
+// Band index of v for increasing edges, or -1 outside them
+static int bandOf(const std::vector<double> &edges, double v) {
+  if (!(v >= edges.front()) || !(v < edges.back()))
+    return -1;
+  return int(std::upper_bound(edges.begin(), edges.end(), v) -
+             edges.begin()) -
+         1;
+}
+
+void KpiAggregator::begin(const ICEEngine &engine) {
+  battery_start = battery_end = engine.getBatteryEnergy();
+}
+
+void KpiAggregator::record(const ICEEngine &engine, double dt) {
+  for (size_t s = 0; s < channels.size(); s++)
+    values[s] = telemetryChannels[channels[s]].sample(engine);
+
+  for (Stats &st : stats) {
+    double v = values[st.slot];
+    if (st.count++ == 0)
+      st.min = st.max = v;
+    st.min = std::min(st.min, v);
+    st.max = std::max(st.max, v);
+    double delta = v - st.mean;
+    st.mean += delta / double(st.count);
+    st.m2 += delta * (v - st.mean);
+  }
+
+  for (Histogram &h : histograms) {
+    double v = values[h.slot];
+    int bin;
+    if (v < h.spec.lo)
+      bin = 0;
+    else if (v >= h.spec.hi)
+      bin = h.spec.bins + 1;
+    else
+      bin = 1 + std::min(int((v - h.spec.lo) / (h.spec.hi - h.spec.lo) *
+                             h.spec.bins),
+                         h.spec.bins - 1);
+    h.seconds[bin] += dt;
+  }
+
+  for (Quantiles &q : quantiles)
+    q.sketch.add(values[q.slot]);
+
+  for (Zones &z : zones) {
+    int band = bandOf(z.spec.edges, values[z.slot]);
+    int cross = z.cross_slot >= 0 ? bandOf(z.spec.cross_edges,
+                                           values[z.cross_slot])
+                                  : 0;
+    size_t cell = band < 0 || cross < 0
+                      ? z.seconds.size() - 1
+                      : size_t(cross) * (z.spec.edges.size() - 1) + band;
+    z.seconds[cell] += dt;
+  }
+
+  fuel_mass += engine.getFuelMassFlow() * dt;
+  ice_work += std::max(engine.getICEPower(), 0.0) * dt;
+  // Electrical power is positive into the battery (generating)
+  double k = engine.getMGUKPower(), h = engine.getMGUHPower();
+  (k < 0.0 ? mguk_deployed : mguk_harvested) += std::abs(k) * dt;
+  (h < 0.0 ? mguh_deployed : mguh_harvested) += std::abs(h) * dt;
+  battery_end = engine.getBatteryEnergy();
+
+  duration += dt;
+  steps++;
+}
+
+// --------------------------------------------------
+// SUMMARY
+// --------------------------------------------------
+
+static std::string jsonNumber(double v) {
+  if (!std::isfinite(v))
+    return "null";
+  char text[32];
+  std::snprintf(text, sizeof text, "%.9g", v);
+  return text;
+}
+
+static std::string jsonList(const std::vector<double> &values, size_t first,
+                            size_t count) {
+  std::string out = "[";
+  for (size_t i = 0; i < count; i++)
+    out += (i ? ", " : "") + jsonNumber(values[first + i]);
+  return out + "]";
+}
+
+void KpiAggregator::write(const std::string &path) const {
+  auto name = [&](int slot) {
+    return std::string("\"") + telemetryChannels[channels[slot]].name + "\"";
+  };
+  std::string out = "{\n";
+  out += "  \"duration_s\": " + jsonNumber(duration) + ",\n";
+  out += "  \"steps\": " + std::to_string(steps) + ",\n";
+
+  out += "  \"stats\": {";
+  for (size_t i = 0; i < stats.size(); i++) {
+    const Stats &st = stats[i];
+    double sd = st.count > 1 ? std::sqrt(st.m2 / double(st.count)) : 0.0;
+    out += std::string(i ? "," : "") + "\n    " + name(st.slot) +
+           ": {\"mean\": " + jsonNumber(st.mean) +
+           ", \"std\": " + jsonNumber(sd) + ", \"min\": " +
+           jsonNumber(st.min) + ", \"max\": " + jsonNumber(st.max) + "}";
+  }
+  out += stats.empty() ? "},\n" : "\n  },\n";
+
+  out += "  \"histograms\": [";
+  for (size_t i = 0; i < histograms.size(); i++) {
+    const Histogram &h = histograms[i];
+    out += std::string(i ? "," : "") + "\n    {\"channel\": " +
+           name(h.slot) + ", \"lo\": " + jsonNumber(h.spec.lo) +
+           ", \"hi\": " + jsonNumber(h.spec.hi) +
+           ", \"below_s\": " + jsonNumber(h.seconds.front()) +
+           ", \"above_s\": " + jsonNumber(h.seconds.back()) +
+           ",\n     \"seconds\": " +
+           jsonList(h.seconds, 1, size_t(h.spec.bins)) + "}";
+  }
+  out += histograms.empty() ? "],\n" : "\n  ],\n";
+
+  out += "  \"quantiles\": [";
+  for (size_t i = 0; i < quantiles.size(); i++) {
+    const Quantiles &q = quantiles[i];
+    out += std::string(i ? "," : "") + "\n    {\"channel\": " +
+           name(q.slot) + ", \"values\": {";
+    for (size_t j = 0; j < q.probabilities.size(); j++)
+      out += std::string(j ? ", " : "") + "\"" +
+             jsonNumber(q.probabilities[j]) +
+             "\": " + jsonNumber(q.sketch.quantile(q.probabilities[j]));
+    out += "}}";
+  }
+  out += quantiles.empty() ? "],\n" : "\n  ],\n";
+
+  out += "  \"zones\": [";
+  for (size_t i = 0; i < zones.size(); i++) {
+    const Zones &z = zones[i];
+    size_t bands = z.spec.edges.size() - 1;
+    out += std::string(i ? "," : "") + "\n    {\"channel\": " +
+           name(z.slot) + ", \"edges\": " +
+           jsonList(z.spec.edges, 0, z.spec.edges.size());
+    if (z.cross_slot >= 0)
+      out += ", \"cross_channel\": " + name(z.cross_slot) +
+             ", \"cross_edges\": " +
+             jsonList(z.spec.cross_edges, 0, z.spec.cross_edges.size());
+    out += ", \"outside_s\": " + jsonNumber(z.seconds.back()) +
+           ",\n     \"seconds\": [";
+    // One row per cross band (a single row for one-dimensional zones)
+    for (size_t row = 0; row * bands + 1 < z.seconds.size(); row++)
+      out += (row ? ", " : "") + jsonList(z.seconds, row * bands, bands);
+    out += "]}";
+  }
+  out += zones.empty() ? "],\n" : "\n  ],\n";
+
+  double fuel_energy = fuel_mass * constants::LHV_fuel;
+  double bsfc = ice_work > 0.0 ? fuel_mass * 1000.0 / (ice_work / 3.6e6)
+                               : NAN; // g/kWh
+  out += "  \"energy\": {\n";
+  out += "    \"fuel_kg\": " + jsonNumber(fuel_mass) + ",\n";
+  out += "    \"fuel_energy_J\": " + jsonNumber(fuel_energy) + ",\n";
+  out += "    \"ice_work_J\": " + jsonNumber(ice_work) + ",\n";
+  out += "    \"ice_efficiency\": " +
+         jsonNumber(fuel_energy > 0.0 ? ice_work / fuel_energy : NAN) +
+         ",\n";
+  out += "    \"mean_bsfc_g_per_kWh\": " + jsonNumber(bsfc) + ",\n";
+  out += "    \"mguk_deployed_J\": " + jsonNumber(mguk_deployed) + ",\n";
+  out += "    \"mguk_harvested_J\": " + jsonNumber(mguk_harvested) + ",\n";
+  out += "    \"mguh_deployed_J\": " + jsonNumber(mguh_deployed) + ",\n";
+  out += "    \"mguh_harvested_J\": " + jsonNumber(mguh_harvested) + ",\n";
+  out += "    \"battery_start_J\": " + jsonNumber(battery_start) + ",\n";
+  out += "    \"battery_end_J\": " + jsonNumber(battery_end) + "\n";
+  out += "  }\n}\n";
+
+  std::ofstream f(path);
+  f << out;
+  if (!f)
+    throw std::runtime_error("cannot write " + path);
+}
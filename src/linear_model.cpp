@@ -0,0 +1,342 @@
+#include "../include/linear_model.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+using Dual = ad::ModelDual;
+
+const char *const LinearModel::state_names[kStates] = {
+    "omega_rad_s", "intake_pressure_Pa", "turbo_speed_rad_s", "soc"};
+const char *const LinearModel::input_names[kInputs] = {
+    "throttle", "mguk_power_W", "mguh_power_W"};
+const char *const LinearModel::output_names[kOutputs] = {
+    "brake_torque_Nm", "total_power_W", "boost_pressure_Pa", "fuel_flow_kg_s"};
+
+// --------------------------------------------------
+// REDUCED PLANT VECTORS
+// --------------------------------------------------
+
+template <typename T>
+static void statesOf(const BasicICEEngine<T> &engine, T *x) {
+  BasicPlantState<T> s = engine.getPlantState();
+  x[0] = s.angular_velocity;
+  x[1] = s.intake_manifold_pressure;
+  x[2] = s.turbo_speed;
+  x[3] = s.battery_soc;
+}
+
+template <typename T>
+static void inputsOf(const BasicICEEngine<T> &engine, T *u) {
+  const BasicEcuCommands<T> &cmd = engine.getEcu().getCommands();
+  u[0] = engine.getThrottle();
+  u[1] = cmd.signedMgukPower();
+  u[2] = cmd.signedMguhPower();
+}
+
+template <typename T>
+static void outputsOf(const BasicICEEngine<T> &engine, T *y) {
+  y[0] = engine.getTorqueOutput();
+  y[1] = engine.getTotalPower();
+  y[2] = engine.getBoostPressure();
+  y[3] = engine.getFuelMassFlow();
+}
+
+void plantVector(const ICEEngine &engine, double *x) { statesOf(engine, x); }
+void inputVector(const ICEEngine &engine, double *u) { inputsOf(engine, u); }
+void outputVector(const ICEEngine &engine, double *y) {
+  outputsOf(engine, y);
+}
+
+// --------------------------------------------------
+// LINEARISATION
+// --------------------------------------------------
+
+LinearModel linearize(const BasicICEEngine<Dual> &engine, double dt,
+                      double period) {
+  constexpr int nx = LinearModel::kStates;
+  constexpr int nu = LinearModel::kInputs;
+  constexpr int ny = LinearModel::kOutputs;
+
+  long steps = std::max(1L, std::lround(period / dt));
+  LinearModel m;
+  m.period = double(steps) * dt;
+
+  Dual x[nx], u[nu];
+  statesOf(engine, x);
+  inputsOf(engine, u);
+  for (int i = 0; i < nx; i++)
+    m.x0[i] = x[i].v;
+  for (int i = 0; i < nu; i++)
+    m.u0[i] = u[i].v;
+
+  // States then inputs, ad::kModelDirections of them per pass
+  for (int first = 0; first < nx + nu; first += ad::kModelDirections) {
+    auto seed = [&](int var, double value) {
+      int dir = var - first;
+      return dir >= 0 && dir < ad::kModelDirections
+                 ? Dual::variable(value, dir)
+                 : Dual(value);
+    };
+
+    BasicICEEngine<Dual> e = engine;
+    e.setPlantState({seed(0, m.x0[0]), seed(1, m.x0[1]), seed(2, m.x0[2]),
+                     seed(3, m.x0[3])});
+    e.setThrottle(seed(nx, m.u0[0]));
+    BasicEcu<Dual> &ecu = e.getEcu();
+    ecu.setDeploymentStrategy(
+        std::make_unique<ManualDeployment<Dual>>(seed(nx + 1, m.u0[1])));
+    ecu.setBoostStrategy(
+        std::make_unique<ManualBoost<Dual>>(seed(nx + 2, m.u0[2])));
+    ecu.setControlPeriod(m.period); // re-syncs: commands apply immediately
+
+    Dual y[ny];
+    for (long s = 0; s < steps; s++) {
+      e.update(dt);
+      if (s == 0)
+        outputsOf(e, y);
+    }
+    Dual x1[nx];
+    statesOf(e, x1);
+
+    if (first == 0) {
+      for (int i = 0; i < nx; i++)
+        m.dx0[i] = x1[i].v - m.x0[i];
+      for (int o = 0; o < ny; o++)
+        m.y0[o] = y[o].v;
+    }
+
+    int last = std::min(first + ad::kModelDirections, nx + nu);
+    for (int var = first; var < last; var++) {
+      int dir = var - first;
+      for (int i = 0; i < nx; i++) {
+        if (var < nx)
+          m.A[i][var] = x1[i].d[dir];
+        else
+          m.B[i][var - nx] = x1[i].d[dir];
+      }
+      for (int o = 0; o < ny; o++) {
+        if (var < nx)
+          m.C[o][var] = y[o].d[dir];
+        else
+          m.D[o][var - nx] = y[o].d[dir];
+      }
+    }
+  }
+  return m;
+}
+
+// --------------------------------------------------
+// SURROGATE
+// --------------------------------------------------
+
+LpvSurrogate::Node LpvSurrogate::affine(const LinearModel &m) {
+  constexpr int nx = LinearModel::kStates;
+  constexpr int nu = LinearModel::kInputs;
+  constexpr int ny = LinearModel::kOutputs;
+
+  Node n;
+  for (int i = 0; i < nx; i++) {
+    n.h[i] = m.x0[i] + m.dx0[i];
+    for (int j = 0; j < nx; j++) {
+      n.F[i][j] = m.A[i][j];
+      n.h[i] -= m.A[i][j] * m.x0[j];
+    }
+    for (int j = 0; j < nu; j++) {
+      n.G[i][j] = m.B[i][j];
+      n.h[i] -= m.B[i][j] * m.u0[j];
+    }
+  }
+  for (int o = 0; o < ny; o++) {
+    n.r[o] = m.y0[o];
+    for (int j = 0; j < nx; j++) {
+      n.P[o][j] = m.C[o][j];
+      n.r[o] -= m.C[o][j] * m.x0[j];
+    }
+    for (int j = 0; j < nu; j++) {
+      n.Q[o][j] = m.D[o][j];
+      n.r[o] -= m.D[o][j] * m.u0[j];
+    }
+  }
+  return n;
+}
+
+LpvSurrogate LpvSurrogate::build(const EngineParams &params,
+                                 const std::vector<Scenario> &training,
+                                 double period, int stride) {
+  std::vector<LinearModel> models;
+  BasicEngineParams<Dual> dual_params = castParams<Dual>(params);
+
+  for (const Scenario &s : training) {
+    long steps = std::max(1L, std::lround(period / s.dt));
+    long every = steps * std::max(1, stride);
+
+    BasicICEEngine<Dual> engine(dual_params);
+    for (int i = 0; i < s.iterations; i++) {
+      engine.setThrottle(s.throttleAt(i * s.dt));
+      engine.update(s.dt);
+      if ((i + 1) % every == 0)
+        models.push_back(linearize(engine, s.dt, period));
+    }
+  }
+  if (models.empty())
+    throw std::invalid_argument("surrogate training produced no models");
+
+  LpvSurrogate lpv;
+  lpv.period = models.front().period;
+  lpv.model_count = models.size();
+
+  double lo = models.front().x0[0], hi = lo;
+  for (const LinearModel &m : models) {
+    lo = std::min(lo, m.x0[0]);
+    hi = std::max(hi, m.x0[0]);
+  }
+  double range = std::max(hi - lo, 1.0);
+  lpv.speed_min = lo;
+  lpv.speed_step = range / (kSpeedNodes - 1);
+
+  // Each node takes the training model nearest in (speed / range, throttle)
+  for (int t = 0; t < kThrottleNodes; t++) {
+    double throttle = double(t) / (kThrottleNodes - 1);
+    for (int s = 0; s < kSpeedNodes; s++) {
+      double speed = lo + s * lpv.speed_step;
+      const LinearModel *best = nullptr;
+      double best_d = 0.0;
+      for (const LinearModel &m : models) {
+        double ds = (m.x0[0] - speed) / range;
+        double dt = m.u0[0] - throttle;
+        double d = ds * ds + dt * dt;
+        if (!best || d < best_d) {
+          best = &m;
+          best_d = d;
+        }
+      }
+      lpv.nodes.push_back(affine(*best));
+    }
+  }
+  return lpv;
+}
+
+double LpvSurrogate::getPeriod() const { return period; }
+
+size_t LpvSurrogate::getModelCount() const { return model_count; }
+
+void LpvSurrogate::step(double *x, const double *u, double *y) const {
+  constexpr int nx = LinearModel::kStates;
+  constexpr int nu = LinearModel::kInputs;
+  constexpr int ny = LinearModel::kOutputs;
+
+  // Bilinear weights on the (speed, throttle) grid, held at the edges
+  double s = std::clamp((x[0] - speed_min) / speed_step, 0.0,
+                        double(kSpeedNodes - 1));
+  double t = std::clamp(u[0], 0.0, 1.0) * (kThrottleNodes - 1);
+  int si = std::min(int(s), kSpeedNodes - 2);
+  int ti = std::min(int(t), kThrottleNodes - 2);
+  double fs = s - si, ft = t - ti;
+
+  const Node *corner[4] = {
+      &nodes[ti * kSpeedNodes + si], &nodes[ti * kSpeedNodes + si + 1],
+      &nodes[(ti + 1) * kSpeedNodes + si],
+      &nodes[(ti + 1) * kSpeedNodes + si + 1]};
+  const double weight[4] = {(1 - fs) * (1 - ft), fs * (1 - ft),
+                            (1 - fs) * ft, fs * ft};
+
+  double next[nx] = {};
+  for (int o = 0; o < ny; o++)
+    y[o] = 0.0;
+
+  for (int c = 0; c < 4; c++) {
+    const Node &n = *corner[c];
+    double w = weight[c];
+    for (int i = 0; i < nx; i++) {
+      double v = n.h[i];
+      for (int j = 0; j < nx; j++)
+        v += n.F[i][j] * x[j];
+      for (int j = 0; j < nu; j++)
+        v += n.G[i][j] * u[j];
+      next[i] += w * v;
+    }
+    for (int o = 0; o < ny; o++) {
+      double v = n.r[o];
+      for (int j = 0; j < nx; j++)
+        v += n.P[o][j] * x[j];
+      for (int j = 0; j < nu; j++)
+        v += n.Q[o][j] * u[j];
+      y[o] += w * v;
+    }
+  }
+
+  // Hard limits of the physics model, which no local linear model carries
+  x[0] = std::max(next[0], constants::engine_idle_rad_s);
+  x[1] = std::max(next[1], 0.3 * constants::ambient_pressure);
+  x[2] = std::max(next[2], constants::turbo_idle_rad_s);
+  x[3] = std::clamp(next[3], 0.0, 1.0);
+}
+
+// --------------------------------------------------
+// FILES
+// --------------------------------------------------
+
+// Visits every coefficient of a node in file order
+template <typename N, typename F> static void forEachCoefficient(N &n, F &&f) {
+  for (auto &row : n.F)
+    for (double &v : row)
+      f(v);
+  for (auto &row : n.G)
+    for (double &v : row)
+      f(v);
+  for (double &v : n.h)
+    f(v);
+  for (auto &row : n.P)
+    for (double &v : row)
+      f(v);
+  for (auto &row : n.Q)
+    for (double &v : row)
+      f(v);
+  for (double &v : n.r)
+    f(v);
+}
+
+void LpvSurrogate::save(const std::string &path) const {
+  FILE *f = std::fopen(path.c_str(), "w");
+  if (!f)
+    throw std::runtime_error("cannot write " + path);
+
+  std::fprintf(f, "f1-pu-lpv 1\nperiod %.17g\nspeed %.17g %.17g %d\n", period,
+               speed_min, speed_step, kSpeedNodes);
+  std::fprintf(f, "throttle %d\nmodels %zu\n", kThrottleNodes, model_count);
+  for (Node n : nodes) {
+    const char *separator = "";
+    forEachCoefficient(n, [&](double v) {
+      std::fprintf(f, "%s%.17g", separator, v);
+      separator = " ";
+    });
+    std::fprintf(f, "\n");
+  }
+  if (std::fclose(f) != 0)
+    throw std::runtime_error("cannot write " + path);
+}
+
+LpvSurrogate LpvSurrogate::load(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("cannot open " + path);
+
+  LpvSurrogate lpv;
+  std::string magic, word;
+  int version = 0, speed_nodes = 0, throttle_nodes = 0;
+  in >> magic >> version >> word >> lpv.period >> word >> lpv.speed_min >>
+      lpv.speed_step >> speed_nodes >> word >> throttle_nodes >> word >>
+      lpv.model_count;
+  if (!in || magic != "f1-pu-lpv" || version != 1 ||
+      speed_nodes != kSpeedNodes || throttle_nodes != kThrottleNodes)
+    throw std::runtime_error(path + ": not a compatible surrogate file");
+
+  lpv.nodes.resize(size_t(kSpeedNodes) * kThrottleNodes);
+  for (Node &n : lpv.nodes)
+    forEachCoefficient(n, [&](double &v) { in >> v; });
+  if (!in)
+    throw std::runtime_error(path + ": truncated surrogate file");
+  return lpv;
+}
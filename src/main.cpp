@@ -1,10 +1,25 @@
+#include "../include/flight_recorder.hpp"
 #include "../include/ice_engine.hpp"
+#include "../include/kpi.hpp"
+#include "../include/metrics.hpp"
+#include "../include/rule_monitor.hpp"
+#include "../include/telemetry.hpp"
 #include <bits/stdc++.h>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 
-int main() {
+static int usage() {
+  std::cerr
+      << "usage: f1-pu [--compressed | --compressed-micro] [--turbo-map file]\n"
+         "             [--metrics file] [--metrics-socket path]\n"
+         "             [--metrics-period s] [--flight-recorder]\n"
+         "             [--trigger cond]... [--kpi] [--kpi-spec file]\n"
+         "             [--rules file] [--cell-pack [cells]] [--gas-dynamics]\n";
+  return 2;
+}
+
+int main(int argc, char **argv) {
   ICEEngine engine;
 
   double dt = 0.0001; // 0.1 ms timestep for high fidelity
@@ -12,110 +27,147 @@ int main() {
   double throttle_init = 0.3;
   engine.setThrottle(throttle_init);
 
-  std::ofstream log("data/engine_log.csv");
-
-  // Comprehensive F1 telemetry header
-  log << "time,"
-      // Engine speed and throttle
-      << "rpm,omega,throttle,effective_throttle,"
-      // Torque breakdown
-      << "indicated_torque,combustion_torque,friction_torque,pumping_torque,"
-      << "load_torque,mguk_torque,mguh_torque,net_torque,torque_output,"
-      // Power breakdown
-      << "ice_power,mguk_power,mguh_power,total_power,"
-      // Mean effective pressures (kPa for readability)
-      << "imep,bmep,fmep,"
-      // Efficiency metrics
-      << "thermal_efficiency,mechanical_efficiency,bsfc,volumetric_efficiency,"
-      // Intake system
-      << "plenum_pressure,intake_manifold_pressure,intake_manifold_temp,"
-      << "boost_pressure,compressor_outlet_temp,"
-      // Exhaust system
-      << "exhaust_manifold_pressure,exhaust_temp,exhaust_mass_flow,"
-      // Airflow and fuel
-      << "na_air_flow,actual_air_flow,turbo_air_flow,fuel_mass_flow,"
-      // Turbo
-      << "turbo_speed,turbo_speed_rpm,"
-      // Battery / ERS
-      << "battery_energy,battery_soc"
-      << "\n";
+  // --compressed writes the bit-exact .f1pz encoding instead of CSV;
+  // --compressed-micro keeps only the CSV's six decimals, far smaller.
+  // --turbo-map <file> switches the turbo to map-based compressor/turbine.
+  // --metrics <file> and --metrics-socket <path> publish run metrics in
+  // Prometheus text format every --metrics-period seconds (default 1).
+  // --flight-recorder keeps every step in memory and dumps windows around
+  // trigger events to data/flight/; --trigger <cond> (repeatable) replaces
+  // the default triggers and implies it.
+  // --kpi aggregates summary KPIs during the run into
+  // data/kpi_summary.json; --kpi-spec <file> chooses them (see kpi.hpp).
+  // --rules <file> checks limit rules every step (see rule_monitor.hpp)
+  // and writes their events to data/rule_events.csv.
+  // --cell-pack [cells] replaces the single-state battery by a
+  // cell-resolved pack (default 200 cells; see battery_pack.hpp).
+  // --gas-dynamics models the exhaust and intake runners and collector
+  // as 1D pipes (see gas_dynamics.hpp).
+  std::string log_format;
+  bool flight_recorder = false;
+  FlightRecorderOptions recorder_options;
+  std::vector<RecorderTrigger> triggers;
+  MetricsExporterOptions metrics_options;
+  std::unique_ptr<KpiAggregator> kpi;
+  std::unique_ptr<RuleMonitor> rules;
+  for (int a = 1; a < argc; a++) {
+    std::string arg = argv[a];
+    if (arg == "--flight-recorder") {
+      flight_recorder = true;
+    } else if (arg == "--trigger" && a + 1 < argc) {
+      try {
+        triggers.push_back(RecorderTrigger::parse(argv[++a]));
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+      flight_recorder = true;
+    } else if (arg == "--kpi") {
+      if (!kpi)
+        kpi = std::make_unique<KpiAggregator>(defaultKpiSpec());
+    } else if (arg == "--kpi-spec" && a + 1 < argc) {
+      try {
+        kpi = std::make_unique<KpiAggregator>(loadKpiSpec(argv[++a]));
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    } else if (arg == "--rules" && a + 1 < argc) {
+      try {
+        rules = std::make_unique<RuleMonitor>(loadRules(argv[++a]), dt);
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    } else if (arg == "--cell-pack") {
+      BatteryPackParams pack;
+      if (a + 1 < argc && std::isdigit((unsigned char)argv[a + 1][0]))
+        pack.cells = std::atoi(argv[++a]);
+      try {
+        engine.setBatteryPack(pack);
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    } else if (arg == "--gas-dynamics") {
+      engine.setGasDynamics(GasDynamicsParams{});
+    } else if (arg == "--metrics" && a + 1 < argc) {
+      metrics_options.textfile = argv[++a];
+    } else if (arg == "--metrics-socket" && a + 1 < argc) {
+      metrics_options.socket_path = argv[++a];
+    } else if (arg == "--metrics-period" && a + 1 < argc) {
+      metrics_options.period = std::atof(argv[++a]);
+    } else if (arg == "--turbo-map" && a + 1 < argc) {
+      try {
+        engine.setTurboMaps(
+            std::make_shared<TurboMaps>(TurboMaps::load(argv[++a])));
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    } else if (arg == "--compressed" || arg == "--compressed-micro") {
+      log_format = arg;
+    } else {
+      std::cerr << "unknown option or missing value: " << arg << "\n";
+      return usage();
+    }
+  }
+  std::unique_ptr<FlightRecorder> recorder;
+  if (flight_recorder) {
+    if (!triggers.empty())
+      recorder_options.triggers = triggers;
+    recorder = std::make_unique<FlightRecorder>(recorder_options, dt);
+  }
+
+  bool compressed = log_format == "--compressed" ||
+                    log_format == "--compressed-micro";
+  const char *log_path =
+      compressed ? "data/engine_log.f1pz" : "data/engine_log.csv";
+
+  std::unique_ptr<TelemetryWriter> log;
+  if (compressed)
+    log = std::make_unique<CompressedTelemetryWriter>(
+        log_path, telemetryChannelNames(), dt,
+        log_format == "--compressed" ? TelemetryCoding::EXACT
+                                     : TelemetryCoding::MICRO);
+  else
+    log = std::make_unique<CsvTelemetryWriter>(log_path,
+                                               telemetryChannelNames(), dt);
+  double row[kTelemetryChannels];
 
   int iterations = 100000;
   int log_interval = 10; // Log every 10 iterations (1 ms)
 
   std::cout << std::fixed << std::setprecision(2);
 
+  // Progress is printed by the exporter thread, off the step loop
+  SimulationMetrics metrics;
+  std::unique_ptr<MetricsExporter> exporter;
+  try {
+    exporter = std::make_unique<MetricsExporter>(metrics, metrics_options);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  if (kpi)
+    kpi->begin(engine);
   for (int i = 0; i < iterations; i++) {
     engine.update(dt);
+    metrics.recordStep(i + 1, (i + 1) * dt, engine);
+    if (recorder)
+      recorder->record(i, engine);
+    if (kpi)
+      kpi->record(engine, dt);
+    if (rules)
+      rules->record(i, engine);
 
-    // Console output every 1000 iterations (100 ms)
-    if (i % 1000 == 0) {
-      std::cout << "t=" << std::setw(6) << i * dt << "s"
-                << " | RPM=" << std::setw(7) << engine.getRPM()
-                << " | Torque=" << std::setw(7) << engine.getTorqueOutput()
-                << " Nm"
-                << " | Power=" << std::setw(8) << engine.getTotalPower() / 1000
-                << " kW"
-                << " | Boost=" << std::setw(5)
-                << engine.getBoostPressure() / 101325.0 << " bar"
-                << " | SOC=" << std::setw(5) << engine.getBatterySOC() * 100
-                << "%"
-                << " | BSFC=" << std::setw(6) << engine.getBSFC() << " g/kWh"
-                << "\n";
-    }
-
-    // Log to CSV at specified interval
+    // Log telemetry at specified interval
     if (i % log_interval == 0) {
-      log << std::fixed
-          << std::setprecision(6)
-          // Time
-          << i * dt
-          << ","
-          // Engine speed and throttle
-          << engine.getRPM() << "," << engine.getAngularVelocity() << ","
-          << engine.getThrottle() << "," << engine.getEffectiveThrottle()
-          << ","
-          // Torque breakdown (Nm)
-          << engine.getIndicatedTorque() << "," << engine.getCombustionTorque()
-          << "," << engine.getFrictionTorque() << ","
-          << engine.getPumpingTorque() << "," << engine.getLoadTorque() << ","
-          << engine.getMGUKTorque() << "," << engine.getMGUHTorque() << ","
-          << engine.getNetTorque() << "," << engine.getTorqueOutput()
-          << ","
-          // Power breakdown (W)
-          << engine.getICEPower() << "," << engine.getMGUKPower() << ","
-          << engine.getMGUHPower() << "," << engine.getTotalPower()
-          << ","
-          // Mean effective pressures (kPa)
-          << engine.getIMEP() / 1000.0 << "," << engine.getBMEP() / 1000.0
-          << "," << engine.getFMEP() / 1000.0
-          << ","
-          // Efficiency metrics
-          << engine.getThermalEfficiency() << ","
-          << engine.getMechanicalEfficiency() << "," << engine.getBSFC() << ","
-          << engine.getVolumetricEfficiency()
-          << ","
-          // Intake system (Pa and K)
-          << engine.getPlenumPressure() << ","
-          << engine.getIntakeManifoldPressure() << ","
-          << engine.getIntakeManifoldTemperature() << ","
-          << engine.getBoostPressure() << ","
-          << engine.getCompressorOutletTemperature()
-          << ","
-          // Exhaust system (Pa, K, kg/s)
-          << engine.getExhaustManifoldPressure() << ","
-          << engine.getExhaustTemperature() << ","
-          << engine.getExhaustMassFlowRate()
-          << ","
-          // Airflow and fuel (kg/s)
-          << engine.getNAAirFlow() << "," << engine.getActualAirFlow() << ","
-          << engine.getAirMassFlow() << "," << engine.getFuelMassFlow()
-          << ","
-          // Turbo (rad/s and RPM)
-          << engine.getTurboSpeed() << "," << engine.getTurboSpeedRPM()
-          << ","
-          // Battery / ERS (J and fraction)
-          << engine.getBatteryEnergy() << "," << engine.getBatterySOC() << "\n";
+      sampleTelemetry(engine, row);
+      log->write(i, row);
+      metrics.telemetry_bytes.store(log->bytesWritten(),
+                                    std::memory_order_relaxed);
     }
 
     // Throttle ramp-up profile (simulates acceleration run)
@@ -125,7 +177,11 @@ int main() {
     }
   }
 
-  log.close();
+  log->close();
+  metrics.telemetry_bytes.store(log->bytesWritten());
+  exporter->stop();
+  if (recorder)
+    recorder->flush();
 
   std::cout << "\n=== Final Engine State ===\n";
   std::cout << "RPM: " << engine.getRPM() << " rev/min\n";
@@ -142,7 +198,64 @@ int main() {
             << " bar\n";
   std::cout << "Turbo Speed: " << engine.getTurboSpeedRPM() << " RPM\n";
   std::cout << "Battery SOC: " << engine.getBatterySOC() * 100 << "%\n";
-  std::cout << "\nLog saved to data/engine_log.csv\n";
+  if (const BatteryPack *pack = engine.getBatteryPack()) {
+    std::cout << "Pack: " << pack->cellCount() << " cells, "
+              << pack->getTerminalVoltage() << " V, cell SOC "
+              << pack->getMinCellSOC() * 100 << ".."
+              << pack->getMaxCellSOC() * 100 << "%, hottest cell "
+              << pack->getMaxCellTemperature() - 273.15 << " C\n";
+    std::cout << "Pack limits: " << pack->getMaxDischargePower() / 1000
+              << " kW discharge, " << pack->getMaxChargePower() / 1000
+              << " kW charge\n";
+  }
+  if (const GasDynamics *gas = engine.getGasDynamics()) {
+    std::cout << "Gas dynamics: " << gas->cellCount() << " cells, "
+              << gas->getSubsteps() << " substeps, turbine inlet "
+              << gas->getTurbineInletPressure() / 1e5 << " bar at "
+              << gas->getTurbineInletTemperature() << " K\n";
+  }
+  std::cout << "\nLog saved to " << log_path << " (" << log->bytesWritten()
+            << " bytes)\n";
+  if (kpi) {
+    const char *kpi_path = "data/kpi_summary.json";
+    try {
+      kpi->write(kpi_path);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    std::cout << "KPI summary saved to " << kpi_path << "\n";
+  }
+  if (rules) {
+    const char *events_path = "data/rule_events.csv";
+    try {
+      rules->write(events_path);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    std::cout << "Rules: " << rules->getEvents().size() << " events saved to "
+              << events_path << "\n";
+    for (size_t r = 0; r < rules->getRules().size(); r++) {
+      if (rules->getRaisedCount(int(r)) == 0)
+        continue;
+      const Rule &rule = rules->getRules()[r];
+      std::cout << "  " << rule.name << " [" << severityName(rule.severity)
+                << "]: raised " << rules->getRaisedCount(int(r))
+                << "x, active " << rules->getActiveSeconds(int(r)) << " s"
+                << (rules->isActive(int(r)) ? " (still active)" : "") << "\n";
+    }
+  }
+  if (recorder) {
+    std::cout << "Flight recorder: " << recorder->getEventCount()
+              << " trigger events\n";
+    for (const FlightRecorder::Dump &d : recorder->getDumps()) {
+      std::cout << "  " << d.path << " (t=" << d.trigger_step * dt << " s:";
+      for (const std::string &t : d.triggers)
+        std::cout << " " << t;
+      std::cout << ")\n";
+    }
+  }
 
   return 0;
 }
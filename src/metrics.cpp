@@ -0,0 +1,188 @@
+#include "../include/metrics.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static double wallSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+MetricsExporter::MetricsExporter(const SimulationMetrics &m,
+                                 const MetricsExporterOptions &opts)
+    : metrics(m), options(opts), start_wall(wallSeconds()) {
+  if (!(options.period > 0.0))
+    throw std::invalid_argument("metrics period must be positive");
+  if (pipe(wake_pipe) != 0)
+    throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+
+  if (!options.socket_path.empty()) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (options.socket_path.size() >= sizeof addr.sun_path)
+      throw std::runtime_error("socket path too long: " +
+                               options.socket_path);
+    std::strcpy(addr.sun_path, options.socket_path.c_str());
+
+    // A leftover socket file from an earlier run is replaced
+    struct stat st;
+    if (stat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode))
+      unlink(addr.sun_path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&addr, sizeof addr) < 0 ||
+        listen(listen_fd, 16) < 0) {
+      std::string why = options.socket_path + ": " + std::strerror(errno);
+      if (listen_fd >= 0)
+        close(listen_fd);
+      close(wake_pipe[0]);
+      close(wake_pipe[1]);
+      throw std::runtime_error(why);
+    }
+  }
+
+  thread = std::thread([this] { run(); });
+}
+
+MetricsExporter::~MetricsExporter() {
+  stop();
+  close(wake_pipe[0]);
+  close(wake_pipe[1]);
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    unlink(options.socket_path.c_str());
+  }
+}
+
+void MetricsExporter::stop() {
+  if (stopping.exchange(true))
+    return;
+  char byte = 0;
+  (void)!write(wake_pipe[1], &byte, 1);
+  thread.join();
+}
+
+// --------------------------------------------------
+// SAMPLING
+// --------------------------------------------------
+
+MetricsExporter::Sample
+MetricsExporter::sample(const Sample &previous) const {
+  Sample s;
+  s.wall = wallSeconds() - start_wall;
+  s.steps = metrics.steps.load(std::memory_order_relaxed);
+  s.simulated = metrics.simulated_seconds.load(std::memory_order_relaxed);
+  s.telemetry_bytes = metrics.telemetry_bytes.load(std::memory_order_relaxed);
+  s.queue_depth = metrics.writer_queue_depth.load(std::memory_order_relaxed);
+  s.rpm = metrics.rpm.load(std::memory_order_relaxed);
+  s.soc = metrics.battery_soc.load(std::memory_order_relaxed);
+
+  double elapsed = s.wall - previous.wall;
+  if (elapsed > 0.0) {
+    s.steps_per_second = double(s.steps - previous.steps) / elapsed;
+    s.realtime_factor = (s.simulated - previous.simulated) / elapsed;
+  }
+  return s;
+}
+
+// Prometheus text exposition format 0.0.4
+std::string MetricsExporter::render(const Sample &s) const {
+  std::string out;
+  char line[256];
+  auto metric = [&](const char *name, const char *type, const char *help,
+                    double value) {
+    std::snprintf(line, sizeof line,
+                  "# HELP %s %s\n# TYPE %s %s\n%s{run=\"%s\"} %.17g\n", name,
+                  help, name, type, name, options.run.c_str(), value);
+    out += line;
+  };
+
+  metric("f1pu_steps_total", "counter", "Physics steps taken.",
+         double(s.steps));
+  metric("f1pu_simulated_seconds", "gauge", "Simulated time.", s.simulated);
+  metric("f1pu_steps_per_second", "gauge",
+         "Physics steps per wall-clock second over the last period.",
+         s.steps_per_second);
+  metric("f1pu_realtime_factor", "gauge",
+         "Simulated seconds per wall-clock second over the last period.",
+         s.realtime_factor);
+  metric("f1pu_telemetry_bytes_total", "counter", "Telemetry log bytes.",
+         double(s.telemetry_bytes));
+  metric("f1pu_writer_queue_depth", "gauge",
+         "Telemetry rows waiting to be written.", double(s.queue_depth));
+  metric("f1pu_engine_rpm", "gauge", "Crank speed.", s.rpm);
+  metric("f1pu_battery_soc", "gauge", "Battery state of charge (0..1).",
+         s.soc);
+  metric("f1pu_wall_seconds", "gauge", "Wall-clock time since start.",
+         s.wall);
+  return out;
+}
+
+void MetricsExporter::publish(const Sample &s) {
+  if (!options.textfile.empty()) {
+    // Temporary name and rename, so a scrape never sees a partial file
+    std::string tmp = options.textfile + ".tmp" + std::to_string(getpid());
+    FILE *f = std::fopen(tmp.c_str(), "w");
+    if (f) {
+      std::string text = render(s);
+      bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+      ok = std::fclose(f) == 0 && ok;
+      if (!ok || std::rename(tmp.c_str(), options.textfile.c_str()) != 0)
+        std::remove(tmp.c_str());
+    }
+  }
+
+  if (options.console) {
+    std::printf("t=%8.3fs | %9.0f steps/s | RTF %7.3f | RPM=%7.0f | "
+                "SOC=%6.2f%% | log %.1f MB\n",
+                s.simulated, s.steps_per_second, s.realtime_factor, s.rpm,
+                s.soc * 100.0, s.telemetry_bytes / 1e6);
+    std::fflush(stdout);
+  }
+}
+
+void MetricsExporter::run() {
+  Sample last;
+  double next = options.period;
+
+  for (;;) {
+    double remaining = next - (wallSeconds() - start_wall);
+    pollfd fds[2] = {{wake_pipe[0], POLLIN, 0}, {listen_fd, POLLIN, 0}};
+    int timeout_ms = remaining > 0.0 ? int(std::ceil(remaining * 1000.0)) : 0;
+    int ready = poll(fds, listen_fd >= 0 ? 2 : 1, timeout_ms);
+
+    if (stopping)
+      break;
+
+    if (ready > 0 && (fds[1].revents & POLLIN)) {
+      int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd >= 0) {
+        std::string text = render(sample(last));
+        send(fd, text.data(), text.size(), MSG_NOSIGNAL);
+        close(fd);
+      }
+      continue;
+    }
+
+    if (wallSeconds() - start_wall >= next) {
+      last = sample(last);
+      publish(last);
+      while (next <= last.wall)
+        next += options.period;
+    }
+  }
+
+  // Final values, so short runs and the last partial period are recorded
+  last = sample(last);
+  publish(last);
+}
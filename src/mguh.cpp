@@ -1,22 +1,20 @@
 #include "../include/mgu_h.hpp"
-#include <algorithm>
+#include "../include/dual.hpp"
 
-static inline double clamp(double v, double lo, double hi) {
-  return std::max(lo, std::min(v, hi));
-}
-
-MGUH::MGUH(double inertia, double efficiency, double max_power)
+template <typename T>
+BasicMGUH<T>::BasicMGUH(double inertia, double efficiency, double max_power)
     : inertia(inertia), efficiency(efficiency), maxPower(max_power), omega(0.0),
       torque(0.0), electricalPower(0.0), requestedPower(0.0),
       mode(MGUHMode::IDLE) {}
 
-void MGUH::setMode(MGUHMode m) { mode = m; }
+template <typename T> void BasicMGUH<T>::setMode(MGUHMode m) { mode = m; }
 
-void MGUH::setRequestedPower(double p) {
-  requestedPower = clamp(p, 0.0, maxPower);
+template <typename T> void BasicMGUH<T>::setRequestedPower(T p) {
+  requestedPower = ad::clamp(p, 0.0, maxPower);
 }
 
-void MGUH::update(double /*dt*/, double turbo_omega) {
+template <typename T>
+void BasicMGUH<T>::update(double /*dt*/, T turbo_omega) {
 
   // avoid division blow-up at low speed
   if (turbo_omega < 1.0) {
@@ -27,12 +25,12 @@ void MGUH::update(double /*dt*/, double turbo_omega) {
 
   switch (mode) {
   case MGUHMode::GENERATOR:
-    electricalPower = clamp(requestedPower, 0.0, maxPower);
+    electricalPower = ad::clamp(requestedPower, 0.0, maxPower);
     torque = -electricalPower / (efficiency * turbo_omega);
     break;
 
   case MGUHMode::MOTOR:
-    electricalPower = -clamp(requestedPower, 0.0, maxPower);
+    electricalPower = -ad::clamp(requestedPower, 0.0, maxPower);
     torque = +(efficiency * (-electricalPower)) / turbo_omega;
     break;
 
@@ -44,6 +42,11 @@ void MGUH::update(double /*dt*/, double turbo_omega) {
   }
 }
 
-double MGUH::getTorque() const { return torque; }
+template <typename T> T BasicMGUH<T>::getTorque() const { return torque; }
+
+template <typename T> T BasicMGUH<T>::getElectricalPower() const {
+  return electricalPower;
+}
 
-double MGUH::getElectricalPower() const { return electricalPower; }
+template class BasicMGUH<double>;
+template class BasicMGUH<ad::ModelDual>;
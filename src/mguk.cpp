@@ -1,15 +1,20 @@
 #include "../include/mgu_k.hpp"
-#include <algorithm>
+#include "../include/dual.hpp"
 
-MGUK::MGUK(double eff, double maxP)
+template <typename T>
+BasicMGUK<T>::BasicMGUK(double eff, double maxP)
     : mode(MGUKMode::IDLE), efficiency(eff), max_power(maxP),
       requested_power(0.0), torque(0.0), electrical_power(0.0) {}
 
-void MGUK::setMode(MGUKMode m) { mode = m; }
+template <typename T> void BasicMGUK<T>::setMode(MGUKMode m) { mode = m; }
 
-void MGUK::setRequestedPower(double p) { requested_power = p; }
+template <typename T> void BasicMGUK<T>::setRequestedPower(T p) {
+  requested_power = p;
+}
 
-void MGUK::update(double dt, double crank_omega, EnergyStore &battery) {
+template <typename T>
+void BasicMGUK<T>::update(double dt, T crank_omega,
+                          BasicEnergyStore<T> &battery) {
   torque = 0.0;
   electrical_power = 0.0;
 
@@ -18,9 +23,9 @@ void MGUK::update(double dt, double crank_omega, EnergyStore &battery) {
 
   switch (mode) {
   case MGUKMode::MOTOR: {
-    double available_power =
-        std::min(requested_power,
-                 std::min(max_power, battery.getAvailableDischargePower()));
+    T available_power =
+        ad::min(requested_power,
+                ad::min(max_power, battery.getAvailableDischargePower()));
 
     electrical_power = -1 * available_power;
 
@@ -31,9 +36,9 @@ void MGUK::update(double dt, double crank_omega, EnergyStore &battery) {
   }
 
   case MGUKMode::GENERATOR: {
-    double available_power =
-        std::min(requested_power,
-                 std::min(max_power, battery.getAvailableChargePower()));
+    T available_power =
+        ad::min(requested_power,
+                ad::min(max_power, battery.getAvailableChargePower()));
 
     electrical_power = +available_power; // shaft → battery
 
@@ -50,6 +55,11 @@ void MGUK::update(double dt, double crank_omega, EnergyStore &battery) {
   }
 }
 
-double MGUK::getTorque() const { return torque; }
+template <typename T> T BasicMGUK<T>::getTorque() const { return torque; }
+
+template <typename T> T BasicMGUK<T>::getElectricalPower() const {
+  return electrical_power;
+}
 
-double MGUK::getElectricalPower() const { return electrical_power; }
+template class BasicMGUK<double>;
+template class BasicMGUK<ad::ModelDual>;
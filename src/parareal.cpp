@@ -0,0 +1,203 @@
+#include "../include/parareal.hpp"
+#include "../include/linear_model.hpp"
+#include "../include/telemetry.hpp"
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <time.h>
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// CPU time of the calling thread, so a segment's cost is measured right
+// even when there are fewer cores than segments
+static double threadSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return double(ts.tv_sec) + 1e-9 * double(ts.tv_nsec);
+}
+
+// --------------------------------------------------
+// PROPAGATORS
+// --------------------------------------------------
+
+// Fine steps [begin, end), optionally sampling telemetry on the global
+// log grid
+static void fine(ICEEngine &engine, const Scenario &s, int64_t begin,
+                 int64_t end, int log_interval, std::vector<int64_t> &steps,
+                 std::vector<double> &rows) {
+  steps.clear();
+  rows.clear();
+  double row[kTelemetryChannels];
+  for (int64_t i = begin; i < end; i++) {
+    engine.setThrottle(s.throttleAt(i * s.dt));
+    engine.update(s.dt);
+    if (log_interval > 0 && i % log_interval == 0) {
+      sampleTelemetry(engine, row);
+      steps.push_back(i);
+      rows.insert(rows.end(), row, row + kTelemetryChannels);
+    }
+  }
+}
+
+// Fine steps per coarse step
+static int64_t coarseSteps(const Scenario &s, const PararealOptions &o) {
+  if (o.surrogate)
+    return std::max(1L, std::lround(o.surrogate->getPeriod() / s.dt));
+  return o.coarse_factor;
+}
+
+// Coarse propagation over [begin, end). With the model, a remainder
+// shorter than one coarse step is taken at the fine step. With the
+// surrogate, the ECU runs once per surrogate period on the reduced state
+// and only the plant state and ECU of `engine` advance; a remainder is
+// dropped (segment bounds are whole periods except at the end of the run).
+static void coarse(ICEEngine &engine, const Scenario &s, int64_t begin,
+                   int64_t end, const PararealOptions &o) {
+  int64_t steps = coarseSteps(s, o);
+  int64_t i = begin;
+
+  if (!o.surrogate) {
+    for (; i + steps <= end; i += steps) {
+      engine.setThrottle(s.throttleAt(i * s.dt));
+      engine.update(s.dt * steps);
+    }
+    for (; i < end; i++) {
+      engine.setThrottle(s.throttleAt(i * s.dt));
+      engine.update(s.dt);
+    }
+    return;
+  }
+
+  double x[LinearModel::kStates], y[LinearModel::kOutputs];
+  double u[LinearModel::kInputs] = {engine.getThrottle(), 0.0, 0.0};
+  plantVector(engine, x);
+  outputVector(engine, y);
+  Ecu &ecu = engine.getEcu();
+  for (; i + steps <= end; i += steps) {
+    u[0] = s.throttleAt(i * s.dt);
+    ecu.control({u[0], x[0], y[2], x[2], x[3]}, s.dt * steps);
+    u[1] = ecu.getCommands().signedMgukPower();
+    u[2] = ecu.getCommands().signedMguhPower();
+    o.surrogate->step(x, u, y);
+  }
+  engine.setThrottle(u[0]);
+  engine.setPlantState({x[0], x[1], x[2], x[3]});
+}
+
+static double stateChange(const PlantState &a, const PlantState &b) {
+  return std::max(
+      {std::abs(a.angular_velocity - b.angular_velocity) / 1000.0,
+       std::abs(a.intake_manifold_pressure - b.intake_manifold_pressure) /
+           1e5,
+       std::abs(a.turbo_speed - b.turbo_speed) / 1e4,
+       std::abs(a.battery_soc - b.battery_soc)});
+}
+
+// --------------------------------------------------
+// PARAREAL
+// --------------------------------------------------
+
+PararealResult runParareal(const ICEEngine &initial, const Scenario &scenario,
+                           const PararealOptions &options) {
+  ThreadPool pool(options.workers);
+  int segments = options.segments > 0 ? options.segments : pool.size();
+  if (options.coarse_factor < 1)
+    throw std::invalid_argument("coarse_factor must be at least 1");
+  int max_iterations =
+      options.max_iterations > 0 ? std::min(options.max_iterations, segments)
+                                 : segments;
+
+  // Segment n covers fine steps [bound[n], bound[n + 1]), in whole coarse
+  // steps
+  int64_t quantum = coarseSteps(scenario, options);
+  int64_t coarse_total = scenario.iterations / quantum;
+  if (segments > coarse_total)
+    throw std::invalid_argument("more segments than coarse steps");
+  std::vector<int64_t> bound(segments + 1);
+  for (int n = 0; n < segments; n++)
+    bound[n] = coarse_total * n / segments * quantum;
+  bound[segments] = scenario.iterations;
+
+  PararealResult result; // final_state is set after the last sweep
+
+  // U[n]: state at the start of segment n; G[n]: coarse prediction of
+  // U[n + 1] from the current U[n]; F[n]: fine solution from it
+  std::vector<ICEEngine> U(segments + 1, initial);
+  std::vector<ICEEngine> G(segments, initial);
+  std::vector<ICEEngine> F(segments, initial);
+  std::vector<std::vector<int64_t>> seg_steps(segments);
+  std::vector<std::vector<double>> seg_rows(segments);
+  std::vector<double> seg_seconds(segments, 0.0);
+
+  Clock::time_point start = Clock::now();
+  for (int n = 0; n < segments; n++) {
+    G[n] = U[n];
+    coarse(G[n], scenario, bound[n], bound[n + 1], options);
+    U[n + 1] = G[n];
+  }
+  result.coarse_seconds += secondsSince(start);
+
+  // Segments before `exact` start from the serial fine solution
+  for (int exact = 0; exact < max_iterations; exact++) {
+    start = Clock::now();
+    pool.parallelFor(segments - exact, [&](int j) {
+      int n = exact + j;
+      double seg_start = threadSeconds();
+      F[n] = U[n];
+      fine(F[n], scenario, bound[n], bound[n + 1], options.log_interval,
+           seg_steps[n], seg_rows[n]);
+      seg_seconds[n] = threadSeconds() - seg_start;
+    });
+    result.fine_seconds += secondsSince(start);
+    result.longest_segment_seconds +=
+        *std::max_element(seg_seconds.begin() + exact, seg_seconds.end());
+    result.iterations++;
+
+    start = Clock::now();
+    double residual = 0.0;
+    U[exact + 1] = F[exact];
+    for (int n = exact + 1; n < segments; n++) {
+      ICEEngine prediction = U[n];
+      coarse(prediction, scenario, bound[n], bound[n + 1], options);
+
+      PlantState g_new = prediction.getPlantState();
+      PlantState g_old = G[n].getPlantState();
+      PlantState f = F[n].getPlantState();
+      PlantState corrected = {
+          g_new.angular_velocity + f.angular_velocity - g_old.angular_velocity,
+          g_new.intake_manifold_pressure + f.intake_manifold_pressure -
+              g_old.intake_manifold_pressure,
+          g_new.turbo_speed + f.turbo_speed - g_old.turbo_speed,
+          g_new.battery_soc + f.battery_soc - g_old.battery_soc};
+
+      residual = std::max(
+          residual, stateChange(corrected, U[n + 1].getPlantState()));
+      U[n + 1] = F[n];
+      U[n + 1].setPlantState(corrected);
+      G[n] = std::move(prediction);
+    }
+    result.coarse_seconds += secondsSince(start);
+    result.residuals.push_back(residual);
+
+    if (residual <= options.tolerance || exact + 1 == segments) {
+      result.converged = true;
+      break;
+    }
+  }
+
+  // The last fine sweep is the answer; its final segment ends the run
+  result.final_state = F[segments - 1];
+  for (int n = 0; n < segments; n++) {
+    result.steps.insert(result.steps.end(), seg_steps[n].begin(),
+                        seg_steps[n].end());
+    result.rows.insert(result.rows.end(), seg_rows[n].begin(),
+                       seg_rows[n].end());
+  }
+  return result;
+}
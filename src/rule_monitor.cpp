@@ -0,0 +1,449 @@
+#include "../include/rule_monitor.hpp"
+#include "../include/constants.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+// --------------------------------------------------
+// RULES
+// --------------------------------------------------
+
+const std::vector<RuleConstant> &ruleConstants() {
+  static const std::vector<RuleConstant> table = {
+      {"ambient_pressure", constants::ambient_pressure},
+      {"ambient_temperature", constants::ambient_temperature},
+      {"turbo_max_pr", constants::turbo_max_pr},
+      {"turbo_nominal_speed", constants::turbo_nominal_speed},
+      {"turbo_max_air_flow", constants::turbo_max_air_flow},
+      {"exhaust_temp_max", constants::exhaust_temp_max},
+      {"battery_max_energy_J", constants::battery_max_energy_J},
+      {"battery_max_charge_power", constants::battery_max_charge_power},
+      {"battery_max_discharge_power", constants::battery_max_discharge_power},
+      {"mguk_max_power", constants::mguk_max_power},
+  };
+  return table;
+}
+
+const char *severityName(Rule::Severity severity) {
+  switch (severity) {
+  case Rule::Severity::INFO:
+    return "info";
+  case Rule::Severity::WARN:
+    return "warn";
+  case Rule::Severity::ERROR:
+    return "error";
+  }
+  return "warn";
+}
+
+namespace {
+
+bool parseNumber(const std::string &word, double &value) {
+  char *end = nullptr;
+  value = std::strtod(word.c_str(), &end);
+  return !word.empty() && *end == '\0';
+}
+
+// A product or quotient of numbers and named constants, e.g.
+// 0.95*exhaust_temp_max or 100/3600
+bool parseConstant(const std::string &text, double &value) {
+  value = 1.0;
+  bool divide = false;
+  size_t start = 0;
+  while (true) {
+    size_t op = text.find_first_of("*/", start);
+    std::string factor = text.substr(start, op - start);
+    double f;
+    bool found = parseNumber(factor, f);
+    for (const RuleConstant &c : ruleConstants())
+      if (!found && factor == c.name) {
+        f = c.value;
+        found = true;
+      }
+    if (!found)
+      return false;
+    value = divide ? value / f : value * f;
+    if (op == std::string::npos)
+      return true;
+    divide = text[op] == '/';
+    start = op + 1;
+  }
+}
+
+// One level of a term: fn(arg) with fn in abs/pos/neg/integral, or ""
+// with arg the whole text
+std::string functionOf(const std::string &term, std::string &arg) {
+  size_t open = term.find('(');
+  if (open == std::string::npos || term.back() != ')') {
+    arg = term;
+    return "";
+  }
+  std::string fn = term.substr(0, open);
+  if (fn != "abs" && fn != "pos" && fn != "neg" && fn != "integral")
+    throw std::invalid_argument("unknown function '" + fn + "'");
+  arg = term.substr(open + 1, term.size() - open - 2);
+  return fn;
+}
+
+void checkTerm(const std::string &term) {
+  std::string arg;
+  if (!functionOf(term, arg).empty()) {
+    checkTerm(arg);
+    return;
+  }
+  double value;
+  if (findTelemetryChannel(term) < 0 && !parseConstant(term, value))
+    throw std::invalid_argument("unknown channel or constant '" + term +
+                                "'");
+}
+
+} // namespace
+
+std::vector<Rule> parseRules(const std::string &text) {
+  std::vector<Rule> rules;
+  std::istringstream lines(text);
+  std::string line;
+  int number = 0;
+  while (std::getline(lines, line)) {
+    number++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.resize(hash);
+    std::istringstream words(line);
+    Rule rule;
+    std::string op;
+    if (!(words >> rule.name))
+      continue;
+    std::string where = "line " + std::to_string(number) + ": ";
+    if (!(words >> rule.lhs >> op >> rule.rhs))
+      throw std::invalid_argument(where + "expected <name> <lhs> <op> <rhs>");
+
+    if (op == "<")
+      rule.op = Rule::Op::LESS;
+    else if (op == "<=")
+      rule.op = Rule::Op::LESS_EQUAL;
+    else if (op == ">")
+      rule.op = Rule::Op::GREATER;
+    else if (op == ">=")
+      rule.op = Rule::Op::GREATER_EQUAL;
+    else
+      throw std::invalid_argument(where + "unknown operator '" + op + "'");
+
+    try {
+      checkTerm(rule.lhs);
+      checkTerm(rule.rhs);
+    } catch (const std::invalid_argument &e) {
+      throw std::invalid_argument(where + e.what());
+    }
+
+    std::string key, word;
+    while (words >> key) {
+      if (!(words >> word))
+        throw std::invalid_argument(where + "value expected after " + key);
+      double value = 0.0;
+      if (key == "severity") {
+        if (word == "info")
+          rule.severity = Rule::Severity::INFO;
+        else if (word == "warn")
+          rule.severity = Rule::Severity::WARN;
+        else if (word == "error")
+          rule.severity = Rule::Severity::ERROR;
+        else
+          throw std::invalid_argument(where + "unknown severity '" + word +
+                                      "'");
+      } else if (key != "for" && key != "hysteresis") {
+        throw std::invalid_argument(where + "unknown field '" + key + "'");
+      } else if (!parseNumber(word, value) || !(value >= 0.0)) {
+        throw std::invalid_argument(where + key +
+                                    " needs a non-negative number");
+      } else {
+        (key == "for" ? rule.duration : rule.hysteresis) = value;
+      }
+    }
+
+    for (const Rule &r : rules)
+      if (r.name == rule.name)
+        throw std::invalid_argument(where + "rule '" + rule.name +
+                                    "' defined twice");
+    rules.push_back(rule);
+  }
+  return rules;
+}
+
+std::vector<Rule> loadRules(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::invalid_argument("cannot open " + path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return parseRules(text.str());
+}
+
+// --------------------------------------------------
+// COMPILATION
+// --------------------------------------------------
+
+RuleMonitor::RuleMonitor(const std::vector<Rule> &rules_, double dt)
+    : rules(rules_), dt(dt) {
+  size_t n = rules.size();
+  std::vector<int> rule_table(n);
+  std::vector<double> on(n), off(n);
+  for (size_t r = 0; r < n; r++) {
+    const Rule &rule = rules[r];
+    lhs_slot.push_back(compile(rule.lhs));
+    rhs_slot.push_back(compile(rule.rhs));
+
+    // A rule on lhs against a constant rhs thresholds the lhs slot;
+    // against anything else, the lhs - rhs slot at zero
+    int slot = lhs_slot[r];
+    double threshold = 0.0;
+    if (slot_constant[rhs_slot[r]])
+      threshold = slots[rhs_slot[r]];
+    else
+      slot = difference(lhs_slot[r], rhs_slot[r]);
+
+    // Fold the direction into a sign and strictness into the thresholds:
+    // y >= t is y > nextafter(t, -inf); y <= t - h is y < nextafter(...)
+    bool less = rule.op == Rule::Op::LESS || rule.op == Rule::Op::LESS_EQUAL;
+    bool strict = rule.op == Rule::Op::LESS || rule.op == Rule::Op::GREATER;
+    double sign = less ? -1.0 : 1.0;
+    double t = sign * threshold;
+    double inf = std::numeric_limits<double>::infinity();
+    on[r] = strict ? t : std::nextafter(t, -inf);
+    off[r] = strict ? std::nextafter(t - rule.hysteresis, inf)
+                    : t - rule.hysteresis;
+
+    size_t k = 0;
+    while (k < tables.size() &&
+           !(tables[k].slot == slot && tables[k].sign == sign))
+      k++;
+    if (k == tables.size())
+      tables.push_back({slot, sign, 0, 0});
+    rule_table[r] = int(k);
+
+    // At least one step; the small slack keeps e.g. 0.01 s at 100 steps
+    int64_t steps = int64_t(std::ceil(rule.duration / dt - 1e-9));
+    need_steps.push_back(steps > 1 ? steps : 1);
+  }
+  slot_terms.clear();
+  slot_constant.clear();
+
+  for (size_t k = 0; k < tables.size(); k++) {
+    Table &table = tables[k];
+    std::vector<int> members;
+    for (size_t r = 0; r < n; r++)
+      if (rule_table[r] == int(k))
+        members.push_back(int(r));
+    table.begin = int(on_rule.size());
+    table.end = table.begin + int(members.size());
+
+    std::sort(members.begin(), members.end(),
+              [&](int a, int b) { return on[a] < on[b]; });
+    for (int r : members) {
+      on_rule.push_back(r);
+      on_threshold.push_back(on[r]);
+    }
+    std::sort(members.begin(), members.end(),
+              [&](int a, int b) { return off[a] < off[b]; });
+    for (int r : members) {
+      clear_rule.push_back(r);
+      clear_threshold.push_back(off[r]);
+    }
+    setBounds(table);
+  }
+
+  onset.assign(n, -1);
+  active.assign(n, 0);
+  pending.reserve(n);
+  raised_count.assign(n, 0);
+  active_steps.assign(n, 0);
+  active_since.assign(n, 0);
+  events.reserve(1024);
+}
+
+int RuleMonitor::compile(const std::string &term) {
+  for (size_t s = 0; s < slot_terms.size(); s++)
+    if (slot_terms[s] == term)
+      return int(s);
+
+  std::string arg;
+  std::string fn = functionOf(term, arg);
+  int src = fn.empty() ? -1 : compile(arg);
+
+  int slot = int(slots.size());
+  slots.push_back(0.0);
+  slot_terms.push_back(term);
+  slot_constant.push_back(0);
+  if (!fn.empty()) {
+    OpCode code = fn == "abs"   ? OpCode::ABS
+                  : fn == "pos" ? OpCode::POS
+                  : fn == "neg" ? OpCode::NEG
+                                : OpCode::INTEGRAL;
+    program.push_back({code, src, -1, slot});
+  } else if (findTelemetryChannel(term) >= 0) {
+    channels.push_back(findTelemetryChannel(term));
+    channel_slots.push_back(slot);
+  } else {
+    parseConstant(term, slots[slot]); // checked by parseRules
+    slot_constant[slot] = 1;
+  }
+  return slot;
+}
+
+int RuleMonitor::difference(int a, int b) {
+  std::string term = slot_terms[a] + " - " + slot_terms[b];
+  for (size_t s = 0; s < slot_terms.size(); s++)
+    if (slot_terms[s] == term)
+      return int(s);
+  int slot = int(slots.size());
+  slots.push_back(0.0);
+  slot_terms.push_back(term);
+  slot_constant.push_back(0);
+  program.push_back({OpCode::DIFFERENCE, a, b, slot});
+  return slot;
+}
+
+// --------------------------------------------------
+// EVALUATION
+// --------------------------------------------------
+
+void RuleMonitor::record(int64_t step, const ICEEngine &engine) {
+  double *v = slots.data();
+  for (size_t c = 0; c < channels.size(); c++)
+    v[channel_slots[c]] = telemetryChannels[channels[c]].sample(engine);
+
+  for (const Operation &op : program) {
+    double x = v[op.src];
+    switch (op.code) {
+    case OpCode::ABS:
+      v[op.dst] = std::fabs(x);
+      break;
+    case OpCode::POS:
+      v[op.dst] = x > 0.0 ? x : 0.0;
+      break;
+    case OpCode::NEG:
+      v[op.dst] = x < 0.0 ? -x : 0.0;
+      break;
+    case OpCode::INTEGRAL:
+      v[op.dst] += x * dt;
+      break;
+    case OpCode::DIFFERENCE:
+      v[op.dst] = x - v[op.src2];
+      break;
+    }
+  }
+
+  // Move each table's cursors to the new value, for tables whose value
+  // left the interval between its neighbouring thresholds. NaN is neither
+  // over nor clear: pending raises are dropped and active rules stay
+  // active.
+  for (Table &t : tables) {
+    double y = t.sign * v[t.slot];
+    if (y > t.on_below && y <= t.on_above && y >= t.clear_below &&
+        y < t.clear_above)
+      continue;
+    const double *on = &on_threshold[t.begin];
+    const int *on_r = &on_rule[t.begin];
+    int size = t.end - t.begin;
+    int k = t.over_count;
+    while (k < size && on[k] < y) {
+      int r = on_r[k++];
+      onset[r] = step;
+      if (active[r])
+        continue;
+      if (need_steps[r] == 1)
+        raise(r, step);
+      else
+        pending.push_back(r);
+    }
+    while (k > 0 && !(on[k - 1] < y))
+      onset[on_r[--k]] = -1;
+    t.over_count = k;
+
+    if (y == y) {
+      const double *off = &clear_threshold[t.begin];
+      const int *off_r = &clear_rule[t.begin];
+      int j = t.kept_count;
+      while (j < size && off[j] <= y)
+        j++;
+      while (j > 0 && off[j - 1] > y) {
+        int r = off_r[--j];
+        if (active[r])
+          clear(r, step);
+      }
+      t.kept_count = j;
+    }
+    setBounds(t);
+  }
+
+  for (size_t p = 0; p < pending.size();) {
+    int r = pending[p];
+    bool done = onset[r] < 0 || active[r];
+    if (!done && step - onset[r] + 1 >= need_steps[r]) {
+      raise(r, step);
+      done = true;
+    }
+    if (done) {
+      pending[p] = pending.back();
+      pending.pop_back();
+    } else {
+      p++;
+    }
+  }
+  last_step = step;
+}
+
+void RuleMonitor::setBounds(Table &t) const {
+  double inf = std::numeric_limits<double>::infinity();
+  int size = t.end - t.begin;
+  const double *on = &on_threshold[t.begin];
+  const double *off = &clear_threshold[t.begin];
+  t.on_below = t.over_count > 0 ? on[t.over_count - 1] : -inf;
+  t.on_above = t.over_count < size ? on[t.over_count] : inf;
+  t.clear_below = t.kept_count > 0 ? off[t.kept_count - 1] : -inf;
+  t.clear_above = t.kept_count < size ? off[t.kept_count] : inf;
+}
+
+void RuleMonitor::raise(int r, int64_t step) {
+  active[r] = 1;
+  raised_count[r]++;
+  active_since[r] = step;
+  events.push_back({step, onset[r], r, true, slots[lhs_slot[r]],
+                    slots[rhs_slot[r]]});
+}
+
+void RuleMonitor::clear(int r, int64_t step) {
+  active[r] = 0;
+  active_steps[r] += step - active_since[r];
+  events.push_back(
+      {step, step, r, false, slots[lhs_slot[r]], slots[rhs_slot[r]]});
+}
+
+double RuleMonitor::getActiveSeconds(int rule) const {
+  int64_t steps = active_steps[rule];
+  if (active[rule])
+    steps += last_step + 1 - active_since[rule];
+  return double(steps) * dt;
+}
+
+void RuleMonitor::write(const std::string &path) const {
+  FILE *out = std::fopen(path.c_str(), "w");
+  if (!out)
+    throw std::runtime_error("cannot write " + path);
+  std::fprintf(out, "time,rule,event,severity,value,threshold,onset\n");
+  for (const RuleEvent &e : events) {
+    const Rule &rule = rules[e.rule];
+    std::fprintf(out, "%.6f,%s,%s,%s,%.9g,%.9g,%.6f\n", e.step * dt,
+                 rule.name.c_str(), e.raised ? "raised" : "cleared",
+                 severityName(rule.severity), e.value, e.threshold,
+                 e.onset_step * dt);
+  }
+  bool failed = std::ferror(out) != 0;
+  if (std::fclose(out) != 0 || failed)
+    throw std::runtime_error("cannot write " + path);
+}
@@ -0,0 +1,18 @@
+#include "../include/scenario.hpp"
+
+double Scenario::throttleAt(double t) const {
+  if (throttle.empty())
+    return 0.0;
+  if (t <= throttle.front().time)
+    return throttle.front().throttle;
+
+  for (size_t i = 1; i < throttle.size(); i++) {
+    const ThrottlePoint &a = throttle[i - 1];
+    const ThrottlePoint &b = throttle[i];
+    if (t < b.time) {
+      double span = b.time - a.time;
+      return a.throttle + (b.throttle - a.throttle) * (t - a.time) / span;
+    }
+  }
+  return throttle.back().throttle;
+}
@@ -0,0 +1,84 @@
+#include "../include/sensitivity.hpp"
+#include "../include/dual.hpp"
+#include "../include/ice_engine.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+const char *const RunOutputs::names[RunOutputs::count] = {
+    "energy_J",      // ∫ total (ICE + MGU-K) power dt
+    "fuel_kg",       // ∫ fuel mass flow dt
+    "peak_boost_Pa", // max compressor outlet pressure
+    "final_rpm",     // crank speed at end of run
+    "final_soc",     // battery SOC at end of run
+};
+
+template <typename T>
+static std::vector<T> runOutputs(const BasicEngineParams<T> &params,
+                                 const Scenario &scenario) {
+  BasicICEEngine<T> engine(params);
+
+  T energy = 0.0;
+  T fuel = 0.0;
+  T peak_boost = engine.getBoostPressure();
+
+  for (int i = 0; i < scenario.iterations; i++) {
+    engine.setThrottle(scenario.throttleAt(i * scenario.dt));
+    engine.update(scenario.dt);
+
+    energy += engine.getTotalPower() * scenario.dt;
+    fuel += engine.getFuelMassFlow() * scenario.dt;
+    peak_boost = ad::max(peak_boost, engine.getBoostPressure());
+  }
+
+  return {energy, fuel, peak_boost, engine.getRPM(), engine.getBatterySOC()};
+}
+
+std::vector<double> evaluateOutputs(const EngineParams &params,
+                                    const Scenario &scenario) {
+  return runOutputs(params, scenario);
+}
+
+SensitivityReport
+computeSensitivities(const EngineParams &params,
+                     const std::vector<std::string> &parameters,
+                     const Scenario &scenario) {
+  // Resolve names up front so a typo fails before any model run
+  std::vector<double> base_values;
+  for (const std::string &name : parameters) {
+    EngineParams probe = params;
+    double *field = findParameter(probe, name);
+    if (!field)
+      throw std::invalid_argument("unknown parameter: " + name);
+    base_values.push_back(*field);
+  }
+
+  SensitivityReport report;
+  report.parameters = parameters;
+  report.values.assign(RunOutputs::count, 0.0);
+  report.derivatives.assign(RunOutputs::count,
+                            std::vector<double>(parameters.size(), 0.0));
+
+  BasicEngineParams<ad::ModelDual> dual_params =
+      castParams<ad::ModelDual>(params);
+
+  size_t first = 0;
+  do {
+    BasicEngineParams<ad::ModelDual> seeded = dual_params;
+    size_t count = std::min<size_t>(ad::kModelDirections,
+                                    parameters.size() - first);
+    for (size_t j = 0; j < count; j++) {
+      *findParameter(seeded, parameters[first + j]) =
+          ad::ModelDual::variable(base_values[first + j], int(j));
+    }
+
+    std::vector<ad::ModelDual> out = runOutputs(seeded, scenario);
+    for (int o = 0; o < RunOutputs::count; o++) {
+      report.values[o] = out[o].v;
+      for (size_t j = 0; j < count; j++)
+        report.derivatives[o][first + j] = out[o].d[j];
+    }
+    first += count;
+  } while (first < parameters.size());
+
+  return report;
+}
@@ -0,0 +1,506 @@
+#include "../include/sweep.hpp"
+#include "../include/job.hpp"
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// --------------------------------------------------
+// SWEEP DEFINITION
+// --------------------------------------------------
+
+SweepPlan parseSweep(const std::string &text) {
+  std::string base;
+  std::vector<std::vector<std::string>> axes;
+  std::vector<std::string> explicit_jobs;
+  SweepPlan plan;
+
+  std::istringstream lines(text);
+  std::string line;
+  int number = 0;
+  while (std::getline(lines, line)) {
+    number++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos)
+      line.resize(hash);
+    std::istringstream words(line);
+    std::string directive;
+    if (!(words >> directive))
+      continue;
+
+    std::string rest;
+    std::getline(words, rest);
+    if (directive == "base") {
+      base += rest;
+    } else if (directive == "job") {
+      explicit_jobs.push_back(rest);
+    } else if (directive == "vary") {
+      std::istringstream values(rest);
+      std::string key, value;
+      values >> key;
+      std::vector<std::string> axis;
+      while (values >> value)
+        axis.push_back(value);
+      if (key.empty() || axis.empty())
+        throw std::invalid_argument("line " + std::to_string(number) +
+                                    ": vary needs a field and values");
+      plan.keys.push_back(key);
+      axes.push_back(axis);
+    } else {
+      throw std::invalid_argument("line " + std::to_string(number) +
+                                  ": unknown directive '" + directive + "'");
+    }
+  }
+
+  // Full grid, last key fastest; the base alone when nothing varies and
+  // no jobs are listed
+  if (!axes.empty() || explicit_jobs.empty()) {
+    std::vector<size_t> at(axes.size(), 0);
+    for (;;) {
+      SweepPlan::Point p;
+      p.job = base;
+      for (size_t k = 0; k < axes.size(); k++) {
+        p.values.push_back(axes[k][at[k]]);
+        p.job += " " + plan.keys[k] + "=" + axes[k][at[k]];
+      }
+      plan.points.push_back(p);
+
+      size_t k = axes.size();
+      while (k > 0 && ++at[k - 1] == axes[k - 1].size())
+        at[--k] = 0;
+      if (k == 0)
+        break;
+    }
+  }
+  for (const std::string &job : explicit_jobs)
+    plan.points.push_back(
+        {std::vector<std::string>(plan.keys.size()), base + " " + job});
+  for (SweepPlan::Point &p : plan.points)
+    p.job.erase(0, p.job.find_first_not_of(" \t"));
+
+  // Every job must parse, and all must report the same outputs so the
+  // merged table has one set of columns
+  std::vector<std::string> outputs;
+  for (size_t i = 0; i < plan.points.size(); i++) {
+    std::vector<std::string> names = jobOutputs(parseJob(plan.points[i].job));
+    if (i == 0)
+      outputs = names;
+    else if (names != outputs)
+      throw std::invalid_argument("sweep jobs must all list the same outputs");
+  }
+  return plan;
+}
+
+SweepPlan loadSweep(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::invalid_argument("cannot open " + path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return parseSweep(text.str());
+}
+
+// --------------------------------------------------
+// FILES
+// --------------------------------------------------
+
+static const char *const kQueueDirs[] = {"pending", "leased",  "done",
+                                         "failed",  "results", "clock"};
+
+static std::string shardName(int shard) {
+  char name[16];
+  std::snprintf(name, sizeof name, "%05d", shard);
+  return name;
+}
+
+// "<shard>.a<attempt>[.<worker>]"
+static std::string shardOf(const std::string &entry) {
+  return entry.substr(0, entry.find('.'));
+}
+
+static int attemptOf(const std::string &entry) {
+  size_t a = entry.find(".a");
+  return a == std::string::npos ? 1 : std::atoi(entry.c_str() + a + 2);
+}
+
+// Written under a temporary name and renamed into place, so readers on
+// any node see either nothing or the whole file
+static void writeAtomically(const std::string &path,
+                            const std::string &contents) {
+  std::string tmp = path + ".tmp" + std::to_string(getpid()) + "-" +
+                    std::to_string(std::hash<std::thread::id>()(
+                        std::this_thread::get_id()));
+  FILE *f = std::fopen(tmp.c_str(), "w");
+  bool ok = f && std::fwrite(contents.data(), 1, contents.size(), f) ==
+                     contents.size();
+  if (f)
+    ok = std::fclose(f) == 0 && ok;
+  if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+static std::vector<std::string> listDir(const std::string &dir) {
+  std::vector<std::string> names;
+  std::error_code ec;
+  for (const fs::directory_entry &e : fs::directory_iterator(dir, ec)) {
+    std::string name = e.path().filename().string();
+    if (name.find(".tmp") == std::string::npos)
+      names.push_back(name);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+static double modifiedTime(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return -1.0;
+  return double(st.st_mtim.tv_sec) + 1e-9 * double(st.st_mtim.tv_nsec);
+}
+
+static void touch(const std::string &path) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd >= 0)
+    close(fd);
+  utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+}
+
+// Current time as the shared filesystem sees it (lease ages are compared
+// against file mtimes, so node clocks need not agree)
+static double filesystemNow(const std::string &clock_file) {
+  touch(clock_file);
+  return modifiedTime(clock_file);
+}
+
+static std::string csvField(const std::string &text) {
+  if (text.find_first_of(",\"") == std::string::npos)
+    return text;
+  std::string quoted = "\"";
+  for (char c : text)
+    quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+  return quoted + "\"";
+}
+
+// --------------------------------------------------
+// COORDINATOR
+// --------------------------------------------------
+
+int planSweep(const std::string &dir, const SweepPlan &plan, int shard_size) {
+  if (shard_size < 1)
+    throw std::invalid_argument("shard size must be at least 1");
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (ec || !fs::is_empty(dir, ec))
+    throw std::runtime_error(dir + ": not an empty directory");
+  for (const char *sub : kQueueDirs)
+    if (!fs::create_directory(dir + "/" + sub, ec))
+      throw std::runtime_error("cannot create " + dir + "/" + sub);
+
+  std::string jobs = "keys";
+  for (const std::string &key : plan.keys)
+    jobs += "\t" + key;
+  jobs += "\n";
+  for (size_t i = 0; i < plan.points.size(); i++) {
+    jobs += std::to_string(i);
+    for (const std::string &v : plan.points[i].values)
+      jobs += "\t" + v;
+    jobs += "\t" + plan.points[i].job + "\n";
+  }
+  writeAtomically(dir + "/jobs.txt", jobs);
+
+  int shards = 0;
+  for (size_t first = 0; first < plan.points.size(); first += shard_size) {
+    std::string text;
+    size_t last = std::min(plan.points.size(), first + size_t(shard_size));
+    for (size_t i = first; i < last; i++)
+      text += std::to_string(i) + "\t" + plan.points[i].job + "\n";
+    writeAtomically(dir + "/pending/" + shardName(shards++) + ".a1", text);
+  }
+  return shards;
+}
+
+SweepStatus sweepStatus(const std::string &dir, double lease_seconds) {
+  SweepStatus s;
+  s.pending = int(listDir(dir + "/pending").size());
+  s.done = int(listDir(dir + "/done").size());
+  s.failed = int(listDir(dir + "/failed").size());
+
+  double now = filesystemNow(dir + "/clock/status-" +
+                             std::to_string(getpid()));
+  for (const std::string &name : listDir(dir + "/leased")) {
+    s.leased++;
+    double mtime = modifiedTime(dir + "/leased/" + name);
+    if (mtime >= 0.0 && now - mtime > lease_seconds)
+      s.stale++;
+  }
+  s.shards = s.pending + s.leased + s.done + s.failed;
+  return s;
+}
+
+// --------------------------------------------------
+// WORKER
+// --------------------------------------------------
+
+static std::string defaultWorkerId() {
+  char host[256] = "localhost";
+  gethostname(host, sizeof host - 1);
+  std::string id = std::string(host) + "-" + std::to_string(getpid());
+  for (char &c : id)
+    if (!std::isalnum((unsigned char)c) && c != '-' && c != '_')
+      c = '-';
+  return id;
+}
+
+// Moves abandoned leases back to pending (or to failed after the last
+// attempt). Returns how many this call moved.
+static int reclaimStale(const std::string &dir, const std::string &clock,
+                        const SweepWorkerOptions &options) {
+  double now = filesystemNow(clock);
+  int moved = 0;
+  for (const std::string &name : listDir(dir + "/leased")) {
+    std::string from = dir + "/leased/" + name;
+    double mtime = modifiedTime(from);
+    if (mtime < 0.0 || now - mtime <= options.lease_seconds)
+      continue;
+    int attempt = attemptOf(name);
+    std::string to =
+        attempt >= options.max_attempts
+            ? dir + "/failed/" + shardOf(name)
+            : dir + "/pending/" + shardOf(name) + ".a" +
+                  std::to_string(attempt + 1);
+    if (std::rename(from.c_str(), to.c_str()) == 0)
+      moved++;
+  }
+  return moved;
+}
+
+// Runs one leased shard, heartbeating the lease while it works. Returns
+// false if the lease was lost before the shard was marked done.
+static bool runShard(const std::string &dir, const std::string &lease,
+                     const std::string &shard,
+                     const SweepWorkerOptions &options, ThreadPool &pool,
+                     SweepWorkerReport &report) {
+  std::vector<long> indices;
+  std::vector<std::string> texts;
+  {
+    std::ifstream in(lease);
+    std::string line;
+    while (std::getline(in, line)) {
+      size_t tab = line.find('\t');
+      if (tab == std::string::npos)
+        continue;
+      indices.push_back(std::atol(line.c_str()));
+      texts.push_back(line.substr(tab + 1));
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool finished = false;
+  std::thread heartbeat([&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto period = std::chrono::duration<double>(options.lease_seconds / 4.0);
+    while (!wake.wait_for(lock, period, [&] { return finished; }))
+      utimensat(AT_FDCWD, lease.c_str(), nullptr, 0);
+  });
+
+  std::vector<std::string> rows(texts.size());
+  std::vector<std::string> header(texts.size());
+  std::vector<char> failed(texts.size(), 0);
+  try {
+    pool.parallelFor(int(texts.size()), [&](int i) {
+      std::string row = std::to_string(indices[i]);
+      try {
+        SimulationJob job = parseJob(texts[i]);
+        std::vector<double> values = runJob(job);
+        char number[32];
+        row += ",ok";
+        for (double v : values) {
+          std::snprintf(number, sizeof number, ",%.17g", v);
+          row += number;
+        }
+        for (const std::string &name : jobOutputs(job))
+          header[i] += "," + name;
+      } catch (const std::exception &e) {
+        std::string why = e.what();
+        std::replace(why.begin(), why.end(), ',', ';');
+        std::replace(why.begin(), why.end(), '\n', ' ');
+        row += ",error: " + why;
+        failed[i] = 1;
+      }
+      rows[i] = row;
+    });
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished = true;
+    }
+    wake.notify_all();
+    heartbeat.join();
+    throw;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  wake.notify_all();
+  heartbeat.join();
+
+  std::string columns;
+  for (const std::string &h : header)
+    if (!h.empty())
+      columns = h;
+  std::string text = "index,status" + columns + "\n";
+  for (const std::string &row : rows)
+    text += row + "\n";
+  writeAtomically(dir + "/results/" + shard + ".csv", text);
+
+  report.jobs += int(texts.size());
+  report.job_errors += int(std::count(failed.begin(), failed.end(), 1));
+  std::string done = dir + "/done/" + shard;
+  return std::rename(lease.c_str(), done.c_str()) == 0;
+}
+
+SweepWorkerReport runSweepWorker(const std::string &dir,
+                                 const SweepWorkerOptions &opts) {
+  SweepWorkerOptions options = opts;
+  if (options.worker_id.empty())
+    options.worker_id = defaultWorkerId();
+  if (!(options.lease_seconds > 0.0) || options.max_attempts < 1)
+    throw std::invalid_argument("lease time and attempts must be positive");
+  if (!fs::is_directory(dir + "/pending"))
+    throw std::runtime_error(dir + ": not a sweep directory");
+
+  std::string clock = dir + "/clock/" + options.worker_id;
+  ThreadPool pool(options.threads);
+  SweepWorkerReport report;
+
+  for (;;) {
+    report.reclaimed += reclaimStale(dir, clock, options);
+
+    // Start at a worker-dependent shard so concurrent workers rarely race
+    // for the same file; a lost race is just a failed rename
+    std::vector<std::string> pending = listDir(dir + "/pending");
+    size_t offset = pending.empty() ? 0
+                                    : std::hash<std::string>()(
+                                          options.worker_id) %
+                                          pending.size();
+    bool claimed = false;
+    for (size_t k = 0; k < pending.size() && !claimed; k++) {
+      const std::string &name = pending[(offset + k) % pending.size()];
+      std::string from = dir + "/pending/" + name;
+      std::string lease =
+          dir + "/leased/" + name + "." + options.worker_id;
+      // Fresh mtime first: the rename keeps it, and a shard planned long
+      // ago must not look like an abandoned lease
+      utimensat(AT_FDCWD, from.c_str(), nullptr, 0);
+      if (std::rename(from.c_str(), lease.c_str()) != 0)
+        continue;
+      claimed = true;
+
+      std::string shard = shardOf(name);
+      if (fs::exists(dir + "/results/" + shard + ".csv")) {
+        // Finished by a worker whose lease had been reclaimed
+        std::rename(lease.c_str(), (dir + "/done/" + shard).c_str());
+      } else if (runShard(dir, lease, shard, options, pool, report)) {
+        report.shards++;
+      } else {
+        report.lost++;
+      }
+    }
+    if (claimed)
+      continue;
+
+    if (listDir(dir + "/leased").empty())
+      break; // nothing pending, nothing in flight
+    std::this_thread::sleep_for(
+        std::chrono::duration<double>(options.poll_seconds));
+  }
+  std::remove(clock.c_str());
+  return report;
+}
+
+// --------------------------------------------------
+// MERGE
+// --------------------------------------------------
+
+size_t mergeSweep(const std::string &dir, const std::string &out_path) {
+  std::ifstream jobs(dir + "/jobs.txt");
+  if (!jobs)
+    throw std::runtime_error(dir + ": not a sweep directory");
+
+  // index -> result row (without its index field)
+  std::map<long, std::string> results;
+  std::string columns;
+  for (const std::string &name : listDir(dir + "/results")) {
+    std::ifstream in(dir + "/results/" + name);
+    std::string line;
+    std::getline(in, line);
+    // A shard whose jobs all failed has no output columns
+    std::string header = line.substr(line.find(',') + 1);
+    if (columns.empty() || columns == "status")
+      columns = header;
+    else if (header != columns && header != "status")
+      throw std::runtime_error(name + ": output columns differ");
+    while (std::getline(in, line))
+      if (!line.empty())
+        results[std::atol(line.c_str())] = line.substr(line.find(',') + 1);
+  }
+
+  std::string line;
+  std::getline(jobs, line); // "keys\t..."
+  std::string out = "index";
+  {
+    std::istringstream keys(line);
+    std::string key;
+    std::getline(keys, key, '\t');
+    while (std::getline(keys, key, '\t'))
+      out += "," + csvField(key);
+  }
+  out += "," + (columns.empty() ? std::string("status") : columns) + "\n";
+
+  size_t rows = 0, missing = 0;
+  while (std::getline(jobs, line)) {
+    std::vector<std::string> fields;
+    std::istringstream in(line);
+    std::string field;
+    while (std::getline(in, field, '\t'))
+      fields.push_back(field);
+    if (fields.size() < 2)
+      continue;
+    long index = std::atol(fields[0].c_str());
+    auto found = results.find(index);
+    if (found == results.end()) {
+      missing++;
+      continue;
+    }
+    out += fields[0];
+    for (size_t k = 1; k + 1 < fields.size(); k++) // varied values
+      out += "," + csvField(fields[k]);
+    out += "," + found->second + "\n";
+    rows++;
+  }
+  if (missing > 0)
+    throw std::runtime_error(std::to_string(missing) +
+                             " jobs have no results yet (shards pending, "
+                             "leased or failed)");
+  writeAtomically(out_path, out);
+  return rows;
+}
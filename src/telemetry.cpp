@@ -0,0 +1,357 @@
+#include "../include/telemetry.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+// --------------------------------------------------
+// CHANNEL TABLE
+// --------------------------------------------------
+
+#define CHANNEL(name, expr)                                                    \
+  {                                                                            \
+    name, [](const ICEEngine &e) -> double { return expr; }                    \
+  }
+
+const TelemetryChannel telemetryChannels[kTelemetryChannels] = {
+    // Engine speed and throttle
+    CHANNEL("rpm", e.getRPM()),
+    CHANNEL("omega", e.getAngularVelocity()),
+    CHANNEL("throttle", e.getThrottle()),
+    CHANNEL("effective_throttle", e.getEffectiveThrottle()),
+    // Torque breakdown (Nm)
+    CHANNEL("indicated_torque", e.getIndicatedTorque()),
+    CHANNEL("combustion_torque", e.getCombustionTorque()),
+    CHANNEL("friction_torque", e.getFrictionTorque()),
+    CHANNEL("pumping_torque", e.getPumpingTorque()),
+    CHANNEL("load_torque", e.getLoadTorque()),
+    CHANNEL("mguk_torque", e.getMGUKTorque()),
+    CHANNEL("mguh_torque", e.getMGUHTorque()),
+    CHANNEL("net_torque", e.getNetTorque()),
+    CHANNEL("torque_output", e.getTorqueOutput()),
+    // Power breakdown (W)
+    CHANNEL("ice_power", e.getICEPower()),
+    CHANNEL("mguk_power", e.getMGUKPower()),
+    CHANNEL("mguh_power", e.getMGUHPower()),
+    CHANNEL("total_power", e.getTotalPower()),
+    // Mean effective pressures (kPa)
+    CHANNEL("imep", e.getIMEP() / 1000.0),
+    CHANNEL("bmep", e.getBMEP() / 1000.0),
+    CHANNEL("fmep", e.getFMEP() / 1000.0),
+    // Efficiency metrics
+    CHANNEL("thermal_efficiency", e.getThermalEfficiency()),
+    CHANNEL("mechanical_efficiency", e.getMechanicalEfficiency()),
+    CHANNEL("bsfc", e.getBSFC()),
+    CHANNEL("volumetric_efficiency", e.getVolumetricEfficiency()),
+    // Intake system (Pa and K)
+    CHANNEL("plenum_pressure", e.getPlenumPressure()),
+    CHANNEL("intake_manifold_pressure", e.getIntakeManifoldPressure()),
+    CHANNEL("intake_manifold_temp", e.getIntakeManifoldTemperature()),
+    CHANNEL("boost_pressure", e.getBoostPressure()),
+    CHANNEL("compressor_outlet_temp", e.getCompressorOutletTemperature()),
+    // Exhaust system (Pa, K, kg/s)
+    CHANNEL("exhaust_manifold_pressure", e.getExhaustManifoldPressure()),
+    CHANNEL("exhaust_temp", e.getExhaustTemperature()),
+    CHANNEL("exhaust_mass_flow", e.getExhaustMassFlowRate()),
+    // Airflow and fuel (kg/s)
+    CHANNEL("na_air_flow", e.getNAAirFlow()),
+    CHANNEL("actual_air_flow", e.getActualAirFlow()),
+    CHANNEL("turbo_air_flow", e.getAirMassFlow()),
+    CHANNEL("fuel_mass_flow", e.getFuelMassFlow()),
+    // Turbo (rad/s and RPM)
+    CHANNEL("turbo_speed", e.getTurboSpeed()),
+    CHANNEL("turbo_speed_rpm", e.getTurboSpeedRPM()),
+    // Battery / ERS (J and fraction)
+    CHANNEL("battery_energy", e.getBatteryEnergy()),
+    CHANNEL("battery_soc", e.getBatterySOC()),
+};
+
+#undef CHANNEL
+
+std::vector<std::string> telemetryChannelNames() {
+  std::vector<std::string> names;
+  for (const TelemetryChannel &c : telemetryChannels)
+    names.push_back(c.name);
+  return names;
+}
+
+int findTelemetryChannel(const std::string &name) {
+  for (int c = 0; c < kTelemetryChannels; c++)
+    if (name == telemetryChannels[c].name)
+      return c;
+  return -1;
+}
+
+void sampleTelemetry(const ICEEngine &engine, double *out) {
+  for (int c = 0; c < kTelemetryChannels; c++)
+    out[c] = telemetryChannels[c].sample(engine);
+}
+
+// --------------------------------------------------
+// CSV
+// --------------------------------------------------
+
+CsvTelemetryWriter::CsvTelemetryWriter(const std::string &path,
+                                       const std::vector<std::string> &channels,
+                                       double dt)
+    : out(path), channel_count(channels.size()), dt(dt) {
+  std::string header = "time";
+  for (const std::string &name : channels)
+    header += "," + name;
+  header += "\n";
+  out << header;
+  bytes += header.size();
+}
+
+void CsvTelemetryWriter::write(int64_t step, const double *values) {
+  // Same text as std::fixed << std::setprecision(6)
+  char buf[64];
+  line.clear();
+  int n = std::snprintf(buf, sizeof buf, "%.6f", step * dt);
+  line.append(buf, size_t(n));
+  for (size_t c = 0; c < channel_count; c++) {
+    n = std::snprintf(buf, sizeof buf, ",%.6f", values[c]);
+    line.append(buf, size_t(n));
+  }
+  line += '\n';
+  out.write(line.data(), std::streamsize(line.size()));
+  bytes += line.size();
+}
+
+void CsvTelemetryWriter::close() { out.close(); }
+
+uint64_t CsvTelemetryWriter::bytesWritten() const { return bytes; }
+
+// --------------------------------------------------
+// COMPRESSED (.f1pz)
+// --------------------------------------------------
+
+static void putBytes(std::ofstream &out, uint64_t &count, const void *data,
+                     size_t size) {
+  out.write(static_cast<const char *>(data), std::streamsize(size));
+  count += size;
+}
+
+static void putLE(std::ofstream &out, uint64_t &count, uint64_t v, int size) {
+  uint8_t buf[8];
+  for (int i = 0; i < size; i++)
+    buf[i] = uint8_t(v >> (8 * i));
+  putBytes(out, count, buf, size_t(size));
+}
+
+CompressedTelemetryWriter::CompressedTelemetryWriter(
+    const std::string &path, const std::vector<std::string> &channels,
+    double dt, TelemetryCoding coding)
+    : out(path, std::ios::binary), coding(coding),
+      xor_encoders(channels.size()), dod_encoders(channels.size()),
+      channel_bits(channels.size()) {
+  uint64_t dt_bits;
+  std::memcpy(&dt_bits, &dt, sizeof dt_bits);
+
+  putBytes(out, bytes, "F1PZ", 4);
+  putLE(out, bytes, 1, 2); // version
+  putLE(out, bytes, channels.size(), 2);
+  putLE(out, bytes, uint64_t(coding), 1);
+  putLE(out, bytes, dt_bits, 8);
+  for (const std::string &name : channels) {
+    size_t len = name.size() < 255 ? name.size() : 255;
+    putLE(out, bytes, len, 1);
+    putBytes(out, bytes, name.data(), len);
+  }
+}
+
+CompressedTelemetryWriter::~CompressedTelemetryWriter() { close(); }
+
+// v in millionths, rounded the way printf("%.6f") rounds v: to nearest on
+// the exact binary value, ties to even. When the product v * 1e6 itself
+// rounds onto a half, its fma residual says which side the exact one is.
+// Values with the sign bit set are stored one lower, so that those which
+// print as -0.000000 keep their sign.
+static int64_t toMicro(double v) {
+  double p = v * 1e6;
+  if (!(std::fabs(p) < 0x1p52))
+    throw std::domain_error("MICRO telemetry coding needs finite values "
+                            "below 4.5e9 in magnitude");
+  double k = std::nearbyint(p);
+  double residual = std::fma(v, 1e6, -p);
+  if (p - k == 0.5 && residual > 0.0)
+    k += 1.0;
+  else if (p - k == -0.5 && residual < 0.0)
+    k -= 1.0;
+  return std::signbit(v) ? int64_t(k) - 1 : int64_t(k);
+}
+
+static double fromMicro(int64_t q) {
+  return q < 0 ? std::copysign(double(q + 1) / 1e6, -1.0) : double(q) / 1e6;
+}
+
+void CompressedTelemetryWriter::write(int64_t step, const double *values) {
+  time_encoder.encode(step, time_bits);
+  if (coding == TelemetryCoding::MICRO) {
+    for (size_t c = 0; c < dod_encoders.size(); c++)
+      dod_encoders[c].encode(toMicro(values[c]), channel_bits[c]);
+  } else {
+    for (size_t c = 0; c < xor_encoders.size(); c++)
+      xor_encoders[c].encode(values[c], channel_bits[c]);
+  }
+
+  if (++rows == kBlockRows)
+    flushBlock();
+}
+
+void CompressedTelemetryWriter::flushBlock() {
+  if (rows == 0)
+    return;
+
+  const std::vector<uint8_t> &t = time_bits.finish();
+  putLE(out, bytes, rows, 4);
+  putLE(out, bytes, t.size(), 4);
+  putBytes(out, bytes, t.data(), t.size());
+  time_bits.clear();
+  time_encoder.reset();
+
+  for (size_t c = 0; c < channel_bits.size(); c++) {
+    const std::vector<uint8_t> &v = channel_bits[c].finish();
+    putLE(out, bytes, v.size(), 4);
+    putBytes(out, bytes, v.data(), v.size());
+    channel_bits[c].clear();
+    xor_encoders[c].reset();
+    dod_encoders[c].reset();
+  }
+  rows = 0;
+}
+
+void CompressedTelemetryWriter::close() {
+  if (!out.is_open())
+    return;
+  flushBlock();
+  out.close();
+}
+
+uint64_t CompressedTelemetryWriter::bytesWritten() const { return bytes; }
+
+// --------------------------------------------------
+// DECODING
+// --------------------------------------------------
+
+namespace {
+struct ByteCursor {
+  const std::vector<uint8_t> &buf;
+  size_t pos = 0;
+
+  const uint8_t *take(size_t n) {
+    if (pos + n > buf.size())
+      throw std::runtime_error("truncated telemetry file");
+    const uint8_t *p = buf.data() + pos;
+    pos += n;
+    return p;
+  }
+  uint64_t le(int size) {
+    const uint8_t *p = take(size_t(size));
+    uint64_t v = 0;
+    for (int i = size - 1; i >= 0; i--)
+      v = (v << 8) | p[i];
+    return v;
+  }
+};
+} // namespace
+
+TelemetryTrace readCompressedTelemetry(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("cannot open " + path);
+  std::vector<uint8_t> buf((std::istreambuf_iterator<char>(in)),
+                           std::istreambuf_iterator<char>());
+
+  ByteCursor cur{buf};
+  if (std::memcmp(cur.take(4), "F1PZ", 4) != 0)
+    throw std::runtime_error(path + ": not an f1pz file");
+  if (cur.le(2) != 1)
+    throw std::runtime_error(path + ": unsupported f1pz version");
+
+  TelemetryTrace trace;
+  size_t channels = size_t(cur.le(2));
+  trace.coding = TelemetryCoding(cur.le(1));
+  if (trace.coding != TelemetryCoding::EXACT &&
+      trace.coding != TelemetryCoding::MICRO)
+    throw std::runtime_error(path + ": unknown value coding");
+  uint64_t dt_bits = cur.le(8);
+  std::memcpy(&trace.dt, &dt_bits, sizeof trace.dt);
+  for (size_t c = 0; c < channels; c++) {
+    size_t len = size_t(cur.le(1));
+    const uint8_t *name = cur.take(len);
+    trace.channels.emplace_back(reinterpret_cast<const char *>(name), len);
+  }
+  trace.values.resize(channels);
+
+  while (cur.pos < buf.size()) {
+    uint32_t rows = uint32_t(cur.le(4));
+
+    size_t size = size_t(cur.le(4));
+    BitReader time_in(cur.take(size), size);
+    DeltaOfDeltaDecoder time_decoder;
+    for (uint32_t r = 0; r < rows; r++)
+      trace.time.push_back(double(time_decoder.decode(time_in)) * trace.dt);
+
+    for (size_t c = 0; c < channels; c++) {
+      size = size_t(cur.le(4));
+      BitReader value_in(cur.take(size), size);
+      std::vector<double> &column = trace.values[c];
+      if (trace.coding == TelemetryCoding::MICRO) {
+        DeltaOfDeltaDecoder decoder;
+        for (uint32_t r = 0; r < rows; r++)
+          column.push_back(fromMicro(decoder.decode(value_in)));
+      } else {
+        XorDecoder decoder;
+        for (uint32_t r = 0; r < rows; r++)
+          column.push_back(decoder.decode(value_in));
+      }
+    }
+  }
+  return trace;
+}
+
+TelemetryTrace readCsvTelemetry(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("cannot open " + path);
+
+  TelemetryTrace trace;
+  std::string line;
+  if (!std::getline(in, line) || line.compare(0, 4, "time") != 0)
+    throw std::runtime_error(path + ": expected a 'time,...' header");
+  for (size_t pos = line.find(','); pos != std::string::npos;) {
+    size_t end = line.find(',', pos + 1);
+    trace.channels.push_back(line.substr(pos + 1, end - pos - 1));
+    pos = end;
+  }
+  trace.values.resize(trace.channels.size());
+
+  for (size_t row = 2; std::getline(in, line); row++) {
+    if (line.empty())
+      continue;
+    const char *p = line.c_str();
+    char *end;
+    trace.time.push_back(std::strtod(p, &end));
+    for (std::vector<double> &column : trace.values) {
+      if (*end != ',')
+        throw std::runtime_error(path + ": short row " + std::to_string(row));
+      p = end + 1;
+      column.push_back(std::strtod(p, &end));
+      if (end == p)
+        throw std::runtime_error(path + ": bad value in row " +
+                                 std::to_string(row));
+    }
+  }
+  if (trace.time.size() >= 2)
+    trace.dt = trace.time[1] - trace.time[0];
+  return trace;
+}
+
+TelemetryTrace readTelemetry(const std::string &path) {
+  size_t dot = path.rfind('.');
+  if (dot != std::string::npos && path.substr(dot) == ".f1pz")
+    return readCompressedTelemetry(path);
+  return readCsvTelemetry(path);
+}
@@ -0,0 +1,215 @@
+#include "../include/telemetry_codec.hpp"
+#include <climits>
+#include <cstring>
+
+static inline uint64_t lowMask(int count) {
+  return count >= 64 ? ~0ULL : ((1ULL << count) - 1);
+}
+
+// --------------------------------------------------
+// BIT PACKING
+// --------------------------------------------------
+
+void BitWriter::write(uint64_t bits, int count) {
+  if (count > 32) {
+    write(bits >> 32, count - 32);
+    write(bits & 0xffffffffULL, 32);
+    return;
+  }
+  acc = (acc << count) | (bits & lowMask(count));
+  pending += count;
+  while (pending >= 8) {
+    out.push_back(uint8_t(acc >> (pending - 8)));
+    pending -= 8;
+  }
+  acc &= lowMask(pending);
+}
+
+const std::vector<uint8_t> &BitWriter::finish() {
+  if (pending > 0) {
+    out.push_back(uint8_t(acc << (8 - pending)));
+    acc = 0;
+    pending = 0;
+  }
+  return out;
+}
+
+void BitWriter::clear() {
+  out.clear();
+  acc = 0;
+  pending = 0;
+}
+
+BitReader::BitReader(const uint8_t *data, size_t size)
+    : data(data), size(size) {}
+
+uint64_t BitReader::read(int count) {
+  uint64_t value = 0;
+  while (count > 0) {
+    size_t byte_index = bit_pos >> 3;
+    int avail = 8 - int(bit_pos & 7);
+    int take = count < avail ? count : avail;
+    uint64_t byte = byte_index < size ? data[byte_index] : 0;
+    value = (value << take) | ((byte >> (avail - take)) & lowMask(take));
+    bit_pos += take;
+    count -= take;
+  }
+  return value;
+}
+
+// --------------------------------------------------
+// DELTA-OF-DELTA INTEGERS
+// --------------------------------------------------
+
+void DeltaOfDeltaEncoder::encode(int64_t value, BitWriter &out) {
+  if (!started) {
+    out.write(uint64_t(value), 64);
+    started = true;
+    prev = value;
+    prev_delta = 0;
+    return;
+  }
+
+  int64_t delta = value - prev;
+  int64_t dod = delta - prev_delta;
+  prev = value;
+  prev_delta = delta;
+
+  if (dod == 0) {
+    out.write(0b0, 1);
+  } else if (dod >= -63 && dod <= 64) {
+    out.write(0b10, 2);
+    out.write(uint64_t(dod + 63), 7);
+  } else if (dod >= -255 && dod <= 256) {
+    out.write(0b110, 3);
+    out.write(uint64_t(dod + 255), 9);
+  } else if (dod >= -2047 && dod <= 2048) {
+    out.write(0b1110, 4);
+    out.write(uint64_t(dod + 2047), 12);
+  } else if (dod >= INT32_MIN && dod <= INT32_MAX) {
+    out.write(0b11110, 5);
+    out.write(uint64_t(dod) & 0xffffffffULL, 32);
+  } else {
+    out.write(0b11111, 5);
+    out.write(uint64_t(dod), 64);
+  }
+}
+
+void DeltaOfDeltaEncoder::reset() {
+  started = false;
+  prev = 0;
+  prev_delta = 0;
+}
+
+int64_t DeltaOfDeltaDecoder::decode(BitReader &in) {
+  if (!started) {
+    started = true;
+    prev = int64_t(in.read(64));
+    prev_delta = 0;
+    return prev;
+  }
+
+  int64_t dod;
+  if (in.read(1) == 0)
+    dod = 0;
+  else if (in.read(1) == 0)
+    dod = int64_t(in.read(7)) - 63;
+  else if (in.read(1) == 0)
+    dod = int64_t(in.read(9)) - 255;
+  else if (in.read(1) == 0)
+    dod = int64_t(in.read(12)) - 2047;
+  else if (in.read(1) == 0)
+    dod = int64_t(int32_t(uint32_t(in.read(32))));
+  else
+    dod = int64_t(in.read(64));
+
+  prev_delta += dod;
+  prev += prev_delta;
+  return prev;
+}
+
+void DeltaOfDeltaDecoder::reset() {
+  started = false;
+  prev = 0;
+  prev_delta = 0;
+}
+
+// --------------------------------------------------
+// XOR VALUES
+// --------------------------------------------------
+
+void XorEncoder::encode(double value, BitWriter &out) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+
+  if (!started) {
+    out.write(bits, 64);
+    started = true;
+    prev = bits;
+    return;
+  }
+
+  uint64_t x = bits ^ prev;
+  prev = bits;
+
+  if (x == 0) {
+    out.write(0b0, 1); // repeated value
+    return;
+  }
+
+  int leading = __builtin_clzll(x);
+  int trailing = __builtin_ctzll(x);
+  if (leading > 31)
+    leading = 31; // 5-bit field
+
+  if (prev_leading >= 0 && leading >= prev_leading &&
+      trailing >= prev_trailing) {
+    // Fits inside the previous meaningful-bit window
+    out.write(0b10, 2);
+    out.write(x >> prev_trailing, 64 - prev_leading - prev_trailing);
+    return;
+  }
+
+  int meaningful = 64 - leading - trailing;
+  out.write(0b11, 2);
+  out.write(uint64_t(leading), 5);
+  out.write(uint64_t(meaningful & 63), 6); // 64 stored as 0
+  out.write(x >> trailing, meaningful);
+  prev_leading = leading;
+  prev_trailing = trailing;
+}
+
+void XorEncoder::reset() {
+  started = false;
+  prev = 0;
+  prev_leading = -1;
+  prev_trailing = 0;
+}
+
+double XorDecoder::decode(BitReader &in) {
+  if (!started) {
+    started = true;
+    prev = in.read(64);
+  } else if (in.read(1) == 1) {
+    if (in.read(1) == 1) {
+      prev_leading = int(in.read(5));
+      int meaningful = int(in.read(6));
+      if (meaningful == 0)
+        meaningful = 64;
+      prev_trailing = 64 - prev_leading - meaningful;
+    }
+    int meaningful = 64 - prev_leading - prev_trailing;
+    prev ^= in.read(meaningful) << prev_trailing;
+  }
+
+  double value;
+  std::memcpy(&value, &prev, sizeof value);
+  return value;
+}
+
+void XorDecoder::reset() {
+  started = false;
+  prev = 0;
+  prev_leading = 0;
+  prev_trailing = 0;
+}
@@ -0,0 +1,80 @@
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0)
+    threads = int(std::max(1u, std::thread::hardware_concurrency()));
+  for (int i = 1; i < threads; i++)
+    workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  batch_ready.notify_all();
+  for (std::thread &t : workers)
+    t.join();
+}
+
+int ThreadPool::size() const { return int(workers.size()) + 1; }
+
+void ThreadPool::parallelFor(int n, const std::function<void(int)> &fn) {
+  if (n <= 0)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    task = &fn;
+    count = n;
+    next = 0;
+    running = 0;
+    error = nullptr;
+    generation++;
+  }
+  batch_ready.notify_all();
+
+  drain();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  batch_done.wait(lock, [&] { return next >= count && running == 0; });
+  task = nullptr;
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Takes indices of the current batch until none are left
+void ThreadPool::drain() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (task && next < count) {
+    int i = next++;
+    running++;
+    const std::function<void(int)> &fn = *task;
+    lock.unlock();
+    try {
+      fn(i);
+    } catch (...) {
+      lock.lock();
+      if (!error)
+        error = std::current_exception();
+      lock.unlock();
+    }
+    lock.lock();
+    if (--running == 0 && next >= count)
+      batch_done.notify_all();
+  }
+}
+
+void ThreadPool::work() {
+  long seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      batch_ready.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+    drain();
+  }
+}
@@ -0,0 +1,305 @@
+#include "../include/transient.hpp"
+#include "../include/constants.hpp"
+#include "../include/ice_engine.hpp"
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+
+// --------------------------------------------------
+// STEP-RESPONSE DETECTOR
+// --------------------------------------------------
+
+StepResponseDetector::StepResponseDetector(double initial_value,
+                                           double resolution_,
+                                           double final_from_)
+    : initial(initial_value), resolution(resolution_),
+      final_from(final_from_), last{0.0, initial_value} {
+  peak = trough = {last, last};
+  rising.push_back(peak);
+  falling.push_back(trough);
+}
+
+void StepResponseDetector::add(double t, double y) {
+  if (t >= final_from) {
+    final_sum += y;
+    final_count++;
+  }
+
+  Point sample{t, y};
+  if (y > peak.at.y) {
+    peak = {last, sample};
+    if (y - rising.back().at.y > resolution)
+      rising.push_back(peak);
+  }
+  if (y < trough.at.y) {
+    trough = {last, sample};
+    if (falling.back().at.y - y > resolution)
+      falling.push_back(trough);
+  }
+  last = sample;
+
+  // Samples dominated by y can never be a suffix extreme again. A value
+  // within the resolution of the last step extends that step instead of
+  // adding one (over-estimating the extreme by at most the resolution).
+  while (!suffix_max.empty() && suffix_max.back().y <= y)
+    suffix_max.pop_back();
+  if (!suffix_max.empty() && suffix_max.back().y - y <= resolution)
+    suffix_max.back().t = t;
+  else
+    suffix_max.push_back({t, y});
+
+  while (!suffix_min.empty() && suffix_min.back().y >= y)
+    suffix_min.pop_back();
+  if (!suffix_min.empty() && y - suffix_min.back().y <= resolution)
+    suffix_min.back().t = t;
+  else
+    suffix_min.push_back({t, y});
+}
+
+size_t StepResponseDetector::storedPoints() const {
+  return rising.size() + falling.size() + suffix_max.size() +
+         suffix_min.size();
+}
+
+StepMetrics StepResponseDetector::finish(double band) const {
+  StepMetrics m;
+  m.initial = initial;
+  m.final = final_count > 0 ? final_sum / double(final_count) : initial;
+
+  double change = m.final - initial;
+  if (std::abs(change) <= resolution) {
+    m.t10 = m.t90 = m.rise_time = m.overshoot = m.settling_time = NAN;
+    return m;
+  }
+
+  // First passage of a level in the direction of the change: the first
+  // record reaching it, then the latest one (which thinning may not have
+  // kept). It lies in the step onto that record, unless the sample before
+  // already reached the level through a record dropped by the thinning;
+  // then between the previous envelope point and that sample.
+  const std::vector<Record> &envelope = change > 0.0 ? rising : falling;
+  const Record &extreme = change > 0.0 ? peak : trough;
+  auto firstPassage = [&](double fraction) {
+    double level = initial + fraction * change;
+    auto reached = [&](const Point &p) {
+      return (p.y - level) * change >= 0.0;
+    };
+    auto interpolate = [&](const Point &a, const Point &b) {
+      return a.t + (b.t - a.t) * (level - a.y) / (b.y - a.y);
+    };
+    for (size_t i = 1; i <= envelope.size(); i++) {
+      const Record &r = i < envelope.size() ? envelope[i] : extreme;
+      if (reached(r.at))
+        return reached(r.before) ? interpolate(envelope[i - 1].at, r.before)
+                                 : interpolate(r.before, r.at);
+    }
+    return double(NAN);
+  };
+  m.t10 = firstPassage(0.1);
+  m.t90 = firstPassage(0.9);
+  m.rise_time = m.t90 - m.t10;
+  m.overshoot = std::max(change > 0.0 ? peak.at.y - m.final
+                                      : m.final - trough.at.y,
+                         0.0) /
+                std::abs(change);
+
+  // Settled after the last staircase step outside the band
+  double tolerance = std::max(band * std::abs(change), resolution);
+  double settled = 0.0;
+  for (const Point &p : suffix_max)
+    if (p.y > m.final + tolerance)
+      settled = std::max(settled, p.t);
+  for (const Point &p : suffix_min)
+    if (p.y < m.final - tolerance)
+      settled = std::max(settled, p.t);
+  m.settling_time = settled < final_from ? settled : NAN;
+  return m;
+}
+
+// --------------------------------------------------
+// TEST MATRIX
+// --------------------------------------------------
+
+std::string TransientCase::name() const {
+  char text[96];
+  std::snprintf(text, sizeof text, "%s %.0frpm %.2f->%.2f mguh-%s",
+                throttle_to > throttle_from ? "tip-in" : "lift-off", rpm,
+                throttle_from, throttle_to, mguh_assist ? "on" : "off");
+  return text;
+}
+
+std::vector<TransientCase> transientMatrix(const TransientOptions &options) {
+  std::vector<TransientCase> cases;
+  for (bool assist : {true, false})
+    for (double rpm : options.rpm)
+      for (double part : options.part_throttle) {
+        cases.push_back({rpm, part, 1.0, assist});
+        cases.push_back({rpm, 1.0, part, assist});
+      }
+  return cases;
+}
+
+// --------------------------------------------------
+// SUITE
+// --------------------------------------------------
+
+// Smallest change each detector resolves
+static constexpr double kBoostResolution = 100.0;  // Pa
+static constexpr double kTorqueResolution = 0.1;   // N·m
+static constexpr double kTurboResolution = 10.0;   // rad/s
+static constexpr double kCrankResolution = 0.1;    // rad/s
+
+namespace {
+
+struct OperatingPoint {
+  ICEEngine engine;
+  double dyno_torque = 0.0;
+};
+
+} // namespace
+
+static double holdSpeed(double rpm) { return rpm * 2.0 * constants::PI / 60.0; }
+
+// Ideal speed-holding dyno: the crank is pinned at speed while the rest of
+// the plant settles; the torque it absorbs is the net torque left over
+static OperatingPoint warmUp(const EngineParams &params,
+                             const TransientCase &c,
+                             const TransientOptions &options) {
+  OperatingPoint p{ICEEngine(params)};
+  ICEEngine &e = p.engine;
+  if (!c.mguh_assist)
+    e.getEcu().setBoostStrategy(std::make_unique<ManualBoost<double>>(0.0));
+
+  double omega = holdSpeed(c.rpm);
+  PlantState s = e.getPlantState();
+  s.angular_velocity = omega;
+  e.setPlantState(s);
+  e.setThrottle(c.throttle_from);
+
+  int steps = int(std::lround(options.warmup / options.dt));
+  for (int i = 0; i < steps; i++) {
+    e.update(options.dt);
+    s = e.getPlantState();
+    s.angular_velocity = omega;
+    e.setPlantState(s);
+  }
+  p.dyno_torque = e.getNetTorque();
+  return p;
+}
+
+static TransientResult runCase(const OperatingPoint &point,
+                               const TransientCase &c,
+                               const TransientOptions &options) {
+  ICEEngine e = point.engine;
+  double omega0 = holdSpeed(c.rpm);
+  double final_from = options.duration - options.final_window;
+
+  StepResponseDetector boost(e.getBoostPressure(), kBoostResolution,
+                             final_from);
+  StepResponseDetector torque(e.getTorqueOutput(), kTorqueResolution,
+                              final_from);
+  StepResponseDetector turbo(e.getTurboSpeed(), kTurboResolution, final_from);
+  StepResponseDetector crank(e.getAngularVelocity(), kCrankResolution,
+                             final_from);
+
+  e.setThrottle(c.throttle_to);
+  int steps = int(std::lround(options.duration / options.dt));
+  for (int i = 1; i <= steps; i++) {
+    e.setExternalLoadTorque(point.dyno_torque +
+                            options.dyno_slope *
+                                (e.getAngularVelocity() - omega0));
+    e.update(options.dt);
+    double t = i * options.dt;
+    boost.add(t, e.getBoostPressure());
+    torque.add(t, e.getTorqueOutput());
+    turbo.add(t, e.getTurboSpeed());
+    crank.add(t, e.getAngularVelocity());
+  }
+
+  TransientResult r;
+  r.test = c;
+  r.boost = boost.finish(options.band);
+  r.torque = torque.finish(options.band);
+  r.turbo_speed = turbo.finish(options.band);
+  r.crank_speed = crank.finish(options.band);
+  r.dyno_torque = point.dyno_torque;
+  r.detector_points = boost.storedPoints() + torque.storedPoints() +
+                      turbo.storedPoints() + crank.storedPoints();
+  return r;
+}
+
+std::vector<TransientResult>
+characterizeTransients(const EngineParams &params,
+                       const std::vector<TransientCase> &cases,
+                       const TransientOptions &options) {
+  if (!(options.dt > 0.0) || !(options.duration > options.final_window) ||
+      !(options.final_window > 0.0))
+    throw std::invalid_argument(
+        "transient suite needs dt > 0 and duration > final window > 0");
+
+  // Distinct warm-up points; several cases share each
+  using Key = std::tuple<double, double, bool>;
+  std::map<Key, int> index;
+  std::vector<int> point_of(cases.size());
+  std::vector<const TransientCase *> firsts;
+  for (size_t k = 0; k < cases.size(); k++) {
+    const TransientCase &c = cases[k];
+    auto found =
+        index.emplace(Key{c.rpm, c.throttle_from, c.mguh_assist},
+                      int(firsts.size()));
+    if (found.second)
+      firsts.push_back(&c);
+    point_of[k] = found.first->second;
+  }
+
+  ThreadPool pool(options.threads);
+  std::vector<OperatingPoint> points(firsts.size());
+  pool.parallelFor(int(firsts.size()), [&](int i) {
+    points[i] = warmUp(params, *firsts[i], options);
+  });
+
+  std::vector<TransientResult> results(cases.size());
+  pool.parallelFor(int(cases.size()), [&](int k) {
+    results[k] = runCase(points[point_of[k]], cases[k], options);
+  });
+  return results;
+}
+
+void writeTransientSummary(const std::string &path,
+                           const std::vector<TransientResult> &results) {
+  FILE *f = std::fopen(path.c_str(), "w");
+  if (!f)
+    throw std::runtime_error("cannot write " + path);
+
+  const char *const signals[4] = {"boost", "torque", "turbo_speed",
+                                  "crank_speed"};
+  const char *const fields[7] = {"initial",   "final",
+                                 "t10",       "t90",
+                                 "rise_time", "overshoot",
+                                 "settling_time"};
+  std::fprintf(f, "case,rpm,throttle_from,throttle_to,mguh_assist,"
+                  "dyno_torque");
+  for (const char *s : signals)
+    for (const char *field : fields)
+      std::fprintf(f, ",%s_%s", s, field);
+  std::fprintf(f, "\n");
+
+  for (const TransientResult &r : results) {
+    std::fprintf(f, "%s,%.0f,%.3f,%.3f,%d,%.6g", r.test.name().c_str(),
+                 r.test.rpm, r.test.throttle_from, r.test.throttle_to,
+                 r.test.mguh_assist ? 1 : 0, r.dyno_torque);
+    for (const StepMetrics *m :
+         {&r.boost, &r.torque, &r.turbo_speed, &r.crank_speed})
+      std::fprintf(f, ",%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g", m->initial,
+                   m->final, m->t10, m->t90, m->rise_time, m->overshoot,
+                   m->settling_time);
+    std::fprintf(f, "\n");
+  }
+  if (std::fclose(f) != 0)
+    throw std::runtime_error("cannot write " + path);
+}
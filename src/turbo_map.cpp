@@ -0,0 +1,236 @@
+#include "../include/turbo_map.hpp"
+#include "../include/constants.hpp"
+#include "../include/dual.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// --------------------------------------------------
+// GRID
+// --------------------------------------------------
+
+MapAxis::MapAxis(std::vector<double> pts) : points(std::move(pts)) {
+  for (size_t i = 0; i + 1 < points.size(); i++) {
+    double span = points[i + 1] - points[i];
+    if (!(span > 0.0))
+      throw std::runtime_error("map axis must be strictly increasing");
+    inv_span.push_back(1.0 / span);
+  }
+}
+
+Map2D::Map2D(MapAxis x, MapAxis y, int fields, std::vector<double> values)
+    : x(std::move(x)), y(std::move(y)), fields(fields),
+      data(values.begin(), values.end()) {
+  if (this->x.size() < 2 || this->y.size() < 2)
+    throw std::runtime_error("map axes need at least two points");
+  if (data.size() != size_t(this->x.size() * this->y.size() * fields))
+    throw std::runtime_error("map value count does not match its axes");
+}
+
+// Cell containing v, starting from the cached cell. A slowly moving
+// operating point stays in the same cell and both loops fall straight
+// through.
+static inline int locate(const MapAxis &axis, double v, int i) {
+  const double *p = axis.points.data();
+  int last = axis.size() - 2;
+  if (i > last)
+    i = last;
+  while (i > 0 && v < p[i])
+    i--;
+  while (i < last && v >= p[i + 1])
+    i++;
+  return i;
+}
+
+template <typename T>
+void Map2D::lookup(const T &xv, const T &yv, MapCursor &cursor, T *out) const {
+  int i = cursor.i = locate(x, ad::value(xv), cursor.i);
+  int j = cursor.j = locate(y, ad::value(yv), cursor.j);
+
+  // Clamped weights hold the edge values outside the grid
+  T tx = ad::clamp((xv - x.points[i]) * x.inv_span[i], 0.0, 1.0);
+  T ty = ad::clamp((yv - y.points[j]) * y.inv_span[j], 0.0, 1.0);
+
+  size_t row = size_t(x.size()) * fields;
+  const double *n00 = &data[(size_t(j) * x.size() + i) * fields];
+  const double *n10 = n00 + fields;
+  const double *n01 = n00 + row;
+  const double *n11 = n01 + fields;
+
+  for (int f = 0; f < fields; f++) {
+    T r0 = n00[f] + (n10[f] - n00[f]) * tx;
+    T r1 = n01[f] + (n11[f] - n01[f]) * tx;
+    out[f] = r0 + (r1 - r0) * ty;
+  }
+}
+
+template <typename T>
+T Map2D::lastYReaching(const T &xv, int field, const T &target,
+                       MapCursor &cursor) const {
+  int i = cursor.i = locate(x, ad::value(xv), cursor.i);
+  T tx = ad::clamp((xv - x.points[i]) * x.inv_span[i], 0.0, 1.0);
+
+  // The line at x is linear in y between nodes
+  size_t row = size_t(x.size()) * fields;
+  const double *column = &data[size_t(i) * fields + field];
+  auto line = [&](int j) {
+    const double *n = column + j * row;
+    return n[0] + (n[fields] - n[0]) * tx;
+  };
+
+  // Cell [j, j + 1] with line(j) >= target > line(j + 1), from the cached
+  // cell
+  double goal = ad::value(target);
+  int last = y.size() - 2;
+  int j = std::min(cursor.j, last);
+  while (j > 0 && ad::value(line(j)) < goal)
+    j--;
+  while (j < last && ad::value(line(j + 1)) >= goal)
+    j++;
+  cursor.j = j;
+
+  T lo = line(j), hi = line(j + 1);
+  if (ad::value(lo) < goal)
+    return T(y.points[0]);
+  if (ad::value(hi) >= goal)
+    return T(y.points[last + 1]);
+  return y.points[j] + (y.points[j + 1] - y.points[j]) * (lo - target) /
+                           (lo - hi);
+}
+
+template void Map2D::lookup<double>(const double &, const double &,
+                                    MapCursor &, double *) const;
+template void Map2D::lookup<ad::ModelDual>(const ad::ModelDual &,
+                                           const ad::ModelDual &, MapCursor &,
+                                           ad::ModelDual *) const;
+template double Map2D::lastYReaching<double>(const double &, int,
+                                             const double &,
+                                             MapCursor &) const;
+template ad::ModelDual
+Map2D::lastYReaching<ad::ModelDual>(const ad::ModelDual &, int,
+                                    const ad::ModelDual &, MapCursor &) const;
+
+// --------------------------------------------------
+// MAP FILES
+// --------------------------------------------------
+
+namespace {
+class MapReader {
+public:
+  MapReader(std::istream &in, const std::string &path) : path(path) {
+    std::string line;
+    while (std::getline(in, line)) {
+      line = line.substr(0, line.find('#'));
+      std::istringstream words(line);
+      std::string w;
+      while (words >> w)
+        tokens.push_back(w);
+    }
+  }
+
+  void expect(const std::string &keyword) {
+    if (pos >= tokens.size() || tokens[pos] != keyword)
+      fail("expected '" + keyword + "'");
+    pos++;
+  }
+
+  double number() {
+    if (pos >= tokens.size())
+      fail("unexpected end of file");
+    try {
+      return std::stod(tokens[pos++]);
+    } catch (const std::exception &) {
+      fail("bad number '" + tokens[pos - 1] + "'");
+    }
+    return 0.0;
+  }
+
+  std::vector<double> numbers(size_t count) {
+    std::vector<double> v;
+    for (size_t k = 0; k < count; k++)
+      v.push_back(number());
+    return v;
+  }
+
+  MapAxis axis(const std::string &keyword) {
+    expect(keyword);
+    double count = number();
+    if (count < 2)
+      fail(keyword + " needs at least two points");
+    return MapAxis(numbers(size_t(count)));
+  }
+
+  [[noreturn]] void fail(const std::string &what) const {
+    throw std::runtime_error(path + ": " + what);
+  }
+
+private:
+  std::string path;
+  std::vector<std::string> tokens;
+  size_t pos = 0;
+};
+
+// Interleaves per-field tables into node order
+Map2D interleave(MapAxis x, MapAxis y,
+                 const std::vector<std::vector<double>> &tables) {
+  size_t nodes = size_t(x.size() * y.size());
+  std::vector<double> values;
+  values.reserve(nodes * tables.size());
+
+  // Files list one x (speed) row per line; the grid is row-major in y
+  for (int j = 0; j < y.size(); j++)
+    for (int i = 0; i < x.size(); i++)
+      for (const std::vector<double> &t : tables)
+        values.push_back(t[size_t(i) * y.size() + j]);
+
+  return Map2D(std::move(x), std::move(y), int(tables.size()),
+               std::move(values));
+}
+} // namespace
+
+TurboMaps TurboMaps::load(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("cannot open turbo map " + path);
+  MapReader r(in, path);
+
+  TurboMaps maps;
+
+  r.expect("compressor");
+  MapAxis c_speed = r.axis("speed");
+  MapAxis c_flow = r.axis("flow");
+  size_t c_nodes = size_t(c_speed.size() * c_flow.size());
+  r.expect("pr");
+  std::vector<double> pr = r.numbers(c_nodes);
+  r.expect("efficiency");
+  std::vector<double> c_eff = r.numbers(c_nodes);
+  maps.compressor = interleave(c_speed, c_flow, {pr, c_eff});
+
+  r.expect("turbine");
+  MapAxis t_speed = r.axis("speed");
+  MapAxis t_expansion = r.axis("expansion");
+  r.expect("efficiency");
+  std::vector<double> t_eff =
+      r.numbers(size_t(t_speed.size() * t_expansion.size()));
+  maps.turbine = interleave(t_speed, t_expansion, {t_eff});
+
+  return maps;
+}
+
+TurboMaps TurboMaps::closedForm(double turbine_efficiency,
+                                double compressor_efficiency) {
+  TurboMaps maps;
+
+  // PR = turbo_pr_idle + (turbo_max_pr - turbo_pr_idle) * clamp(speed, 0, 1)
+  // is exactly the bilinear interpolant over speed {0, 1} with held edges
+  maps.compressor = interleave(MapAxis({0.0, 1.0}), MapAxis({0.0, 10.0}),
+                               {{constants::turbo_pr_idle,
+                                 constants::turbo_pr_idle,
+                                 constants::turbo_max_pr,
+                                 constants::turbo_max_pr},
+                                std::vector<double>(4, compressor_efficiency)});
+  maps.turbine = interleave(MapAxis({0.0, 10.0}), MapAxis({1.0, 10.0}),
+                            {std::vector<double>(4, turbine_efficiency)});
+  return maps;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Wall-clock timing shared by the benchmarking tools
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
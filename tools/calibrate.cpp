@@ -0,0 +1,224 @@
+// Fit model tunables to measured dyno traces.
+//
+//   f1-pu-calibrate [--params a,b,...] [--channels a,b,...] [--stride n]
+//                   [--threads n] [--max-iter n] [--bound name=lo:hi]
+//                   [--dt s] [--segment s] [--save file] trace ...
+//   f1-pu-calibrate --self-fit [scenario] [options]
+//
+// Traces are telemetry logs (CSV, or .f1pz) with at least a throttle
+// column and the fitted channels. Without --params the turbo efficiencies,
+// fmepA and intercooler_eff are fitted. --dt sets the physics step the
+// model is run at (default 1e-4 s, whatever the log's row spacing), and
+// --segment the seconds of trace replayed from each logged state (default
+// 1, 0 for whole traces). --save writes the fitted values as name=value
+// lines.
+//
+// --self-fit fits the model's own run of a golden scenario (f1-pu-golden
+// list, default tip_in_lift_off) from parameters 10 % off their defaults,
+// and exits with 1 unless it returns the defaults. (On ramp the boost sits
+// at its target, so compressor_efficiency and intercooler_eff need
+// --bound to stay physical.)
+#include "../include/calibration.hpp"
+#include "../include/golden.hpp"
+#include "bench_clock.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static std::vector<std::string> splitList(const char *text) {
+  std::vector<std::string> out;
+  std::stringstream in(text);
+  std::string item;
+  while (std::getline(in, item, ','))
+    if (!item.empty())
+      out.push_back(item);
+  return out;
+}
+
+// The model's run of a golden scenario at default parameters, logged
+// without rounding
+static DynoTrace ownTrace(const GoldenScenario &g) {
+  const Scenario &s = g.scenario;
+  ICEEngine engine;
+  if (g.initial_soc >= 0.0) {
+    PlantState state = engine.getPlantState();
+    state.battery_soc = g.initial_soc;
+    engine.setPlantState(state);
+  }
+  DynoTrace trace;
+  trace.name = s.name;
+  TelemetryTrace &t = trace.data;
+  t.dt = s.dt;
+  t.channels = telemetryChannelNames();
+  t.values.resize(t.channels.size());
+  double row[kTelemetryChannels];
+  for (int i = 0; i < s.iterations; i++) {
+    engine.setThrottle(s.throttleAt(i * s.dt));
+    engine.update(s.dt);
+    sampleTelemetry(engine, row);
+    t.time.push_back(i * s.dt);
+    for (int c = 0; c < kTelemetryChannels; c++)
+      t.values[c].push_back(row[c]);
+  }
+  return trace;
+}
+
+int main(int argc, char **argv) {
+  CalibrationOptions options;
+  options.parameters = {"compressor_efficiency", "turbine_efficiency",
+                        "fmepA", "intercooler_eff"};
+  std::vector<std::string> bounds, paths;
+  std::string save_path, self_fit;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--params") == 0 && i + 1 < argc)
+      options.parameters = splitList(argv[++i]);
+    else if (std::strcmp(argv[i], "--channels") == 0 && i + 1 < argc)
+      options.channels = splitList(argv[++i]);
+    else if (std::strcmp(argv[i], "--stride") == 0 && i + 1 < argc)
+      options.stride = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      options.threads = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc)
+      options.max_iterations = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--bound") == 0 && i + 1 < argc)
+      bounds.push_back(argv[++i]);
+    else if (std::strcmp(argv[i], "--dt") == 0 && i + 1 < argc)
+      options.dt = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--segment") == 0 && i + 1 < argc)
+      options.segment_length = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+      save_path = argv[++i];
+    else if (std::strcmp(argv[i], "--self-fit") == 0)
+      self_fit = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i]
+                                                       : "tip_in_lift_off";
+    else if (argv[i][0] != '-')
+      paths.push_back(argv[i]);
+    else {
+      paths.clear();
+      self_fit.clear();
+      break;
+    }
+  }
+  if (paths.empty() == self_fit.empty()) {
+    std::cerr << "usage: f1-pu-calibrate [--params a,b] [--channels a,b] "
+                 "[--stride n] [--threads n] [--max-iter n] "
+                 "[--bound name=lo:hi] [--dt s] [--segment s] "
+                 "[--save file] trace ...\n"
+                 "       f1-pu-calibrate --self-fit [scenario] [options]\n";
+    return 2;
+  }
+
+  size_t n = options.parameters.size();
+  options.lower.assign(n, -HUGE_VAL);
+  options.upper.assign(n, HUGE_VAL);
+  for (const std::string &b : bounds) {
+    size_t eq = b.find('='), colon = b.find(':');
+    size_t j = 0;
+    while (j < n && options.parameters[j] != b.substr(0, eq))
+      j++;
+    if (eq == std::string::npos || colon == std::string::npos || j == n) {
+      std::cerr << "bad bound (name=lo:hi of a fitted parameter): " << b
+                << "\n";
+      return 2;
+    }
+    options.lower[j] = std::atof(b.substr(eq + 1, colon - eq - 1).c_str());
+    options.upper[j] = std::atof(b.substr(colon + 1).c_str());
+  }
+
+  CalibrationResult result;
+  Clock::time_point start = Clock::now();
+  try {
+    std::vector<DynoTrace> traces;
+    for (const std::string &path : paths)
+      traces.push_back({path, readTelemetry(path)});
+    EngineParams first_guess;
+    if (!self_fit.empty()) {
+      traces.push_back(ownTrace(findGoldenScenario(self_fit)));
+      for (const std::string &name : options.parameters)
+        if (double *field = findParameter(first_guess, name))
+          *field *= 1.1;
+    }
+    std::cout << std::scientific << std::setprecision(6);
+    result = calibrate(first_guess, traces, options,
+                       [](int iteration, double cost, double lambda) {
+                         std::cout << "iteration " << std::setw(3)
+                                   << iteration << "  cost " << cost
+                                   << "  lambda " << lambda << std::endl;
+                       });
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  double seconds = secondsSince(start);
+
+  std::cout << (result.converged ? "converged" : "not converged") << " after "
+            << result.iterations << " iterations, cost "
+            << result.initial_cost << " -> " << result.final_cost << " ("
+            << result.residual_count << " residuals)\n\n";
+
+  std::cout << std::left << std::setw(28) << "parameter" << std::right
+            << std::setw(15) << "start" << std::setw(15) << "fitted"
+            << std::setw(15) << "std error" << "\n";
+  for (size_t j = 0; j < n; j++)
+    std::cout << std::left << std::setw(28) << result.parameters[j]
+              << std::right << std::setw(15) << result.initial[j]
+              << std::setw(15) << result.fitted[j] << std::setw(15)
+              << result.standard_error[j] << "\n";
+
+  std::cout << "\ncorrelation\n" << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < n; i++) {
+    std::cout << "  " << std::left << std::setw(26) << result.parameters[i]
+              << std::right;
+    for (size_t j = 0; j < n; j++)
+      std::cout << std::setw(8) << result.correlation[i][j];
+    std::cout << "\n";
+  }
+
+  std::cout << "\nfit quality (RMS error per trace, R^2 over all)\n"
+            << std::scientific << std::setprecision(3);
+  for (size_t c = 0; c < result.channels.size(); c++) {
+    std::cout << "  " << std::left << std::setw(26) << result.channels[c]
+              << std::right;
+    for (const std::vector<double> &rms : result.trace_rms)
+      std::cout << std::setw(12) << rms[c];
+    std::cout << std::fixed << std::setprecision(5) << "   R^2 "
+              << result.r_squared[c] << std::scientific
+              << std::setprecision(3) << "\n";
+  }
+  std::cout << std::fixed << std::setprecision(2) << "\n"
+            << seconds << " s\n";
+
+  if (!save_path.empty()) {
+    std::ofstream out(save_path);
+    out << std::setprecision(17);
+    for (size_t j = 0; j < n; j++)
+      out << result.parameters[j] << "=" << result.fitted[j] << "\n";
+    if (!out) {
+      std::cerr << "cannot write " << save_path << "\n";
+      return 1;
+    }
+    std::cout << "Parameters saved to " << save_path << "\n";
+  }
+
+  if (!self_fit.empty()) {
+    EngineParams defaults;
+    double worst = 0.0;
+    for (size_t j = 0; j < n; j++) {
+      double truth = *findParameter(defaults, result.parameters[j]);
+      worst = std::max(worst, std::abs(result.fitted[j] - truth) /
+                                  std::max(std::abs(truth), 1e-12));
+    }
+    bool pass = worst <= 1e-6;
+    std::cout << "self-fit " << (pass ? "PASS" : "FAIL") << ", largest "
+              << std::scientific << std::setprecision(2) << worst
+              << " relative to the defaults\n";
+    if (!pass)
+      return 1;
+  }
+  return 0;
+}
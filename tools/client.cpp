@@ -0,0 +1,82 @@
+// Sends one request to f1-pu-daemon and prints the reply.
+//
+//   f1-pu-client [--socket path] [--repeat n] <request ...>
+//
+// e.g.  f1-pu-client run iterations=20000 outputs=final_rpm,fuel_kg
+//       f1-pu-client status
+// --repeat sends the request n times over one connection and reports the
+// request rate (the last reply is printed). Exits 1 on an "error" reply.
+#include "bench_clock.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Reads one reply line (any bytes past it are kept for the next call)
+static bool readLine(int fd, std::string &buffer, std::string &line) {
+  size_t newline;
+  char chunk[4096];
+  while ((newline = buffer.find('\n')) == std::string::npos) {
+    ssize_t n = recv(fd, chunk, sizeof chunk, 0);
+    if (n <= 0)
+      return false;
+    buffer.append(chunk, size_t(n));
+  }
+  line = buffer.substr(0, newline);
+  buffer.erase(0, newline + 1);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::string socket_path = "/tmp/f1-pu.sock";
+  long repeat = 1;
+  std::string request;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+      socket_path = argv[++i];
+    else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeat = std::max(1L, std::atol(argv[++i]));
+    else
+      request += (request.empty() ? "" : " ") + std::string(argv[i]);
+  }
+  if (request.empty()) {
+    std::cerr << "usage: f1-pu-client [--socket path] [--repeat n] "
+                 "<request ...>\n";
+    return 1;
+  }
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, socket_path.c_str(), sizeof addr.sun_path - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof addr) < 0) {
+    std::cerr << "cannot connect to " << socket_path << ": "
+              << std::strerror(errno) << "\n";
+    return 1;
+  }
+
+  std::string line = request + "\n";
+  std::string buffer, reply;
+  auto start = Clock::now();
+  for (long r = 0; r < repeat; r++) {
+    if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) < 0 ||
+        !readLine(fd, buffer, reply)) {
+      std::cerr << "connection closed by daemon\n";
+      return 1;
+    }
+  }
+  double elapsed = secondsSince(start);
+  close(fd);
+
+  std::cout << reply << "\n";
+  if (repeat > 1)
+    std::cerr << repeat << " requests in " << elapsed << " s ("
+              << double(repeat) / elapsed << " /s)\n";
+  return reply.compare(0, 5, "error") == 0 ? 1 : 0;
+}
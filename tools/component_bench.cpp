@@ -0,0 +1,121 @@
+// Component-in-the-loop bench: runs many variants of one subsystem
+// against the boundary conditions recorded in a telemetry log, without
+// the rest of the engine.
+//
+//   f1-pu-component-bench <turbo|mguh|ers> <trace> [--variants file]
+//                         [--vary "key v1 v2 ..."]... [--variant "name
+//                         key=value ..."]... [--dt s] [--log-interval n]
+//                         [--threads n] [--out-dir D]
+//
+// The trace is a CSV or .f1pz log (data/engine_log.csv by default runs).
+// --vary and --variant add lines to the variants file (see
+// include/component_bench.hpp). Writes D/<component>_<nnn>.f1pz per
+// variant with only the component's channels, every n bench steps (D
+// defaults to data/bench), and D/<component>_summary.csv with each
+// output's final value and its RMS and largest difference from the
+// recorded channel.
+#include "../include/component_bench.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static int usage() {
+  std::cerr << "usage: f1-pu-component-bench <turbo|mguh|ers> <trace> "
+               "[--variants file]\n"
+               "           [--vary \"key v1 v2 ...\"]... "
+               "[--variant \"name key=value ...\"]...\n"
+               "           [--dt s] [--log-interval n] [--threads n] "
+               "[--out-dir D]\n";
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3)
+    return usage();
+  std::string component_name = argv[1], trace_path = argv[2];
+  std::string variants_path, extra;
+  BenchOptions options;
+  options.out_dir = "data/bench";
+  for (int i = 3; i < argc; i++) {
+    if (std::strcmp(argv[i], "--variants") == 0 && i + 1 < argc)
+      variants_path = argv[++i];
+    else if (std::strcmp(argv[i], "--vary") == 0 && i + 1 < argc)
+      extra += std::string("vary ") + argv[++i] + "\n";
+    else if (std::strcmp(argv[i], "--variant") == 0 && i + 1 < argc)
+      extra += std::string("variant ") + argv[++i] + "\n";
+    else if (std::strcmp(argv[i], "--dt") == 0 && i + 1 < argc)
+      options.dt = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--log-interval") == 0 && i + 1 < argc)
+      options.log_interval = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      options.threads = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc)
+      options.out_dir = argv[++i];
+    else
+      return usage();
+  }
+
+  try {
+    BenchComponent component = parseBenchComponent(component_name);
+    std::string text;
+    if (!variants_path.empty()) {
+      std::ifstream in(variants_path);
+      if (!in)
+        throw std::runtime_error("cannot open " + variants_path);
+      std::stringstream buf;
+      buf << in.rdbuf();
+      text = buf.str() + "\n";
+    }
+    std::vector<BenchVariant> variants =
+        parseBenchVariants(text + extra, component);
+    TelemetryTrace trace = readTelemetry(trace_path);
+
+    BenchResult r = runComponentBench(component, trace, variants, options);
+    double steps = double(r.steps) * r.variants.size();
+    std::printf("%s bench: %zu variants x %lld steps in %.3f s "
+                "(%.3g variant-steps/s)\n",
+                benchComponentName(component), r.variants.size(),
+                (long long)r.steps, r.seconds,
+                r.seconds > 0 ? steps / r.seconds : 0.0);
+
+    std::string summary_path = options.out_dir + "/" +
+                               benchComponentName(component) +
+                               "_summary.csv";
+    FILE *out = std::fopen(summary_path.c_str(), "w");
+    if (!out)
+      throw std::runtime_error("cannot write " + summary_path);
+    std::fprintf(out, "variant,trace");
+    for (const std::string &name : r.outputs)
+      std::fprintf(out, ",%s_final,%s_rms,%s_max_abs", name.c_str(),
+                   name.c_str(), name.c_str());
+    std::fprintf(out, "\n");
+
+    for (const BenchVariantResult &v : r.variants) {
+      std::printf("  %s\n", v.variant.c_str());
+      std::fprintf(out, "\"%s\",%s", v.variant.c_str(), v.trace_path.c_str());
+      for (size_t o = 0; o < r.outputs.size(); o++) {
+        std::printf("    %-24s final %-12.6g", r.outputs[o].c_str(),
+                    v.final_value[o]);
+        if (std::isfinite(v.rms[o]))
+          std::printf(" vs recorded: rms %.3g, max %.3g", v.rms[o],
+                      v.max_abs[o]);
+        std::printf("\n");
+        std::fprintf(out, ",%.9g,%.9g,%.9g", v.final_value[o], v.rms[o],
+                     v.max_abs[o]);
+      }
+      std::fprintf(out, "\n");
+    }
+    bool failed = std::ferror(out) != 0;
+    if (std::fclose(out) != 0 || failed)
+      throw std::runtime_error("cannot write " + summary_path);
+    std::printf("traces and %s written\n", summary_path.c_str());
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
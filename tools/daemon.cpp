@@ -0,0 +1,60 @@
+// Local simulation daemon (protocol in include/daemon.hpp).
+//
+//   f1-pu-daemon [--socket path] [--cache dir] [--workers n]
+//                [--max-queued n] [--max-clients n]
+//
+// --cache "" disables the on-disk result cache. SIGINT/SIGTERM or a
+// "shutdown" request stop it.
+#include "../include/daemon.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static SimulationDaemon *running_daemon = nullptr;
+
+static void onSignal(int) {
+  if (running_daemon)
+    running_daemon->stop();
+}
+
+int main(int argc, char **argv) {
+  DaemonOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "missing value for " << arg << "\n";
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--socket")
+      options.socket_path = value;
+    else if (arg == "--cache")
+      options.cache_dir = value;
+    else if (arg == "--workers")
+      options.workers = std::atoi(value);
+    else if (arg == "--max-queued")
+      options.max_queued = std::atoi(value);
+    else if (arg == "--max-clients")
+      options.max_clients = std::atoi(value);
+    else {
+      std::cerr << "unknown option " << arg << "\n";
+      return 1;
+    }
+  }
+
+  try {
+    SimulationDaemon daemon(options);
+    running_daemon = &daemon;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::cerr << "f1-pu-daemon listening on " << options.socket_path << "\n";
+    daemon.serve();
+    running_daemon = nullptr;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Benchmarks the ECU control loop on its own and the full plant at several
+// control rates.
+//
+//   f1-pu-ecu-bench [updates]
+#include "../include/ecu.hpp"
+#include "../include/ice_engine.hpp"
+#include "../include/scenario.hpp"
+#include "bench_clock.hpp"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Control-only loop over a synthetic sweep of plant measurements
+static double benchControl(Ecu &ecu, long updates) {
+  EcuInputs in{0.0, 0.0, constants::ambient_pressure, 2100.0, 0.5};
+  double checksum = 0.0;
+
+  auto start = Clock::now();
+  for (long i = 0; i < updates; i++) {
+    double phase = double(i % 1000) / 1000.0;
+    in.driver_throttle = phase;
+    in.angular_velocity = 300.0 + 1200.0 * phase;
+    in.boost_pressure = constants::ambient_pressure * (1.0 + 3.0 * phase);
+    in.battery_soc = 1.0 - phase;
+    ecu.control(in, 0.001);
+    checksum += ecu.getCommands().mguh_power + ecu.getCommands().mguk_power;
+  }
+  double elapsed = secondsSince(start);
+
+  volatile double sink = 0.0; // keeps the loop from being optimised out
+  sink += checksum;
+  return elapsed * 1e9 / double(updates);
+}
+
+int main(int argc, char **argv) {
+  long updates = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "control loop alone (" << updates << " updates)\n";
+
+  Ecu stock;
+  std::cout << "  bang-bang boost + throttle deployment: "
+            << benchControl(stock, updates) << " ns/update\n";
+
+  Ecu tuned;
+  tuned.setBoostStrategy(std::make_unique<PidBoost<double>>());
+  tuned.setDeploymentStrategy(std::make_unique<SocAwareDeployment<double>>());
+  std::cout << "  PID boost + SOC-aware deployment:      "
+            << benchControl(tuned, updates) << " ns/update\n";
+
+  Scenario scenario;
+  std::cout << "\nfull plant, " << scenario.name << " scenario ("
+            << scenario.iterations << " steps of " << scenario.dt * 1e3
+            << " ms)\n";
+
+  for (double period : {0.0001, 0.001, 0.01}) {
+    ICEEngine engine;
+    engine.getEcu().setControlPeriod(period);
+
+    auto start = Clock::now();
+    for (int i = 0; i < scenario.iterations; i++) {
+      engine.setThrottle(scenario.throttleAt(i * scenario.dt));
+      engine.update(scenario.dt);
+    }
+    double elapsed = secondsSince(start);
+
+    std::cout << "  ECU every " << std::setw(5) << period * 1e3 << " ms: "
+              << std::setw(8) << scenario.iterations / elapsed / 1e6
+              << " M steps/s, " << engine.getEcu().getUpdateCount()
+              << " ECU updates, final RPM " << engine.getRPM() << ", SOC "
+              << engine.getBatterySOC() * 100 << "%\n";
+  }
+  return 0;
+}
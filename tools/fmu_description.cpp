@@ -0,0 +1,21 @@
+// Writes the FMU's modelDescription.xml (used when packing f1pu.fmu).
+//
+//   f1-pu-fmu-description [file]   (stdout without a file)
+#include "../include/fmu.hpp"
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv) {
+  std::string xml = fmuModelDescription();
+  if (argc < 2) {
+    std::cout << xml;
+    return 0;
+  }
+  std::ofstream out(argv[1]);
+  out << xml;
+  if (!out) {
+    std::cerr << "cannot write " << argv[1] << "\n";
+    return 1;
+  }
+  return 0;
+}
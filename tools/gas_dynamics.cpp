@@ -0,0 +1,134 @@
+// Cost and behaviour of the 1D gas-dynamics runners on a reference
+// scenario.
+//
+//   f1-pu-gas-dynamics [--scenario name] [--runner-cells n] [--cfl x]
+//                      [--repeat n]
+//
+// Runs the golden scenario (f1-pu-golden list, default ramp) with the
+// lumped exhaust and intake and with the pipe model (--runner-cells sets
+// the cells of every runner, --cfl its Courant number), best of --repeat
+// runs each (default 3). Prints the time per step of both, then the mean
+// air flow and turbine inlet state over the last engine cycle and the
+// pulse the turbine sees.
+#include "../include/golden.hpp"
+#include "../include/ice_engine.hpp"
+#include "bench_clock.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Best wall time of `repeat` runs; `engine` is left in the final state
+static double timeRun(const GoldenScenario &g, const GasDynamicsParams *gas,
+                      int repeat, ICEEngine &engine) {
+  const Scenario &s = g.scenario;
+  double best = 1e300;
+  for (int r = 0; r < repeat; r++) {
+    engine = ICEEngine();
+    if (gas)
+      engine.setGasDynamics(*gas);
+    if (g.initial_soc >= 0.0) {
+      PlantState state = engine.getPlantState();
+      state.battery_soc = g.initial_soc;
+      engine.setPlantState(state);
+    }
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < s.iterations; i++) {
+      engine.setThrottle(s.throttleAt(i * s.dt));
+      engine.update(s.dt);
+    }
+    best = std::min(best, secondsSince(start));
+  }
+  return best;
+}
+
+struct CycleStats {
+  double air_flow = 0.0, turbine_pressure = 0.0, turbine_flow = 0.0;
+  double pressure_min = 1e300, pressure_max = 0.0;
+  int substeps = 0;
+};
+
+// Carries on at the final throttle for one engine cycle (720°)
+static CycleStats lastCycle(ICEEngine &engine, const Scenario &s) {
+  CycleStats stats;
+  double throttle = s.throttleAt(s.iterations * s.dt);
+  double angle = 0.0;
+  int steps = 0;
+  while (angle < 4.0 * constants::PI) {
+    engine.setThrottle(throttle);
+    engine.update(s.dt);
+    angle += engine.getAngularVelocity() * s.dt;
+    const GasDynamics *gas = engine.getGasDynamics();
+    double pressure = engine.getExhaustManifoldPressure();
+    stats.air_flow += engine.getActualAirFlow();
+    stats.turbine_pressure += pressure;
+    stats.turbine_flow +=
+        gas ? gas->getTurbineMassFlow() : engine.getExhaustMassFlowRate();
+    stats.pressure_min = std::min(stats.pressure_min, pressure);
+    stats.pressure_max = std::max(stats.pressure_max, pressure);
+    stats.substeps = std::max(stats.substeps, gas ? gas->getSubsteps() : 1);
+    steps++;
+  }
+  stats.air_flow /= steps;
+  stats.turbine_pressure /= steps;
+  stats.turbine_flow /= steps;
+  return stats;
+}
+
+static void report(const char *label, const CycleStats &c) {
+  std::printf("%-8s air %.4f kg/s, turbine %.4f kg/s at %.3f bar "
+              "(%.3f..%.3f)\n",
+              label, c.air_flow, c.turbine_flow, c.turbine_pressure / 1e5,
+              c.pressure_min / 1e5, c.pressure_max / 1e5);
+}
+
+int main(int argc, char **argv) {
+  std::string name = "ramp";
+  int repeat = 3;
+  GasDynamicsParams params;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+      name = argv[++i];
+    else if (std::strcmp(argv[i], "--runner-cells") == 0 && i + 1 < argc)
+      params.exhaust_runner.cells = params.intake_runner.cells =
+          std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--cfl") == 0 && i + 1 < argc)
+      params.cfl = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeat = std::max(1, std::atoi(argv[++i]));
+    else {
+      std::cerr << "usage: f1-pu-gas-dynamics [--scenario name] "
+                   "[--runner-cells n] [--cfl x]\n"
+                   "                          [--repeat n]\n";
+      return 2;
+    }
+  }
+
+  try {
+    const GoldenScenario &g = findGoldenScenario(name);
+    int steps = g.scenario.iterations;
+    ICEEngine lumped, pipes;
+    double lumped_s = timeRun(g, nullptr, repeat, lumped);
+    double pipes_s = timeRun(g, &params, repeat, pipes);
+    int cells = pipes.getGasDynamics()->cellCount();
+
+    std::printf("%s: %d steps\n", g.scenario.name.c_str(), steps);
+    std::printf("lumped   %.3f us/step\n", lumped_s / steps * 1e6);
+    std::printf("pipes    %.3f us/step with %d cells (+%.3f us, %.2f ns "
+                "per cell-step)\n",
+                pipes_s / steps * 1e6, cells,
+                (pipes_s - lumped_s) / steps * 1e6,
+                (pipes_s - lumped_s) / steps / cells * 1e9);
+
+    std::printf("last engine cycle:\n");
+    report("lumped", lastCycle(lumped, g.scenario));
+    CycleStats c = lastCycle(pipes, g.scenario);
+    report("pipes", c);
+    std::printf("         up to %d substeps per step\n", c.substeps);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Golden-trace regression checks: reruns the reference scenarios, diffs
+// every channel against the stored traces and reports the accuracy
+// verdict together with the measured step throughput.
+//
+//   f1-pu-golden list
+//   f1-pu-golden record [--dir D] [--scenario name]...
+//   f1-pu-golden check [--dir D] [--tolerances file] [--report file]
+//                      [--repeat n] [--scenario name]...
+//
+// D defaults to data/golden, the tolerances to D/tolerances.txt (see
+// include/golden.hpp) and the report to data/golden_report.json. check
+// exits with 1 if any scenario fails. --repeat times each scenario n times
+// and keeps the fastest.
+#include "../include/golden.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+static int usage() {
+  std::cerr << "usage: f1-pu-golden list\n"
+               "       f1-pu-golden record [--dir D] [--scenario name]...\n"
+               "       f1-pu-golden check [--dir D] [--tolerances file] "
+               "[--report file]\n"
+               "                          [--repeat n] [--scenario name]...\n";
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+  std::string command = argv[1];
+
+  std::string dir = "data/golden", tolerances_path;
+  std::string report_path = "data/golden_report.json";
+  int repeat = 1;
+  std::vector<std::string> names;
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+      dir = argv[++i];
+    else if (std::strcmp(argv[i], "--tolerances") == 0 && i + 1 < argc)
+      tolerances_path = argv[++i];
+    else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+      report_path = argv[++i];
+    else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeat = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+      names.push_back(argv[++i]);
+    else
+      return usage();
+  }
+  if (tolerances_path.empty())
+    tolerances_path = dir + "/tolerances.txt";
+
+  try {
+    std::vector<GoldenScenario> scenarios;
+    for (const std::string &name : names)
+      scenarios.push_back(findGoldenScenario(name));
+    if (names.empty())
+      scenarios = goldenScenarios();
+
+    if (command == "list") {
+      for (const GoldenScenario &g : goldenScenarios())
+        std::cout << g.scenario.name << ": " << g.scenario.iterations
+                  << " steps of " << g.scenario.dt * 1e3 << " ms, a row every "
+                  << g.log_interval << "\n";
+    } else if (command == "record") {
+      std::filesystem::create_directories(dir);
+      for (const GoldenScenario &g : scenarios) {
+        GoldenRun run = runGoldenScenario(g);
+        std::string path = goldenTracePath(dir, g.scenario.name);
+        writeGoldenTrace(path, run.trace);
+        std::cout << path << ": " << run.trace.time.size() << " rows, "
+                  << std::filesystem::file_size(path) << " bytes\n";
+      }
+    } else if (command == "check") {
+      GoldenTolerances tolerances = loadGoldenTolerances(tolerances_path);
+      std::vector<GoldenResult> results;
+      bool pass = true;
+      for (const GoldenScenario &g : scenarios) {
+        GoldenResult r = checkGoldenScenario(g, dir, tolerances, repeat);
+        pass = pass && r.pass;
+        std::printf("%-16s %s  %8.0f steps/s  %6.1fx realtime  (%lld steps "
+                    "in %.3f s)\n",
+                    r.scenario.c_str(), r.pass ? "PASS" : "FAIL",
+                    r.stepsPerSecond(),
+                    r.seconds > 0 ? r.simulated / r.seconds : 0.0,
+                    (long long)r.steps, r.seconds);
+        if (!r.error.empty())
+          std::printf("  %s\n", r.error.c_str());
+        for (const ChannelDiff &d : r.channels)
+          if (!d.pass)
+            std::printf("  %-26s max abs %.3g at %.4f s, max rel %.3g, "
+                        "rms %.3g, event shift %.3g s\n",
+                        d.channel.c_str(), d.max_abs, d.max_abs_time,
+                        d.max_rel, d.rms, d.event_shift);
+        results.push_back(r);
+      }
+      writeGoldenReport(report_path, results);
+      std::cout << (pass ? "PASS" : "FAIL") << ", report written to "
+                << report_path << "\n";
+      return pass ? 0 : 1;
+    } else {
+      return usage();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+// Linearised state-space model of the power unit at an operating point.
+//
+//   f1-pu-linearize [--time t] [--throttle x] [--period Ts] [--fd]
+//
+// The operating point is the state after t seconds (default 5) of the
+// standard ramp, or of a constant throttle x. Prints discrete-time A/B/C/D
+// for sample period Ts (default 1 ms) around it; --fd adds a
+// finite-difference check of the AD Jacobians.
+#include "../include/linear_model.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+constexpr int nx = LinearModel::kStates;
+constexpr int nu = LinearModel::kInputs;
+constexpr int ny = LinearModel::kOutputs;
+
+static void printMatrix(const char *title, const double *m, int rows,
+                        int cols, const char *const *row_names,
+                        const char *const *col_names) {
+  std::cout << title << "\n" << std::setw(20) << "";
+  for (int c = 0; c < cols; c++)
+    std::cout << std::setw(20) << col_names[c];
+  std::cout << "\n";
+  for (int r = 0; r < rows; r++) {
+    std::cout << std::setw(20) << row_names[r];
+    for (int c = 0; c < cols; c++)
+      std::cout << std::setw(20) << m[r * cols + c];
+    std::cout << "\n";
+  }
+  std::cout << "\n";
+}
+
+// One period from the operating point with the given state and inputs
+static void stepFrom(const ICEEngine &at, double dt, long steps,
+                     const double *x, const double *u, double *x1,
+                     double *y) {
+  ICEEngine e = at;
+  e.setPlantState({x[0], x[1], x[2], x[3]});
+  e.setThrottle(u[0]);
+  Ecu &ecu = e.getEcu();
+  ecu.setDeploymentStrategy(std::make_unique<ManualDeployment<double>>(u[1]));
+  ecu.setBoostStrategy(std::make_unique<ManualBoost<double>>(u[2]));
+  ecu.setControlPeriod(double(steps) * dt);
+  for (long s = 0; s < steps; s++) {
+    e.update(dt);
+    if (s == 0)
+      outputVector(e, y);
+  }
+  plantVector(e, x1);
+}
+
+// Largest |AD - FD| relative to the larger magnitude in each column
+static void finiteDifferenceCheck(const ICEEngine &at, const LinearModel &m,
+                                  double dt) {
+  long steps = std::lround(m.period / dt);
+  const double scale[nx + nu] = {1.0, 100.0, 1.0, 1e-3, 1e-3, 1.0, 1.0};
+
+  std::cout << "finite-difference check (max relative difference per "
+               "column)\n";
+  for (int var = 0; var < nx + nu; var++) {
+    double x[nx], u[nu];
+    std::copy(m.x0, m.x0 + nx, x);
+    std::copy(m.u0, m.u0 + nu, u);
+    double &v = var < nx ? x[var] : u[var - nx];
+    double base = v;
+    double h = 1e-6 * std::max(std::abs(base), scale[var]);
+
+    // One-sided at the throttle's upper bound
+    bool backward = var == nx && base + h > 1.0;
+    double xp[nx], yp[ny], xm[nx], ym[ny];
+    v = backward ? base : base + h;
+    stepFrom(at, dt, steps, x, u, xp, yp);
+    v = base - h;
+    stepFrom(at, dt, steps, x, u, xm, ym);
+    double span = backward ? h : 2.0 * h;
+
+    double worst = 0.0;
+    for (int i = 0; i < nx + ny; i++) {
+      double fd = i < nx ? (xp[i] - xm[i]) / span
+                         : (yp[i - nx] - ym[i - nx]) / span;
+      double ad = i < nx ? (var < nx ? m.A[i][var] : m.B[i][var - nx])
+                         : (var < nx ? m.C[i - nx][var] : m.D[i - nx][var - nx]);
+      double mag = std::max({std::abs(fd), std::abs(ad), 1e-12});
+      worst = std::max(worst, std::abs(fd - ad) / mag);
+    }
+    std::cout << "  " << std::setw(20) << std::left
+              << (var < nx ? LinearModel::state_names[var]
+                           : LinearModel::input_names[var - nx])
+              << std::right << worst << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  double time = 5.0;
+  double period = 0.001;
+  double throttle = -1.0;
+  bool finite_difference = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+      time = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--throttle") == 0 && i + 1 < argc)
+      throttle = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--period") == 0 && i + 1 < argc)
+      period = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--fd") == 0)
+      finite_difference = true;
+    else {
+      std::cerr << "usage: f1-pu-linearize [--time t] [--throttle x] "
+                   "[--period Ts] [--fd]\n";
+      return 1;
+    }
+  }
+
+  Scenario scenario;
+  if (throttle >= 0.0)
+    scenario.throttle = {{0.0, throttle}};
+  int steps = int(std::lround(time / scenario.dt));
+
+  // Same trajectory in both scalar types
+  ICEEngine engine;
+  BasicICEEngine<ad::ModelDual> dual_engine;
+  for (int i = 0; i < steps; i++) {
+    double t = scenario.throttleAt(i * scenario.dt);
+    engine.setThrottle(t);
+    engine.update(scenario.dt);
+    dual_engine.setThrottle(t);
+    dual_engine.update(scenario.dt);
+  }
+
+  LinearModel m = linearize(dual_engine, scenario.dt, period);
+
+  std::cout << "operating point t=" << time << " s, Ts=" << m.period
+            << " s (discrete time)\n\n"
+            << std::scientific << std::setprecision(4);
+  const char *const value[] = {"value"};
+  printMatrix("x0", m.x0, 1, nx, value, LinearModel::state_names);
+  printMatrix("dx0 (drift per period)", m.dx0, 1, nx, value,
+              LinearModel::state_names);
+  printMatrix("u0", m.u0, 1, nu, value, LinearModel::input_names);
+  printMatrix("y0", m.y0, 1, ny, value, LinearModel::output_names);
+  printMatrix("A", &m.A[0][0], nx, nx, LinearModel::state_names,
+              LinearModel::state_names);
+  printMatrix("B", &m.B[0][0], nx, nu, LinearModel::state_names,
+              LinearModel::input_names);
+  printMatrix("C", &m.C[0][0], ny, nx, LinearModel::output_names,
+              LinearModel::state_names);
+  printMatrix("D", &m.D[0][0], ny, nu, LinearModel::output_names,
+              LinearModel::input_names);
+
+  if (finite_difference)
+    finiteDifferenceCheck(engine, m, scenario.dt);
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Turbo map checks and lookup cost.
+//
+//   f1-pu-map-bench [map file]
+//
+// 1. Compares the closed-form-equivalent maps with the closed-form
+//    pressure ratio and efficiencies over a speed/flow sweep (expected 0).
+// 2. Reads each compressor speed line back: the flow found at a pressure
+//    ratio must give that ratio again, and be no less than the flow it
+//    came from. Exits 1 if either check fails.
+// 3. Times map lookups along a slowly moving operating point against the
+//    std::pow expression the closed-form model evaluates every step.
+// 4. With a map file, runs the scenario on it and prints the final state.
+#include "../include/constants.hpp"
+#include "../include/ice_engine.hpp"
+#include "../include/scenario.hpp"
+#include "../include/telemetry.hpp"
+#include "bench_clock.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+static void run(ICEEngine &engine, const Scenario &scenario,
+                std::vector<double> &trace) {
+  double row[kTelemetryChannels];
+  for (int i = 0; i < scenario.iterations; i++) {
+    engine.setThrottle(scenario.throttleAt(i * scenario.dt));
+    engine.update(scenario.dt);
+    if (i % 10 == 0) {
+      sampleTelemetry(engine, row);
+      trace.insert(trace.end(), row, row + kTelemetryChannels);
+    }
+  }
+}
+
+// Largest difference from the closed-form PR ramp and efficiencies
+static double closedFormDifference(const EngineParams &params) {
+  TurboMaps maps = TurboMaps::closedForm(params.turbine_efficiency,
+                                         params.compressor_efficiency);
+  MapCursor compressor_cursor, turbine_cursor;
+  double worst = 0.0;
+  for (int a = 0; a <= 150; a++)
+    for (int b = 0; b <= 200; b++) {
+      double speed = a * 0.01, y = b * 0.01;
+      double pr = constants::turbo_pr_idle +
+                  (constants::turbo_max_pr - constants::turbo_pr_idle) *
+                      std::clamp(speed, 0.0, 1.0);
+      double compressor[2], turbine;
+      maps.compressor.lookup(speed, y, compressor_cursor, compressor);
+      maps.turbine.lookup(speed, 1.0 + y, turbine_cursor, &turbine);
+      worst = std::max(
+          {worst, std::abs(compressor[TurboMaps::kCompressorPR] - pr),
+           std::abs(compressor[TurboMaps::kCompressorEfficiency] -
+                    params.compressor_efficiency),
+           std::abs(turbine - params.turbine_efficiency)});
+    }
+  return worst;
+}
+
+// Largest PR error of the flow read back from each speed line
+static double speedLineReadBack(const Map2D &compressor) {
+  const std::vector<double> &speeds = compressor.xAxis().points;
+  const std::vector<double> &flows = compressor.yAxis().points;
+  MapCursor cursor;
+  double worst = 0.0;
+  for (int a = 0; a <= 100; a++)
+    for (int b = 0; b <= 100; b++) {
+      double speed =
+          speeds.front() + (speeds.back() - speeds.front()) * a / 100;
+      double flow = flows.front() + (flows.back() - flows.front()) * b / 100;
+      double out[2];
+      compressor.lookup(speed, flow, cursor, out);
+      double pr = out[TurboMaps::kCompressorPR];
+      double back = compressor.lastYReaching(speed, TurboMaps::kCompressorPR,
+                                             pr, cursor);
+      compressor.lookup(speed, back, cursor, out);
+      double error = std::abs(out[TurboMaps::kCompressorPR] - pr);
+      if (back < flow - 1e-12)
+        error = std::max(error, flow - back);
+      worst = std::max(worst, error);
+    }
+  return worst;
+}
+
+int main(int argc, char **argv) {
+  Scenario scenario;
+  EngineParams params;
+
+  // ---------------- CHECKS ----------------
+  TurboMaps maps = argc > 1 ? TurboMaps::load(argv[1])
+                            : TurboMaps::closedForm(0.72, 0.74);
+  double equivalence = closedFormDifference(params);
+  double read_back = speedLineReadBack(maps.compressor);
+  std::cout << "closed-form-equivalent maps: max |difference| = "
+            << equivalence << "\n"
+            << "compressor speed lines read back at their own PR: max "
+               "error = "
+            << read_back << "\n";
+  bool ok = equivalence == 0.0 && read_back < 1e-9;
+
+  // ---------------- LOOKUP COST ----------------
+  const long n = 10000000;
+  volatile double sink = 0.0; // keeps the loops from being optimised out
+
+  MapCursor cursor;
+  double out[2];
+  auto start = Clock::now();
+  for (long i = 0; i < n; i++) {
+    double phase = double(i % 100000) * 1e-5; // slow sweep across the map
+    maps.compressor.lookup(phase, 1.2 * phase, cursor, out);
+    sink += out[0] + out[1];
+  }
+  double lookup_ns = secondsSince(start) * 1e9 / n;
+
+  start = Clock::now();
+  for (long i = 0; i < n; i++) {
+    double phase = double(i % 100000) * 1e-5;
+    sink += maps.compressor.lastYReaching(
+        phase, TurboMaps::kCompressorPR, 1.0 + 2.0 * phase, cursor);
+  }
+  double flow_ns = secondsSince(start) * 1e9 / n;
+
+  start = Clock::now();
+  for (long i = 0; i < n; i++) {
+    double phase = double(i % 100000) * 1e-5;
+    sink += std::pow(1.0 + 2.0 * phase,
+                     (constants::gamma - 1.0) / constants::gamma);
+  }
+  double pow_ns = secondsSince(start) * 1e9 / n;
+
+  std::cout << std::fixed << std::setprecision(2)
+            << "compressor map lookup (PR + efficiency): " << lookup_ns
+            << " ns\ncompressor flow at PR (speed line):      " << flow_ns
+            << " ns\nclosed-form std::pow:                    " << pow_ns
+            << " ns\n";
+
+  // ---------------- MAP RUN ----------------
+  if (argc > 1) {
+    std::vector<double> trace;
+    ICEEngine engine(params);
+    engine.setTurboMaps(std::make_shared<TurboMaps>(maps));
+    run(engine, scenario, trace);
+    std::cout << "\nwith " << argv[1] << ": RPM " << engine.getRPM()
+              << ", boost " << engine.getBoostPressure() / 101325.0
+              << " bar, turbo " << engine.getTurboSpeedRPM() << " RPM\n";
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Cost and behaviour of the cell-resolved battery pack on a reference
+// scenario.
+//
+//   f1-pu-pack [--scenario name] [--cells n] [--cell-period s]
+//              [--repeat n]
+//
+// Runs the golden scenario (f1-pu-golden list, default ramp) with the
+// single-state battery and with an n-cell pack (default 200) whose cells
+// advance every --cell-period seconds (default 0.01, 0 every step), best of
+// --repeat runs each (default 3). Prints the time per step of both and
+// the pack's share of it, then the state each run ends in: SOC, cell
+// spread, hottest cell and the pack's power limits. Exits with 1 if the
+// pack SOC jumps at a cell update instead of following the charge drawn
+// between them.
+#include "../include/golden.hpp"
+#include "../include/ice_engine.hpp"
+#include "bench_clock.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Best wall time of `repeat` runs; `engine` is left in the final state
+static double timeRun(const GoldenScenario &g, const BatteryPackParams *pack,
+                      int repeat, ICEEngine &engine) {
+  const Scenario &s = g.scenario;
+  double best = 1e300;
+  for (int r = 0; r < repeat; r++) {
+    engine = ICEEngine();
+    if (pack)
+      engine.setBatteryPack(*pack);
+    if (g.initial_soc >= 0.0) {
+      PlantState state = engine.getPlantState();
+      state.battery_soc = g.initial_soc;
+      engine.setPlantState(state);
+    }
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < s.iterations; i++) {
+      engine.setThrottle(s.throttleAt(i * s.dt));
+      engine.update(s.dt);
+    }
+    best = std::min(best, secondsSince(start));
+  }
+  return best;
+}
+
+// Largest step-to-step SOC change that exceeds twice both neighbouring
+// changes (a jump), or 0 if the SOC follows the charge continuously
+static double socJump(const GoldenScenario &g, const BatteryPackParams &pack) {
+  const Scenario &s = g.scenario;
+  ICEEngine engine;
+  engine.setBatteryPack(pack);
+  if (g.initial_soc >= 0.0) {
+    PlantState state = engine.getPlantState();
+    state.battery_soc = g.initial_soc;
+    engine.setPlantState(state);
+  }
+  double soc = engine.getBatterySOC();
+  double before = 0.0, change = 0.0, jump = 0.0;
+  for (int i = 0; i < s.iterations; i++) {
+    engine.setThrottle(s.throttleAt(i * s.dt));
+    engine.update(s.dt);
+    double after = std::fabs(engine.getBatterySOC() - soc);
+    soc = engine.getBatterySOC();
+    if (i >= 2 && change > 2.0 * std::max(before, after) + 1e-9)
+      jump = std::max(jump, change);
+    before = change;
+    change = after;
+  }
+  return jump;
+}
+
+int main(int argc, char **argv) {
+  std::string name = "ramp";
+  int repeat = 3;
+  BatteryPackParams params;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+      name = argv[++i];
+    else if (std::strcmp(argv[i], "--cells") == 0 && i + 1 < argc)
+      params.cells = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--cell-period") == 0 && i + 1 < argc)
+      params.cell_period = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+      repeat = std::max(1, std::atoi(argv[++i]));
+    else {
+      std::cerr << "usage: f1-pu-pack [--scenario name] [--cells n] "
+                   "[--cell-period s]\n"
+                   "                  [--repeat n]\n";
+      return 2;
+    }
+  }
+
+  try {
+    const GoldenScenario &g = findGoldenScenario(name);
+    int steps = g.scenario.iterations;
+    ICEEngine single, cells;
+    double single_s = timeRun(g, nullptr, repeat, single);
+    double pack_s = timeRun(g, &params, repeat, cells);
+    const BatteryPack &pack = *cells.getBatteryPack();
+
+    std::printf("%s: %d steps\n", g.scenario.name.c_str(), steps);
+    std::printf("single state   %.3f us/step\n", single_s / steps * 1e6);
+    std::printf("%d-cell pack   %.3f us/step (+%.3f us, %.2f ns per "
+                "cell-step)\n",
+                pack.cellCount(), pack_s / steps * 1e6,
+                (pack_s - single_s) / steps * 1e6,
+                (pack_s - single_s) / steps / pack.cellCount() * 1e9);
+
+    std::printf("final SOC      %.4f single state, %.4f pack (cells "
+                "%.4f..%.4f)\n",
+                single.getBatterySOC(), cells.getBatterySOC(),
+                pack.getMinCellSOC(), pack.getMaxCellSOC());
+    std::printf("pack           %.1f V open circuit, %.1f V at %.1f A, "
+                "%.4f ohm\n",
+                pack.getOpenCircuitVoltage(), pack.getTerminalVoltage(),
+                pack.getCurrent(), pack.getResistance());
+    std::printf("hottest cell   %.2f K\n", pack.getMaxCellTemperature());
+    std::printf("limits         %.1f kW discharge, %.1f kW charge\n",
+                pack.getMaxDischargePower() / 1e3,
+                pack.getMaxChargePower() / 1e3);
+
+    double jump = socJump(g, params);
+    if (jump > 0.0) {
+      std::printf("SOC continuity FAIL, jumps by %.3g at a cell update\n",
+                  jump);
+      return 1;
+    }
+    std::printf("SOC continuity ok\n");
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
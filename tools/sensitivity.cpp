@@ -0,0 +1,78 @@
+// Parameter sensitivities of the standard ramp run in one AD pass.
+//
+//   f1-pu-sensitivity [--fd] [param ...]
+//
+// Without parameter names the turbo efficiencies, fmepA and intercooler_eff
+// are used. --fd also runs central finite differences for comparison.
+#include "../include/sensitivity.hpp"
+#include "bench_clock.hpp"
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+int main(int argc, char **argv) {
+  bool finite_difference = false;
+  std::vector<std::string> parameters;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--fd") == 0)
+      finite_difference = true;
+    else
+      parameters.push_back(argv[i]);
+  }
+  if (parameters.empty())
+    parameters = {"compressor_efficiency", "turbine_efficiency", "fmepA",
+                  "intercooler_eff"};
+
+  EngineParams params;
+  Scenario scenario;
+
+  auto start = Clock::now();
+  evaluateOutputs(params, scenario);
+  double plain_s = secondsSince(start);
+
+  start = Clock::now();
+  SensitivityReport report;
+  try {
+    report = computeSensitivities(params, parameters, scenario);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  double ad_s = secondsSince(start);
+
+  std::cout << std::scientific << std::setprecision(6);
+  for (int o = 0; o < RunOutputs::count; o++) {
+    std::cout << RunOutputs::names[o] << " = " << report.values[o] << "\n";
+    for (size_t j = 0; j < parameters.size(); j++)
+      std::cout << "  d/d " << std::setw(32) << std::left << parameters[j]
+                << std::right << report.derivatives[o][j] << "\n";
+  }
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "\nplain run: " << plain_s << " s, AD run: " << ad_s
+            << " s (" << ad_s / plain_s << "x)\n";
+
+  if (!finite_difference)
+    return 0;
+
+  // Central differences: 2N extra plain runs
+  std::cout << "\nfinite-difference check (relative step 1e-6)\n"
+            << std::scientific << std::setprecision(6);
+  for (size_t j = 0; j < parameters.size(); j++) {
+    EngineParams up = params, down = params;
+    double *pu = findParameter(up, parameters[j]);
+    double *pd = findParameter(down, parameters[j]);
+    double h = 1e-6 * (*pu != 0.0 ? std::abs(*pu) : 1.0);
+    *pu += h;
+    *pd -= h;
+    std::vector<double> fu = evaluateOutputs(up, scenario);
+    std::vector<double> fd = evaluateOutputs(down, scenario);
+    for (int o = 0; o < RunOutputs::count; o++) {
+      double fd_grad = (fu[o] - fd[o]) / (2.0 * h);
+      std::cout << "  d" << RunOutputs::names[o] << "/d" << parameters[j]
+                << ": AD " << report.derivatives[o][j] << "  FD " << fd_grad
+                << "\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Builds the LPV surrogate and measures it against the physics model.
+//
+//   f1-pu-surrogate [--period Ts] [--stride n] [--save file] [--load file]
+//
+// Training runs: the standard ramp plus full-throttle runs with lift-offs
+// to 0, 0.1, ... 0.9. Validation: an unseen tip-in / lift-off sequence,
+// with the surrogate driven open-loop by the physics run's ECU commands.
+// Prints RMS / max error per state and output and the speed-up.
+#include "../include/linear_model.hpp"
+#include "bench_clock.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+constexpr int nx = LinearModel::kStates;
+constexpr int nu = LinearModel::kInputs;
+constexpr int ny = LinearModel::kOutputs;
+
+static std::vector<Scenario> trainingScenarios() {
+  std::vector<Scenario> runs(1); // standard ramp
+  for (int l = 0; l < 10; l++) {
+    double level = 0.1 * l;
+    Scenario s;
+    s.name = "lift-off";
+    s.throttle = {{0.0, 0.3}, {0.07, 1.0}, {3.0, 1.0},
+                  {3.0, level}, {6.0, level}, {6.0, 1.0}};
+    runs.push_back(s);
+  }
+  return runs;
+}
+
+static Scenario validationScenario() {
+  Scenario s;
+  s.name = "validation";
+  s.throttle = {{0.0, 0.3}, {0.07, 1.0}, {2.5, 1.0}, {2.6, 0.45},
+                {5.0, 0.45}, {5.05, 0.85}, {7.5, 0.85}, {7.5, 0.15}};
+  return s;
+}
+
+// Physics trajectory sampled once per period
+struct Trace {
+  std::vector<double> x; // [period][state], one more entry than u
+  std::vector<double> u; // [period][input]
+  std::vector<double> y; // [period][output]
+};
+
+static Trace physicsTrace(const Scenario &s, double period) {
+  long steps = std::max(1L, std::lround(period / s.dt));
+  ICEEngine engine;
+  engine.getEcu().setControlPeriod(double(steps) * s.dt);
+
+  Trace trace;
+  double x[nx], u[nu], y[ny];
+  plantVector(engine, x);
+  trace.x.insert(trace.x.end(), x, x + nx);
+
+  for (int i = 0; i + steps <= s.iterations; i += int(steps)) {
+    for (long k = 0; k < steps; k++) {
+      engine.setThrottle(s.throttleAt((i + k) * s.dt));
+      engine.update(s.dt);
+      if (k == 0) {
+        // Commands and outputs of this period's first physics step
+        inputVector(engine, u);
+        outputVector(engine, y);
+        trace.u.insert(trace.u.end(), u, u + nu);
+        trace.y.insert(trace.y.end(), y, y + ny);
+      }
+    }
+    plantVector(engine, x);
+    trace.x.insert(trace.x.end(), x, x + nx);
+  }
+  return trace;
+}
+
+static void printErrors(const char *const *names, int count,
+                        const std::vector<double> &reference,
+                        const std::vector<double> &model, size_t offset) {
+  size_t rows = model.size() / count;
+  for (int c = 0; c < count; c++) {
+    double lo = 1e300, hi = -1e300, sum_sq = 0.0, worst = 0.0;
+    for (size_t r = 0; r < rows; r++) {
+      double ref = reference[(r + offset) * count + c];
+      double err = model[r * count + c] - ref;
+      lo = std::min(lo, ref);
+      hi = std::max(hi, ref);
+      sum_sq += err * err;
+      worst = std::max(worst, std::abs(err));
+    }
+    double range = std::max(hi - lo, 1e-12);
+    std::cout << "  " << std::setw(20) << std::left << names[c] << std::right
+              << " rms " << std::setw(11) << std::sqrt(sum_sq / rows)
+              << " max " << std::setw(11) << worst << "  (" << std::fixed
+              << std::setprecision(2) << 100.0 * worst / range
+              << "% of range)\n"
+              << std::scientific << std::setprecision(3);
+  }
+}
+
+int main(int argc, char **argv) {
+  double period = 0.01;
+  int stride = 2;
+  std::string save_path, load_path;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--period") == 0 && i + 1 < argc)
+      period = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--stride") == 0 && i + 1 < argc)
+      stride = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+      save_path = argv[++i];
+    else if (std::strcmp(argv[i], "--load") == 0 && i + 1 < argc)
+      load_path = argv[++i];
+    else {
+      std::cerr << "usage: f1-pu-surrogate [--period Ts] [--stride n] "
+                   "[--save file] [--load file]\n";
+      return 1;
+    }
+  }
+
+  LpvSurrogate lpv;
+  try {
+    auto start = Clock::now();
+    if (!load_path.empty()) {
+      lpv = LpvSurrogate::load(load_path);
+      period = lpv.getPeriod();
+    } else {
+      lpv = LpvSurrogate::build(EngineParams{}, trainingScenarios(), period,
+                                stride);
+    }
+    std::cout << "surrogate: " << lpv.getModelCount()
+              << " local models, Ts=" << lpv.getPeriod() << " s ("
+              << secondsSince(start) << " s to "
+              << (load_path.empty() ? "build" : "load") << ")\n";
+    if (!save_path.empty())
+      lpv.save(save_path);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  Scenario validation = validationScenario();
+  auto start = Clock::now();
+  Trace ref = physicsTrace(validation, period);
+  double physics_s = secondsSince(start);
+  size_t periods = ref.u.size() / nu;
+
+  // Open-loop surrogate run on the recorded inputs, repeated for timing
+  std::vector<double> xs, ys(periods * ny);
+  const int repeats = 50;
+  start = Clock::now();
+  for (int r = 0; r < repeats; r++) {
+    double x[nx];
+    std::copy(ref.x.begin(), ref.x.begin() + nx, x);
+    xs.clear();
+    for (size_t k = 0; k < periods; k++) {
+      lpv.step(x, &ref.u[k * nu], &ys[k * ny]);
+      xs.insert(xs.end(), x, x + nx);
+    }
+  }
+  double surrogate_s = secondsSince(start) / repeats;
+
+  std::cout << std::scientific << std::setprecision(3) << "\nvalidation ("
+            << validation.duration() << " s, " << periods
+            << " periods), surrogate vs physics:\n states\n";
+  printErrors(LinearModel::state_names, nx, ref.x, xs, 1);
+  std::cout << " outputs\n";
+  printErrors(LinearModel::output_names, ny, ref.y, ys, 0);
+
+  std::cout << std::fixed << std::setprecision(3) << "\nphysics "
+            << physics_s * 1e3 << " ms, surrogate " << surrogate_s * 1e3
+            << " ms (" << std::setprecision(0) << physics_s / surrogate_s
+            << "x)\n";
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Design-of-experiments sweeps over a shared directory, split across any
+// number of worker processes on any nodes.
+//
+//   f1-pu-sweep plan <sweep-file> --dir D [--shard-size n]
+//   f1-pu-sweep work --dir D [--lease s] [--attempts n] [--threads n]
+//                    [--id name]
+//   f1-pu-sweep status --dir D [--lease s]
+//   f1-pu-sweep merge --dir D [--out file]
+//
+// plan expands the sweep file (see include/sweep.hpp) into shards under
+// D. work claims, runs and records shards until none are left, taking
+// over leases abandoned for longer than --lease seconds (default 60).
+// merge writes D/results.csv (or --out) once every shard has finished.
+#include "../include/sweep.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static int usage() {
+  std::cerr << "usage: f1-pu-sweep plan <sweep-file> --dir D [--shard-size n]\n"
+               "       f1-pu-sweep work --dir D [--lease s] [--attempts n] "
+               "[--threads n] [--id name]\n"
+               "       f1-pu-sweep status --dir D [--lease s]\n"
+               "       f1-pu-sweep merge --dir D [--out file]\n";
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2)
+    return usage();
+  std::string command = argv[1];
+
+  std::string dir, sweep_file, out_path;
+  int shard_size = 16;
+  SweepWorkerOptions worker;
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+      dir = argv[++i];
+    else if (std::strcmp(argv[i], "--shard-size") == 0 && i + 1 < argc)
+      shard_size = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--lease") == 0 && i + 1 < argc)
+      worker.lease_seconds = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--attempts") == 0 && i + 1 < argc)
+      worker.max_attempts = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      worker.threads = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--id") == 0 && i + 1 < argc)
+      worker.worker_id = argv[++i];
+    else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+      out_path = argv[++i];
+    else if (command == "plan" && sweep_file.empty() && argv[i][0] != '-')
+      sweep_file = argv[i];
+    else
+      return usage();
+  }
+  if (dir.empty() || (command == "plan" && sweep_file.empty()))
+    return usage();
+
+  try {
+    if (command == "plan") {
+      SweepPlan plan = loadSweep(sweep_file);
+      int shards = planSweep(dir, plan, shard_size);
+      std::cout << plan.points.size() << " jobs in " << shards
+                << " shards under " << dir << "\n";
+    } else if (command == "work") {
+      SweepWorkerReport r = runSweepWorker(dir, worker);
+      std::cout << "ran " << r.shards << " shards (" << r.jobs << " jobs, "
+                << r.job_errors << " errors), reclaimed " << r.reclaimed
+                << " abandoned leases, lost " << r.lost << "\n";
+    } else if (command == "status") {
+      SweepStatus s = sweepStatus(dir, worker.lease_seconds);
+      std::cout << s.shards << " shards: " << s.pending << " pending, "
+                << s.leased << " leased (" << s.stale << " stale), "
+                << s.done << " done, " << s.failed << " failed\n";
+    } else if (command == "merge") {
+      if (out_path.empty())
+        out_path = dir + "/results.csv";
+      size_t rows = mergeSweep(dir, out_path);
+      std::cout << rows << " rows written to " << out_path << "\n";
+    } else {
+      return usage();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
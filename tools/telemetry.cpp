@@ -0,0 +1,216 @@
+// Inspect, convert and check compressed telemetry logs.
+//
+//   f1-pu-telemetry info   <log.f1pz>
+//   f1-pu-telemetry decode <log.f1pz> [out.csv]
+//   f1-pu-telemetry encode <log.csv>  <out.f1pz> [dt] [--micro]
+//   f1-pu-telemetry check  [scenario...]
+//
+// decode writes the same CSV format as the simulator (6 decimals). An
+// EXACT-coded .f1pz keeps the exact double values; a MICRO-coded one
+// (encode --micro, f1-pu --compressed-micro) only what the CSV shows.
+//
+// check runs golden scenarios (default: all of them, see f1-pu-golden
+// list), logging every step, and writes each as CSV and as both codings.
+// EXACT must read back bit-exact and both must decode to the identical
+// CSV text; exits 1 otherwise.
+#include "../include/golden.hpp"
+#include "../include/telemetry.hpp"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static int usage() {
+  std::cerr
+      << "usage: f1-pu-telemetry info <log.f1pz>\n"
+         "       f1-pu-telemetry decode <log.f1pz> [out.csv]\n"
+         "       f1-pu-telemetry encode <log.csv> <out.f1pz> [dt] [--micro]\n"
+         "       f1-pu-telemetry check [scenario...]\n";
+  return 2;
+}
+
+static int info(const std::string &path) {
+  TelemetryTrace trace = readCompressedTelemetry(path);
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  double bytes = double(in.tellg());
+  size_t rows = trace.time.size();
+  size_t values = rows * (trace.channels.size() + 1);
+
+  std::cout << path << ": " << rows << " rows x " << trace.channels.size()
+            << " channels, dt " << trace.dt << " s\n"
+            << "  " << bytes << " bytes, " << (values ? 8.0 * bytes / values : 0)
+            << " bits/value\n";
+  return 0;
+}
+
+static int decode(const std::string &path, const std::string &csv_path) {
+  TelemetryTrace trace = readCompressedTelemetry(path);
+  CsvTelemetryWriter csv(csv_path, trace.channels, trace.dt);
+  std::vector<double> row(trace.channels.size());
+  for (size_t r = 0; r < trace.time.size(); r++) {
+    for (size_t c = 0; c < row.size(); c++)
+      row[c] = trace.values[c][r];
+    // Timestamps are stored as step indices
+    csv.write(int64_t(std::llround(trace.time[r] / trace.dt)), row.data());
+  }
+  csv.close();
+  return 0;
+}
+
+// Re-encodes an existing CSV log. Values are only as exact as the text.
+static int encode(const std::string &csv_path, const std::string &path,
+                  double dt, TelemetryCoding coding) {
+  std::ifstream in(csv_path);
+  if (!in) {
+    std::cerr << "cannot open " << csv_path << "\n";
+    return 1;
+  }
+
+  std::string line, cell;
+  std::getline(in, line);
+  std::vector<std::string> channels;
+  std::stringstream header(line);
+  std::getline(header, cell, ','); // time
+  while (std::getline(header, cell, ','))
+    channels.push_back(cell);
+
+  CompressedTelemetryWriter out(path, channels, dt, coding);
+  std::vector<double> row(channels.size());
+  while (std::getline(in, line)) {
+    std::stringstream fields(line);
+    std::getline(fields, cell, ',');
+    int64_t step = std::llround(std::stod(cell) / dt);
+    for (double &v : row) {
+      std::getline(fields, cell, ',');
+      v = std::stod(cell);
+    }
+    out.write(step, row.data());
+  }
+  out.close();
+  return 0;
+}
+
+static std::string readText(const std::string &path) {
+  std::ifstream in(path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+// 1-based line of the first difference
+static size_t firstDiffLine(const std::string &a, const std::string &b) {
+  size_t line = 1;
+  for (size_t i = 0; i < a.size() && i < b.size() && a[i] == b[i]; i++)
+    line += a[i] == '\n';
+  return line;
+}
+
+static bool sameBits(const std::vector<double> &a,
+                     const std::vector<double> &b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+}
+
+static bool roundTrip(const GoldenScenario &scenario, const std::string &dir) {
+  GoldenScenario every_step = scenario;
+  every_step.log_interval = 1;
+  TelemetryTrace trace = runGoldenScenario(every_step).trace;
+  std::string name = dir + "/" + scenario.scenario.name;
+
+  CsvTelemetryWriter csv(name + ".csv", trace.channels, trace.dt);
+  CompressedTelemetryWriter exact(name + "_exact.f1pz", trace.channels,
+                                  trace.dt, TelemetryCoding::EXACT);
+  CompressedTelemetryWriter micro(name + "_micro.f1pz", trace.channels,
+                                  trace.dt, TelemetryCoding::MICRO);
+  std::vector<double> row(trace.channels.size());
+  for (size_t r = 0; r < trace.time.size(); r++) {
+    for (size_t c = 0; c < row.size(); c++)
+      row[c] = trace.values[c][r];
+    int64_t step = std::llround(trace.time[r] / trace.dt);
+    csv.write(step, row.data());
+    exact.write(step, row.data());
+    micro.write(step, row.data());
+  }
+  csv.close();
+  exact.close();
+  micro.close();
+  std::string text = readText(name + ".csv");
+
+  bool ok = true;
+  TelemetryTrace back = readCompressedTelemetry(name + "_exact.f1pz");
+  for (size_t c = 0; c < trace.channels.size(); c++)
+    if (!sameBits(back.values[c], trace.values[c])) {
+      std::cout << scenario.scenario.name << ": EXACT changed "
+                << trace.channels[c] << "\n";
+      ok = false;
+    }
+
+  for (const char *coding : {"exact", "micro"}) {
+    std::string f1pz = name + "_" + coding + ".f1pz";
+    decode(f1pz, name + "_" + coding + ".csv");
+    std::string decoded = readText(name + "_" + coding + ".csv");
+    std::ifstream in(f1pz, std::ios::binary | std::ios::ate);
+    double ratio = double(text.size()) / double(in.tellg());
+    if (decoded == text) {
+      std::cout << scenario.scenario.name << ": " << coding << " ok, "
+                << trace.time.size() << " rows, " << ratio
+                << "x smaller than CSV\n";
+    } else {
+      std::cout << scenario.scenario.name << ": " << coding
+                << " CSV text differs at line "
+                << firstDiffLine(decoded, text) << "\n";
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static int check(int argc, char **argv) {
+  std::vector<const GoldenScenario *> scenarios;
+  for (int i = 2; i < argc; i++)
+    scenarios.push_back(&findGoldenScenario(argv[i]));
+  if (scenarios.empty())
+    for (const GoldenScenario &g : goldenScenarios())
+      scenarios.push_back(&g);
+
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "f1-pu-telemetry-check";
+  std::filesystem::create_directories(dir);
+  bool ok = true;
+  for (const GoldenScenario *g : scenarios)
+    ok = roundTrip(*g, dir.string()) && ok;
+  std::filesystem::remove_all(dir);
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 2 && std::strcmp(argv[1], "check") == 0) {
+    try {
+      return check(argc, argv);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  }
+  if (argc < 3)
+    return usage();
+
+  try {
+    if (std::strcmp(argv[1], "info") == 0)
+      return info(argv[2]);
+    if (std::strcmp(argv[1], "decode") == 0)
+      return decode(argv[2], argc > 3 ? argv[3] : "/dev/stdout");
+    if (std::strcmp(argv[1], "encode") == 0 && argc > 3) {
+      bool micro = std::strcmp(argv[argc - 1], "--micro") == 0;
+      int last = micro ? argc - 1 : argc;
+      return encode(argv[2], argv[3], last > 4 ? std::stod(argv[4]) : 0.0001,
+                    micro ? TelemetryCoding::MICRO : TelemetryCoding::EXACT);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return usage();
+}